@@ -89,6 +89,45 @@ nautilus_info_provider_cancel_update (NautilusInfoProvider *provider,
 								    handle);
 }
 
+gboolean
+nautilus_info_provider_supports_batch (NautilusInfoProvider *provider)
+{
+	NautilusInfoProviderIface *iface;
+
+	g_return_val_if_fail (NAUTILUS_IS_INFO_PROVIDER (provider), FALSE);
+
+	iface = NAUTILUS_INFO_PROVIDER_GET_IFACE (provider);
+
+	return iface->update_file_info_batch != NULL &&
+		iface->complete_file_info_batch != NULL;
+}
+
+/* Called from a worker thread. */
+gpointer
+nautilus_info_provider_update_file_info_batch (NautilusInfoProvider *provider,
+					       GList *locations,
+					       GCancellable *cancellable)
+{
+	g_return_val_if_fail (NAUTILUS_IS_INFO_PROVIDER (provider), NULL);
+	g_return_val_if_fail (NAUTILUS_INFO_PROVIDER_GET_IFACE (provider)->update_file_info_batch != NULL,
+			      NULL);
+
+	return NAUTILUS_INFO_PROVIDER_GET_IFACE (provider)->update_file_info_batch
+		(provider, locations, cancellable);
+}
+
+void
+nautilus_info_provider_complete_file_info_batch (NautilusInfoProvider *provider,
+						 GList *files,
+						 gpointer data)
+{
+	g_return_if_fail (NAUTILUS_IS_INFO_PROVIDER (provider));
+	g_return_if_fail (NAUTILUS_INFO_PROVIDER_GET_IFACE (provider)->complete_file_info_batch != NULL);
+
+	NAUTILUS_INFO_PROVIDER_GET_IFACE (provider)->complete_file_info_batch
+		(provider, files, data);
+}
+
 void
 nautilus_info_provider_update_complete_invoke (GClosure *update_complete,
 					       NautilusInfoProvider *provider,
@@ -57,6 +57,21 @@ struct _NautilusInfoProviderIface {
 						     NautilusOperationHandle **handle);
 	void                    (*cancel_update)    (NautilusInfoProvider     *provider,
 						     NautilusOperationHandle  *handle);
+
+	/* Optional batch interface. When both are implemented they are
+	 * used instead of update_file_info. update_file_info_batch runs
+	 * in a worker thread shared by all providers, gets the locations
+	 * of up to a few dozen files and returns whatever it computed;
+	 * it must not touch the files themselves. complete_file_info_batch
+	 * is then called in the main loop with the files that still want
+	 * the info, which may be none, and must apply and free the data.
+	 */
+	gpointer                (*update_file_info_batch)   (NautilusInfoProvider *provider,
+							     GList                *locations,
+							     GCancellable         *cancellable);
+	void                    (*complete_file_info_batch) (NautilusInfoProvider *provider,
+							     GList                *files,
+							     gpointer              data);
 };
 
 /* Interface Functions */
@@ -67,6 +82,13 @@ NautilusOperationResult nautilus_info_provider_update_file_info       (NautilusI
 								       NautilusOperationHandle **handle);
 void                    nautilus_info_provider_cancel_update          (NautilusInfoProvider     *provider,
 								       NautilusOperationHandle  *handle);
+gboolean                nautilus_info_provider_supports_batch         (NautilusInfoProvider     *provider);
+gpointer                nautilus_info_provider_update_file_info_batch (NautilusInfoProvider     *provider,
+								       GList                    *locations,
+								       GCancellable             *cancellable);
+void                    nautilus_info_provider_complete_file_info_batch (NautilusInfoProvider   *provider,
+									 GList                  *files,
+									 gpointer                data);
 
 
 
@@ -0,0 +1,936 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+ *
+ * nautilus-bookmark-status.c: whether bookmarked locations exist,
+ * checked in the background
+ *
+ * Nautilus is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * Nautilus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; see the file COPYING.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <config.h>
+#include "nautilus-bookmark-status.h"
+
+#include "nautilus-lib-self-check-functions.h"
+
+#define DEBUG_FLAG NAUTILUS_DEBUG_BOOKMARKS
+#include "nautilus-debug.h"
+
+#include <eel/eel-debug.h>
+#include <gio/gunixmounts.h>
+#include <glib/gstdio.h>
+#include <errno.h>
+#include <string.h>
+
+#define CACHE_VERSION 1
+/* (version, [(uri, exists, last checked)]) */
+#define CACHE_FORMAT "(ua(sbx))"
+
+/* Seconds to wait after a change before writing the cache */
+#define SAVE_DELAY 10
+/* Locations not checked for this long are dropped, in seconds */
+#define MAX_UNCHECKED_AGE (90 * 24 * 60 * 60)
+
+/* Checks running at once, at most one of them per host */
+#define MAX_RUNNING_CHECKS 4
+/* Seconds a host has to answer */
+#define CHECK_TIMEOUT 5
+/* Seconds a host is left alone after its first failure, doubled after
+ * each further failure up to the maximum.
+ */
+#define MIN_BACKOFF 30
+#define MAX_BACKOFF (60 * 60)
+
+typedef struct {
+	gboolean exists;
+	gint64 last_checked;
+} CacheItem;
+
+typedef struct Host Host;
+
+typedef struct {
+	GFile *location;
+	char *uri;
+	NautilusBookmarkStatusFunc callback;
+	gpointer user_data;
+	Host *host;
+
+	/* While running */
+	GCancellable *cancellable;
+	guint timeout_id;
+} Check;
+
+struct Host {
+	char *key;
+	GQueue waiting;
+	Check *running;
+	guint failures;
+	/* Monotonic time before which the host is not tried again */
+	gint64 retry_time;
+};
+
+static GHashTable *cache;
+static guint save_timeout_id;
+static gboolean dirty;
+
+static GHashTable *hosts;
+static guint running_checks;
+static guint retry_timeout_id;
+
+/* Where local file systems are mounted, and when that was read */
+static GList *mount_paths;
+static guint64 mount_paths_time;
+
+static void schedule_checks (void);
+
+static char *
+get_cache_path (void)
+{
+	return g_build_filename (g_get_user_cache_dir (), "nautilus",
+				 "bookmark-status", NULL);
+}
+
+static void
+load_cache (void)
+{
+	GMappedFile *file;
+	GVariant *variant, *items;
+	GVariantIter iter;
+	CacheItem *item;
+	guint32 version;
+	gboolean exists;
+	gint64 last_checked;
+	char *path, *uri;
+
+	path = get_cache_path ();
+	file = g_mapped_file_new (path, FALSE, NULL);
+	g_free (path);
+	if (file == NULL) {
+		return;
+	}
+
+	variant = g_variant_new_from_data (G_VARIANT_TYPE (CACHE_FORMAT),
+					   g_mapped_file_get_contents (file),
+					   g_mapped_file_get_length (file),
+					   FALSE,
+					   (GDestroyNotify) g_mapped_file_unref,
+					   file);
+	g_variant_ref_sink (variant);
+
+	g_variant_get (variant, "(u@a(sbx))", &version, &items);
+	if (version == CACHE_VERSION) {
+		g_variant_iter_init (&iter, items);
+		while (g_variant_iter_next (&iter, "(sbx)", &uri, &exists, &last_checked)) {
+			item = g_new0 (CacheItem, 1);
+			item->exists = exists;
+			item->last_checked = last_checked;
+			g_hash_table_replace (cache, uri, item);
+		}
+	}
+
+	g_variant_unref (items);
+	g_variant_unref (variant);
+
+	DEBUG ("Loaded %u bookmark status cache entries", g_hash_table_size (cache));
+}
+
+static GVariant *
+cache_to_variant (void)
+{
+	GVariantBuilder builder;
+	GHashTableIter iter;
+	CacheItem *item;
+	const char *uri;
+	gint64 now;
+
+	now = g_get_real_time () / G_USEC_PER_SEC;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(sbx)"));
+	g_hash_table_iter_init (&iter, cache);
+	while (g_hash_table_iter_next (&iter, (gpointer *) &uri, (gpointer *) &item)) {
+		if (now - item->last_checked > MAX_UNCHECKED_AGE) {
+			g_hash_table_iter_remove (&iter);
+			continue;
+		}
+
+		g_variant_builder_add (&builder, "(sbx)",
+				       uri, item->exists, item->last_checked);
+	}
+
+	return g_variant_ref_sink (g_variant_new ("(u@a(sbx))",
+						  CACHE_VERSION,
+						  g_variant_builder_end (&builder)));
+}
+
+static void
+write_cache (GVariant *variant)
+{
+	char *path, *dirname;
+	GError *error;
+
+	path = get_cache_path ();
+	dirname = g_path_get_dirname (path);
+
+	error = NULL;
+	if (g_mkdir_with_parents (dirname, 0700) != 0 ||
+	    !g_file_set_contents (path,
+				  g_variant_get_data (variant),
+				  g_variant_get_size (variant),
+				  &error)) {
+		DEBUG ("Could not save the bookmark status cache: %s",
+		       error != NULL ? error->message : g_strerror (errno));
+		g_clear_error (&error);
+	}
+
+	g_free (dirname);
+	g_free (path);
+}
+
+static void
+save_thread (GTask *task,
+	     gpointer source_object,
+	     gpointer task_data,
+	     GCancellable *cancellable)
+{
+	write_cache (task_data);
+	g_task_return_boolean (task, TRUE);
+}
+
+static gboolean
+save_timeout_callback (gpointer user_data)
+{
+	GTask *task;
+
+	save_timeout_id = 0;
+	dirty = FALSE;
+
+	task = g_task_new (NULL, NULL, NULL, NULL);
+	g_task_set_task_data (task, cache_to_variant (), (GDestroyNotify) g_variant_unref);
+	g_task_run_in_thread (task, save_thread);
+	g_object_unref (task);
+
+	return FALSE;
+}
+
+static void
+schedule_save (void)
+{
+	dirty = TRUE;
+	if (save_timeout_id == 0) {
+		save_timeout_id = g_timeout_add_seconds (SAVE_DELAY, save_timeout_callback, NULL);
+	}
+}
+
+static Check *
+check_new (GFile *location,
+	   NautilusBookmarkStatusFunc callback,
+	   gpointer user_data,
+	   Host *host)
+{
+	Check *check;
+
+	check = g_new0 (Check, 1);
+	check->location = g_object_ref (location);
+	check->uri = g_file_get_uri (location);
+	check->callback = callback;
+	check->user_data = user_data;
+	check->host = host;
+
+	return check;
+}
+
+static void
+check_free (Check *check)
+{
+	g_object_unref (check->location);
+	g_free (check->uri);
+	g_clear_object (&check->cancellable);
+	g_free (check);
+}
+
+static Host *
+host_new (const char *key)
+{
+	Host *host;
+
+	host = g_new0 (Host, 1);
+	host->key = g_strdup (key);
+	g_queue_init (&host->waiting);
+
+	return host;
+}
+
+static void
+host_free (Host *host)
+{
+	g_queue_foreach (&host->waiting, (GFunc) check_free, NULL);
+	g_queue_clear (&host->waiting);
+	g_free (host->key);
+	g_free (host);
+}
+
+static void
+free_state (void)
+{
+	GHashTableIter iter;
+	Host *host;
+	GVariant *variant;
+
+	if (retry_timeout_id != 0) {
+		g_source_remove (retry_timeout_id);
+		retry_timeout_id = 0;
+	}
+
+	/* Running checks finish on their own and find nothing to report to */
+	g_hash_table_iter_init (&iter, hosts);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &host)) {
+		if (host->running != NULL) {
+			host->running->callback = NULL;
+			host->running->host = NULL;
+			if (host->running->timeout_id != 0) {
+				g_source_remove (host->running->timeout_id);
+				host->running->timeout_id = 0;
+			}
+			g_cancellable_cancel (host->running->cancellable);
+		}
+	}
+	g_hash_table_destroy (hosts);
+	hosts = NULL;
+	running_checks = 0;
+
+	g_list_free_full (mount_paths, g_free);
+	mount_paths = NULL;
+
+	if (save_timeout_id != 0) {
+		g_source_remove (save_timeout_id);
+		save_timeout_id = 0;
+	}
+
+	if (dirty) {
+		variant = cache_to_variant ();
+		write_cache (variant);
+		g_variant_unref (variant);
+	}
+
+	g_hash_table_destroy (cache);
+	cache = NULL;
+}
+
+static void
+ensure_state (void)
+{
+	if (cache != NULL) {
+		return;
+	}
+
+	cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+	hosts = g_hash_table_new_full (g_str_hash, g_str_equal,
+				       NULL, (GDestroyNotify) host_free);
+	load_cache ();
+
+	eel_debug_call_at_shutdown (free_state);
+}
+
+/* Whether @path is on the file system mounted at @mount_path */
+static gboolean
+path_is_on_mount (const char *path,
+		  const char *mount_path)
+{
+	gsize length;
+
+	length = strlen (mount_path);
+	if (length > 0 && mount_path[length - 1] == '/') {
+		length--;
+	}
+
+	return strncmp (path, mount_path, length) == 0 &&
+		(path[length] == '\0' || path[length] == '/');
+}
+
+/* Reading the mount table does no I/O on the mounts themselves, so it
+ * does not hang on one that does not answer.
+ */
+static char *
+get_mount_path (const char *path)
+{
+	GList *mounts, *l;
+	const char *best;
+
+	if (mount_paths == NULL || g_unix_mounts_changed_since (mount_paths_time)) {
+		g_list_free_full (mount_paths, g_free);
+		mount_paths = NULL;
+
+		mounts = g_unix_mounts_get (&mount_paths_time);
+		for (l = mounts; l != NULL; l = l->next) {
+			mount_paths = g_list_prepend (mount_paths,
+						      g_strdup (g_unix_mount_get_mount_path (l->data)));
+		}
+		g_list_free_full (mounts, (GDestroyNotify) g_unix_mount_free);
+	}
+
+	best = "/";
+	for (l = mount_paths; l != NULL; l = l->next) {
+		if (strlen (l->data) > strlen (best) &&
+		    path_is_on_mount (path, l->data)) {
+			best = l->data;
+		}
+	}
+
+	return g_strdup (best);
+}
+
+/* Local files are told apart by the mount they are on, so a network
+ * mount that hangs does not hold up the others. Remote ones are told
+ * apart by scheme and server.
+ */
+static char *
+get_host_key (GFile *location)
+{
+	char *uri, *start, *end, *path, *mount_path, *key;
+
+	if (g_file_is_native (location)) {
+		path = g_file_get_path (location);
+		mount_path = get_mount_path (path != NULL ? path : "/");
+		key = g_strconcat ("file://", mount_path, NULL);
+		g_free (mount_path);
+		g_free (path);
+
+		return key;
+	}
+
+	uri = g_file_get_uri (location);
+	start = strstr (uri, "://");
+	if (start != NULL) {
+		end = strchr (start + 3, '/');
+		if (end != NULL) {
+			*end = '\0';
+		}
+	}
+
+	return uri;
+}
+
+static void
+store_status (const char *uri,
+	      gboolean exists)
+{
+	CacheItem *item;
+
+	item = g_hash_table_lookup (cache, uri);
+	if (item == NULL) {
+		item = g_new0 (CacheItem, 1);
+		g_hash_table_insert (cache, g_strdup (uri), item);
+	}
+
+	item->exists = exists;
+	item->last_checked = g_get_real_time () / G_USEC_PER_SEC;
+
+	schedule_save ();
+}
+
+/* Seconds to leave a host alone after its failures so far */
+static guint
+get_backoff (guint failures)
+{
+	guint backoff;
+
+	backoff = MIN_BACKOFF << MIN (failures, 16);
+	return MIN (backoff, MAX_BACKOFF);
+}
+
+static void
+host_failed (Host *host)
+{
+	guint backoff;
+
+	backoff = get_backoff (host->failures);
+	host->failures++;
+	host->retry_time = g_get_monotonic_time () + (gint64) backoff * G_USEC_PER_SEC;
+
+	DEBUG ("%s: not answering, next try in %u seconds", host->key, backoff);
+}
+
+static void
+check_done (Check *check)
+{
+	Host *host;
+
+	host = check->host;
+	if (host != NULL) {
+		host->running = NULL;
+	}
+	if (check->timeout_id != 0) {
+		g_source_remove (check->timeout_id);
+		check->timeout_id = 0;
+	}
+	running_checks--;
+}
+
+/* Whether the host did not answer, rather than answered with an error */
+static gboolean
+is_host_failure (const GError *error)
+{
+	return g_error_matches (error, G_IO_ERROR, G_IO_ERROR_HOST_NOT_FOUND) ||
+		g_error_matches (error, G_IO_ERROR, G_IO_ERROR_HOST_UNREACHABLE) ||
+		g_error_matches (error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT);
+}
+
+/* Reports the last known status, a location never checked is taken
+ * to be there.
+ */
+static void
+check_report_cached (Check *check)
+{
+	gboolean exists;
+
+	exists = TRUE;
+	nautilus_bookmark_status_lookup (check->location, &exists);
+	/* Unless no longer wanted */
+	if (check->callback != NULL) {
+		check->callback (check->location, exists, check->user_data);
+	}
+}
+
+/* Reports the result, or puts the check back in the queue if the host
+ * is to be tried again later.
+ */
+static void
+check_finish (Check *check,
+	      GFileInfo *info,
+	      const GError *error)
+{
+	Host *host;
+	gboolean known, exists;
+
+	host = check->host;
+
+	known = TRUE;
+	exists = FALSE;
+	if (info != NULL) {
+		exists = TRUE;
+		host->failures = 0;
+	} else if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_MOUNTED)) {
+		/* Says nothing about the location, so keep what we had */
+		known = FALSE;
+		host->failures = 0;
+	} else if (is_host_failure (error)) {
+		DEBUG ("%s: %s", check->uri, error->message);
+		known = FALSE;
+
+		/* Local files have no host to wait for. Remote ones are
+		 * tried again once the host is given another chance.
+		 */
+		if (!g_file_is_native (check->location)) {
+			host_failed (host);
+			if (check->callback != NULL) {
+				g_clear_object (&check->cancellable);
+				g_queue_push_head (&host->waiting, check);
+				return;
+			}
+		}
+	} else {
+		/* The host answered, so the location is not there for us */
+		host->failures = 0;
+	}
+
+	if (!known) {
+		check_report_cached (check);
+		check_free (check);
+		return;
+	}
+
+	store_status (check->uri, exists);
+	/* Unless no longer wanted */
+	if (check->callback != NULL) {
+		check->callback (check->location, exists, check->user_data);
+	}
+	check_free (check);
+}
+
+static void
+query_info_callback (GObject *source,
+		     GAsyncResult *res,
+		     gpointer user_data)
+{
+	Check *check;
+	GFileInfo *info;
+	GError *error;
+
+	check = user_data;
+
+	error = NULL;
+	info = g_file_query_info_finish (G_FILE (source), res, &error);
+
+	if (check->host == NULL) {
+		/* Timed out or shutting down, nothing waits for it */
+		g_clear_error (&error);
+		g_clear_object (&info);
+		check_free (check);
+		return;
+	}
+
+	check_done (check);
+
+	check_finish (check, info, error);
+
+	g_clear_error (&error);
+	g_clear_object (&info);
+
+	schedule_checks ();
+}
+
+/* A query stuck in a blocking call is not stopped by cancelling it, so
+ * the host's slot is given back and the last known status reported
+ * now. The query finishes on its own.
+ */
+static void
+check_timed_out (Check *check)
+{
+	Host *host;
+
+	host = check->host;
+
+	DEBUG ("%s: timed out", check->uri);
+
+	g_cancellable_cancel (check->cancellable);
+	check_done (check);
+	check->host = NULL;
+	host_failed (host);
+
+	check_report_cached (check);
+	check->callback = NULL;
+}
+
+static gboolean
+check_timeout_callback (gpointer user_data)
+{
+	Check *check;
+
+	check = user_data;
+	check->timeout_id = 0;
+	check_timed_out (check);
+
+	schedule_checks ();
+
+	return FALSE;
+}
+
+static void
+start_check (Host *host)
+{
+	Check *check;
+
+	check = g_queue_pop_head (&host->waiting);
+	host->running = check;
+	running_checks++;
+
+	DEBUG ("%s: checking", check->uri);
+
+	check->cancellable = g_cancellable_new ();
+	check->timeout_id = g_timeout_add_seconds (CHECK_TIMEOUT, check_timeout_callback, check);
+	g_file_query_info_async (check->location,
+				 G_FILE_ATTRIBUTE_STANDARD_TYPE,
+				 0, G_PRIORITY_LOW,
+				 check->cancellable,
+				 query_info_callback, check);
+}
+
+static gboolean
+retry_timeout_callback (gpointer user_data)
+{
+	retry_timeout_id = 0;
+	schedule_checks ();
+
+	return FALSE;
+}
+
+static void
+schedule_checks (void)
+{
+	GHashTableIter iter;
+	Host *host;
+	gint64 now, next_retry;
+
+	now = g_get_monotonic_time ();
+	next_retry = G_MAXINT64;
+
+	g_hash_table_iter_init (&iter, hosts);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &host)) {
+		if (host->running != NULL || g_queue_is_empty (&host->waiting)) {
+			continue;
+		}
+		if (host->retry_time > now) {
+			next_retry = MIN (next_retry, host->retry_time);
+			continue;
+		}
+		if (running_checks < MAX_RUNNING_CHECKS) {
+			start_check (host);
+		}
+	}
+
+	if (retry_timeout_id != 0) {
+		g_source_remove (retry_timeout_id);
+		retry_timeout_id = 0;
+	}
+	if (next_retry != G_MAXINT64) {
+		retry_timeout_id =
+			g_timeout_add_seconds ((next_retry - now) / G_USEC_PER_SEC + 1,
+					       retry_timeout_callback, NULL);
+	}
+}
+
+gboolean
+nautilus_bookmark_status_lookup (GFile *location,
+				 gboolean *exists)
+{
+	CacheItem *item;
+	char *uri;
+
+	ensure_state ();
+
+	uri = g_file_get_uri (location);
+	item = g_hash_table_lookup (cache, uri);
+	g_free (uri);
+
+	if (item == NULL) {
+		return FALSE;
+	}
+
+	*exists = item->exists;
+	return TRUE;
+}
+
+void
+nautilus_bookmark_status_check (GFile *location,
+				NautilusBookmarkStatusFunc callback,
+				gpointer user_data)
+{
+	Check *check;
+	Host *host;
+	char *key;
+
+	g_return_if_fail (G_IS_FILE (location));
+	g_return_if_fail (callback != NULL);
+
+	ensure_state ();
+
+	key = get_host_key (location);
+	host = g_hash_table_lookup (hosts, key);
+	if (host == NULL) {
+		host = host_new (key);
+		g_hash_table_insert (hosts, host->key, host);
+	}
+	g_free (key);
+
+	check = check_new (location, callback, user_data, host);
+	g_queue_push_tail (&host->waiting, check);
+
+	schedule_checks ();
+}
+
+void
+nautilus_bookmark_status_cancel (gpointer user_data)
+{
+	GHashTableIter iter;
+	Host *host;
+	Check *check;
+	GList *l, *next;
+
+	if (hosts == NULL) {
+		return;
+	}
+
+	g_hash_table_iter_init (&iter, hosts);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &host)) {
+		for (l = host->waiting.head; l != NULL; l = next) {
+			next = l->next;
+			check = l->data;
+			if (check->user_data == user_data) {
+				g_queue_delete_link (&host->waiting, l);
+				check_free (check);
+			}
+		}
+
+		/* The running one is let finish, so a slow host is not
+		 * asked again right away.
+		 */
+		check = host->running;
+		if (check != NULL && check->user_data == user_data) {
+			check->callback = NULL;
+		}
+	}
+}
+
+#if !defined (NAUTILUS_OMIT_SELF_CHECK)
+
+typedef struct {
+	int calls;
+	gboolean exists;
+} SelfCheckResult;
+
+static void
+self_check_status_callback (GFile *location,
+			    gboolean exists,
+			    gpointer user_data)
+{
+	SelfCheckResult *result;
+
+	result = user_data;
+	result->calls++;
+	result->exists = exists;
+}
+
+static void
+self_check_finish (Check *check,
+		   GIOErrorEnum code)
+{
+	GError *error;
+
+	error = g_error_new_literal (G_IO_ERROR, code, "self check");
+	check_finish (check, NULL, error);
+	g_error_free (error);
+}
+
+static char *
+self_check_get_host_key (const char *path)
+{
+	GFile *location;
+	char *key;
+
+	location = g_file_new_for_path (path);
+	key = get_host_key (location);
+	g_object_unref (location);
+
+	return key;
+}
+
+void
+nautilus_self_check_bookmark_status (void)
+{
+	SelfCheckResult result;
+	GError *error;
+	GFile *location;
+	Host *host;
+	Check *check;
+	gboolean was_dirty;
+	char *uri, *key;
+
+	EEL_CHECK_INTEGER_RESULT (get_backoff (0), MIN_BACKOFF);
+	EEL_CHECK_INTEGER_RESULT (get_backoff (1), MIN_BACKOFF * 2);
+	EEL_CHECK_INTEGER_RESULT (get_backoff (3), MIN_BACKOFF * 8);
+	EEL_CHECK_INTEGER_RESULT (get_backoff (7), MAX_BACKOFF);
+	EEL_CHECK_INTEGER_RESULT (get_backoff (100), MAX_BACKOFF);
+
+	/* Only a host that does not answer counts as failed */
+	error = g_error_new_literal (G_IO_ERROR, G_IO_ERROR_HOST_NOT_FOUND, "");
+	EEL_CHECK_BOOLEAN_RESULT (is_host_failure (error), TRUE);
+	error->code = G_IO_ERROR_HOST_UNREACHABLE;
+	EEL_CHECK_BOOLEAN_RESULT (is_host_failure (error), TRUE);
+	error->code = G_IO_ERROR_TIMED_OUT;
+	EEL_CHECK_BOOLEAN_RESULT (is_host_failure (error), TRUE);
+	error->code = G_IO_ERROR_CANCELLED;
+	EEL_CHECK_BOOLEAN_RESULT (is_host_failure (error), FALSE);
+	error->code = G_IO_ERROR_PERMISSION_DENIED;
+	EEL_CHECK_BOOLEAN_RESULT (is_host_failure (error), FALSE);
+	error->code = G_IO_ERROR_NOT_FOUND;
+	EEL_CHECK_BOOLEAN_RESULT (is_host_failure (error), FALSE);
+	g_error_free (error);
+
+	/* Local files are told apart by their mount */
+	EEL_CHECK_BOOLEAN_RESULT (path_is_on_mount ("/home/user", "/home"), TRUE);
+	EEL_CHECK_BOOLEAN_RESULT (path_is_on_mount ("/home", "/home/"), TRUE);
+	EEL_CHECK_BOOLEAN_RESULT (path_is_on_mount ("/homer", "/home"), FALSE);
+	EEL_CHECK_BOOLEAN_RESULT (path_is_on_mount ("/home", "/"), TRUE);
+	key = self_check_get_host_key ("/nautilus-self-check-a");
+	EEL_CHECK_BOOLEAN_RESULT (g_str_has_prefix (key, "file:///"), TRUE);
+	EEL_CHECK_STRING_RESULT (self_check_get_host_key ("/nautilus-self-check-b"), key);
+	g_free (key);
+
+	ensure_state ();
+	was_dirty = dirty;
+	memset (&result, 0, sizeof (result));
+
+	/* A check that times out gives its host's slot back at once and
+	 * reports the last known status, and the host is left alone.
+	 */
+	host = host_new ("sftp://nautilus-self-check.invalid");
+	location = g_file_new_for_uri ("sftp://nautilus-self-check.invalid/bookmark");
+	uri = g_file_get_uri (location);
+	store_status (uri, FALSE);
+	check = check_new (location, self_check_status_callback, &result, host);
+	host->running = check;
+	running_checks++;
+
+	check_timed_out (check);
+	EEL_CHECK_INTEGER_RESULT (result.calls, 1);
+	EEL_CHECK_BOOLEAN_RESULT (result.exists, FALSE);
+	EEL_CHECK_BOOLEAN_RESULT (host->running == NULL, TRUE);
+	EEL_CHECK_BOOLEAN_RESULT (check->host == NULL, TRUE);
+	EEL_CHECK_INTEGER_RESULT (host->failures, 1);
+	EEL_CHECK_BOOLEAN_RESULT (host->retry_time > g_get_monotonic_time (), TRUE);
+	check_free (check);
+
+	/* A remote check whose host is not found waits in the queue, and
+	 * the host is left alone longer each time.
+	 */
+	memset (&result, 0, sizeof (result));
+	check = check_new (location, self_check_status_callback, &result, host);
+	self_check_finish (check, G_IO_ERROR_HOST_NOT_FOUND);
+	EEL_CHECK_INTEGER_RESULT (result.calls, 0);
+	EEL_CHECK_INTEGER_RESULT (host->failures, 2);
+	EEL_CHECK_INTEGER_RESULT (g_queue_get_length (&host->waiting), 1);
+	EEL_CHECK_BOOLEAN_RESULT (host->retry_time - g_get_monotonic_time () >
+				  (gint64) get_backoff (0) * G_USEC_PER_SEC, TRUE);
+
+	/* Any other error is an answer, and the location is reported gone */
+	check = g_queue_pop_head (&host->waiting);
+	self_check_finish (check, G_IO_ERROR_PERMISSION_DENIED);
+	EEL_CHECK_INTEGER_RESULT (result.calls, 1);
+	EEL_CHECK_BOOLEAN_RESULT (result.exists, FALSE);
+	EEL_CHECK_INTEGER_RESULT (host->failures, 0);
+	EEL_CHECK_INTEGER_RESULT (g_queue_get_length (&host->waiting), 0);
+
+	/* A check no longer wanted is dropped, not queued again */
+	check = check_new (location, NULL, &result, host);
+	self_check_finish (check, G_IO_ERROR_TIMED_OUT);
+	EEL_CHECK_INTEGER_RESULT (result.calls, 1);
+	EEL_CHECK_INTEGER_RESULT (g_queue_get_length (&host->waiting), 0);
+
+	g_hash_table_remove (cache, uri);
+	g_free (uri);
+	g_object_unref (location);
+	host_free (host);
+
+	/* Local files are reported right away, with no backoff */
+	memset (&result, 0, sizeof (result));
+	host = host_new ("file:///");
+	location = g_file_new_for_path ("/nautilus-self-check-bookmark");
+	check = check_new (location, self_check_status_callback, &result, host);
+	self_check_finish (check, G_IO_ERROR_TIMED_OUT);
+	EEL_CHECK_INTEGER_RESULT (result.calls, 1);
+	EEL_CHECK_BOOLEAN_RESULT (result.exists, TRUE);
+	EEL_CHECK_INTEGER_RESULT (host->failures, 0);
+	EEL_CHECK_INTEGER_RESULT (g_queue_get_length (&host->waiting), 0);
+	g_object_unref (location);
+	host_free (host);
+
+	/* Leave the user's cache as it was */
+	if (!was_dirty && save_timeout_id != 0) {
+		g_source_remove (save_timeout_id);
+		save_timeout_id = 0;
+		dirty = FALSE;
+	}
+}
+
+#endif /* !NAUTILUS_OMIT_SELF_CHECK */
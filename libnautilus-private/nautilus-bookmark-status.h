@@ -0,0 +1,50 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+ *
+ * nautilus-bookmark-status.h: whether bookmarked locations exist,
+ * checked in the background
+ *
+ * Nautilus is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * Nautilus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; see the file COPYING.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef NAUTILUS_BOOKMARK_STATUS_H
+#define NAUTILUS_BOOKMARK_STATUS_H
+
+#include <gio/gio.h>
+
+/* Checks run a few at a time, one per host or local mount. A check that
+ * gets no answer in time reports the last known status. A host that
+ * failed is left alone for a while, longer after each failure, and its
+ * checks wait until then. The last
+ * status seen for each location is kept in the user's cache directory,
+ * so bookmarks show it right away on the next start.
+ */
+
+typedef void (* NautilusBookmarkStatusFunc) (GFile    *location,
+					     gboolean  exists,
+					     gpointer  user_data);
+
+/* The last known status, FALSE if the location was never checked */
+gboolean nautilus_bookmark_status_lookup (GFile                      *location,
+					  gboolean                   *exists);
+
+/* The callback is called once, when the check is done */
+void     nautilus_bookmark_status_check  (GFile                      *location,
+					  NautilusBookmarkStatusFunc  callback,
+					  gpointer                    user_data);
+/* Drops the checks requested with the user data */
+void     nautilus_bookmark_status_cancel (gpointer                    user_data);
+
+#endif /* NAUTILUS_BOOKMARK_STATUS_H */
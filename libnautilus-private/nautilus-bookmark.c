@@ -32,6 +32,7 @@
 #include <glib/gi18n.h>
 #include <gtk/gtk.h>
 
+#include <libnautilus-private/nautilus-bookmark-status.h>
 #include <libnautilus-private/nautilus-file.h>
 #include <libnautilus-private/nautilus-file-utilities.h>
 #include <libnautilus-private/nautilus-global-preferences.h>
@@ -71,8 +72,7 @@ struct NautilusBookmarkDetails
 	char *scroll_file;
 
 	gboolean exists;
-	guint exists_id;
-	GCancellable *cancellable;
+	gboolean checking_exists;
 };
 
 static void	  nautilus_bookmark_disconnect_file	  (NautilusBookmark	 *file);
@@ -322,14 +322,9 @@ nautilus_bookmark_disconnect_file (NautilusBookmark *bookmark)
 		g_clear_object (&bookmark->details->file);
 	}
 
-	if (bookmark->details->cancellable != NULL) {
-		g_cancellable_cancel (bookmark->details->cancellable);
-		g_clear_object (&bookmark->details->cancellable);
-	}
-
-	if (bookmark->details->exists_id != 0) {
-		g_source_remove (bookmark->details->exists_id);
-		bookmark->details->exists_id = 0;
+	if (bookmark->details->checking_exists) {
+		nautilus_bookmark_status_cancel (bookmark);
+		bookmark->details->checking_exists = FALSE;
 	}
 }
 
@@ -383,41 +378,15 @@ nautilus_bookmark_set_exists (NautilusBookmark *bookmark,
 	nautilus_bookmark_set_icon_to_default (bookmark);
 }
 
-static gboolean
-exists_non_native_idle_cb (gpointer user_data)
-{
-	NautilusBookmark *bookmark = user_data;
-	bookmark->details->exists_id = 0;
-	nautilus_bookmark_set_exists (bookmark, FALSE);
-
-	return FALSE;
-}
-
 static void
-exists_query_info_ready_cb (GObject *source,
-			    GAsyncResult *res,
-			    gpointer user_data)
+exists_status_cb (GFile *location,
+		  gboolean exists,
+		  gpointer user_data)
 {
-	GFileInfo *info;
 	NautilusBookmark *bookmark;
-	GError *error = NULL;
-	gboolean exists = FALSE;
 
-	info = g_file_query_info_finish (G_FILE (source), res, &error);
-	if (!info && g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
-		g_clear_error (&error);
-		return;
-	}
-
-	g_clear_error (&error);
 	bookmark = user_data;
-
-	if (info) {
-		exists = TRUE;
-
-		g_object_unref (info);
-		g_clear_object (&bookmark->details->cancellable);
-	}
+	bookmark->details->checking_exists = FALSE;
 
 	nautilus_bookmark_set_exists (bookmark, exists);
 }
@@ -425,24 +394,16 @@ exists_query_info_ready_cb (GObject *source,
 static void
 nautilus_bookmark_update_exists (NautilusBookmark *bookmark)
 {
-	/* Convert to a path, returning FALSE if not local. */
-	if (!g_file_is_native (bookmark->details->location) &&
-	    bookmark->details->exists_id == 0) {
-		bookmark->details->exists_id =
-			g_idle_add (exists_non_native_idle_cb, bookmark);
-		return;
-	}
-
-	if (bookmark->details->cancellable != NULL) {
+	if (bookmark->details->checking_exists) {
 		return;
 	}
 
-	bookmark->details->cancellable = g_cancellable_new ();
-	g_file_query_info_async (bookmark->details->location,
-				 G_FILE_ATTRIBUTE_STANDARD_TYPE,
-				 0, G_PRIORITY_DEFAULT,
-				 bookmark->details->cancellable,
-				 exists_query_info_ready_cb, bookmark);
+	/* Checked in the background, as remote locations can take long
+	 * to answer, or not answer at all.
+	 */
+	bookmark->details->checking_exists = TRUE;
+	nautilus_bookmark_status_check (bookmark->details->location,
+					exists_status_cb, bookmark);
 }
 
 /* GObject methods */
@@ -545,6 +506,12 @@ static void
 nautilus_bookmark_constructed (GObject *obj)
 {
 	NautilusBookmark *self = NAUTILUS_BOOKMARK (obj);
+	gboolean exists;
+
+	/* Start out with what the last check found */
+	if (nautilus_bookmark_status_lookup (self->details->location, &exists)) {
+		self->details->exists = exists;
+	}
 
 	nautilus_bookmark_connect_file (self);
 	nautilus_bookmark_update_exists (self);
@@ -240,6 +240,13 @@ typedef struct {
 	int num_rows;
 	int num_columns;
 	gboolean tight;
+
+	/* Cells are only ever marked, so these only move forward, and
+	 * let find_empty_location skip what is taken without looking.
+	 */
+	int *column_free_cells;
+	int *column_first_free_row;
+	int first_free_column;
 } PlacementGrid;
 
 static guint signals[LAST_SIGNAL];
@@ -431,6 +438,12 @@ icon_toggle_selected (NautilusCanvasContainer *container,
 		container->details->selection = g_list_remove (container->details->selection, icon->data);
 	}
 
+	if (container->details->selection_model != NULL) {
+		nautilus_selection_model_set_selected (container->details->selection_model,
+						       (NautilusFile *) icon->data,
+						       icon->is_selected);
+	}
+
 	eel_canvas_item_set (EEL_CANVAS_ITEM (icon->item),
 			     "highlighted_for_selection", (gboolean) icon->is_selected,
 			     NULL);
@@ -1398,13 +1411,38 @@ compare_icons_by_position (gconstpointer a, gconstpointer b)
 }
 
 static PlacementGrid *
-placement_grid_new (NautilusCanvasContainer *container, gboolean tight)
+placement_grid_new_with_size (int num_columns, int num_rows, gboolean tight)
 {
 	PlacementGrid *grid;
+	int i;
+
+	grid = g_new0 (PlacementGrid, 1);
+	grid->tight = tight;
+	grid->num_columns = num_columns;
+	grid->num_rows = num_rows;
+
+	grid->grid_memory = g_new0 (int, (num_rows * num_columns));
+	grid->icon_grid = g_new0 (int *, num_columns);
+	
+	for (i = 0; i < num_columns; i++) {
+		grid->icon_grid[i] = grid->grid_memory + (i * num_rows);
+	}
+
+	grid->column_free_cells = g_new (int, num_columns);
+	grid->column_first_free_row = g_new0 (int, num_columns);
+	for (i = 0; i < num_columns; i++) {
+		grid->column_free_cells[i] = num_rows;
+	}
+	
+	return grid;
+}
+
+static PlacementGrid *
+placement_grid_new (NautilusCanvasContainer *container, gboolean tight)
+{
 	int width, height;
 	int num_columns;
 	int num_rows;
-	int i;
 	GtkAllocation allocation;
 
 	/* Get container dimensions */
@@ -1419,19 +1457,7 @@ placement_grid_new (NautilusCanvasContainer *container, gboolean tight)
 		return NULL;
 	}
 
-	grid = g_new0 (PlacementGrid, 1);
-	grid->tight = tight;
-	grid->num_columns = num_columns;
-	grid->num_rows = num_rows;
-
-	grid->grid_memory = g_new0 (int, (num_rows * num_columns));
-	grid->icon_grid = g_new0 (int *, num_columns);
-	
-	for (i = 0; i < num_columns; i++) {
-		grid->icon_grid[i] = grid->grid_memory + (i * num_rows);
-	}
-	
-	return grid;
+	return placement_grid_new_with_size (num_columns, num_rows, tight);
 }
 
 static void
@@ -1439,6 +1465,8 @@ placement_grid_free (PlacementGrid *grid)
 {
 	g_free (grid->icon_grid);
 	g_free (grid->grid_memory);
+	g_free (grid->column_free_cells);
+	g_free (grid->column_first_free_row);
 	g_free (grid);
 }
 
@@ -1475,9 +1503,22 @@ placement_grid_mark (PlacementGrid *grid, EelIRect pos)
 
 	for (x = pos.x0; x <= pos.x1; x++) {
 		for (y = pos.y0; y <= pos.y1; y++) {
-			grid->icon_grid[x][y] = 1;
+			if (grid->icon_grid[x][y] == 0) {
+				grid->icon_grid[x][y] = 1;
+				grid->column_free_cells[x]--;
+			}
+		}
+
+		while (grid->column_first_free_row[x] < grid->num_rows &&
+		       grid->icon_grid[x][grid->column_first_free_row[x]] != 0) {
+			grid->column_first_free_row[x]++;
 		}
 	}
+
+	while (grid->first_free_column < grid->num_columns &&
+	       grid->column_free_cells[grid->first_free_column] == 0) {
+		grid->first_free_column++;
+	}
 }
 
 static void
@@ -1523,6 +1564,75 @@ placement_grid_mark_icon (PlacementGrid *grid, NautilusCanvasIcon *icon)
 	placement_grid_mark (grid, grid_pos);
 }
 
+/* Moves @icon_position down the columns, starting where it is, until
+ * it covers only free cells. @column_top is where a new column starts.
+ */
+static void
+placement_grid_find_empty (PlacementGrid *grid,
+			   EelIRect *icon_position,
+			   int height_for_bound_check,
+			   int column_top,
+			   int canvas_width,
+			   int canvas_height)
+{
+	int icon_width, icon_height;
+	gboolean collision;
+
+	icon_width = icon_position->x1 - icon_position->x0;
+	icon_height = icon_position->y1 - icon_position->y0;
+
+	do {
+		EelIRect grid_position;
+		gboolean need_new_column;
+		int skip_columns;
+
+		collision = FALSE;
+		
+		canvas_position_to_grid_position (grid,
+						  *icon_position,
+						  &grid_position);
+
+		need_new_column = icon_position->y0 + height_for_bound_check + DESKTOP_PAD_VERTICAL > canvas_height;
+		skip_columns = 1;
+
+		/* Moving on from a full column, or over the taken cells at
+		 * the top of a column, ends up where stepping through them
+		 * one at a time would. An icon past the right edge only
+		 * gets one step, so neither is skipped past there.
+		 */
+		if (need_new_column || icon_position->x1 >= canvas_width) {
+			/* Stepped through as before */
+		} else if (grid->column_free_cells[grid_position.x0] == 0) {
+			need_new_column = TRUE;
+			skip_columns = MIN (grid->first_free_column - grid_position.x0,
+					    (canvas_width - icon_position->x1 + SNAP_SIZE_X - 1) / SNAP_SIZE_X);
+			skip_columns = MAX (skip_columns, 1);
+		} else if (grid_position.y0 < grid->column_first_free_row[grid_position.x0]) {
+			icon_position->y0 += (grid->column_first_free_row[grid_position.x0] - grid_position.y0) * SNAP_SIZE_Y;
+			icon_position->y1 = icon_position->y0 + icon_height;
+			collision = TRUE;
+			continue;
+		}
+
+		if (need_new_column ||
+		    !placement_grid_position_is_free (grid, grid_position)) {
+			icon_position->y0 += SNAP_SIZE_Y;
+			icon_position->y1 = icon_position->y0 + icon_height;
+			
+			if (need_new_column) {
+				/* Move to the next column */
+				icon_position->y0 = column_top;
+				icon_position->y1 = icon_position->y0 + icon_height;
+				
+				icon_position->x0 += SNAP_SIZE_X * skip_columns;
+				icon_position->x1 = icon_position->x0 + icon_width;
+			}
+				
+			collision = TRUE;
+		}
+	} while (collision && (icon_position->x1 < canvas_width));
+}
+
 static void
 find_empty_location (NautilusCanvasContainer *container,
 		     PlacementGrid *grid,
@@ -1536,9 +1646,9 @@ find_empty_location (NautilusCanvasContainer *container,
 	int canvas_width;
 	int canvas_height;
 	int height_for_bound_check;
+	int column_top;
 	EelIRect icon_position;
 	EelDRect pixbuf_rect;
-	gboolean collision;
 	GtkAllocation allocation;
 
 	/* Get container dimensions */
@@ -1569,38 +1679,13 @@ find_empty_location (NautilusCanvasContainer *container,
 	icon_position.x1 = icon_position.x0 + icon_width;
 	icon_position.y1 = icon_position.y0 + icon_height;
 
-	do {
-		EelIRect grid_position;
-		gboolean need_new_column;
-
-		collision = FALSE;
-		
-		canvas_position_to_grid_position (grid,
-						  icon_position,
-						  &grid_position);
+	column_top = DESKTOP_PAD_VERTICAL + SNAP_SIZE_Y - (pixbuf_rect.y1 - pixbuf_rect.y0);
+	while (column_top < DESKTOP_PAD_VERTICAL) {
+		column_top += SNAP_SIZE_Y;
+	}
 
-		need_new_column = icon_position.y0 + height_for_bound_check + DESKTOP_PAD_VERTICAL > canvas_height;
-
-		if (need_new_column ||
-		    !placement_grid_position_is_free (grid, grid_position)) {
-			icon_position.y0 += SNAP_SIZE_Y;
-			icon_position.y1 = icon_position.y0 + icon_height;
-			
-			if (need_new_column) {
-				/* Move to the next column */
-				icon_position.y0 = DESKTOP_PAD_VERTICAL + SNAP_SIZE_Y - (pixbuf_rect.y1 - pixbuf_rect.y0);
-				while (icon_position.y0 < DESKTOP_PAD_VERTICAL) {
-					icon_position.y0 += SNAP_SIZE_Y;
-				}
-				icon_position.y1 = icon_position.y0 + icon_height;
-				
-				icon_position.x0 += SNAP_SIZE_X;
-				icon_position.x1 = icon_position.x0 + icon_width;
-			}
-				
-			collision = TRUE;
-		}
-	} while (collision && (icon_position.x1 < canvas_width));
+	placement_grid_find_empty (grid, &icon_position, height_for_bound_check,
+				   column_top, canvas_width, canvas_height);
 
 	*x = icon_position.x0;
 	*y = icon_position.y0;
@@ -5576,6 +5661,49 @@ nautilus_canvas_container_get_first_visible_icon (NautilusCanvasContainer *conta
 	return best_icon ? best_icon->data : NULL;
 }
 
+/* Returns the data of the positioned icons that intersect the scrolled
+ * area, in the container's order. Free the list with g_list_free().
+ */
+GList *
+nautilus_canvas_container_get_visible_icons (NautilusCanvasContainer *container)
+{
+	GList *l, *result;
+	NautilusCanvasIcon *icon;
+	GtkAdjustment *hadj, *vadj;
+	double left, top, right, bottom;
+	double x1, y1, x2, y2;
+
+	hadj = gtk_scrollable_get_hadjustment (GTK_SCROLLABLE (container));
+	vadj = gtk_scrollable_get_vadjustment (GTK_SCROLLABLE (container));
+
+	eel_canvas_c2w (EEL_CANVAS (container),
+			gtk_adjustment_get_value (hadj),
+			gtk_adjustment_get_value (vadj),
+			&left, &top);
+	eel_canvas_c2w (EEL_CANVAS (container),
+			gtk_adjustment_get_value (hadj) + gtk_adjustment_get_page_size (hadj),
+			gtk_adjustment_get_value (vadj) + gtk_adjustment_get_page_size (vadj),
+			&right, &bottom);
+
+	result = NULL;
+	for (l = container->details->icons; l != NULL; l = l->next) {
+		icon = l->data;
+
+		if (!icon_is_positioned (icon)) {
+			continue;
+		}
+
+		eel_canvas_item_get_bounds (EEL_CANVAS_ITEM (icon->item),
+					    &x1, &y1, &x2, &y2);
+		if (x2 >= left && x1 <= right &&
+		    y2 >= top && y1 <= bottom) {
+			result = g_list_prepend (result, icon->data);
+		}
+	}
+
+	return g_list_reverse (result);
+}
+
 /* puts the icon at the top of the screen */
 void
 nautilus_canvas_container_scroll_to_canvas (NautilusCanvasContainer  *container,
@@ -8177,6 +8305,16 @@ nautilus_canvas_container_set_store_layout_timestamps (NautilusCanvasContainer *
 	container->details->store_layout_timestamps = store_layout_timestamps;
 }
 
+/* The icon data of a container with a selection model must be the
+ * NautilusFiles the model was filled with.
+ */
+void
+nautilus_canvas_container_set_selection_model (NautilusCanvasContainer *container,
+					       NautilusSelectionModel  *selection_model)
+{
+	container->details->selection_model = selection_model;
+}
+
 
 #if ! defined (NAUTILUS_OMIT_SELF_CHECK)
 
@@ -8203,13 +8341,142 @@ check_compute_stretch (int icon_x, int icon_y, int icon_size,
 				current.icon_size);
 }
 
+/* How empty locations were found before the grid kept count of its
+ * free cells: one cell at a time.
+ */
+static void
+check_find_empty_linear (PlacementGrid *grid,
+			 EelIRect *icon_position,
+			 int height_for_bound_check,
+			 int column_top,
+			 int canvas_width,
+			 int canvas_height)
+{
+	int icon_width, icon_height;
+	gboolean collision;
+
+	icon_width = icon_position->x1 - icon_position->x0;
+	icon_height = icon_position->y1 - icon_position->y0;
+
+	do {
+		EelIRect grid_position;
+		gboolean need_new_column;
+
+		collision = FALSE;
+
+		canvas_position_to_grid_position (grid,
+						  *icon_position,
+						  &grid_position);
+
+		need_new_column = icon_position->y0 + height_for_bound_check + DESKTOP_PAD_VERTICAL > canvas_height;
+
+		if (need_new_column ||
+		    !placement_grid_position_is_free (grid, grid_position)) {
+			icon_position->y0 += SNAP_SIZE_Y;
+			icon_position->y1 = icon_position->y0 + icon_height;
+
+			if (need_new_column) {
+				icon_position->y0 = column_top;
+				icon_position->y1 = icon_position->y0 + icon_height;
+
+				icon_position->x0 += SNAP_SIZE_X;
+				icon_position->x1 = icon_position->x0 + icon_width;
+			}
+
+			collision = TRUE;
+		}
+	} while (collision && (icon_position->x1 < canvas_width));
+}
+
+#define CHECK_ICON_WIDTH 70
+#define CHECK_ICON_HEIGHT 70
+#define CHECK_COLUMN_TOP 22
+
+/* Places icons on a grid with some cells already taken, and returns
+ * where they went.
+ */
+static char *
+check_placement (guint32 seed,
+		 int num_columns,
+		 int num_rows,
+		 int taken_cells,
+		 gboolean tight,
+		 gboolean linear)
+{
+	PlacementGrid *grid;
+	GRand *rand;
+	GString *result;
+	EelIRect rect, grid_rect;
+	int canvas_width, canvas_height;
+	int i;
+
+	rand = g_rand_new_with_seed (seed);
+	grid = placement_grid_new_with_size (num_columns, num_rows, tight);
+	canvas_width = num_columns * SNAP_SIZE_X;
+	canvas_height = num_rows * SNAP_SIZE_Y;
+
+	for (i = 0; i < taken_cells; i++) {
+		grid_rect.x0 = g_rand_int_range (rand, 0, num_columns);
+		grid_rect.y0 = g_rand_int_range (rand, 0, num_rows);
+		grid_rect.x1 = grid_rect.x0 + g_rand_int_range (rand, 0, 2);
+		grid_rect.y1 = grid_rect.y0 + g_rand_int_range (rand, 0, 4);
+		grid_rect.x1 = MIN (grid_rect.x1, num_columns - 1);
+		grid_rect.y1 = MIN (grid_rect.y1, num_rows - 1);
+		placement_grid_mark (grid, grid_rect);
+	}
+
+	result = g_string_new (NULL);
+	for (i = 0; i < num_columns * num_rows / 3; i++) {
+		/* New icons start in the first column, others anywhere */
+		if (g_rand_boolean (rand)) {
+			rect.x0 = DESKTOP_PAD_HORIZONTAL + (SNAP_SIZE_X / 2) - 32;
+			rect.y0 = CHECK_COLUMN_TOP;
+		} else {
+			rect.x0 = g_rand_int_range (rand, 0, canvas_width);
+			rect.y0 = g_rand_int_range (rand, 0, canvas_height);
+		}
+		rect.x1 = rect.x0 + CHECK_ICON_WIDTH;
+		rect.y1 = rect.y0 + CHECK_ICON_HEIGHT;
+
+		if (linear) {
+			check_find_empty_linear (grid, &rect, CHECK_ICON_HEIGHT + 4,
+						 CHECK_COLUMN_TOP, canvas_width, canvas_height);
+		} else {
+			placement_grid_find_empty (grid, &rect, CHECK_ICON_HEIGHT + 4,
+						   CHECK_COLUMN_TOP, canvas_width, canvas_height);
+		}
+		g_string_append_printf (result, "%d,%d ", rect.x0, rect.y0);
+
+		canvas_position_to_grid_position (grid, rect, &grid_rect);
+		placement_grid_mark (grid, grid_rect);
+	}
+
+	placement_grid_free (grid);
+	g_rand_free (rand);
+
+	return g_string_free (result, FALSE);
+}
+
 void
 nautilus_self_check_canvas_container (void)
 {
+	char *expected;
+	guint32 seed;
+
 	EEL_CHECK_STRING_RESULT (check_compute_stretch (0, 0, 16, 0, 0, 0, 0), "0,0:16");
 	EEL_CHECK_STRING_RESULT (check_compute_stretch (0, 0, 16, 16, 16, 17, 17), "0,0:17");
 	EEL_CHECK_STRING_RESULT (check_compute_stretch (0, 0, 16, 16, 16, 17, 16), "0,0:16");
 	EEL_CHECK_STRING_RESULT (check_compute_stretch (100, 100, 64, 105, 105, 40, 40), "35,35:129");
+
+	/* Skipping over taken cells places icons where the cell by cell
+	 * search did, from an empty desktop to a full one.
+	 */
+	for (seed = 0; seed < 24; seed++) {
+		expected = check_placement (seed, 12, 40, seed * 20, seed % 2, TRUE);
+		EEL_CHECK_STRING_RESULT (check_placement (seed, 12, 40, seed * 20, seed % 2, FALSE),
+					 expected);
+		g_free (expected);
+	}
 }
 
 #endif /* ! NAUTILUS_OMIT_SELF_CHECK */
@@ -27,6 +27,7 @@
 
 #include <eel/eel-canvas.h>
 #include <libnautilus-private/nautilus-icon-info.h>
+#include <libnautilus-private/nautilus-selection-model.h>
 
 #define NAUTILUS_TYPE_CANVAS_CONTAINER nautilus_canvas_container_get_type()
 #define NAUTILUS_CANVAS_CONTAINER(obj) \
@@ -244,6 +245,7 @@ void              nautilus_canvas_container_reveal                        (Nauti
 									   NautilusCanvasIconData       *data);
 gboolean          nautilus_canvas_container_is_empty                      (NautilusCanvasContainer  *container);
 NautilusCanvasIconData *nautilus_canvas_container_get_first_visible_icon        (NautilusCanvasContainer  *container);
+GList *           nautilus_canvas_container_get_visible_icons             (NautilusCanvasContainer  *container);
 void              nautilus_canvas_container_scroll_to_canvas                (NautilusCanvasContainer  *container,
 									     NautilusCanvasIconData       *data);
 
@@ -323,6 +325,8 @@ gboolean	  nautilus_canvas_container_is_layout_rtl			(NautilusCanvasContainer  *
 gboolean	  nautilus_canvas_container_is_layout_vertical		(NautilusCanvasContainer  *container);
 
 gboolean          nautilus_canvas_container_get_store_layout_timestamps   (NautilusCanvasContainer  *container);
+void              nautilus_canvas_container_set_selection_model           (NautilusCanvasContainer  *container,
+									   NautilusSelectionModel   *selection_model);
 void              nautilus_canvas_container_set_store_layout_timestamps   (NautilusCanvasContainer  *container,
 									   gboolean                store_layout);
 
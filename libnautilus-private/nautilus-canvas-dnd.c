@@ -1283,6 +1283,7 @@ drag_begin_callback (GtkWidget      *widget,
 
 	/* cache the data at the beginning since the view may change */
 	drag_info = &(container->details->dnd_info->drag_info);
+	nautilus_drag_selection_cache_free (drag_info->selection_cache);
 	drag_info->selection_cache = nautilus_drag_create_selection_cache (widget,
 									   each_icon_get_data_binder);
 
@@ -124,6 +124,9 @@ struct NautilusCanvasContainerDetails {
 	GList *selection;
 	GHashTable *icon_set;
 
+	/* Not owned, mirrors the is_selected flag of the icons. */
+	NautilusSelectionModel *selection_model;
+
 	/* Current icon for keyboard navigation. */
 	NautilusCanvasIcon *keyboard_focus;
 	NautilusCanvasIcon *keyboard_rubberband_start;
@@ -26,6 +26,7 @@
 
 #include <eel/eel-debug.h>
 #include <gtk/gtk.h>
+#include <string.h>
 
 /* X11 has a weakness when it comes to clipboard handling,
  * there is no way to get told when the owner of the clipboard
@@ -125,6 +126,9 @@ static void
 nautilus_clipboard_info_free (NautilusClipboardInfo *info)
 {
 	nautilus_file_list_free (info->files);
+	g_strfreev (info->uris);
+	g_free (info->text);
+	g_free (info->copied_files);
 
 	g_slice_free (NautilusClipboardInfo, info);
 }
@@ -214,51 +218,94 @@ nautilus_clear_clipboard_callback (GtkClipboard *clipboard,
 }
 
 static char *
-convert_file_list_to_string (NautilusClipboardInfo *info,
-			     gboolean format_for_text,
-                             gsize *len)
+get_parse_name_for_uri (const char *uri)
 {
-	GString *uris;
-	char *uri, *tmp;
-	GFile *f;
-        guint i;
-	GList *l;
+	char *path, *parse_name;
+	GFile *file;
+
+	/* Local files in a UTF-8 locale are shown as their path, which
+	 * is what g_file_get_parse_name() would return, without going
+	 * through a GFile for each of them.
+	 */
+	if (g_str_has_prefix (uri, "file://") && g_get_filename_charsets (NULL)) {
+		path = g_filename_from_uri (uri, NULL, NULL);
+		if (path != NULL && g_utf8_validate (path, -1, NULL)) {
+			return path;
+		}
+		g_free (path);
+	}
+
+	file = g_file_new_for_uri (uri);
+	parse_name = g_file_get_parse_name (file);
+	g_object_unref (file);
 
-	if (format_for_text) {
-		uris = g_string_new (NULL);
-	} else {
-		uris = g_string_new (info->cut ? "cut" : "copy");
+	return parse_name;
+}
+
+/* Serializes a NULL terminated URI array either as plain text, one
+ * parse name per line, or in the x-special/gnome-copied-files format.
+ * The buffer is sized up front so large selections don't reallocate.
+ */
+char *
+nautilus_clipboard_format_uris (char     **uris,
+				gboolean   cut,
+				gboolean   format_for_text,
+				gsize     *len)
+{
+	GString *buffer;
+	char *parse_name;
+	gsize size;
+	guint i;
+
+	size = 5;
+	for (i = 0; uris[i] != NULL; i++) {
+		size += strlen (uris[i]) + 1;
 	}
 
-        for (i = 0, l = info->files; l != NULL; l = l->next, i++) {
-		uri = nautilus_file_get_uri (l->data);
+	buffer = g_string_sized_new (size);
+	if (!format_for_text) {
+		g_string_append (buffer, cut ? "cut" : "copy");
+	}
 
+	for (i = 0; uris[i] != NULL; i++) {
 		if (format_for_text) {
-			f = g_file_new_for_uri (uri);
-			tmp = g_file_get_parse_name (f);
-			g_object_unref (f);
-			
-			if (tmp != NULL) {
-				g_string_append (uris, tmp);
-				g_free (tmp);
-			} else {
-				g_string_append (uris, uri);
+			/* skip newline for last element */
+			if (i > 0) {
+				g_string_append_c (buffer, '\n');
 			}
 
-			/* skip newline for last element */
-			if (i + 1 < g_list_length (info->files)) {
-				g_string_append_c (uris, '\n');
+			parse_name = get_parse_name_for_uri (uris[i]);
+			if (parse_name != NULL) {
+				g_string_append (buffer, parse_name);
+				g_free (parse_name);
+			} else {
+				g_string_append (buffer, uris[i]);
 			}
 		} else {
-			g_string_append_c (uris, '\n');
-			g_string_append (uris, uri);
+			g_string_append_c (buffer, '\n');
+			g_string_append (buffer, uris[i]);
 		}
+	}
+
+	*len = buffer->len;
+	return g_string_free (buffer, FALSE);
+}
 
-		g_free (uri);
+static char **
+clipboard_info_get_uris (NautilusClipboardInfo *info)
+{
+	GList *l;
+	guint i;
+
+	if (info->uris == NULL) {
+		info->uris = g_new (char *, g_list_length (info->files) + 1);
+		for (i = 0, l = info->files; l != NULL; l = l->next, i++) {
+			info->uris[i] = nautilus_file_get_uri (l->data);
+		}
+		info->uris[i] = NULL;
 	}
 
-        *len = uris->len;
-	return g_string_free (uris, FALSE);
+	return info->uris;
 }
 
 void
@@ -268,8 +315,6 @@ nautilus_get_clipboard_callback (GtkClipboard     *clipboard,
                                  gpointer          user_data)
 {
 	char **uris;
-	GList *l;
-	int i;
 	NautilusClipboardInfo *clipboard_info;
 	GdkAtom target;
 
@@ -278,33 +323,31 @@ nautilus_get_clipboard_callback (GtkClipboard     *clipboard,
 
 	target = gtk_selection_data_get_target (selection_data);
 
-        if (gtk_targets_include_uri (&target, 1)) {
-		uris = g_malloc ((g_list_length (clipboard_info->files) + 1) * sizeof (char *));
-		i = 0;
-
-		for (l = clipboard_info->files; l != NULL; l = l->next) {
-			uris[i] = nautilus_file_get_uri (l->data);
-			i++;
-		}
+	if (clipboard_info == NULL) {
+		return;
+	}
 
-		uris[i] = NULL;
+	uris = clipboard_info_get_uris (clipboard_info);
 
+        if (gtk_targets_include_uri (&target, 1)) {
 		gtk_selection_data_set_uris (selection_data, uris);
-
-		g_strfreev (uris);
         } else if (gtk_targets_include_text (&target, 1)) {
-                char *str;
-                gsize len;
-
-                str = convert_file_list_to_string (clipboard_info, TRUE, &len);
-                gtk_selection_data_set_text (selection_data, str, len);
-                g_free (str);
+		if (clipboard_info->text == NULL) {
+			clipboard_info->text =
+				nautilus_clipboard_format_uris (uris, clipboard_info->cut, TRUE,
+								&clipboard_info->text_len);
+		}
+                gtk_selection_data_set_text (selection_data,
+					     clipboard_info->text,
+					     clipboard_info->text_len);
         } else if (target == copied_files_atom) {
-                char *str;
-                gsize len;
-
-                str = convert_file_list_to_string (clipboard_info, FALSE, &len);
-                gtk_selection_data_set (selection_data, copied_files_atom, 8, (guchar *) str, len);
-                g_free (str);
+		if (clipboard_info->copied_files == NULL) {
+			clipboard_info->copied_files =
+				nautilus_clipboard_format_uris (uris, clipboard_info->cut, FALSE,
+								&clipboard_info->copied_files_len);
+		}
+                gtk_selection_data_set (selection_data, copied_files_atom, 8,
+					(guchar *) clipboard_info->copied_files,
+					clipboard_info->copied_files_len);
         }
 }
@@ -57,6 +57,16 @@ typedef struct {
 struct NautilusClipboardInfo {
 	GList *files;
 	gboolean cut;
+
+	/* Serialized forms of the file list, built on the first
+	 * request for each target. Only the info owned by the monitor
+	 * has them; callers setting the info leave them unset.
+	 */
+	char **uris;
+	char *text;
+	gsize text_len;
+	char *copied_files;
+	gsize copied_files_len;
 };
 
 GType   nautilus_clipboard_monitor_get_type (void);
@@ -74,6 +84,11 @@ void nautilus_get_clipboard_callback   (GtkClipboard     *clipboard,
                                         guint             info,
                                         gpointer          user_data);
 
+char * nautilus_clipboard_format_uris  (char            **uris,
+                                        gboolean          cut,
+                                        gboolean          format_for_text,
+                                        gsize            *len);
+
 
 
 #endif /* NAUTILUS_CLIPBOARD_MONITOR_H */
@@ -455,32 +455,44 @@ nautilus_clipboard_set_up_editable (GtkEditable *target,
 					editable_disconnect_callbacks);
 }
 
-static GList *
-convert_lines_to_str_list (char **lines, gboolean *cut)
+/* Parses data in the x-special/gnome-copied-files format in a single
+ * pass, without splitting it into an intermediate string vector.
+ */
+GList *
+nautilus_clipboard_parse_uri_list (const char *data,
+				   gsize       len,
+				   gboolean   *cut)
 {
-	int i;
+	const char *line, *end, *newline;
 	GList *result;
 
 	if (cut) {
 		*cut = FALSE;
 	}
 
-	if (lines[0] == NULL) {
-		return NULL;
+	end = data + len;
+	newline = memchr (data, '\n', len);
+	if (newline == NULL) {
+		newline = end;
 	}
 
-	if (strcmp (lines[0], "cut") == 0) {
+	if (newline - data == 3 && strncmp (data, "cut", 3) == 0) {
 		if (cut) {
 			*cut = TRUE;
 		}
-	} else if (strcmp (lines[0], "copy") != 0) {
+	} else if (newline - data != 4 || strncmp (data, "copy", 4) != 0) {
 		return NULL;
 	}
 
 	result = NULL;
-	for (i = 1; lines[i] != NULL; i++) {
-		result = g_list_prepend (result, g_strdup (lines[i]));
+	for (line = newline + 1; line <= end; line = newline + 1) {
+		newline = memchr (line, '\n', end - line);
+		if (newline == NULL) {
+			newline = end;
+		}
+		result = g_list_prepend (result, g_strndup (line, newline - line));
 	}
+
 	return g_list_reverse (result);
 }
 
@@ -489,27 +501,18 @@ nautilus_clipboard_get_uri_list_from_selection_data (GtkSelectionData *selection
 						     gboolean *cut,
 						     GdkAtom copied_files_atom)
 {
-	GList *items;
-	char **lines;
-
 	if (gtk_selection_data_get_data_type (selection_data) != copied_files_atom
 	    || gtk_selection_data_get_length (selection_data) <= 0) {
-		items = NULL;
-	} else {
-		gchar *data;
-		/* Not sure why it's legal to assume there's an extra byte
-		 * past the end of the selection data that it's safe to write
-		 * to. But gtk_editable_selection_received does this, so I
-		 * think it is OK.
-		 */
-		data = (gchar *) gtk_selection_data_get_data (selection_data);
-		data[gtk_selection_data_get_length (selection_data)] = '\0';
-		lines = g_strsplit (data, "\n", 0);
-		items = convert_lines_to_str_list (lines, cut);
-		g_strfreev (lines);
+		if (cut) {
+			*cut = FALSE;
+		}
+		return NULL;
 	}
-	
-	return items;
+
+	return nautilus_clipboard_parse_uri_list
+		((const char *) gtk_selection_data_get_data (selection_data),
+		 gtk_selection_data_get_length (selection_data),
+		 cut);
 }
 
 GtkClipboard *
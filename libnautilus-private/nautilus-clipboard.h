@@ -46,5 +46,8 @@ GList* nautilus_clipboard_get_uri_list_from_selection_data
 						   (GtkSelectionData   *selection_data,
 						    gboolean           *cut,
 						    GdkAtom             copied_files_atom);
+GList* nautilus_clipboard_parse_uri_list            (const char         *data,
+						    gsize               len,
+						    gboolean           *cut);
 
 #endif /* NAUTILUS_CLIPBOARD_H */
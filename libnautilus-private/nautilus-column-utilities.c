@@ -33,9 +33,12 @@
 static const char *default_column_order[] = {
 	"name",
 	"size",
+	"total_size",
 	"type",
 	"date_modified",
 	"date_accessed",
+	"date_taken",
+	"dimensions",
 	"owner",
 	"group",
 	"permissions",
@@ -64,6 +67,14 @@ get_builtin_columns (void)
 					       "description", _("The size of the file."),
 					       "xalign", 1.0,
 					       NULL));
+	columns = g_list_append (columns,
+				 g_object_new (NAUTILUS_TYPE_COLUMN,
+					       "name", "total_size",
+					       "attribute", "total_size",
+					       "label", _("Total Size"),
+					       "description", _("The size of the file, or of everything in the folder."),
+					       "xalign", 1.0,
+					       NULL));
 	columns = g_list_append (columns,
 				 g_object_new (NAUTILUS_TYPE_COLUMN,
 					       "name", "type",
@@ -87,6 +98,21 @@ get_builtin_columns (void)
 					       "description", _("The date the file was accessed."),
 					       "default-sort-order", GTK_SORT_DESCENDING,
 					       NULL));
+	columns = g_list_append (columns,
+				 g_object_new (NAUTILUS_TYPE_COLUMN,
+					       "name", "date_taken",
+					       "attribute", "date_taken",
+					       "label", _("Date Taken"),
+					       "description", _("The date the picture was taken."),
+					       "default-sort-order", GTK_SORT_DESCENDING,
+					       NULL));
+	columns = g_list_append (columns,
+				 g_object_new (NAUTILUS_TYPE_COLUMN,
+					       "name", "dimensions",
+					       "attribute", "dimensions",
+					       "label", _("Dimensions"),
+					       "description", _("The width and height of the image."),
+					       NULL));
 
 	columns = g_list_append (columns,
 				 g_object_new (NAUTILUS_TYPE_COLUMN,
@@ -137,6 +163,7 @@ get_extension_columns (void)
 	GList *columns;
 	GList *providers;
 	GList *l;
+	gint64 start_time;
 	
 	providers = nautilus_module_get_extensions_for_type (NAUTILUS_TYPE_COLUMN_PROVIDER);
 	
@@ -147,7 +174,11 @@ get_extension_columns (void)
 		GList *provider_columns;
 		
 		provider = NAUTILUS_COLUMN_PROVIDER (l->data);
+		/* Never skipped, the columns are kept for the session. */
+		start_time = g_get_monotonic_time ();
 		provider_columns = nautilus_column_provider_get_columns (provider);
+		nautilus_module_record_call (l->data, "columns",
+					     g_get_monotonic_time () - start_time);
 		columns = g_list_concat (columns, provider_columns);
 	}
 
@@ -40,6 +40,7 @@ static GDebugKey keys[] = {
   { "Bookmarks", NAUTILUS_DEBUG_BOOKMARKS },
   { "DBus", NAUTILUS_DEBUG_DBUS },
   { "DirectoryView", NAUTILUS_DEBUG_DIRECTORY_VIEW },
+  { "Extensions", NAUTILUS_DEBUG_EXTENSIONS },
   { "File", NAUTILUS_DEBUG_FILE },
   { "CanvasContainer", NAUTILUS_DEBUG_CANVAS_CONTAINER },
   { "IconView", NAUTILUS_DEBUG_CANVAS_VIEW },
@@ -0,0 +1,597 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+ *
+ * nautilus-deep-count-cache.c: folder counts kept between deep counts
+ *
+ * Nautilus is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * Nautilus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; see the file COPYING.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <config.h>
+#include "nautilus-deep-count-cache.h"
+
+#include "nautilus-lib-self-check-functions.h"
+
+#define DEBUG_FLAG NAUTILUS_DEBUG_FILE
+#include "nautilus-debug.h"
+
+#include <eel/eel-debug.h>
+#include <glib/gstdio.h>
+#include <errno.h>
+
+#define CACHE_VERSION 2
+/* (version, [(device, inode, mtime, last used, files, folders, size, subfolders,
+ *             hidden files, hidden folders, hidden size, hidden subfolders)]) */
+#define ITEM_FORMAT "(ttxxuuxasuuxas)"
+#define CACHE_FORMAT "(ua" ITEM_FORMAT ")"
+
+/* Seconds to wait after a change before writing the cache */
+#define SAVE_DELAY 10
+/* Folders not counted for this long are dropped, in seconds */
+#define MAX_UNUSED_AGE (30 * 24 * 60 * 60)
+#define MAX_ENTRIES 500000
+
+typedef struct {
+	guint64 device;
+	guint64 inode;
+} CacheKey;
+
+typedef struct {
+	CacheKey key;
+	gint64 mtime;
+	gint64 last_used;
+	NautilusDeepCountEntry *entry;
+	GList link;
+} CacheItem;
+
+static GHashTable *cache;
+/* The items, least recently used first, linked through their own link */
+static GQueue lru = G_QUEUE_INIT;
+static guint save_timeout_id;
+static gboolean dirty;
+
+NautilusDeepCountEntry *
+nautilus_deep_count_entry_new (void)
+{
+	NautilusDeepCountEntry *entry;
+
+	entry = g_new0 (NautilusDeepCountEntry, 1);
+	entry->subdirectories = g_ptr_array_new_with_free_func (g_free);
+	entry->hidden_subdirectories = g_ptr_array_new_with_free_func (g_free);
+
+	return entry;
+}
+
+void
+nautilus_deep_count_entry_free (NautilusDeepCountEntry *entry)
+{
+	g_ptr_array_unref (entry->subdirectories);
+	g_ptr_array_unref (entry->hidden_subdirectories);
+	g_free (entry);
+}
+
+static void
+add_names (GPtrArray *names,
+	   GPtrArray *more_names)
+{
+	guint i;
+
+	for (i = 0; i < more_names->len; i++) {
+		g_ptr_array_add (names, g_strdup (g_ptr_array_index (more_names, i)));
+	}
+}
+
+GPtrArray *
+nautilus_deep_count_entry_add (const NautilusDeepCountEntry *entry,
+			       gboolean show_hidden,
+			       guint *file_count,
+			       guint *directory_count,
+			       goffset *size)
+{
+	GPtrArray *subdirectories;
+
+	subdirectories = g_ptr_array_new_with_free_func (g_free);
+
+	*file_count += entry->file_count;
+	*directory_count += entry->directory_count;
+	*size += entry->size;
+	add_names (subdirectories, entry->subdirectories);
+
+	if (show_hidden) {
+		*file_count += entry->hidden_file_count;
+		*directory_count += entry->hidden_directory_count;
+		*size += entry->hidden_size;
+		add_names (subdirectories, entry->hidden_subdirectories);
+	}
+
+	return subdirectories;
+}
+
+static guint
+cache_key_hash (gconstpointer data)
+{
+	const CacheKey *key = data;
+
+	return (guint) (key->inode ^ (key->inode >> 32) ^ (key->device * 31));
+}
+
+static gboolean
+cache_key_equal (gconstpointer a,
+		 gconstpointer b)
+{
+	const CacheKey *key_a = a;
+	const CacheKey *key_b = b;
+
+	return key_a->inode == key_b->inode && key_a->device == key_b->device;
+}
+
+static void
+cache_item_free (CacheItem *item)
+{
+	g_queue_unlink (&lru, &item->link);
+	nautilus_deep_count_entry_free (item->entry);
+	g_free (item);
+}
+
+static char *
+get_cache_path (void)
+{
+	return g_build_filename (g_get_user_cache_dir (), "nautilus",
+				 "deep-counts", NULL);
+}
+
+static void
+cache_insert (CacheItem *item)
+{
+	g_hash_table_replace (cache, &item->key, item);
+
+	item->link.data = item;
+	g_queue_push_tail_link (&lru, &item->link);
+}
+
+static gint
+compare_last_used (gconstpointer a,
+		   gconstpointer b,
+		   gpointer user_data)
+{
+	const CacheItem *item_a = a;
+	const CacheItem *item_b = b;
+
+	return item_a->last_used < item_b->last_used ? -1 :
+		item_a->last_used > item_b->last_used;
+}
+
+static void
+read_names (GVariantIter *iter,
+	    GPtrArray *names)
+{
+	char *name;
+
+	while (g_variant_iter_next (iter, "s", &name)) {
+		g_ptr_array_add (names, name);
+	}
+	g_variant_iter_free (iter);
+}
+
+static void
+load_cache (void)
+{
+	GMappedFile *file;
+	GVariant *variant, *items;
+	GVariantIter iter;
+	GVariantIter *subdirectories, *hidden_subdirectories;
+	CacheItem *item;
+	NautilusDeepCountEntry *entry;
+	guint32 version;
+	gint64 size, hidden_size;
+	char *path;
+
+	path = get_cache_path ();
+	file = g_mapped_file_new (path, FALSE, NULL);
+	g_free (path);
+	if (file == NULL) {
+		return;
+	}
+
+	variant = g_variant_new_from_data (G_VARIANT_TYPE (CACHE_FORMAT),
+					   g_mapped_file_get_contents (file),
+					   g_mapped_file_get_length (file),
+					   FALSE,
+					   (GDestroyNotify) g_mapped_file_unref,
+					   file);
+	g_variant_ref_sink (variant);
+
+	g_variant_get (variant, "(u@a" ITEM_FORMAT ")", &version, &items);
+	if (version == CACHE_VERSION) {
+		g_variant_iter_init (&iter, items);
+		for (;;) {
+			item = g_new0 (CacheItem, 1);
+			entry = nautilus_deep_count_entry_new ();
+			if (!g_variant_iter_next (&iter, ITEM_FORMAT,
+						  &item->key.device, &item->key.inode,
+						  &item->mtime, &item->last_used,
+						  &entry->file_count, &entry->directory_count,
+						  &size, &subdirectories,
+						  &entry->hidden_file_count, &entry->hidden_directory_count,
+						  &hidden_size, &hidden_subdirectories)) {
+				nautilus_deep_count_entry_free (entry);
+				g_free (item);
+				break;
+			}
+
+			entry->size = size;
+			entry->hidden_size = hidden_size;
+			read_names (subdirectories, entry->subdirectories);
+			read_names (hidden_subdirectories, entry->hidden_subdirectories);
+
+			item->entry = entry;
+			cache_insert (item);
+		}
+	}
+
+	g_variant_unref (items);
+	g_variant_unref (variant);
+
+	g_queue_sort (&lru, compare_last_used, NULL);
+
+	DEBUG ("Loaded %u deep count cache entries", g_hash_table_size (cache));
+}
+
+/* What is saved of an item. The entry shares the names with the cached
+ * one, which do not change once stored.
+ */
+typedef struct {
+	CacheKey key;
+	gint64 mtime;
+	gint64 last_used;
+	NautilusDeepCountEntry entry;
+} SavedItem;
+
+static void
+saved_items_free (GArray *saved_items)
+{
+	SavedItem *saved;
+	guint i;
+
+	for (i = 0; i < saved_items->len; i++) {
+		saved = &g_array_index (saved_items, SavedItem, i);
+		g_ptr_array_unref (saved->entry.subdirectories);
+		g_ptr_array_unref (saved->entry.hidden_subdirectories);
+	}
+	g_array_free (saved_items, TRUE);
+}
+
+/* Cheap enough for the main thread, the rest is done by cache_to_variant() */
+static GArray *
+cache_snapshot (void)
+{
+	GArray *saved_items;
+	GHashTableIter iter;
+	CacheItem *item;
+	SavedItem saved;
+	gint64 now;
+
+	now = g_get_real_time () / G_USEC_PER_SEC;
+
+	saved_items = g_array_sized_new (FALSE, FALSE, sizeof (SavedItem),
+					 g_hash_table_size (cache));
+	g_hash_table_iter_init (&iter, cache);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &item)) {
+		if (now - item->last_used > MAX_UNUSED_AGE) {
+			g_hash_table_iter_remove (&iter);
+			continue;
+		}
+
+		saved.key = item->key;
+		saved.mtime = item->mtime;
+		saved.last_used = item->last_used;
+		saved.entry = *item->entry;
+		g_ptr_array_ref (saved.entry.subdirectories);
+		g_ptr_array_ref (saved.entry.hidden_subdirectories);
+		g_array_append_val (saved_items, saved);
+	}
+
+	return saved_items;
+}
+
+static GVariant *
+names_to_variant (GPtrArray *names)
+{
+	GVariantBuilder builder;
+	guint i;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE_STRING_ARRAY);
+	for (i = 0; i < names->len; i++) {
+		g_variant_builder_add (&builder, "s", g_ptr_array_index (names, i));
+	}
+
+	return g_variant_builder_end (&builder);
+}
+
+static GVariant *
+cache_to_variant (GArray *saved_items)
+{
+	GVariantBuilder builder;
+	SavedItem *saved;
+	guint i;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a" ITEM_FORMAT));
+	for (i = 0; i < saved_items->len; i++) {
+		saved = &g_array_index (saved_items, SavedItem, i);
+		g_variant_builder_add (&builder, "(ttxxuux@asuux@as)",
+				       saved->key.device, saved->key.inode,
+				       saved->mtime, saved->last_used,
+				       saved->entry.file_count, saved->entry.directory_count,
+				       (gint64) saved->entry.size,
+				       names_to_variant (saved->entry.subdirectories),
+				       saved->entry.hidden_file_count, saved->entry.hidden_directory_count,
+				       (gint64) saved->entry.hidden_size,
+				       names_to_variant (saved->entry.hidden_subdirectories));
+	}
+
+	return g_variant_ref_sink (g_variant_new ("(u@a" ITEM_FORMAT ")",
+						  CACHE_VERSION,
+						  g_variant_builder_end (&builder)));
+}
+
+static void
+write_cache (GArray *saved_items)
+{
+	GVariant *variant;
+	char *path, *dirname;
+	GError *error;
+
+	variant = cache_to_variant (saved_items);
+	path = get_cache_path ();
+	dirname = g_path_get_dirname (path);
+
+	error = NULL;
+	if (g_mkdir_with_parents (dirname, 0700) != 0 ||
+	    !g_file_set_contents (path,
+				  g_variant_get_data (variant),
+				  g_variant_get_size (variant),
+				  &error)) {
+		DEBUG ("Could not save the deep count cache: %s",
+		       error != NULL ? error->message : g_strerror (errno));
+		g_clear_error (&error);
+	}
+
+	g_free (dirname);
+	g_free (path);
+	g_variant_unref (variant);
+}
+
+static void
+save_thread (GTask *task,
+	     gpointer source_object,
+	     gpointer task_data,
+	     GCancellable *cancellable)
+{
+	write_cache (task_data);
+	g_task_return_boolean (task, TRUE);
+}
+
+static gboolean
+save_timeout_callback (gpointer user_data)
+{
+	GTask *task;
+
+	save_timeout_id = 0;
+	dirty = FALSE;
+
+	/* Take the items here, build the data and write it in a thread */
+	task = g_task_new (NULL, NULL, NULL, NULL);
+	g_task_set_task_data (task, cache_snapshot (), (GDestroyNotify) saved_items_free);
+	g_task_run_in_thread (task, save_thread);
+	g_object_unref (task);
+
+	return FALSE;
+}
+
+static void
+schedule_save (void)
+{
+	dirty = TRUE;
+	if (save_timeout_id == 0) {
+		save_timeout_id = g_timeout_add_seconds (SAVE_DELAY, save_timeout_callback, NULL);
+	}
+}
+
+static void
+free_cache (void)
+{
+	GArray *saved_items;
+
+	if (save_timeout_id != 0) {
+		g_source_remove (save_timeout_id);
+		save_timeout_id = 0;
+	}
+
+	if (dirty) {
+		saved_items = cache_snapshot ();
+		write_cache (saved_items);
+		saved_items_free (saved_items);
+	}
+
+	g_hash_table_destroy (cache);
+	cache = NULL;
+}
+
+static void
+ensure_cache (void)
+{
+	if (cache != NULL) {
+		return;
+	}
+
+	cache = g_hash_table_new_full (cache_key_hash, cache_key_equal,
+				       NULL, (GDestroyNotify) cache_item_free);
+	load_cache ();
+
+	eel_debug_call_at_shutdown (free_cache);
+}
+
+static gboolean
+get_key (GFileInfo *info,
+	 CacheKey *key,
+	 gint64 *mtime)
+{
+	if (!g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_UNIX_INODE) ||
+	    !g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_TIME_MODIFIED)) {
+		return FALSE;
+	}
+
+	key->device = g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_DEVICE);
+	key->inode = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_UNIX_INODE);
+	*mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC +
+		g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+
+	return key->inode != 0;
+}
+
+const NautilusDeepCountEntry *
+nautilus_deep_count_cache_lookup (GFileInfo *directory_info)
+{
+	CacheItem *item;
+	CacheKey key;
+	gint64 mtime;
+
+	if (!get_key (directory_info, &key, &mtime)) {
+		return NULL;
+	}
+
+	ensure_cache ();
+
+	item = g_hash_table_lookup (cache, &key);
+	if (item == NULL || item->mtime != mtime) {
+		return NULL;
+	}
+
+	item->last_used = g_get_real_time () / G_USEC_PER_SEC;
+	g_queue_unlink (&lru, &item->link);
+	g_queue_push_tail_link (&lru, &item->link);
+	schedule_save ();
+
+	return item->entry;
+}
+
+void
+nautilus_deep_count_cache_store (GFileInfo *directory_info,
+				 NautilusDeepCountEntry *entry)
+{
+	CacheItem *item, *oldest;
+	CacheKey key;
+	gint64 mtime;
+
+	if (!get_key (directory_info, &key, &mtime)) {
+		nautilus_deep_count_entry_free (entry);
+		return;
+	}
+
+	ensure_cache ();
+
+	/* Make room by dropping the folders not counted for longest */
+	while (g_hash_table_size (cache) >= MAX_ENTRIES &&
+	       (oldest = g_queue_peek_head (&lru)) != NULL) {
+		g_hash_table_remove (cache, &oldest->key);
+	}
+
+	item = g_new0 (CacheItem, 1);
+	item->key = key;
+	item->mtime = mtime;
+	item->last_used = g_get_real_time () / G_USEC_PER_SEC;
+	item->entry = entry;
+	cache_insert (item);
+
+	schedule_save ();
+}
+
+#if !defined (NAUTILUS_OMIT_SELF_CHECK)
+
+static char *
+self_check_totals (const NautilusDeepCountEntry *entry,
+		   gboolean show_hidden)
+{
+	GPtrArray *subdirectories;
+	guint file_count, directory_count;
+	goffset size;
+	char *result;
+
+	file_count = directory_count = 0;
+	size = 0;
+	subdirectories = nautilus_deep_count_entry_add (entry, show_hidden,
+							&file_count, &directory_count, &size);
+	result = g_strdup_printf ("%u %u %" G_GINT64_FORMAT " %u",
+				  file_count, directory_count, (gint64) size,
+				  subdirectories->len);
+	g_ptr_array_unref (subdirectories);
+
+	return result;
+}
+
+void
+nautilus_self_check_deep_count_cache (void)
+{
+	NautilusDeepCountEntry *entry;
+	const NautilusDeepCountEntry *found;
+	GFileInfo *info;
+	CacheKey key;
+	gboolean was_dirty;
+
+	entry = nautilus_deep_count_entry_new ();
+	entry->file_count = 3;
+	entry->directory_count = 1;
+	entry->size = 300;
+	g_ptr_array_add (entry->subdirectories, g_strdup ("Documents"));
+	entry->hidden_file_count = 2;
+	entry->hidden_directory_count = 1;
+	entry->hidden_size = 50;
+	g_ptr_array_add (entry->hidden_subdirectories, g_strdup (".cache"));
+
+	info = g_file_info_new ();
+	g_file_info_set_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_DEVICE, G_MAXUINT32);
+	g_file_info_set_attribute_uint64 (info, G_FILE_ATTRIBUTE_UNIX_INODE, G_MAXUINT64);
+	g_file_info_set_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED, 1000);
+	g_file_info_set_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC, 0);
+
+	ensure_cache ();
+	was_dirty = dirty;
+	nautilus_deep_count_cache_store (info, entry);
+
+	/* The same entry gives both totals, whichever way the setting is */
+	found = nautilus_deep_count_cache_lookup (info);
+	EEL_CHECK_BOOLEAN_RESULT (found != NULL, TRUE);
+	EEL_CHECK_STRING_RESULT (self_check_totals (found, FALSE), "3 1 300 1");
+	EEL_CHECK_STRING_RESULT (self_check_totals (found, TRUE), "5 2 350 2");
+	found = nautilus_deep_count_cache_lookup (info);
+	EEL_CHECK_STRING_RESULT (self_check_totals (found, FALSE), "3 1 300 1");
+
+	/* A folder changed since is read again */
+	g_file_info_set_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED, 1001);
+	EEL_CHECK_BOOLEAN_RESULT (nautilus_deep_count_cache_lookup (info) == NULL, TRUE);
+
+	/* Leave the user's cache as it was */
+	key.device = G_MAXUINT32;
+	key.inode = G_MAXUINT64;
+	g_hash_table_remove (cache, &key);
+	if (!was_dirty && save_timeout_id != 0) {
+		g_source_remove (save_timeout_id);
+		save_timeout_id = 0;
+		dirty = FALSE;
+	}
+
+	g_object_unref (info);
+}
+
+#endif /* !NAUTILUS_OMIT_SELF_CHECK */
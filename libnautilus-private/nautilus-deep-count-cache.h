@@ -0,0 +1,73 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+ *
+ * nautilus-deep-count-cache.h: folder counts kept between deep counts
+ *
+ * Nautilus is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * Nautilus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; see the file COPYING.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef NAUTILUS_DEEP_COUNT_CACHE_H
+#define NAUTILUS_DEEP_COUNT_CACHE_H
+
+#include <gio/gio.h>
+
+/* What a deep count found directly in one folder: its files and
+ * folders, their size, and the subfolders it went on into. Entries are
+ * stored by device and inode, and only used while the folder has the
+ * same modification time, so a folder whose list of children did not
+ * change is not read again.
+ *
+ * Hidden and backup files are kept apart, so the same entry serves
+ * whether they are shown or not.
+ */
+typedef struct {
+	guint file_count;
+	guint directory_count;
+	goffset size;
+	GPtrArray *subdirectories;
+
+	guint hidden_file_count;
+	guint hidden_directory_count;
+	goffset hidden_size;
+	GPtrArray *hidden_subdirectories;
+} NautilusDeepCountEntry;
+
+/* The attributes the folder info passed in has to have */
+#define NAUTILUS_DEEP_COUNT_CACHE_ATTRIBUTES \
+	G_FILE_ATTRIBUTE_UNIX_DEVICE "," \
+	G_FILE_ATTRIBUTE_UNIX_INODE "," \
+	G_FILE_ATTRIBUTE_TIME_MODIFIED "," \
+	G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC
+
+NautilusDeepCountEntry *nautilus_deep_count_entry_new    (void);
+void                    nautilus_deep_count_entry_free   (NautilusDeepCountEntry *entry);
+/* Adds what the folder counts for to the totals, with or without the
+ * hidden files, and returns the subfolders to count too. Free the array
+ * with g_ptr_array_unref().
+ */
+GPtrArray *             nautilus_deep_count_entry_add    (const NautilusDeepCountEntry *entry,
+							  gboolean                show_hidden,
+							  guint                  *file_count,
+							  guint                  *directory_count,
+							  goffset                *size);
+
+/* Returns NULL if the folder is not known or changed since */
+const NautilusDeepCountEntry *
+                        nautilus_deep_count_cache_lookup (GFileInfo              *directory_info);
+/* Takes the entry */
+void                    nautilus_deep_count_cache_store  (GFileInfo              *directory_info,
+							  NautilusDeepCountEntry *entry);
+
+#endif /* NAUTILUS_DEEP_COUNT_CACHE_H */
@@ -22,14 +22,17 @@
 
 #include <config.h>
 
+#include "nautilus-deep-count-cache.h"
 #include "nautilus-directory-notify.h"
 #include "nautilus-directory-private.h"
 #include "nautilus-file-attributes.h"
 #include "nautilus-file-private.h"
 #include "nautilus-file-utilities.h"
+#include "nautilus-image-header.h"
 #include "nautilus-signaller.h"
 #include "nautilus-global-preferences.h"
 #include "nautilus-link.h"
+#include "nautilus-module.h"
 #include "nautilus-profile.h"
 #include <eel/eel-glib-extensions.h>
 #include <gtk/gtk.h>
@@ -37,6 +40,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#define DEBUG_FLAG NAUTILUS_DEBUG_EXTENSIONS
+#include "nautilus-debug.h"
+
 /* turn this on to see messages about each load_directory call: */
 #if 0
 #define DEBUG_LOAD_DIRECTORY
@@ -57,6 +63,18 @@
 /* Keep async. jobs down to this number for all directories. */
 #define MAX_ASYNC_JOBS 10
 
+/* Enumerating a directory mostly waits on the GIO worker threads, so
+ * file list jobs get slots of their own. That way expanded subfolders
+ * load side by side instead of queueing behind per-file jobs.
+ */
+#define MAX_FILE_LIST_JOBS 6
+
+/* Deep counts walk whole trees, so only this many run on one
+ * filesystem at a time. The rest of the job slots stay free for other
+ * disks and for the cheaper per-file jobs.
+ */
+#define MAX_DEEP_COUNTS_PER_FILESYSTEM 2
+
 struct TopLeftTextReadState {
 	NautilusDirectory *directory;
 	NautilusFile *file;
@@ -90,6 +108,12 @@ struct FilesystemInfoState {
 	NautilusFile *file;
 };
 
+struct ImageInfoState {
+	NautilusDirectory *directory;
+	GCancellable *cancellable;
+	NautilusFile *file;
+};
+
 struct DirectoryLoadState {
 	NautilusDirectory *directory;
 	GCancellable *cancellable;
@@ -134,6 +158,13 @@ struct DeepCountState {
 	GList *deep_count_subdirectories;
 	GArray *seen_deep_count_inodes;
 	char *fs_id;
+	/* The filesystem the count is charged to */
+	char *budget_fs_id;
+
+	/* What was found in the folder being read, for the cache */
+	GFileInfo *directory_info;
+	NautilusDeepCountEntry *entry;
+	gboolean entry_cacheable;
 };
 
 
@@ -173,6 +204,16 @@ typedef gboolean (* FileCheck) (NautilusFile *);
 /* Current number of async. jobs. */
 static int async_job_count;
 static GHashTable *waiting_directories;
+/* Current number of file list jobs, counted apart from the above. */
+static int file_list_job_count;
+static GHashTable *waiting_file_list_directories;
+/* Source of the directories' shown stamps. */
+static guint shown_stamp_counter;
+/* Running deep counts per filesystem id, and the directories waiting
+ * for one of their filesystem's slots, with the id they wait for.
+ */
+static GHashTable *deep_counts_per_filesystem;
+static GHashTable *waiting_deep_count_directories;
 #ifdef DEBUG_ASYNC_JOBS
 static GHashTable *async_jobs;
 #endif
@@ -197,6 +238,11 @@ static void     move_file_to_low_priority_queue               (NautilusDirectory
 							       NautilusFile           *file);
 static void     move_file_to_extension_queue                  (NautilusDirectory      *directory,
 							       NautilusFile           *file);
+static void     remove_file_from_extension_queue              (NautilusDirectory      *directory,
+							       NautilusFile           *file);
+static void     count_extension_queue_provider                (NautilusDirectory      *directory,
+							       NautilusInfoProvider   *provider,
+							       int                     delta);
 static void     nautilus_directory_invalidate_file_attributes (NautilusDirectory      *directory,
 							       NautilusFileAttributes  file_attributes);
 
@@ -381,6 +427,8 @@ async_job_start (NautilusDirectory *directory,
 #endif	
 
 	async_job_count += 1;
+	nautilus_profile_async_begin ("directory", job, directory);
+	nautilus_profile_counter ("directory", "async jobs", async_job_count);
 	return TRUE;
 }
 
@@ -419,29 +467,174 @@ async_job_end (NautilusDirectory *directory,
 #endif
 
 	async_job_count -= 1;
+	nautilus_profile_async_end ("directory", job, directory);
+	nautilus_profile_counter ("directory", "async jobs", async_job_count);
+}
+
+/* Start a file list job. Works like async_job_start, but against
+ * the separate file list limit.
+ */
+static gboolean
+file_list_job_start (NautilusDirectory *directory)
+{
+	g_assert (file_list_job_count >= 0);
+	g_assert (file_list_job_count <= MAX_FILE_LIST_JOBS);
+
+	if (file_list_job_count >= MAX_FILE_LIST_JOBS) {
+		if (waiting_file_list_directories == NULL) {
+			waiting_file_list_directories = g_hash_table_new (NULL, NULL);
+		}
+
+		g_hash_table_insert (waiting_file_list_directories,
+				     directory,
+				     directory);
+
+		return FALSE;
+	}
+
+#ifdef DEBUG_START_STOP
+	g_message ("starting file list in %p", directory->details->location);
+#endif
+
+	file_list_job_count += 1;
+	nautilus_profile_async_begin ("directory", "file list", directory);
+	nautilus_profile_counter ("directory", "file list jobs", file_list_job_count);
+	return TRUE;
+}
+
+/* End a file list job. */
+static void
+file_list_job_end (NautilusDirectory *directory)
+{
+#ifdef DEBUG_START_STOP
+	g_message ("stopping file list in %p", directory->details->location);
+#endif
+
+	g_assert (file_list_job_count > 0);
+
+	file_list_job_count -= 1;
+	nautilus_profile_async_end ("directory", "file list", directory);
+	nautilus_profile_counter ("directory", "file list jobs", file_list_job_count);
 }
 
-/* Helper to get one value from a hash table. */
+/* Helper to get the waiting directory that was shown last. */
 static void
-get_one_value_callback (gpointer key, gpointer value, gpointer callback_data)
+get_most_recently_shown_callback (gpointer key, gpointer value, gpointer callback_data)
 {
-	gpointer *returned_value;
+	NautilusDirectory **returned_value;
+	NautilusDirectory *directory;
 
 	returned_value = callback_data;
-	*returned_value = value;
+	directory = value;
+	if (*returned_value == NULL ||
+	    directory->details->shown_stamp > (*returned_value)->details->shown_stamp) {
+		*returned_value = directory;
+	}
 }
 
-/* return a single value from a hash table. */
-static gpointer
-get_one_value (GHashTable *table)
+/* Return the directory of a table that the user most likely looks
+ * at, so what is on screen gets the free job slots first.
+ */
+static NautilusDirectory *
+get_most_recently_shown (GHashTable *table)
 {
-	gpointer value;
+	NautilusDirectory *directory;
 
-	value = NULL;
+	directory = NULL;
 	if (table != NULL) {
-		g_hash_table_foreach (table, get_one_value_callback, &value);
+		g_hash_table_foreach (table, get_most_recently_shown_callback, &directory);
+	}
+	return directory;
+}
+
+static int
+get_deep_count_filesystem_count (const char *fs_id)
+{
+	if (deep_counts_per_filesystem == NULL) {
+		return 0;
+	}
+	return GPOINTER_TO_INT (g_hash_table_lookup (deep_counts_per_filesystem, fs_id));
+}
+
+/* Check the filesystem budget before starting a deep count. Works like
+ * async_job_start, but the slot is only taken by
+ * deep_count_filesystem_job_start once the job itself got one.
+ */
+static gboolean
+deep_count_filesystem_has_room (NautilusDirectory *directory,
+				const char *fs_id)
+{
+	if (get_deep_count_filesystem_count (fs_id) < MAX_DEEP_COUNTS_PER_FILESYSTEM) {
+		return TRUE;
+	}
+
+	if (waiting_deep_count_directories == NULL) {
+		waiting_deep_count_directories = g_hash_table_new_full (NULL, NULL,
+									NULL, g_free);
+	}
+	g_hash_table_insert (waiting_deep_count_directories,
+			     directory,
+			     g_strdup (fs_id));
+
+	return FALSE;
+}
+
+static void
+deep_count_filesystem_job_start (const char *fs_id)
+{
+	if (deep_counts_per_filesystem == NULL) {
+		deep_counts_per_filesystem = g_hash_table_new_full (g_str_hash, g_str_equal,
+								    g_free, NULL);
 	}
-	return value;
+	g_hash_table_insert (deep_counts_per_filesystem,
+			     g_strdup (fs_id),
+			     GINT_TO_POINTER (get_deep_count_filesystem_count (fs_id) + 1));
+}
+
+static void
+deep_count_filesystem_job_end (const char *fs_id)
+{
+	int count;
+
+	count = get_deep_count_filesystem_count (fs_id);
+	g_assert (count > 0);
+
+	if (count == 1) {
+		g_hash_table_remove (deep_counts_per_filesystem, fs_id);
+	} else {
+		g_hash_table_insert (deep_counts_per_filesystem,
+				     g_strdup (fs_id),
+				     GINT_TO_POINTER (count - 1));
+	}
+}
+
+/* Return the most recently shown directory waiting for a deep count
+ * whose filesystem has a slot free again.
+ */
+static NautilusDirectory *
+get_next_deep_count_directory (void)
+{
+	GHashTableIter iter;
+	NautilusDirectory *directory, *next;
+	const char *fs_id;
+
+	next = NULL;
+	if (waiting_deep_count_directories == NULL) {
+		return NULL;
+	}
+
+	g_hash_table_iter_init (&iter, waiting_deep_count_directories);
+	while (g_hash_table_iter_next (&iter, (gpointer *) &directory, (gpointer *) &fs_id)) {
+		if (get_deep_count_filesystem_count (fs_id) >= MAX_DEEP_COUNTS_PER_FILESYSTEM) {
+			continue;
+		}
+		if (next == NULL ||
+		    directory->details->shown_stamp > next->details->shown_stamp) {
+			next = directory;
+		}
+	}
+
+	return next;
 }
 
 /* Wake up directories that are "blocked" as long as there are job
@@ -451,7 +644,7 @@ static void
 async_job_wake_up (void)
 {
 	static gboolean already_waking_up = FALSE;
-	gpointer value;
+	NautilusDirectory *directory;
 
 	g_assert (async_job_count >= 0);
 	g_assert (async_job_count <= MAX_ASYNC_JOBS);
@@ -461,14 +654,29 @@ async_job_wake_up (void)
 	}
 	
 	already_waking_up = TRUE;
+	while (file_list_job_count < MAX_FILE_LIST_JOBS) {
+		directory = get_most_recently_shown (waiting_file_list_directories);
+		if (directory == NULL) {
+			break;
+		}
+		g_hash_table_remove (waiting_file_list_directories, directory);
+		nautilus_directory_async_state_changed (directory);
+	}
+	while (async_job_count < MAX_ASYNC_JOBS) {
+		directory = get_most_recently_shown (waiting_directories);
+		if (directory == NULL) {
+			break;
+		}
+		g_hash_table_remove (waiting_directories, directory);
+		nautilus_directory_async_state_changed (directory);
+	}
 	while (async_job_count < MAX_ASYNC_JOBS) {
-		value = get_one_value (waiting_directories);
-		if (value == NULL) {
+		directory = get_next_deep_count_directory ();
+		if (directory == NULL) {
 			break;
 		}
-		g_hash_table_remove (waiting_directories, value);
-		nautilus_directory_async_state_changed
-			(NAUTILUS_DIRECTORY (value));
+		g_hash_table_remove (waiting_deep_count_directories, directory);
+		nautilus_directory_async_state_changed (directory);
 	}
 	already_waking_up = FALSE;
 }
@@ -491,6 +699,7 @@ deep_count_cancel (NautilusDirectory *directory)
 
 		directory->details->deep_count_file->details->deep_counts_status = NAUTILUS_REQUEST_NOT_STARTED;
 
+		deep_count_filesystem_job_end (directory->details->deep_count_in_progress->budget_fs_id);
 		directory->details->deep_count_in_progress->directory = NULL;
 		directory->details->deep_count_in_progress = NULL;
 		directory->details->deep_count_file = NULL;
@@ -682,6 +891,11 @@ nautilus_directory_set_up_request (NautilusFileAttributes file_attributes)
 		REQUEST_SET_TYPE (request, REQUEST_FILESYSTEM_INFO);
 	}
 
+	if (file_attributes & NAUTILUS_FILE_ATTRIBUTE_IMAGE_INFO) {
+		REQUEST_SET_TYPE (request, REQUEST_IMAGE_INFO);
+		REQUEST_SET_TYPE (request, REQUEST_FILE_INFO);
+	}
+
 	return request;
 }
 
@@ -768,6 +982,10 @@ nautilus_directory_monitor_add_internal (NautilusDirectory *directory,
 
 	/* Put the monitor file or all the files on the work queue. */
 	if (file != NULL) {
+		if (REQUEST_WANTS_TYPE (monitor->request, REQUEST_FILE_INFO) &&
+		    file->details->directory == directory) {
+			nautilus_directory_request_full_info (directory, file);
+		}
 		nautilus_directory_add_file_to_work_queue (directory, file);
 	} else {
 		add_all_files_to_work_queue (directory);
@@ -808,7 +1026,7 @@ show_hidden_files_changed_callback (gpointer callback_data)
 }
 
 static gboolean
-should_skip_file (NautilusDirectory *directory, GFileInfo *info)
+get_show_hidden_files (void)
 {
 	static gboolean show_hidden_files_changed_callback_installed = FALSE;
 
@@ -825,7 +1043,13 @@ should_skip_file (NautilusDirectory *directory, GFileInfo *info)
 		show_hidden_files_changed_callback (NULL);
 	}
 
-	if (!show_hidden_files &&
+	return show_hidden_files;
+}
+
+static gboolean
+should_skip_file (NautilusDirectory *directory, GFileInfo *info)
+{
+	if (!get_show_hidden_files () &&
 	    (g_file_info_get_is_hidden (info) ||
 	     g_file_info_get_is_backup (info))) {
 		return TRUE;
@@ -845,6 +1069,7 @@ dequeue_pending_idle_callback (gpointer callback_data)
 	GFileInfo *file_info;
 	const char *mimetype, *name;
 	DirectoryLoadState *dir_load_state;
+	gboolean partial;
 
 	directory = NAUTILUS_DIRECTORY (callback_data);
 
@@ -887,13 +1112,15 @@ dequeue_pending_idle_callback (gpointer callback_data)
 			dir_load_state->load_file_count += 1;
 
 			/* Add the MIME type to the set. */
-			mimetype = g_file_info_get_content_type (file_info);
+			mimetype = nautilus_get_content_type_from_info (file_info);
 			if (mimetype != NULL) {
 				istr_set_insert (dir_load_state->load_mime_list_hash,
 						 mimetype);
 			}
 		}
 		
+		partial = is_partial_info (file_info);
+
 		/* check if the file already exists */
 		file = nautilus_directory_find_file_by_name (directory, name);
 		if (file != NULL) {
@@ -908,7 +1135,16 @@ dequeue_pending_idle_callback (gpointer callback_data)
 				nautilus_file_ref (file);
 				file->details->is_added = TRUE;
 				added_files = g_list_prepend (added_files, file);
-			} else if (nautilus_file_update_info (file, file_info)) {
+			} else if (partial && file->details->got_file_info &&
+				   !file->details->file_info_is_partial) {
+				/* Don't throw away the full info we already
+				 * have; fetch it again if the file changed.
+				 */
+				if (partial_info_differs (file, file_info)) {
+					file->details->file_info_is_up_to_date = FALSE;
+					nautilus_directory_add_file_to_work_queue (directory, file);
+				}
+			} else if (nautilus_file_update_enumerated_info (file, file_info, partial)) {
 				/* File changed, notify about the change. */
 				nautilus_file_ref (file);
 				changed_files = g_list_prepend (changed_files, file);
@@ -916,6 +1152,7 @@ dequeue_pending_idle_callback (gpointer callback_data)
 		} else {
 			/* new file, create a nautilus file object and add it to the list */
 			file = nautilus_file_new_from_info (directory, file_info);
+			file->details->file_info_is_partial = partial;
 			nautilus_directory_add_file (directory, file);			
 			file->details->is_added = TRUE;
 			added_files = g_list_prepend (added_files, file);
@@ -993,9 +1230,39 @@ nautilus_directory_schedule_dequeue_pending (NautilusDirectory *directory)
 	}
 }
 
+static GQuark
+partial_info_quark (void)
+{
+	static GQuark quark = 0;
+
+	if (quark == 0) {
+		quark = g_quark_from_static_string ("nautilus-partial-file-info");
+	}
+	return quark;
+}
+
+static gboolean
+is_partial_info (GFileInfo *info)
+{
+	return g_object_get_qdata (G_OBJECT (info), partial_info_quark ()) != NULL;
+}
+
+static gboolean
+partial_info_differs (NautilusFile *file,
+		      GFileInfo *info)
+{
+	return file->details->type != g_file_info_get_file_type (info)
+		|| file->details->size != g_file_info_get_size (info)
+		|| file->details->mtime != (time_t) g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+}
+
+/* Infos coming from the enumerator only have
+ * NAUTILUS_FILE_ENUMERATION_ATTRIBUTES; partial is TRUE for those.
+ */
 static void
 directory_load_one (NautilusDirectory *directory,
-		    GFileInfo *info)
+		    GFileInfo *info,
+		    gboolean partial)
 {
 	if (info == NULL) {
 		return;
@@ -1011,6 +1278,10 @@ directory_load_one (NautilusDirectory *directory,
 		return;
 	}
 	
+	if (partial) {
+		g_object_set_qdata (G_OBJECT (info), partial_info_quark (), GINT_TO_POINTER (TRUE));
+	}
+
 	/* Arrange for the "loading" part of the work. */
 	g_object_ref (info);
 	directory->details->pending_file_info
@@ -1035,7 +1306,7 @@ directory_load_cancel (NautilusDirectory *directory)
 		g_cancellable_cancel (state->cancellable);
 		state->directory = NULL;
 		directory->details->directory_load_in_progress = NULL;
-		async_job_end (directory, "file list");
+		file_list_job_end (directory);
 	}
 }
 
@@ -1321,6 +1592,10 @@ nautilus_directory_call_when_ready_internal (NautilusDirectory *directory,
 
 	/* Put the callback file or all the files on the work queue. */
 	if (file != NULL) {
+		if (REQUEST_WANTS_TYPE (callback.request, REQUEST_FILE_INFO) &&
+		    file->details->directory == directory) {
+			nautilus_directory_request_full_info (directory, file);
+		}
 		nautilus_directory_add_file_to_work_queue (directory, file);
 	} else {
 		add_all_files_to_work_queue (directory);
@@ -1449,7 +1724,7 @@ new_files_callback (GObject *source_object,
 	/* Queue up the new file. */
 	info = g_file_query_info_finish (G_FILE (source_object), res, NULL);
 	if (info != NULL) {
-		directory_load_one (directory, info);
+		directory_load_one (directory, info, FALSE);
 		g_object_unref (info);
 	}
 
@@ -1501,6 +1776,7 @@ nautilus_async_destroying_file (NautilusFile *file)
 	GList *node, *next;
 	ReadyCallback *callback;
 	Monitor *monitor;
+	ExtensionInfoJob *job;
 
 	directory = file->details->directory;
 	changed = FALSE;
@@ -1559,9 +1835,12 @@ nautilus_async_destroying_file (NautilusFile *file)
 		directory->details->link_info_read_state->file = NULL;
 		changed = TRUE;
 	}
-	if (directory->details->extension_info_file == file) {
-		directory->details->extension_info_file = NULL;
-		changed = TRUE;
+	for (node = directory->details->extension_info_jobs; node != NULL; node = node->next) {
+		job = node->data;
+		if (g_list_find (job->files, file) != NULL) {
+			job->files = g_list_remove (job->files, file);
+			changed = TRUE;
+		}
 	}
 
 	if (directory->details->thumbnail_state != NULL &&
@@ -1581,6 +1860,12 @@ nautilus_async_destroying_file (NautilusFile *file)
 		directory->details->filesystem_info_state->file = NULL;
 		changed = TRUE;
 	}
+
+	if (directory->details->image_info_state != NULL &&
+	    directory->details->image_info_state->file == file) {
+		directory->details->image_info_state->file = NULL;
+		changed = TRUE;
+	}
 	
 	/* Let the directory take care of the rest. */
 	if (changed) {
@@ -1615,6 +1900,12 @@ lacks_filesystem_info (NautilusFile *file)
 	return !file->details->filesystem_info_is_up_to_date;
 }
 
+static gboolean
+lacks_image_info (NautilusFile *file)
+{
+	return !file->details->image_info_is_up_to_date;
+}
+
 static gboolean
 lacks_deep_count (NautilusFile *file)
 {
@@ -1730,6 +2021,12 @@ request_is_satisfied (NautilusDirectory *directory,
 		}
 	}
 
+	if (REQUEST_WANTS_TYPE (request, REQUEST_IMAGE_INFO)) {
+		if (has_problem (directory, file, lacks_image_info)) {
+			return FALSE;
+		}
+	}
+
 	if (REQUEST_WANTS_TYPE (request, REQUEST_DEEP_COUNT)) {
 		if (has_problem (directory, file, lacks_deep_count)) {
 			return FALSE;
@@ -1959,7 +2256,7 @@ more_files_callback (GObject *source_object,
 
 	for (l = files; l != NULL; l = l->next) {
 		info = l->data;
-		directory_load_one (directory, info);
+		directory_load_one (directory, info, TRUE);
 		g_object_unref (info);
 	}
 
@@ -2039,7 +2336,7 @@ start_monitoring_file_list (NautilusDirectory *directory)
 		return;
 	}
 
-	if (!async_job_start (directory, "file list")) {
+	if (!file_list_job_start (directory)) {
 		return;
 	}
 
@@ -2064,7 +2361,7 @@ start_monitoring_file_list (NautilusDirectory *directory)
 	directory->details->directory_load_in_progress = state;
 	
 	g_file_enumerate_children_async (directory->details->location,
-					 NAUTILUS_FILE_DEFAULT_ATTRIBUTES,
+					 NAUTILUS_FILE_ENUMERATION_ATTRIBUTES,
 					 0, /* flags */
 					 G_PRIORITY_DEFAULT, /* prio */
 					 state->cancellable,
@@ -2169,6 +2466,21 @@ nautilus_directory_force_reload_internal (NautilusDirectory     *directory,
 	nautilus_profile_end (NULL);
 }
 
+/* Enumerates a loaded directory again without invalidating anything,
+ * so the files stay shown; the ones not seen again go away once the
+ * new load is done.
+ */
+void
+nautilus_directory_revalidate_file_list (NautilusDirectory *directory)
+{
+	if (!directory->details->directory_loaded) {
+		return;
+	}
+
+	directory->details->directory_loaded = FALSE;
+	nautilus_directory_async_state_changed (directory);
+}
+
 static gboolean
 monitor_includes_file (const Monitor *monitor,
 		       NautilusFile *file)
@@ -2516,34 +2828,97 @@ mark_inode_as_seen (DeepCountState *state,
 	}
 }
 
+/* The cache entry keeps hidden files apart, and has them even while
+ * they are not shown and so not counted.
+ */
+static void
+deep_count_entry_add (NautilusDeepCountEntry *entry,
+		      GFileInfo *info,
+		      gboolean is_directory,
+		      gboolean descend,
+		      gboolean has_size)
+{
+	gboolean hidden;
+	GPtrArray *subdirectories;
+
+	hidden = g_file_info_get_is_hidden (info) || g_file_info_get_is_backup (info);
+
+	if (is_directory) {
+		if (hidden) {
+			entry->hidden_directory_count += 1;
+		} else {
+			entry->directory_count += 1;
+		}
+
+		if (descend) {
+			subdirectories = hidden ?
+				entry->hidden_subdirectories : entry->subdirectories;
+			g_ptr_array_add (subdirectories, g_strdup (g_file_info_get_name (info)));
+		}
+	} else if (hidden) {
+		entry->hidden_file_count += 1;
+	} else {
+		entry->file_count += 1;
+	}
+
+	if (has_size) {
+		if (hidden) {
+			entry->hidden_size += g_file_info_get_size (info);
+		} else {
+			entry->size += g_file_info_get_size (info);
+		}
+	}
+}
+
 static void
 deep_count_one (DeepCountState *state,
 		GFileInfo *info)
 {
 	NautilusFile *file;
 	GFile *subdir;
-	gboolean is_seen_inode;
+	gboolean skip, is_seen_inode, is_directory, descend, has_size;
 	const char *fs_id;
 
-	if (should_skip_file (NULL, info)) {
-		return;
+	skip = should_skip_file (NULL, info);
+
+	is_seen_inode = FALSE;
+	if (!skip) {
+		is_seen_inode = seen_inode (state, info);
+		if (!is_seen_inode) {
+			mark_inode_as_seen (state, info);
+		}
+	}
+
+	is_directory = g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY;
+	/* Subdirectories are only counted on the same filesystem */
+	fs_id = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_ID_FILESYSTEM);
+	descend = is_directory && g_strcmp0 (fs_id, state->fs_id) == 0;
+	has_size = !is_seen_inode && g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_SIZE);
+
+	/* Files with more than one name may be counted elsewhere too,
+	 * which the cached counts would not know about.
+	 */
+	if (is_seen_inode ||
+	    (!is_directory && g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_NLINK) > 1)) {
+		state->entry_cacheable = FALSE;
+	}
+
+	if (state->entry != NULL) {
+		deep_count_entry_add (state->entry, info, is_directory, descend, has_size);
 	}
 
-	is_seen_inode = seen_inode (state, info);
-	if (!is_seen_inode) {
-		mark_inode_as_seen (state, info);
+	if (skip) {
+		return;
 	}
 
 	file = state->directory->details->deep_count_file;
 
-	if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY) {
+	if (is_directory) {
 		/* Count the directory. */
 		file->details->deep_directory_count += 1;
 
 		/* Record the fact that we have to descend into this directory. */
-		fs_id = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_ID_FILESYSTEM);
-		if (g_strcmp0 (fs_id, state->fs_id) == 0) {
-			/* only if it is on the same filesystem */
+		if (descend) {
 			subdir = g_file_get_child (state->deep_count_location, g_file_info_get_name (info));
 			state->deep_count_subdirectories = g_list_prepend
 				(state->deep_count_subdirectories, subdir);
@@ -2554,11 +2929,21 @@ deep_count_one (DeepCountState *state,
 	}
 
 	/* Count the size. */
-	if (!is_seen_inode && g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_SIZE)) {
+	if (has_size) {
 		file->details->deep_size += g_file_info_get_size (info);
 	}
 }
 
+static void
+deep_count_clear_entry (DeepCountState *state)
+{
+	g_clear_object (&state->directory_info);
+	if (state->entry != NULL) {
+		nautilus_deep_count_entry_free (state->entry);
+		state->entry = NULL;
+	}
+}
+
 static void
 deep_count_state_free (DeepCountState *state)
 {
@@ -2576,6 +2961,8 @@ deep_count_state_free (DeepCountState *state)
 	g_list_free_full (state->deep_count_subdirectories, g_object_unref);
 	g_array_free (state->seen_deep_count_inodes, TRUE);
 	g_free (state->fs_id);
+	g_free (state->budget_fs_id);
+	deep_count_clear_entry (state);
 	g_free (state);
 }
 
@@ -2606,6 +2993,7 @@ deep_count_next_dir (DeepCountState *state)
 		file->details->deep_counts_status = NAUTILUS_REQUEST_DONE;
 		directory->details->deep_count_file = NULL;
 		directory->details->deep_count_in_progress = NULL;
+		deep_count_filesystem_job_end (state->budget_fs_id);
 		deep_count_state_free (state);
 		done = TRUE;
 	}
@@ -2628,6 +3016,7 @@ deep_count_more_files_callback (GObject *source_object,
 	NautilusDirectory *directory;
 	GList *files, *l;
 	GFileInfo *info;
+	GError *error;
 
 	state = user_data;
 
@@ -2642,19 +3031,35 @@ deep_count_more_files_callback (GObject *source_object,
 	g_assert (directory->details->deep_count_in_progress != NULL);
 	g_assert (directory->details->deep_count_in_progress == state);
 
+	error = NULL;
 	files = g_file_enumerator_next_files_finish (state->enumerator,
-						     res, NULL);
+						     res, &error);
 
 	for (l = files; l != NULL; l = l->next)	{
 		info = l->data;
 		deep_count_one (state, info);
 		g_object_unref (info);
 	}
+
+	if (error != NULL) {
+		/* What was read so far is counted, but the rest of the
+		 * folder is not, so its count is not kept.
+		 */
+		directory->details->deep_count_file->details->deep_unreadable_count += 1;
+		state->entry_cacheable = FALSE;
+		g_error_free (error);
+	}
 	
 	if (files == NULL) {
 		g_file_enumerator_close_async (state->enumerator, 0, NULL, NULL, NULL);
 		g_object_unref (state->enumerator);
 		state->enumerator = NULL;
+
+		if (state->entry != NULL && state->entry_cacheable) {
+			nautilus_deep_count_cache_store (state->directory_info, state->entry);
+			state->entry = NULL;
+		}
+		deep_count_clear_entry (state);
 		
 		deep_count_next_dir (state);
 	} else {
@@ -2694,6 +3099,7 @@ deep_count_callback (GObject *source_object,
 	
 	if (enumerator == NULL) {
 		file->details->deep_unreadable_count += 1;
+		deep_count_clear_entry (state);
 		
 		deep_count_next_dir (state);
 	} else {
@@ -2709,12 +3115,10 @@ deep_count_callback (GObject *source_object,
 
 
 static void
-deep_count_load (DeepCountState *state, GFile *location)
+deep_count_read_directory (DeepCountState *state)
 {
-	state->deep_count_location = g_object_ref (location);
-
 #ifdef DEBUG_LOAD_DIRECTORY		
-	g_message ("load_directory called to get deep file count for %p", location);
+	g_message ("load_directory called to get deep file count for %p", state->deep_count_location);
 #endif	
 	g_file_enumerate_children_async (state->deep_count_location,
 					 G_FILE_ATTRIBUTE_STANDARD_NAME ","
@@ -2723,7 +3127,8 @@ deep_count_load (DeepCountState *state, GFile *location)
 					 G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN ","
 					 G_FILE_ATTRIBUTE_STANDARD_IS_BACKUP ","
 					 G_FILE_ATTRIBUTE_ID_FILESYSTEM ","
-					 G_FILE_ATTRIBUTE_UNIX_INODE,
+					 G_FILE_ATTRIBUTE_UNIX_INODE ","
+					 G_FILE_ATTRIBUTE_UNIX_NLINK,
 					 G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS, /* flags */
 					 G_PRIORITY_LOW, /* prio */
 					 state->cancellable,
@@ -2731,6 +3136,79 @@ deep_count_load (DeepCountState *state, GFile *location)
 					 state);
 }
 
+static void
+deep_count_directory_info_callback (GObject *source_object,
+				    GAsyncResult *res,
+				    gpointer user_data)
+{
+	DeepCountState *state;
+	NautilusFile *file;
+	const NautilusDeepCountEntry *entry;
+	GFileInfo *info;
+	GFile *subdir;
+	GPtrArray *subdirectories;
+	guint i;
+
+	state = user_data;
+
+	if (state->directory == NULL) {
+		/* Operation was cancelled. Bail out */
+		deep_count_state_free (state);
+		return;
+	}
+
+	info = g_file_query_info_finish (G_FILE (source_object), res, NULL);
+	if (info == NULL) {
+		deep_count_read_directory (state);
+		return;
+	}
+
+	/* A folder whose children did not change since it was last read
+	 * adds up to what it had then, only its subfolders are checked.
+	 */
+	entry = nautilus_deep_count_cache_lookup (info);
+	if (entry != NULL) {
+		file = state->directory->details->deep_count_file;
+		subdirectories = nautilus_deep_count_entry_add (entry,
+								get_show_hidden_files (),
+								&file->details->deep_file_count,
+								&file->details->deep_directory_count,
+								&file->details->deep_size);
+
+		for (i = 0; i < subdirectories->len; i++) {
+			subdir = g_file_get_child (state->deep_count_location,
+						   g_ptr_array_index (subdirectories, i));
+			state->deep_count_subdirectories = g_list_prepend
+				(state->deep_count_subdirectories, subdir);
+		}
+		g_ptr_array_unref (subdirectories);
+
+		g_object_unref (info);
+		deep_count_next_dir (state);
+		return;
+	}
+
+	state->directory_info = info;
+	state->entry = nautilus_deep_count_entry_new ();
+	state->entry_cacheable = TRUE;
+
+	deep_count_read_directory (state);
+}
+
+static void
+deep_count_load (DeepCountState *state, GFile *location)
+{
+	state->deep_count_location = g_object_ref (location);
+
+	g_file_query_info_async (state->deep_count_location,
+				 NAUTILUS_DEEP_COUNT_CACHE_ATTRIBUTES,
+				 G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+				 G_PRIORITY_LOW,
+				 state->cancellable,
+				 deep_count_directory_info_callback,
+				 state);
+}
+
 static void
 deep_count_stop (NautilusDirectory *directory)
 {
@@ -2779,6 +3257,7 @@ deep_count_start (NautilusDirectory *directory,
 {
 	GFile *location;
 	DeepCountState *state;
+	const char *fs_id;
 	
 	if (directory->details->deep_count_in_progress != NULL) {
 		*doing_io = TRUE;
@@ -2799,9 +3278,15 @@ deep_count_start (NautilusDirectory *directory,
 		return;
 	}
 
+	/* Files whose info did not say share one budget */
+	fs_id = file->details->filesystem_id != NULL ? file->details->filesystem_id : "";
+	if (!deep_count_filesystem_has_room (directory, fs_id)) {
+		return;
+	}
 	if (!async_job_start (directory, "deep count")) {
 		return;
 	}
+	deep_count_filesystem_job_start (fs_id);
 
 	/* Start counting. */
 	file->details->deep_counts_status = NAUTILUS_REQUEST_IN_PROGRESS;
@@ -2816,6 +3301,7 @@ deep_count_start (NautilusDirectory *directory,
 	state->cancellable = g_cancellable_new ();
 	state->seen_deep_count_inodes = g_array_new (FALSE, TRUE, sizeof (guint64));
 	state->fs_id = NULL;
+	state->budget_fs_id = g_strdup (fs_id);
 
 	directory->details->deep_count_in_progress = state;
 	
@@ -2830,6 +3316,19 @@ deep_count_start (NautilusDirectory *directory,
 	g_object_unref (location);
 }
 
+/* Deep counts are started from their own queue, see start_or_stop_io. */
+static void
+deep_count_enqueue (NautilusDirectory *directory,
+		    NautilusFile *file)
+{
+	if (is_needy (file,
+		      lacks_deep_count,
+		      REQUEST_DEEP_COUNT)) {
+		nautilus_file_queue_enqueue (directory->details->deep_count_queue,
+					     file);
+	}
+}
+
 static void
 mime_list_stop (NautilusDirectory *directory)
 {
@@ -3491,6 +3990,8 @@ thumbnail_done (NautilusDirectory *directory,
 			file->details->thumbnail_path = NULL;
 		}
 	}
+
+	nautilus_file_update_thumbnail_budget (file);
 	
 	nautilus_directory_async_state_changed (directory);
 }
@@ -4045,43 +4546,341 @@ filesystem_info_start (NautilusDirectory *directory,
 }
 
 static void
-extension_info_cancel (NautilusDirectory *directory)
+image_info_cancel (NautilusDirectory *directory)
 {
-	if (directory->details->extension_info_in_progress != NULL) {
-		if (directory->details->extension_info_idle) {
-			g_source_remove (directory->details->extension_info_idle);
-		} else {
-			nautilus_info_provider_cancel_update 
-				(directory->details->extension_info_provider,
-				 directory->details->extension_info_in_progress);
-		}
-
-		directory->details->extension_info_in_progress = NULL;
-		directory->details->extension_info_file = NULL;
-		directory->details->extension_info_provider = NULL;
-		directory->details->extension_info_idle = 0;
-
-		async_job_end (directory, "extension info");
+	if (directory->details->image_info_state != NULL) {
+		g_cancellable_cancel (directory->details->image_info_state->cancellable);
+		directory->details->image_info_state->directory = NULL;
+		directory->details->image_info_state = NULL;
+		async_job_end (directory, "image info");
 	}
 }
-	
+
 static void
-extension_info_stop (NautilusDirectory *directory)
+image_info_stop (NautilusDirectory *directory)
 {
-	if (directory->details->extension_info_in_progress != NULL) {
-		NautilusFile *file;
+	NautilusFile *file;
+
+	if (directory->details->image_info_state != NULL) {
+		file = directory->details->image_info_state->file;
 
-		file = directory->details->extension_info_file;
 		if (file != NULL) {
 			g_assert (NAUTILUS_IS_FILE (file));
 			g_assert (file->details->directory == directory);
-			if (is_needy (file, lacks_extension_info, REQUEST_EXTENSION_INFO)) {
+			if (is_needy (file,
+				      lacks_image_info,
+				      REQUEST_IMAGE_INFO)) {
 				return;
 			}
 		}
 
-		/* The info is not wanted, so stop it. */
-		extension_info_cancel (directory);
+		/* The image info is not wanted, so stop it. */
+		image_info_cancel (directory);
+	}
+}
+
+static void
+image_info_state_free (ImageInfoState *state)
+{
+	g_object_unref (state->cancellable);
+	g_free (state);
+}
+
+static void
+set_image_info (NautilusFile *file,
+		NautilusImageHeader *header)
+{
+	file->details->image_info_is_up_to_date = TRUE;
+	file->details->image_width = header != NULL ? header->width : 0;
+	file->details->image_height = header != NULL ? header->height : 0;
+	file->details->image_date_taken = header != NULL ? header->date_taken : 0;
+}
+
+static void
+got_image_info (ImageInfoState *state,
+		NautilusImageHeader *header)
+{
+	NautilusDirectory *directory;
+	NautilusFile *file;
+
+	/* careful here, header may be NULL */
+
+	directory = nautilus_directory_ref (state->directory);
+
+	state->directory->details->image_info_state = NULL;
+	async_job_end (state->directory, "image info");
+
+	/* The file may have been removed meanwhile */
+	file = nautilus_file_ref (state->file);
+	if (file != NULL) {
+		set_image_info (file, header);
+	}
+
+	nautilus_directory_async_state_changed (directory);
+
+	if (file != NULL) {
+		nautilus_file_changed (file);
+		nautilus_file_unref (file);
+	}
+
+	nautilus_directory_unref (directory);
+
+	image_info_state_free (state);
+}
+
+static void
+image_info_thread (GTask *task,
+		   gpointer source_object,
+		   gpointer task_data,
+		   GCancellable *cancellable)
+{
+	NautilusImageHeader *header;
+
+	/* Only reads the first blocks of the file */
+	header = nautilus_image_header_read (G_FILE (source_object), cancellable, NULL);
+	g_task_return_pointer (task, header, header != NULL ?
+			       (GDestroyNotify) nautilus_image_header_free : NULL);
+}
+
+static void
+image_info_callback (GObject *source_object,
+		     GAsyncResult *res,
+		     gpointer user_data)
+{
+	NautilusImageHeader *header;
+	ImageInfoState *state;
+
+	state = user_data;
+	header = g_task_propagate_pointer (G_TASK (res), NULL);
+
+	if (state->directory == NULL) {
+		/* Operation was cancelled. Bail out */
+		image_info_state_free (state);
+	} else {
+		got_image_info (state, header);
+	}
+
+	if (header != NULL) {
+		nautilus_image_header_free (header);
+	}
+}
+
+static void
+image_info_start (NautilusDirectory *directory,
+		  NautilusFile *file,
+		  gboolean *doing_io)
+{
+	GFile *location;
+	ImageInfoState *state;
+	GTask *task;
+	char *mime_type;
+	gboolean supported;
+
+	if (directory->details->image_info_state != NULL) {
+		*doing_io = TRUE;
+		return;
+	}
+
+	if (!is_needy (file,
+		       lacks_image_info,
+		       REQUEST_IMAGE_INFO)) {
+		return;
+	}
+	*doing_io = TRUE;
+
+	mime_type = nautilus_file_get_mime_type (file);
+	supported = nautilus_image_header_supports (mime_type);
+	g_free (mime_type);
+
+	if (!supported) {
+		/* Nothing to read */
+		set_image_info (file, NULL);
+		nautilus_directory_async_state_changed (directory);
+		return;
+	}
+
+	if (!async_job_start (directory, "image info")) {
+		return;
+	}
+
+	state = g_new0 (ImageInfoState, 1);
+	state->directory = directory;
+	state->file = file;
+	state->cancellable = g_cancellable_new ();
+
+	directory->details->image_info_state = state;
+
+	location = nautilus_file_get_location (file);
+	task = g_task_new (location, state->cancellable, image_info_callback, state);
+	g_task_run_in_thread (task, image_info_thread);
+	g_object_unref (task);
+	g_object_unref (location);
+}
+
+/* Extension info is scheduled per provider: every provider can have
+ * one job running for a directory, so a slow provider only holds up
+ * its own work. Providers that implement the batch interface get up
+ * to EXTENSION_INFO_BATCH_SIZE files per job, handled by a small pool
+ * of worker threads shared by all directories.
+ */
+#define EXTENSION_INFO_BATCH_SIZE 64
+#define EXTENSION_INFO_MAX_WORKERS 2
+#define EXTENSION_INFO_SLOW_MSEC 100
+
+struct ExtensionInfoJob {
+	NautilusDirectory *directory; /* NULL once the job is cancelled */
+	NautilusInfoProvider *provider;
+	GList *files; /* not referenced, destroyed files are taken out */
+	gint64 start_time;
+
+	/* For providers using update_file_info */
+	NautilusOperationHandle *handle;
+	guint idle_id;
+
+	/* For providers using the batch interface */
+	GCancellable *cancellable;
+	GList *locations;
+	gpointer data;
+};
+
+static GThreadPool *extension_info_pool;
+
+static void
+extension_info_report (ExtensionInfoJob *job)
+{
+	gint64 elapsed;
+
+	elapsed = g_get_monotonic_time () - job->start_time;
+	nautilus_module_record_call (G_OBJECT (job->provider), "info", elapsed);
+
+	if (elapsed >= EXTENSION_INFO_SLOW_MSEC * 1000) {
+		DEBUG ("%s took %" G_GINT64_FORMAT " ms for %u files",
+		       G_OBJECT_TYPE_NAME (job->provider), elapsed / 1000,
+		       g_list_length (job->files));
+	}
+}
+
+static ExtensionInfoJob *
+extension_info_job_new (NautilusDirectory *directory,
+			NautilusInfoProvider *provider)
+{
+	ExtensionInfoJob *job;
+
+	job = g_new0 (ExtensionInfoJob, 1);
+	job->directory = directory;
+	job->provider = g_object_ref (provider);
+	job->start_time = g_get_monotonic_time ();
+
+	directory->details->extension_info_jobs =
+		g_list_prepend (directory->details->extension_info_jobs, job);
+	nautilus_profile_async_begin ("extension", G_OBJECT_TYPE_NAME (provider), job);
+
+	return job;
+}
+
+static void
+extension_info_job_free (ExtensionInfoJob *job)
+{
+	g_list_free (job->files);
+	g_list_free_full (job->locations, g_object_unref);
+	g_clear_object (&job->cancellable);
+	g_object_unref (job->provider);
+	g_free (job);
+}
+
+static ExtensionInfoJob *
+find_extension_info_job (NautilusDirectory *directory,
+			 NautilusInfoProvider *provider)
+{
+	GList *node;
+	ExtensionInfoJob *job;
+
+	for (node = directory->details->extension_info_jobs; node != NULL; node = node->next) {
+		job = node->data;
+		if (job->provider == provider) {
+			return job;
+		}
+	}
+
+	return NULL;
+}
+
+static void
+extension_info_job_detach (ExtensionInfoJob *job)
+{
+	NautilusDirectory *directory;
+
+	directory = job->directory;
+	directory->details->extension_info_jobs =
+		g_list_remove (directory->details->extension_info_jobs, job);
+	job->directory = NULL;
+
+	nautilus_profile_async_end ("extension", G_OBJECT_TYPE_NAME (job->provider), job);
+	async_job_end (directory, "extension info");
+}
+
+static void
+extension_info_job_cancel (ExtensionInfoJob *job)
+{
+	if (job->cancellable != NULL) {
+		/* The worker still owns the job, it is freed when the
+		 * batch comes back.
+		 */
+		g_cancellable_cancel (job->cancellable);
+		extension_info_job_detach (job);
+		return;
+	}
+
+	if (job->idle_id != 0) {
+		g_source_remove (job->idle_id);
+	} else if (job->handle != NULL) {
+		nautilus_info_provider_cancel_update (job->provider, job->handle);
+	}
+
+	extension_info_job_detach (job);
+	extension_info_job_free (job);
+}
+
+static void
+extension_info_cancel (NautilusDirectory *directory)
+{
+	while (directory->details->extension_info_jobs != NULL) {
+		extension_info_job_cancel (directory->details->extension_info_jobs->data);
+	}
+}
+
+static gboolean
+extension_info_job_is_wanted (ExtensionInfoJob *job)
+{
+	GList *node;
+	NautilusFile *file;
+
+	for (node = job->files; node != NULL; node = node->next) {
+		file = node->data;
+		g_assert (NAUTILUS_IS_FILE (file));
+		if (file->details->directory == job->directory &&
+		    is_needy (file, lacks_extension_info, REQUEST_EXTENSION_INFO)) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static void
+extension_info_stop (NautilusDirectory *directory)
+{
+	GList *node, *next;
+	ExtensionInfoJob *job;
+
+	for (node = directory->details->extension_info_jobs; node != NULL; node = next) {
+		next = node->next;
+		job = node->data;
+
+		/* Stop the jobs whose info is no longer wanted. */
+		if (!extension_info_job_is_wanted (job)) {
+			extension_info_job_cancel (job);
+		}
 	}
 }
 
@@ -4090,9 +4889,20 @@ finish_info_provider (NautilusDirectory *directory,
 		      NautilusFile *file,
 		      NautilusInfoProvider *provider)
 {
+	GList *node;
+
+	node = g_list_find (file->details->pending_info_providers, provider);
+	if (node == NULL) {
+		/* The info was invalidated meanwhile. */
+		return;
+	}
+
+	/* The file may have moved to another directory meanwhile. */
+	if (nautilus_file_queue_contains (file->details->directory->details->extension_queue, file)) {
+		count_extension_queue_provider (file->details->directory, provider, -1);
+	}
 	file->details->pending_info_providers = 
-		g_list_remove  (file->details->pending_info_providers,
-				provider);
+		g_list_delete_link (file->details->pending_info_providers, node);
 	g_object_unref (provider);
 
 	nautilus_directory_async_state_changed (directory);
@@ -4102,31 +4912,42 @@ finish_info_provider (NautilusDirectory *directory,
 	}
 }
 
+static void
+extension_info_job_done (ExtensionInfoJob *job)
+{
+	NautilusDirectory *directory;
+	GList *node;
+	NautilusFile *file;
+
+	directory = job->directory;
+
+	extension_info_report (job);
+	extension_info_job_detach (job);
+
+	for (node = job->files; node != NULL; node = node->next) {
+		file = node->data;
+		if (file->details->directory == directory) {
+			finish_info_provider (directory, file, job->provider);
+		}
+	}
+
+	extension_info_job_free (job);
+}
 
 static gboolean
 info_provider_idle_callback (gpointer user_data)
 {
 	InfoProviderResponse *response;
-	NautilusDirectory *directory;
+	ExtensionInfoJob *job;
 
 	response = user_data;
-	directory = response->directory;
+	job = find_extension_info_job (response->directory, response->provider);
 
-	if (response->handle != directory->details->extension_info_in_progress
-	    || response->provider != directory->details->extension_info_provider) {
+	if (job == NULL || job->cancellable != NULL || response->handle != job->handle) {
 		g_warning ("Unexpected plugin response.  This probably indicates a bug in a Nautilus extension: handle=%p", response->handle);
 	} else {
-		NautilusFile *file;
-		async_job_end (directory, "extension info");
-
-		file = directory->details->extension_info_file;
-
-		directory->details->extension_info_file = NULL;
-		directory->details->extension_info_provider = NULL;
-		directory->details->extension_info_in_progress = NULL;
-		directory->details->extension_info_idle = 0;
-		
-		finish_info_provider (directory, file, response->provider);
+		job->idle_id = 0;
+		extension_info_job_done (job);
 	}
 
 	return FALSE;
@@ -4139,51 +4960,45 @@ info_provider_callback (NautilusInfoProvider *provider,
 			gpointer user_data)
 {
 	InfoProviderResponse *response;
-	
+	ExtensionInfoJob *job;
+	guint idle_id;
+
 	response = g_new0 (InfoProviderResponse, 1);
 	response->provider = provider;
 	response->handle = handle;
 	response->result = result;
 	response->directory = NAUTILUS_DIRECTORY (user_data);
 
-	response->directory->details->extension_info_idle =
-		g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
-				 info_provider_idle_callback, response,
-				 g_free);
+	idle_id = g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
+				   info_provider_idle_callback, response,
+				   g_free);
+
+	job = find_extension_info_job (response->directory, provider);
+	if (job != NULL) {
+		job->idle_id = idle_id;
+	}
 }
 
 static void
-extension_info_start (NautilusDirectory *directory,
-		      NautilusFile *file,
-		      gboolean *doing_io)
+extension_info_start_update (NautilusDirectory *directory,
+			     NautilusFile *file,
+			     NautilusInfoProvider *provider)
 {
-	NautilusInfoProvider *provider;
+	ExtensionInfoJob *job;
 	NautilusOperationResult result;
 	NautilusOperationHandle *handle;
 	GClosure *update_complete;
 
-	if (directory->details->extension_info_in_progress != NULL) {
-		*doing_io = TRUE;
-		return;
-	}
-	
-	if (!is_needy (file, lacks_extension_info, REQUEST_EXTENSION_INFO)) {
-		return;
-	}
-	*doing_io = TRUE;
-
-	if (!async_job_start (directory, "extension info")) {
-		return;
-	}
-
-	provider = file->details->pending_info_providers->data;
+	job = extension_info_job_new (directory, provider);
+	job->files = g_list_prepend (NULL, file);
 
 	update_complete = g_cclosure_new (G_CALLBACK (info_provider_callback),
 					  directory,
 					  NULL);
 	g_closure_set_marshal (update_complete,
 			       g_cclosure_marshal_generic);
-			       
+
+	handle = NULL;
 	result = nautilus_info_provider_update_file_info
 		(provider, 
 		 NAUTILUS_FILE_INFO (file), 
@@ -4194,20 +5009,196 @@ extension_info_start (NautilusDirectory *directory,
 
 	if (result == NAUTILUS_OPERATION_COMPLETE ||
 	    result == NAUTILUS_OPERATION_FAILED) {
-		finish_info_provider (directory, file, provider);
-		async_job_end (directory, "extension info");
+		if (job->idle_id != 0) {
+			g_source_remove (job->idle_id);
+			job->idle_id = 0;
+		}
+		extension_info_job_done (job);
+	} else {
+		job->handle = handle;
+	}
+}
+
+static void
+extension_info_batch_thread_func (gpointer data,
+				  gpointer user_data)
+{
+	GTask *task;
+	ExtensionInfoJob *job;
+
+	task = data;
+	job = g_task_get_task_data (task);
+
+	if (!g_cancellable_is_cancelled (job->cancellable)) {
+		job->data = nautilus_info_provider_update_file_info_batch
+			(job->provider, job->locations, job->cancellable);
+	}
+
+	g_task_return_boolean (task, TRUE);
+	g_object_unref (task);
+}
+
+static void
+extension_info_batch_callback (GObject *source_object,
+			       GAsyncResult *res,
+			       gpointer user_data)
+{
+	ExtensionInfoJob *job;
+	NautilusDirectory *directory;
+	GList *node, *files;
+	NautilusFile *file;
+
+	job = user_data;
+	directory = job->directory;
+
+	/* Only the files that still want the info get it. */
+	files = NULL;
+	if (directory != NULL) {
+		for (node = job->files; node != NULL; node = node->next) {
+			file = node->data;
+			if (file->details->directory == directory &&
+			    g_list_find (file->details->pending_info_providers, job->provider) != NULL) {
+				files = g_list_prepend (files, file);
+			}
+		}
+		files = g_list_reverse (files);
+	}
+
+	nautilus_info_provider_complete_file_info_batch (job->provider, files, job->data);
+	g_list_free (files);
+
+	if (directory == NULL) {
+		extension_info_job_free (job);
 	} else {
-		directory->details->extension_info_in_progress = handle;
-		directory->details->extension_info_provider = provider;
-		directory->details->extension_info_file = file;
+		extension_info_job_done (job);
+	}
+}
+
+static void
+extension_info_start_batch (NautilusDirectory *directory,
+			    NautilusInfoProvider *provider)
+{
+	ExtensionInfoJob *job;
+	GList *node;
+	NautilusFile *file;
+	guint n_files, n_waiting;
+	GTask *task;
+
+	if (extension_info_pool == NULL) {
+		extension_info_pool = g_thread_pool_new (extension_info_batch_thread_func, NULL,
+							 EXTENSION_INFO_MAX_WORKERS, FALSE, NULL);
 	}
+
+	job = extension_info_job_new (directory, provider);
+	job->cancellable = g_cancellable_new ();
+
+	/* The queue has the files that are shown first. Once all the
+	 * files waiting for the provider are found, the rest of the
+	 * queue is not looked at.
+	 */
+	n_waiting = GPOINTER_TO_UINT (g_hash_table_lookup (directory->details->extension_queue_providers,
+							   provider));
+	n_files = 0;
+	for (node = nautilus_file_queue_peek_list (directory->details->extension_queue);
+	     node != NULL && n_files < EXTENSION_INFO_BATCH_SIZE && n_waiting > 0;
+	     node = node->next) {
+		file = node->data;
+		if (g_list_find (file->details->pending_info_providers, provider) == NULL) {
+			continue;
+		}
+		n_waiting--;
+		if (!is_needy (file, lacks_extension_info, REQUEST_EXTENSION_INFO)) {
+			continue;
+		}
+
+		job->files = g_list_prepend (job->files, file);
+		job->locations = g_list_prepend (job->locations, nautilus_file_get_location (file));
+		n_files++;
+	}
+	job->files = g_list_reverse (job->files);
+	job->locations = g_list_reverse (job->locations);
+
+	task = g_task_new (NULL, job->cancellable, extension_info_batch_callback, job);
+	g_task_set_task_data (task, job, NULL);
+	g_thread_pool_push (extension_info_pool, task, NULL);
+}
+
+/* Sets doing_io only when a job was started or the job limit was hit.
+ * A file whose providers are all busy with other files is left for
+ * when those jobs are done.
+ */
+static void
+extension_info_start (NautilusDirectory *directory,
+		      NautilusFile *file,
+		      gboolean *doing_io)
+{
+	GList *node;
+	NautilusInfoProvider *provider;
+
+	if (!is_needy (file, lacks_extension_info, REQUEST_EXTENSION_INFO)) {
+		return;
+	}
+
+	node = file->details->pending_info_providers;
+	while (node != NULL) {
+		provider = node->data;
+
+		if (find_extension_info_job (directory, provider) != NULL) {
+			node = node->next;
+			continue;
+		}
+
+		*doing_io = TRUE;
+		if (!async_job_start (directory, "extension info")) {
+			return;
+		}
+
+		if (nautilus_info_provider_supports_batch (provider)) {
+			extension_info_start_batch (directory, provider);
+		} else {
+			extension_info_start_update (directory, file, provider);
+		}
+
+		if (!is_needy (file, lacks_extension_info, REQUEST_EXTENSION_INFO)) {
+			return;
+		}
+
+		/* Finishing synchronously may have changed the list. */
+		node = file->details->pending_info_providers;
+	}
+}
+
+/* Whether a file in the extension queue waits for a provider that has
+ * no job running, so walking the queue could start something. Without
+ * this, files waiting for busy providers were walked over again on
+ * every state change.
+ */
+static gboolean
+extension_queue_has_idle_provider (NautilusDirectory *directory)
+{
+	GHashTableIter iter;
+	gpointer provider;
+
+	if (directory->details->extension_queue_providers == NULL) {
+		return FALSE;
+	}
+
+	g_hash_table_iter_init (&iter, directory->details->extension_queue_providers);
+	while (g_hash_table_iter_next (&iter, &provider, NULL)) {
+		if (find_extension_info_job (directory, provider) == NULL) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
 }
 
 static void
 start_or_stop_io (NautilusDirectory *directory)
 {
 	NautilusFile *file;
-	gboolean doing_io;
+	GList *node;
+	gboolean doing_io, doing_deep_count;
 
 	/* Start or stop reading files. */
 	file_list_start_or_stop (directory);
@@ -4222,8 +5213,36 @@ start_or_stop_io (NautilusDirectory *directory)
 	mount_stop (directory);
 	thumbnail_stop (directory);
 	filesystem_info_stop (directory);
+	image_info_stop (directory);
 
 	doing_io = FALSE;
+	/* Full info for the files that are shown goes first. */
+	while (!nautilus_file_queue_is_empty (directory->details->full_info_queue)) {
+		file = nautilus_file_queue_head (directory->details->full_info_queue);
+
+		file_info_start (directory, file, &doing_io);
+		if (doing_io) {
+			return;
+		}
+
+		nautilus_file_queue_remove (directory->details->full_info_queue, file);
+	}
+
+	/* Deep counts run beside the rest of the work, so one long count
+	 * does not hold up item counts and thumbnails of the other files.
+	 */
+	while (!nautilus_file_queue_is_empty (directory->details->deep_count_queue)) {
+		file = nautilus_file_queue_head (directory->details->deep_count_queue);
+
+		doing_deep_count = FALSE;
+		deep_count_start (directory, file, &doing_deep_count);
+		if (doing_deep_count) {
+			break;
+		}
+
+		nautilus_file_queue_remove (directory->details->deep_count_queue, file);
+	}
+
 	/* Take files that are all done off the queue. */
 	while (!nautilus_file_queue_is_empty (directory->details->high_priority_queue)) {
 		file = nautilus_file_queue_head (directory->details->high_priority_queue);
@@ -4246,10 +5265,11 @@ start_or_stop_io (NautilusDirectory *directory)
 		/* Start getting attributes if possible */
 		mount_start (directory, file, &doing_io);
 		directory_count_start (directory, file, &doing_io);
-		deep_count_start (directory, file, &doing_io);
+		deep_count_enqueue (directory, file);
 		mime_list_start (directory, file, &doing_io);
 		thumbnail_start (directory, file, &doing_io);
 		filesystem_info_start (directory, file, &doing_io);
+		image_info_start (directory, file, &doing_io);
 
 		if (doing_io) {
 			return;
@@ -4259,8 +5279,23 @@ start_or_stop_io (NautilusDirectory *directory)
 	}
 
 	/* Low priority queue must be empty */
-	while (!nautilus_file_queue_is_empty (directory->details->extension_queue)) {
-		file = nautilus_file_queue_head (directory->details->extension_queue);
+	if (directory->details->extension_queue_providers == NULL ||
+	    g_hash_table_size (directory->details->extension_queue_providers) == 0) {
+		/* No file left in the queue waits for a provider. */
+		while (!nautilus_file_queue_is_empty (directory->details->extension_queue)) {
+			file = nautilus_file_queue_head (directory->details->extension_queue);
+			nautilus_file_queue_remove (directory->details->extension_queue, file);
+		}
+		return;
+	}
+	if (!extension_queue_has_idle_provider (directory)) {
+		return;
+	}
+
+	node = nautilus_file_queue_peek_list (directory->details->extension_queue);
+	while (node != NULL) {
+		file = node->data;
+		node = node->next;
 
 		/* Start getting attributes if possible */
 		extension_info_start (directory, file, &doing_io);
@@ -4268,7 +5303,12 @@ start_or_stop_io (NautilusDirectory *directory)
 			return;
 		}
 
-		nautilus_directory_remove_file_from_work_queue (directory, file);
+		/* Files waiting for busy providers keep their place; a
+		 * pending deep count stays queued.
+		 */
+		if (!is_needy (file, lacks_extension_info, REQUEST_EXTENSION_INFO)) {
+			remove_file_from_extension_queue (directory, file);
+		}
 	}
 }
 
@@ -4321,11 +5361,18 @@ nautilus_directory_cancel (NautilusDirectory *directory)
 	thumbnail_cancel (directory);
 	mount_cancel (directory);
 	filesystem_info_cancel (directory);
+	image_info_cancel (directory);
 
 	/* We aren't waiting for anything any more. */
 	if (waiting_directories != NULL) {
 		g_hash_table_remove (waiting_directories, directory);
 	}
+	if (waiting_file_list_directories != NULL) {
+		g_hash_table_remove (waiting_file_list_directories, directory);
+	}
+	if (waiting_deep_count_directories != NULL) {
+		g_hash_table_remove (waiting_deep_count_directories, directory);
+	}
 
 	/* Check if any directories should wake up. */
 	async_job_wake_up ();
@@ -4399,6 +5446,16 @@ cancel_filesystem_info_for_file (NautilusDirectory *directory,
 	}
 }
 
+static void
+cancel_image_info_for_file (NautilusDirectory *directory,
+			    NautilusFile      *file)
+{
+	if (directory->details->image_info_state != NULL &&
+	    directory->details->image_info_state->file == file) {
+		image_info_cancel (directory);
+	}
+}
+
 static void
 cancel_link_info_for_file (NautilusDirectory *directory,
 			   NautilusFile      *file)
@@ -4448,6 +5505,10 @@ cancel_loading_attributes (NautilusDirectory *directory,
 	if (REQUEST_WANTS_TYPE (request, REQUEST_MOUNT)) {
 		mount_cancel (directory);
 	}
+
+	if (REQUEST_WANTS_TYPE (request, REQUEST_IMAGE_INFO)) {
+		image_info_cancel (directory);
+	}
 	
 	nautilus_directory_async_state_changed (directory);
 }
@@ -4487,6 +5548,9 @@ nautilus_directory_cancel_loading_file_attributes (NautilusDirectory      *direc
 	if (REQUEST_WANTS_TYPE (request, REQUEST_MOUNT)) {
 		cancel_mount_for_file (directory, file);
 	}
+	if (REQUEST_WANTS_TYPE (request, REQUEST_IMAGE_INFO)) {
+		cancel_image_info_for_file (directory, file);
+	}
 
 	nautilus_directory_async_state_changed (directory);
 }
@@ -4523,10 +5587,61 @@ nautilus_directory_remove_file_from_work_queue (NautilusDirectory *directory,
 				    file);
 	nautilus_file_queue_remove (directory->details->low_priority_queue,
 				    file);
-	nautilus_file_queue_remove (directory->details->extension_queue,
+	remove_file_from_extension_queue (directory, file);
+	nautilus_file_queue_remove (directory->details->full_info_queue,
+				    file);
+	nautilus_file_queue_remove (directory->details->deep_count_queue,
 				    file);
 }
 
+/* Makes a file that only has the enumeration attributes lack info, so
+ * the complete set is fetched ahead of the rest of the work queue.
+ * Called for the files a view shows.
+ */
+void
+nautilus_directory_request_full_info (NautilusDirectory *directory,
+				      NautilusFile *file)
+{
+	NautilusDirectory *subdirectory;
+	GFile *location;
+
+	g_return_if_fail (file->details->directory == directory);
+
+	/* Shown files put their directory, and the contents of a shown
+	 * folder that is being loaded, ahead for free job slots.
+	 */
+	directory->details->shown_stamp = ++shown_stamp_counter;
+	if (nautilus_file_is_directory (file)) {
+		location = nautilus_file_get_location (file);
+		subdirectory = nautilus_directory_get_existing (location);
+		if (subdirectory != NULL) {
+			subdirectory->details->shown_stamp = shown_stamp_counter;
+			nautilus_directory_unref (subdirectory);
+		}
+		g_object_unref (location);
+	}
+
+	/* The extension info and deep counts of the files that are shown
+	 * come first too.
+	 */
+	if (nautilus_file_queue_contains (directory->details->extension_queue, file)) {
+		nautilus_file_queue_enqueue_head (directory->details->extension_queue,
+						  file);
+	}
+	if (nautilus_file_queue_contains (directory->details->deep_count_queue, file)) {
+		nautilus_file_queue_enqueue_head (directory->details->deep_count_queue,
+						  file);
+	}
+
+	if (!file->details->file_info_is_partial) {
+		return;
+	}
+
+	file->details->file_info_is_up_to_date = FALSE;
+	nautilus_file_queue_enqueue_head (directory->details->full_info_queue,
+					  file);
+}
+
 
 static void
 move_file_to_low_priority_queue (NautilusDirectory *directory,
@@ -4539,13 +5654,70 @@ move_file_to_low_priority_queue (NautilusDirectory *directory,
 				    file);
 }
 
+static void
+count_extension_queue_provider (NautilusDirectory *directory,
+				NautilusInfoProvider *provider,
+				int delta)
+{
+	int count;
+
+	if (directory->details->extension_queue_providers == NULL) {
+		directory->details->extension_queue_providers =
+			g_hash_table_new (NULL, NULL);
+	}
+
+	count = GPOINTER_TO_INT (g_hash_table_lookup (directory->details->extension_queue_providers,
+						      provider));
+	count += delta;
+	g_assert (count >= 0);
+
+	if (count == 0) {
+		g_hash_table_remove (directory->details->extension_queue_providers, provider);
+	} else {
+		g_hash_table_insert (directory->details->extension_queue_providers,
+				     provider, GINT_TO_POINTER (count));
+	}
+}
+
+/* Adds @delta to the count of each provider @file waits for, if the
+ * file is in the extension queue. Called with -1 before the file's
+ * providers are replaced and with 1 after.
+ */
+void
+nautilus_directory_count_extension_queue_providers (NautilusDirectory *directory,
+						    NautilusFile *file,
+						    int delta)
+{
+	GList *node;
+
+	if (!nautilus_file_queue_contains (directory->details->extension_queue, file)) {
+		return;
+	}
+
+	for (node = file->details->pending_info_providers; node != NULL; node = node->next) {
+		count_extension_queue_provider (directory, node->data, delta);
+	}
+}
+
 static void
 move_file_to_extension_queue (NautilusDirectory *directory,
 			      NautilusFile *file)
 {
-	/* Must add before removing to avoid ref underflow */
-	nautilus_file_queue_enqueue (directory->details->extension_queue,
-				     file);
+	if (!nautilus_file_queue_contains (directory->details->extension_queue, file)) {
+		/* Must add before removing to avoid ref underflow */
+		nautilus_file_queue_enqueue (directory->details->extension_queue,
+					     file);
+		nautilus_directory_count_extension_queue_providers (directory, file, 1);
+	}
 	nautilus_file_queue_remove (directory->details->low_priority_queue,
 				    file);
 }
+
+static void
+remove_file_from_extension_queue (NautilusDirectory *directory,
+				  NautilusFile *file)
+{
+	nautilus_directory_count_extension_queue_providers (directory, file, -1);
+	nautilus_file_queue_remove (directory->details->extension_queue,
+				    file);
+}
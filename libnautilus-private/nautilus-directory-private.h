@@ -41,6 +41,8 @@ typedef struct MimeListState MimeListState;
 typedef struct ThumbnailState ThumbnailState;
 typedef struct MountState MountState;
 typedef struct FilesystemInfoState FilesystemInfoState;
+typedef struct ImageInfoState ImageInfoState;
+typedef struct ExtensionInfoJob ExtensionInfoJob;
 
 typedef enum {
 	REQUEST_LINK_INFO,
@@ -53,6 +55,7 @@ typedef enum {
 	REQUEST_THUMBNAIL,
 	REQUEST_MOUNT,
 	REQUEST_FILESYSTEM_INFO,
+	REQUEST_IMAGE_INFO,
 	REQUEST_TYPE_LAST
 } RequestType;
 
@@ -77,6 +80,20 @@ struct NautilusDirectoryDetails
 	NautilusFileQueue *high_priority_queue;
 	NautilusFileQueue *low_priority_queue;
 	NautilusFileQueue *extension_queue;
+	/* For each info provider, how many files in the extension queue
+	 * still wait for it.
+	 */
+	GHashTable *extension_queue_providers;
+	/* Partial files whose full info was asked for, most wanted first */
+	NautilusFileQueue *full_info_queue;
+	/* Folders whose deep count was asked for. Counts take long, so
+	 * they are started from here, one at a time, beside the other work.
+	 */
+	NautilusFileQueue *deep_count_queue;
+	/* Stamp of the last time the directory or its files were shown,
+	 * directories with newer stamps get free job slots first.
+	 */
+	guint shown_stamp;
 
 	/* These lists are going to be pretty short.  If we think they
 	 * are going to get big, we can use hash tables instead.
@@ -114,16 +131,15 @@ struct NautilusDirectoryDetails
 	NautilusFile *get_info_file;
 	GetInfoState *get_info_in_progress;
 
-	NautilusFile *extension_info_file;
-	NautilusInfoProvider *extension_info_provider;
-	NautilusOperationHandle *extension_info_in_progress;
-	guint extension_info_idle;
+	GList *extension_info_jobs; /* list of ExtensionInfoJob *, one per provider */
 
 	ThumbnailState *thumbnail_state;
 
 	MountState *mount_state;
 
 	FilesystemInfoState *filesystem_info_state;
+
+	ImageInfoState *image_info_state;
 	
 	LinkInfoReadState *link_info_read_state;
 
@@ -173,6 +189,7 @@ void               nautilus_directory_schedule_dequeue_pending        (NautilusD
 void               nautilus_directory_stop_monitoring_file_list       (NautilusDirectory         *directory);
 void               nautilus_directory_cancel                          (NautilusDirectory         *directory);
 void               nautilus_async_destroying_file                     (NautilusFile              *file);
+void               nautilus_directory_revalidate_file_list            (NautilusDirectory         *directory);
 void               nautilus_directory_force_reload_internal           (NautilusDirectory         *directory,
 								       NautilusFileAttributes     file_attributes);
 void               nautilus_directory_cancel_loading_file_attributes  (NautilusDirectory         *directory,
@@ -226,6 +243,11 @@ void               nautilus_directory_add_file_to_work_queue          (NautilusD
 								       NautilusFile *file);
 void               nautilus_directory_remove_file_from_work_queue     (NautilusDirectory *directory,
 								       NautilusFile *file);
+void               nautilus_directory_request_full_info               (NautilusDirectory *directory,
+								       NautilusFile *file);
+void               nautilus_directory_count_extension_queue_providers (NautilusDirectory *directory,
+								       NautilusFile *file,
+								       int delta);
 
 
 /* debugging functions */
@@ -27,6 +27,7 @@
 #include "nautilus-file-attributes.h"
 #include "nautilus-file-private.h"
 #include "nautilus-file-utilities.h"
+#include "nautilus-filename-index.h"
 #include "nautilus-search-directory.h"
 #include "nautilus-global-preferences.h"
 #include "nautilus-lib-self-check-functions.h"
@@ -168,6 +169,8 @@ nautilus_directory_init (NautilusDirectory *directory)
 	directory->details->high_priority_queue = nautilus_file_queue_new ();
 	directory->details->low_priority_queue = nautilus_file_queue_new ();
 	directory->details->extension_queue = nautilus_file_queue_new ();
+	directory->details->full_info_queue = nautilus_file_queue_new ();
+	directory->details->deep_count_queue = nautilus_file_queue_new ();
 }
 
 NautilusDirectory *
@@ -234,6 +237,9 @@ nautilus_directory_finalize (GObject *object)
 	nautilus_file_queue_destroy (directory->details->high_priority_queue);
 	nautilus_file_queue_destroy (directory->details->low_priority_queue);
 	nautilus_file_queue_destroy (directory->details->extension_queue);
+	g_clear_pointer (&directory->details->extension_queue_providers, g_hash_table_destroy);
+	nautilus_file_queue_destroy (directory->details->full_info_queue);
+	nautilus_file_queue_destroy (directory->details->deep_count_queue);
 	g_assert (directory->details->directory_load_in_progress == NULL);
 	g_assert (directory->details->count_in_progress == NULL);
 	g_assert (directory->details->dequeue_pending_idle_id == 0);
@@ -980,6 +986,8 @@ nautilus_directory_notify_files_added (GList *files)
 
 	nautilus_profile_start (NULL);
 
+	nautilus_filename_index_notify_added (files);
+
 	/* Make a list of added files in each directory. */
 	added_lists = g_hash_table_new (NULL, NULL);
 
@@ -1147,6 +1155,8 @@ nautilus_directory_notify_files_removed (GList *files)
 	NautilusFile *file;
 	GFile *location;
 
+	nautilus_filename_index_notify_removed (files);
+
 	/* Make a list of changed files in each directory. */
 	changed_lists = g_hash_table_new (NULL, NULL);
 
@@ -1354,6 +1364,8 @@ nautilus_directory_notify_files_moved (GList *file_pairs)
 	char *name;
 	NautilusFileAttributes cancel_attributes;
 	GFile *to_location, *from_location;
+
+	nautilus_filename_index_notify_moved (file_pairs);
 	
 	/* Make a list of added and changed files in each directory. */
 	new_files_list = NULL;
@@ -80,7 +80,7 @@ nautilus_drag_finalize (NautilusDragInfo *drag_info)
 {
 	gtk_target_list_unref (drag_info->target_list);
 	nautilus_drag_destroy_selection_list (drag_info->selection_list);
-	nautilus_drag_destroy_selection_list (drag_info->selection_cache);
+	nautilus_drag_selection_cache_free (drag_info->selection_cache);
 
 	g_free (drag_info);
 }
@@ -221,7 +221,6 @@ nautilus_drag_build_selection_list (GtkSelectionData *data)
 		item->uri = g_malloc (len + 1);
 		memcpy (item->uri, oldp, len);
 		item->uri[len] = 0;
-		item->file = nautilus_file_get_existing_by_uri (item->uri);
 
 		p++;
 		if (*p == '\n' || *p == '\0') {
@@ -436,6 +435,7 @@ nautilus_drag_default_drop_action_for_icons (GdkDragContext *context,
 	const char *dropped_uri;
 	GFile *target, *dropped, *dropped_directory;
 	GdkDragAction actions;
+	NautilusDragSelectionItem *dropped_item;
 	NautilusFile *dropped_file, *target_file;
 
 	if (target_uri_string == NULL) {
@@ -456,8 +456,15 @@ nautilus_drag_default_drop_action_for_icons (GdkDragContext *context,
 		return;
 	}
 	
-	dropped_uri = ((NautilusDragSelectionItem *)items->data)->uri;
-	dropped_file = ((NautilusDragSelectionItem *)items->data)->file;
+	/* Only the first item is looked at, so its file is looked up here
+	 * rather than for every item when the selection list is built.
+	 */
+	dropped_item = items->data;
+	if (dropped_item->file == NULL) {
+		dropped_item->file = nautilus_file_get_existing_by_uri (dropped_item->uri);
+	}
+	dropped_uri = dropped_item->uri;
+	dropped_file = dropped_item->file;
 	target_file = nautilus_file_get_existing_by_uri (target_uri_string);
 
 	if (eel_uri_is_desktop (dropped_uri) &&
@@ -588,77 +595,130 @@ add_one_uri (const char *uri, int x, int y, int w, int h, gpointer data)
 	g_string_append (result, "\r\n");
 }
 
+typedef struct {
+	/* Where the URI is in the URI list buffer */
+	guint uri_offset;
+	guint uri_length;
+	int icon_x, icon_y;
+	int icon_width, icon_height;
+} CachedItem;
+
+struct NautilusDragSelectionCache {
+	/* Every URI followed by "\r\n", which is the text/uri-list payload */
+	GString *uri_list;
+	GArray *items;
+	/* The x-special/gnome-icon-list payload, built when first asked for */
+	GString *icon_list;
+};
+
 static void
 cache_one_item (const char *uri,
 		int x, int y,
 		int w, int h,
 		gpointer data)
 {
-	GList **cache = data;
-	NautilusDragSelectionItem *item;
+	NautilusDragSelectionCache *cache = data;
+	CachedItem item;
 
-	item = nautilus_drag_selection_item_new ();
-	item->uri = g_strdup (uri);
-	item->file = nautilus_file_get_existing_by_uri (uri);
-	item->icon_x = x;
-	item->icon_y = y;
-	item->icon_width = w;
-	item->icon_height = h;
-	*cache = g_list_prepend (*cache, item);
+	item.uri_offset = cache->uri_list->len;
+	item.uri_length = strlen (uri);
+	item.icon_x = x;
+	item.icon_y = y;
+	item.icon_width = w;
+	item.icon_height = h;
+	g_array_append_val (cache->items, item);
+
+	g_string_append_len (cache->uri_list, uri, item.uri_length);
+	g_string_append (cache->uri_list, "\r\n");
 }
 
-GList *
+NautilusDragSelectionCache *
 nautilus_drag_create_selection_cache (gpointer container_context,
 				      NautilusDragEachSelectedItemIterator each_selected_item_iterator)
 {
-	GList *cache = NULL;
+	NautilusDragSelectionCache *cache;
 
-	(* each_selected_item_iterator) (cache_one_item, container_context, &cache);
-	cache = g_list_reverse (cache);
+	cache = g_new0 (NautilusDragSelectionCache, 1);
+	cache->uri_list = g_string_new (NULL);
+	cache->items = g_array_new (FALSE, FALSE, sizeof (CachedItem));
+
+	(* each_selected_item_iterator) (cache_one_item, container_context, cache);
 
 	return cache;
 }
 
+void
+nautilus_drag_selection_cache_free (NautilusDragSelectionCache *cache)
+{
+	if (cache == NULL) {
+		return;
+	}
+
+	g_string_free (cache->uri_list, TRUE);
+	g_array_free (cache->items, TRUE);
+	if (cache->icon_list != NULL) {
+		g_string_free (cache->icon_list, TRUE);
+	}
+	g_free (cache);
+}
+
+static GString *
+selection_cache_get_icon_list (NautilusDragSelectionCache *cache)
+{
+	CachedItem *item;
+	guint i;
+
+	if (cache->icon_list != NULL) {
+		return cache->icon_list;
+	}
+
+	/* Same format as add_one_gnome_icon, with the URIs copied
+	 * straight out of the shared buffer.
+	 */
+	cache->icon_list = g_string_sized_new (cache->uri_list->len + 24 * cache->items->len);
+	for (i = 0; i < cache->items->len; i++) {
+		item = &g_array_index (cache->items, CachedItem, i);
+		g_string_append_len (cache->icon_list,
+				     cache->uri_list->str + item->uri_offset,
+				     item->uri_length);
+		g_string_append_printf (cache->icon_list, "\r%d:%d:%hu:%hu\r\n",
+					item->icon_x, item->icon_y,
+					item->icon_width, item->icon_height);
+	}
+
+	return cache->icon_list;
+}
+
 /* Common function for drag_data_get_callback calls.
  * Returns FALSE if it doesn't handle drag data */
 gboolean
-nautilus_drag_drag_data_get_from_cache (GList *cache,
+nautilus_drag_drag_data_get_from_cache (NautilusDragSelectionCache *cache,
 					GdkDragContext *context,
 					GtkSelectionData *selection_data,
 					guint info,
 					guint32 time)
 {
-	GList *l;
 	GString *result;
-	NautilusDragEachSelectedItemDataGet func;
 
-	if (cache == NULL) {
+	if (cache == NULL || cache->items->len == 0) {
 		return FALSE;
 	}
 
 	switch (info) {
 	case NAUTILUS_ICON_DND_GNOME_ICON_LIST:
-		func = add_one_gnome_icon;
+		result = selection_cache_get_icon_list (cache);
 		break;
 	case NAUTILUS_ICON_DND_URI_LIST:
 	case NAUTILUS_ICON_DND_TEXT:
-		func = add_one_uri;
+		result = cache->uri_list;
 		break;
 	default:
 		return FALSE;
 	}
 
-	result = g_string_new (NULL);
-
-	for (l = cache; l != NULL; l = l->next) {
-		NautilusDragSelectionItem *item = l->data;
-		(*func) (item->uri, item->icon_x, item->icon_y, item->icon_width, item->icon_height, result);
-	}
-
 	gtk_selection_data_set (selection_data,
 				gtk_selection_data_get_target (selection_data),
 				8, (guchar *) result->str, result->len);
-	g_string_free (result, TRUE);
 
 	return TRUE;
 }
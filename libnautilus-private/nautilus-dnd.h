@@ -40,13 +40,19 @@
 
 /* Item of the drag selection list */
 typedef struct {
-	NautilusFile *file;
+	NautilusFile *file; /* looked up when needed, may be NULL */
 	char *uri;
 	gboolean got_icon_position;
 	int icon_x, icon_y;
 	int icon_width, icon_height;
 } NautilusDragSelectionItem;
 
+/* The dragged items as they are sent to drop targets. All URIs live in
+ * one buffer that is sent as is for text/uri-list, and the payload of
+ * each target type is built only once per drag.
+ */
+typedef struct NautilusDragSelectionCache NautilusDragSelectionCache;
+
 /* Standard Drag & Drop types. */
 typedef enum {
 	NAUTILUS_ICON_DND_GNOME_ICON_LIST,
@@ -77,7 +83,7 @@ typedef struct {
 	GList *selection_list;
 
 	/* cache of selected URIs, representing items being dragged */
-	GList *selection_cache;
+	NautilusDragSelectionCache *selection_cache;
 
 	/* has the drop occured ? */
 	gboolean drop_occured;
@@ -134,9 +140,10 @@ gboolean		    nautilus_drag_drag_data_get			(GtkWidget			      *widget,
 									 guint32			       time,
 									 gpointer			       container_context,
 									 NautilusDragEachSelectedItemIterator  each_selected_item_iterator);
-GList			   *nautilus_drag_create_selection_cache	(gpointer			       container_context,
+NautilusDragSelectionCache *nautilus_drag_create_selection_cache	(gpointer			       container_context,
 									 NautilusDragEachSelectedItemIterator  each_selected_item_iterator);
-gboolean		    nautilus_drag_drag_data_get_from_cache	(GList				      *cache,
+void			    nautilus_drag_selection_cache_free		(NautilusDragSelectionCache	      *cache);
+gboolean		    nautilus_drag_drag_data_get_from_cache	(NautilusDragSelectionCache	      *cache,
 									 GdkDragContext			      *context,
 									 GtkSelectionData		      *selection_data,
 									 guint				       info,
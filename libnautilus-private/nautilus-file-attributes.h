@@ -39,6 +39,7 @@ typedef enum {
 	NAUTILUS_FILE_ATTRIBUTE_THUMBNAIL = 1 << 8,
 	NAUTILUS_FILE_ATTRIBUTE_MOUNT = 1 << 9,
 	NAUTILUS_FILE_ATTRIBUTE_FILESYSTEM_INFO = 1 << 10,
+	NAUTILUS_FILE_ATTRIBUTE_IMAGE_INFO = 1 << 11, /* from the image file header */
 } NautilusFileAttributes;
 
 #endif /* NAUTILUS_FILE_ATTRIBUTES_H */
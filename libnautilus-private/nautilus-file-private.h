@@ -26,6 +26,7 @@
 #include <libnautilus-private/nautilus-directory.h>
 #include <libnautilus-private/nautilus-file.h>
 #include <libnautilus-private/nautilus-monitor.h>
+#include <libnautilus-private/nautilus-pixbuf-budget.h>
 #include <libnautilus-private/nautilus-file-undo-operations.h>
 #include <eel/eel-glib-extensions.h>
 #include <eel/eel-string.h>
@@ -33,6 +34,16 @@
 #define NAUTILUS_FILE_DEFAULT_ATTRIBUTES				\
 	"standard::*,access::*,mountable::*,time::*,unix::*,owner::*,selinux::*,thumbnail::*,id::filesystem,trash::orig-path,trash::deletion-date,metadata::*"
 
+/* The subset requested when enumerating a directory: only what can be
+ * answered from the directory entry, a stat and the metadata store,
+ * without sniffing the contents, resolving owners or reading thumbnails.
+ * Metadata stays in because views lay out icons from it as files are
+ * added. Files loaded with it are marked partial and get the rest when
+ * a view shows them or someone asks for them specifically.
+ */
+#define NAUTILUS_FILE_ENUMERATION_ATTRIBUTES				\
+	"standard::name,standard::display-name,standard::edit-name,standard::copy-name,standard::type,standard::size,standard::allocated-size,standard::is-hidden,standard::is-backup,standard::is-symlink,standard::symlink-target,standard::target-uri,standard::sort-order,standard::fast-content-type,access::*,mountable::*,time::*,unix::*,id::filesystem,trash::orig-path,trash::deletion-date,metadata::*"
+
 /* These are in the typical sort order. Known things come first, then
  * things where we can't know, finally things where we don't yet know.
  */
@@ -95,6 +106,10 @@ struct NautilusFileDetails
 
 	GdkPixbuf *scaled_thumbnail;
 	double thumbnail_scale;
+	/* Accounts for thumbnail and scaled_thumbnail */
+	NautilusPixbufBudgetEntry thumbnail_budget_entry;
+	/* Number of views showing the file on screen */
+	guint shown_count;
 
 	GList *mime_list; /* If this is a directory, the list of MIME types in it. */
 
@@ -147,6 +162,8 @@ struct NautilusFileDetails
 	eel_boolean_bit got_file_info                 : 1;
 	eel_boolean_bit get_info_failed               : 1;
 	eel_boolean_bit file_info_is_up_to_date       : 1;
+	/* Info came from NAUTILUS_FILE_ENUMERATION_ATTRIBUTES only */
+	eel_boolean_bit file_info_is_partial          : 1;
 	
 	eel_boolean_bit got_directory_count           : 1;
 	eel_boolean_bit directory_count_failed        : 1;
@@ -174,6 +191,10 @@ struct NautilusFileDetails
 	eel_boolean_bit thumbnailing_failed           : 1;
 	
 	eel_boolean_bit is_thumbnailing               : 1;
+	/* Thumbnail dropped by the pixbuf budget, reload when next drawn */
+	eel_boolean_bit thumbnail_evicted             : 1;
+
+	eel_boolean_bit is_loading_custom_icon        : 1;
 
 	/* TRUE if the file is open in a spatial window */
 	eel_boolean_bit has_open_window               : 1;
@@ -207,6 +228,12 @@ struct NautilusFileDetails
 	eel_boolean_bit filesystem_use_preview        : 2; /* GFilesystemPreviewType */
 	eel_boolean_bit filesystem_info_is_up_to_date : 1;
 
+	/* From the image header, 0 where unknown */
+	eel_boolean_bit image_info_is_up_to_date      : 1;
+	int image_width;
+	int image_height;
+	time_t image_date_taken;
+
 	time_t trash_time; /* 0 is unknown */
 
 	gdouble search_relevance;
@@ -244,6 +271,12 @@ void          nautilus_file_clear_info                     (NautilusFile
  * new state.  */
 gboolean      nautilus_file_update_info                    (NautilusFile           *file,
 							    GFileInfo              *info);
+/* The same for info from listing the folder, which is partial if only
+ * the enumeration attributes were asked for. */
+gboolean      nautilus_file_update_enumerated_info         (NautilusFile           *file,
+							    GFileInfo              *info,
+							    gboolean                partial);
+const char *  nautilus_get_content_type_from_info          (GFileInfo              *info);
 gboolean      nautilus_file_update_name                    (NautilusFile           *file,
 							    const char             *name);
 gboolean      nautilus_file_update_metadata_from_info      (NautilusFile           *file,
@@ -278,6 +311,7 @@ void                   nautilus_file_info_providers_done                (Nautilu
 /* Thumbnailing: */
 void          nautilus_file_set_is_thumbnailing            (NautilusFile           *file,
 							    gboolean                is_thumbnailing);
+void          nautilus_file_update_thumbnail_budget        (NautilusFile           *file);
 
 NautilusFileOperation *nautilus_file_operation_new      (NautilusFile                  *file,
 							 NautilusFileOperationCallback  callback,
@@ -69,6 +69,29 @@ nautilus_file_queue_enqueue (NautilusFileQueue *queue,
 	g_hash_table_insert (queue->item_to_link_map, file, queue->tail);
 }
 
+void
+nautilus_file_queue_enqueue_head (NautilusFileQueue *queue,
+				  NautilusFile      *file)
+{
+	GList *link;
+
+	link = g_hash_table_lookup (queue->item_to_link_map, file);
+	if (link == queue->head && link != NULL) {
+		return;
+	}
+
+	/* Keep the reference the queue already holds while moving. */
+	nautilus_file_ref (file);
+	nautilus_file_queue_remove (queue, file);
+
+	queue->head = g_list_prepend (queue->head, file);
+	if (queue->tail == NULL) {
+		queue->tail = queue->head;
+	}
+
+	g_hash_table_insert (queue->item_to_link_map, file, queue->head);
+}
+
 NautilusFile *
 nautilus_file_queue_dequeue (NautilusFileQueue *queue)
 {
@@ -121,3 +144,16 @@ nautilus_file_queue_is_empty (NautilusFileQueue *queue)
 {
 	return (queue->head == NULL);
 }
+
+gboolean
+nautilus_file_queue_contains (NautilusFileQueue *queue,
+			      NautilusFile *file)
+{
+	return g_hash_table_lookup (queue->item_to_link_map, file) != NULL;
+}
+
+GList *
+nautilus_file_queue_peek_list (NautilusFileQueue *queue)
+{
+	return queue->head;
+}
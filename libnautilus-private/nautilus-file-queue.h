@@ -32,6 +32,12 @@ void               nautilus_file_queue_destroy  (NautilusFileQueue *queue);
 void               nautilus_file_queue_enqueue  (NautilusFileQueue *queue,
 						 NautilusFile      *file);
 
+/* Add a file to the head of the queue, moving it there if it's
+ * already in the queue.
+ */
+void               nautilus_file_queue_enqueue_head (NautilusFileQueue *queue,
+						     NautilusFile      *file);
+
 /* Return the file at the head of the queue after removing it from the
  * queue. This is dangerous unless you have another ref to the file,
  * since it will unref it.  
@@ -47,4 +53,12 @@ NautilusFile *     nautilus_file_queue_head     (NautilusFileQueue *queue);
 
 gboolean           nautilus_file_queue_is_empty (NautilusFileQueue *queue);
 
+gboolean           nautilus_file_queue_contains (NautilusFileQueue *queue,
+						 NautilusFile      *file);
+
+/* Get the files in the queue, head first. The list belongs to the
+ * queue and is only valid until the queue changes.
+ */
+GList *            nautilus_file_queue_peek_list (NautilusFileQueue *queue);
+
 #endif /* NAUTILUS_FILE_CHANGES_QUEUE_H */
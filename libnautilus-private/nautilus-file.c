@@ -137,6 +137,9 @@ static GQuark attribute_name_q,
 	attribute_deep_file_count_q,
 	attribute_deep_directory_count_q,
 	attribute_deep_total_count_q,
+	attribute_total_size_q,
+	attribute_dimensions_q,
+	attribute_date_taken_q,
 	attribute_search_relevance_q,
 	attribute_trashed_on_q,
 	attribute_trashed_on_full_q,
@@ -817,6 +820,7 @@ finalize (GObject *object)
 	g_free (file->details->activation_uri);
 	g_clear_object (&file->details->custom_icon);
 
+	nautilus_pixbuf_budget_remove (&file->details->thumbnail_budget_entry);
 	if (file->details->thumbnail) {
 		g_object_unref (file->details->thumbnail);
 	}
@@ -2099,6 +2103,16 @@ update_links_if_target (NautilusFile *target_file)
 	nautilus_file_list_free (link_files);
 }
 
+/* Enumerated infos only carry the content type guessed from the name. */
+const char *
+nautilus_get_content_type_from_info (GFileInfo *info)
+{
+	if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE)) {
+		return g_file_info_get_content_type (info);
+	}
+	return g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE);
+}
+
 static gboolean
 update_info_internal (NautilusFile *file,
 		      GFileInfo *info,
@@ -2141,6 +2155,7 @@ update_info_internal (NautilusFile *file,
 	}
 
 	file->details->file_info_is_up_to_date = TRUE;
+	file->details->file_info_is_partial = FALSE;
 
 	/* FIXME bugzilla.gnome.org 42044: Need to let links that
 	 * point to the old name know that the file has been renamed.
@@ -2160,7 +2175,7 @@ update_info_internal (NautilusFile *file,
 						  g_file_info_get_edit_name (info),
 						  FALSE);
 
-	mime_type = g_file_info_get_content_type (info);
+	mime_type = nautilus_get_content_type_from_info (info);
 	if (g_strcmp0 (mime_type, NAUTILUS_SAVED_SEARCH_MIMETYPE) == 0) {
 		g_file_info_set_file_type (info, G_FILE_TYPE_DIRECTORY);
 	}
@@ -2408,6 +2423,9 @@ update_info_internal (NautilusFile *file,
 		if (file->details->thumbnail == NULL) {
 			file->details->thumbnail_is_up_to_date = FALSE;
 		}
+		if (file->details->mtime != mtime) {
+			file->details->image_info_is_up_to_date = FALSE;
+		}
 
 		changed = TRUE;
 	}
@@ -2421,7 +2439,13 @@ update_info_internal (NautilusFile *file,
 		changed = TRUE;
 	}
 
-	icon = g_file_info_get_icon (info);
+	if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_ICON)) {
+		icon = g_object_ref (g_file_info_get_icon (info));
+	} else {
+		/* Partial info, use the generic icon for the guessed type. */
+		mime_type = nautilus_get_content_type_from_info (info);
+		icon = g_content_type_get_icon (mime_type != NULL ? mime_type : "application/octet-stream");
+	}
 	if (!g_icon_equal (icon, file->details->icon)) {
 		changed = TRUE;
 
@@ -2430,6 +2454,7 @@ update_info_internal (NautilusFile *file,
 		}
 		file->details->icon = g_object_ref (icon);
 	}
+	g_object_unref (icon);
 
 	thumbnail_path =  g_file_info_get_attribute_byte_string (info, G_FILE_ATTRIBUTE_THUMBNAIL_PATH);
 	if (g_strcmp0 (file->details->thumbnail_path, thumbnail_path) != 0) {
@@ -2451,7 +2476,7 @@ update_info_internal (NautilusFile *file,
 		file->details->symlink_name = g_strdup (symlink_name);
 	}
 
-	mime_type = g_file_info_get_content_type (info);
+	mime_type = nautilus_get_content_type_from_info (info);
 	if (g_strcmp0 (eel_ref_str_peek (file->details->mime_type), mime_type) != 0) {
 		changed = TRUE;
 		eel_ref_str_unref (file->details->mime_type);
@@ -2554,6 +2579,23 @@ nautilus_file_update_info (NautilusFile *file,
 	return update_info_internal (file, info, FALSE);
 }
 
+gboolean
+nautilus_file_update_enumerated_info (NautilusFile *file,
+				      GFileInfo *info,
+				      gboolean partial)
+{
+	gboolean changed;
+
+	changed = update_info_internal (file, info, FALSE);
+
+	/* Changed or not, the file has only what the enumeration gave,
+	 * so the rest is still to be fetched.
+	 */
+	file->details->file_info_is_partial = partial;
+
+	return changed;
+}
+
 static gboolean
 update_name_internal (NautilusFile *file,
 		      const char *name,
@@ -2737,6 +2779,12 @@ get_time (NautilusFile *file,
 	case NAUTILUS_DATE_TYPE_TRASHED:
 		time = file->details->trash_time;
 		break;
+	case NAUTILUS_DATE_TYPE_TAKEN:
+		if (!file->details->image_info_is_up_to_date) {
+			return UNKNOWN;
+		}
+		time = file->details->image_date_taken;
+		break;
 	default:
 		g_assert_not_reached ();
 		break;
@@ -2867,6 +2915,110 @@ compare_by_size (NautilusFile *file_1, NautilusFile *file_2)
 	}
 }
 
+static Knowledge
+get_total_size (NautilusFile *file,
+		goffset *size)
+{
+	if (!nautilus_file_is_directory (file)) {
+		return get_size (file, size);
+	}
+
+	/* Folders are only compared once they are fully counted */
+	if (nautilus_file_get_deep_counts (file, NULL, NULL, NULL, size, FALSE) != NAUTILUS_REQUEST_DONE) {
+		return UNKNOWN;
+	}
+	return KNOWN;
+}
+
+static int
+compare_by_total_size (NautilusFile *file_1, NautilusFile *file_2)
+{
+	/* Sort order:
+	 *   Files and directories with unknown size.
+	 *   Files with "unknowable" size.
+	 *   Files and directories with smaller sizes.
+	 *   Files and directories with large sizes.
+	 */
+
+	Knowledge size_known_1, size_known_2;
+	goffset size_1 = 0, size_2 = 0;
+
+	size_known_1 = get_total_size (file_1, &size_1);
+	size_known_2 = get_total_size (file_2, &size_2);
+
+	if (size_known_1 > size_known_2) {
+		return -1;
+	}
+	if (size_known_1 < size_known_2) {
+		return +1;
+	}
+
+	if (size_known_1 == UNKNOWABLE || size_known_1 == UNKNOWN) {
+		return 0;
+	}
+
+	if (size_1 < size_2) {
+		return -1;
+	}
+	if (size_1 > size_2) {
+		return +1;
+	}
+
+	return 0;
+}
+
+static Knowledge
+get_image_area (NautilusFile *file,
+		gint64 *area)
+{
+	if (!file->details->image_info_is_up_to_date) {
+		return UNKNOWN;
+	}
+	if (file->details->image_width <= 0 || file->details->image_height <= 0) {
+		return UNKNOWABLE;
+	}
+
+	*area = (gint64) file->details->image_width * file->details->image_height;
+	return KNOWN;
+}
+
+static int
+compare_by_dimensions (NautilusFile *file_1, NautilusFile *file_2)
+{
+	/* Sort order:
+	 *   Files not read yet.
+	 *   Files that are not images.
+	 *   Images with fewer pixels.
+	 *   Images with more pixels.
+	 */
+
+	Knowledge area_known_1, area_known_2;
+	gint64 area_1 = 0, area_2 = 0;
+
+	area_known_1 = get_image_area (file_1, &area_1);
+	area_known_2 = get_image_area (file_2, &area_2);
+
+	if (area_known_1 > area_known_2) {
+		return -1;
+	}
+	if (area_known_1 < area_known_2) {
+		return +1;
+	}
+
+	if (area_known_1 == UNKNOWABLE || area_known_1 == UNKNOWN) {
+		return 0;
+	}
+
+	if (area_1 < area_2) {
+		return -1;
+	}
+	if (area_1 > area_2) {
+		return +1;
+	}
+
+	return 0;
+}
+
 static int
 compare_by_display_name (NautilusFile *file_1, NautilusFile *file_2)
 {
@@ -3234,6 +3386,37 @@ nautilus_file_compare_for_sort_by_attribute_q   (NautilusFile
 						       NAUTILUS_FILE_SORT_BY_TYPE,
 						       directories_first,
 						       reversed);
+	} else if (attribute == attribute_total_size_q) {
+		/* Not a sort type of its own, as only the list view shows it */
+		result = nautilus_file_compare_for_sort_internal (file_1, file_2, directories_first, reversed);
+		if (result == 0) {
+			result = compare_by_total_size (file_1, file_2);
+			if (result == 0) {
+				result = compare_by_full_path (file_1, file_2);
+			}
+			if (reversed) {
+				result = -result;
+			}
+		}
+		return result;
+	} else if (attribute == attribute_dimensions_q ||
+		   attribute == attribute_date_taken_q) {
+		/* Also only shown by the list view, like the total size */
+		result = nautilus_file_compare_for_sort_internal (file_1, file_2, directories_first, reversed);
+		if (result == 0) {
+			if (attribute == attribute_dimensions_q) {
+				result = compare_by_dimensions (file_1, file_2);
+			} else {
+				result = compare_by_time (file_1, file_2, NAUTILUS_DATE_TYPE_TAKEN);
+			}
+			if (result == 0) {
+				result = compare_by_full_path (file_1, file_2);
+			}
+			if (reversed) {
+				result = -result;
+			}
+		}
+		return result;
 	} else if (attribute == attribute_modification_date_q || attribute == attribute_date_modified_q || attribute == attribute_date_modified_full_q) {
 		return nautilus_file_compare_for_sort (file_1, file_2,
 						       NAUTILUS_FILE_SORT_BY_MTIME,
@@ -4240,6 +4423,69 @@ nautilus_file_get_thumbnail_path (NautilusFile *file)
 	return g_strdup (file->details->thumbnail_path);
 }
 
+static void
+thumbnail_evict (gpointer owner)
+{
+	NautilusFile *file = owner;
+
+	g_clear_object (&file->details->thumbnail);
+	g_clear_object (&file->details->scaled_thumbnail);
+	file->details->thumbnail_evicted = TRUE;
+}
+
+void
+nautilus_file_set_shown (NautilusFile *file,
+			 gboolean shown)
+{
+	g_return_if_fail (NAUTILUS_IS_FILE (file));
+
+	if (shown) {
+		file->details->shown_count++;
+	} else {
+		g_return_if_fail (file->details->shown_count > 0);
+		file->details->shown_count--;
+	}
+
+	nautilus_pixbuf_budget_set_pinned (&file->details->thumbnail_budget_entry,
+					   file->details->shown_count > 0);
+}
+
+/* Must be called whenever the thumbnail pixbufs of the file change. */
+void
+nautilus_file_update_thumbnail_budget (NautilusFile *file)
+{
+	gsize bytes;
+
+	bytes = nautilus_pixbuf_budget_get_pixbuf_size (file->details->thumbnail) +
+		nautilus_pixbuf_budget_get_pixbuf_size (file->details->scaled_thumbnail);
+
+	if (bytes == 0) {
+		nautilus_pixbuf_budget_remove (&file->details->thumbnail_budget_entry);
+	} else {
+		file->details->thumbnail_evicted = FALSE;
+		nautilus_pixbuf_budget_add (&file->details->thumbnail_budget_entry,
+					    file, bytes, thumbnail_evict);
+	}
+}
+
+static void
+custom_icon_loaded (GObject      *source_object,
+		    GAsyncResult *res,
+		    gpointer      user_data)
+{
+	NautilusFile *file = user_data;
+	NautilusIconInfo *icon;
+
+	icon = nautilus_icon_info_lookup_finish (res, NULL);
+	if (icon != NULL) {
+		g_object_unref (icon);
+	}
+
+	file->details->is_loading_custom_icon = FALSE;
+	nautilus_file_changed (file);
+	nautilus_file_unref (file);
+}
+
 NautilusIconInfo *
 nautilus_file_get_icon (NautilusFile *file,
 			int size,
@@ -4261,10 +4507,20 @@ nautilus_file_get_icon (NautilusFile *file,
 	}
 
 	if (gicon != NULL) {
-		icon = nautilus_icon_info_lookup (gicon, size, scale);
+		icon = nautilus_icon_info_lookup_cached (gicon, size, scale);
+		if (icon == NULL && !file->details->is_loading_custom_icon) {
+			file->details->is_loading_custom_icon = TRUE;
+			nautilus_icon_info_lookup_async (gicon, size, scale, NULL,
+							 custom_icon_loaded,
+							 nautilus_file_ref (file));
+		}
 		g_object_unref (gicon);
 
-		return icon;
+		if (icon != NULL) {
+			return icon;
+		}
+
+		/* Show the regular icon until the custom one is loaded. */
 	}
 
 	DEBUG ("Called file_get_icon(), at size %d, force thumbnail %d", size,
@@ -4280,6 +4536,13 @@ nautilus_file_get_icon (NautilusFile *file,
 
 	if (flags & NAUTILUS_FILE_ICON_FLAGS_USE_THUMBNAILS &&
 	    nautilus_file_should_show_thumbnail (file)) {
+		if (file->details->thumbnail == NULL &&
+		    file->details->thumbnail_evicted) {
+			/* Reload the thumbnail now that it is needed again. */
+			file->details->thumbnail_evicted = FALSE;
+			nautilus_file_invalidate_attributes (file, NAUTILUS_FILE_ATTRIBUTE_THUMBNAIL);
+		}
+
 		if (file->details->thumbnail) {
 			int w, h, s;
 			double thumb_scale;
@@ -4305,6 +4568,7 @@ nautilus_file_get_icon (NautilusFile *file,
 			if (file->details->thumbnail_scale == thumb_scale &&
 			    file->details->scaled_thumbnail != NULL) {
 				scaled_pixbuf = file->details->scaled_thumbnail;
+				nautilus_pixbuf_budget_touch (&file->details->thumbnail_budget_entry);
 			} else {
 				scaled_pixbuf = gdk_pixbuf_scale_simple (raw_pixbuf,
 									 MAX (w * thumb_scale, 1),
@@ -4322,6 +4586,7 @@ nautilus_file_get_icon (NautilusFile *file,
 				g_clear_object (&file->details->scaled_thumbnail);
 				file->details->scaled_thumbnail = scaled_pixbuf;
 				file->details->thumbnail_scale = thumb_scale;
+				nautilus_file_update_thumbnail_budget (file);
 			}
 
 			g_object_unref (raw_pixbuf);
@@ -4343,6 +4608,7 @@ nautilus_file_get_icon (NautilusFile *file,
 			
 			return nautilus_icon_info_new_for_pixbuf (scaled_pixbuf, scale);
 		} else if (file->details->thumbnail_path == NULL &&
+			   !file->details->file_info_is_partial &&
 			   file->details->can_read &&				
 			   !file->details->is_thumbnailing &&
 			   !file->details->thumbnailing_failed) {
@@ -4403,7 +4669,8 @@ nautilus_file_get_date (NautilusFile *file,
 
 	g_return_val_if_fail (date_type == NAUTILUS_DATE_TYPE_ACCESSED
 			      || date_type == NAUTILUS_DATE_TYPE_MODIFIED
-			      || date_type == NAUTILUS_DATE_TYPE_TRASHED,
+			      || date_type == NAUTILUS_DATE_TYPE_TRASHED
+			      || date_type == NAUTILUS_DATE_TYPE_TAKEN,
 			      FALSE);
 
 	if (file == NULL) {
@@ -5921,6 +6188,90 @@ nautilus_file_get_deep_directory_count_as_string (NautilusFile *file)
 	return nautilus_file_get_deep_count_as_string_internal (file, FALSE, TRUE, FALSE);
 }
 
+/**
+ * nautilus_file_get_total_size_as_string:
+ * 
+ * Get a user-displayable string representing the size of a file, or
+ * the size of all contained items for directories. While a directory
+ * is still being counted, this is the size found so far followed by
+ * dots. The caller is responsible for g_free-ing this string.
+ * @file: NautilusFile representing the file in question.
+ * 
+ * Returns: Newly allocated string ready to display to the user.
+ * 
+ **/
+static char *
+nautilus_file_get_total_size_as_string (NautilusFile *file)
+{
+	NautilusRequestStatus status;
+	goffset total_size;
+	char *size, *result;
+
+	if (file == NULL) {
+		return NULL;
+	}
+
+	g_assert (NAUTILUS_IS_FILE (file));
+
+	if (!nautilus_file_is_directory (file)) {
+		if (file->details->size == -1) {
+			return NULL;
+		}
+		return g_format_size (file->details->size);
+	}
+
+	status = nautilus_file_get_deep_counts
+		(file, NULL, NULL, NULL, &total_size, FALSE);
+
+	switch (status) {
+	case NAUTILUS_REQUEST_DONE:
+		return g_format_size (total_size);
+	case NAUTILUS_REQUEST_IN_PROGRESS:
+		if (total_size == 0) {
+			return NULL;
+		}
+		size = g_format_size (total_size);
+		result = g_strconcat (size, "...", NULL);
+		g_free (size);
+		return result;
+	default:
+		return NULL;
+	}
+}
+
+/**
+ * nautilus_file_get_dimensions_as_string:
+ *
+ * Get a user-displayable string with the width and height of an image,
+ * as read from its header. The caller is responsible for g_free-ing
+ * this string.
+ * @file: NautilusFile representing the file in question.
+ *
+ * Returns: Newly allocated string ready to display to the user, or NULL
+ * if the file is not an image or was not read yet.
+ *
+ **/
+static char *
+nautilus_file_get_dimensions_as_string (NautilusFile *file)
+{
+	if (file == NULL) {
+		return NULL;
+	}
+
+	g_assert (NAUTILUS_IS_FILE (file));
+
+	if (!file->details->image_info_is_up_to_date ||
+	    file->details->image_width <= 0 ||
+	    file->details->image_height <= 0) {
+		return NULL;
+	}
+
+	/* Translators: the width and height of an image in pixels */
+	return g_strdup_printf (_("%d × %d"),
+				file->details->image_width,
+				file->details->image_height);
+}
+
 /**
  * nautilus_file_get_string_attribute:
  * 
@@ -5932,7 +6283,7 @@ nautilus_file_get_deep_directory_count_as_string (NautilusFile *file)
  * @file: NautilusFile representing the file in question.
  * @attribute_name: The name of the desired attribute. The currently supported
  * set includes "name", "type", "detailed_type", "mime_type", "size", "deep_size", "deep_directory_count",
- * "deep_file_count", "deep_total_count", "date_modified", "date_accessed",
+ * "deep_file_count", "deep_total_count", "total_size", "date_modified", "date_accessed",
  * "date_modified_full", "date_accessed_full",
  * "owner", "group", "permissions", "octal_permissions", "uri", "where",
  * "link_target", "volume", "free_space", "selinux_context", "trashed_on", "trashed_on_full", "trashed_orig_path"
@@ -5973,6 +6324,17 @@ nautilus_file_get_string_attribute_q (NautilusFile *file, GQuark attribute_q)
 	if (attribute_q == attribute_deep_directory_count_q) {
 		return nautilus_file_get_deep_directory_count_as_string (file);
 	}
+	if (attribute_q == attribute_total_size_q) {
+		return nautilus_file_get_total_size_as_string (file);
+	}
+	if (attribute_q == attribute_dimensions_q) {
+		return nautilus_file_get_dimensions_as_string (file);
+	}
+	if (attribute_q == attribute_date_taken_q) {
+		return nautilus_file_get_date_as_string (file,
+							 NAUTILUS_DATE_TYPE_TAKEN,
+							 TRUE);
+	}
 	if (attribute_q == attribute_deep_total_count_q) {
 		return nautilus_file_get_deep_total_count_as_string (file);
 	}
@@ -6106,6 +6468,21 @@ nautilus_file_get_string_attribute_with_default_q (NautilusFile *file, GQuark at
 		}
 		return g_strdup (count_unreadable ? _("? items") : "...");
 	}
+	if (attribute_q == attribute_total_size_q) {
+		if (nautilus_file_is_directory (file) &&
+		    !nautilus_file_should_show_directory_item_count (file)) {
+			return g_strdup ("--");
+		}
+		return g_strdup ("...");
+	}
+	if (attribute_q == attribute_dimensions_q ||
+	    attribute_q == attribute_date_taken_q) {
+		if (nautilus_file_is_directory (file) ||
+		    file->details->image_info_is_up_to_date) {
+			return g_strdup ("");
+		}
+		return g_strdup ("...");
+	}
 	if (attribute_q == attribute_deep_size_q) {
 		status = nautilus_file_get_deep_counts (file, NULL, NULL, NULL, NULL, FALSE);
 		if (status == NAUTILUS_REQUEST_DONE) {
@@ -7260,6 +7637,12 @@ invalidate_thumbnail (NautilusFile *file)
 	file->details->thumbnail_is_up_to_date = FALSE;
 }
 
+static void
+invalidate_image_info (NautilusFile *file)
+{
+	file->details->image_info_is_up_to_date = FALSE;
+}
+
 static void
 invalidate_mount (NautilusFile *file)
 {
@@ -7269,11 +7652,23 @@ invalidate_mount (NautilusFile *file)
 void
 nautilus_file_invalidate_extension_info_internal (NautilusFile *file)
 {
+	NautilusDirectory *directory;
+
+	/* The directory is not set yet when called from nautilus_file_init(). */
+	directory = file->details->directory;
+	if (directory != NULL) {
+		nautilus_directory_count_extension_queue_providers (directory, file, -1);
+	}
+
 	if (file->details->pending_info_providers)
 		g_list_free_full (file->details->pending_info_providers, g_object_unref);
 
 	file->details->pending_info_providers =
 		nautilus_module_get_extensions_for_type (NAUTILUS_TYPE_INFO_PROVIDER);
+
+	if (directory != NULL) {
+		nautilus_directory_count_extension_queue_providers (directory, file, 1);
+	}
 }
 
 void
@@ -7320,6 +7715,9 @@ nautilus_file_invalidate_attributes_internal (NautilusFile *file,
 	if (REQUEST_WANTS_TYPE (request, REQUEST_MOUNT)) {
 		invalidate_mount (file);
 	}
+	if (REQUEST_WANTS_TYPE (request, REQUEST_IMAGE_INFO)) {
+		invalidate_image_info (file);
+	}
 
 	/* FIXME bugzilla.gnome.org 45075: implement invalidating metadata */
 }
@@ -7397,7 +7795,8 @@ nautilus_file_get_all_attributes (void)
 		NAUTILUS_FILE_ATTRIBUTE_DIRECTORY_ITEM_MIME_TYPES | 
 		NAUTILUS_FILE_ATTRIBUTE_EXTENSION_INFO |
 		NAUTILUS_FILE_ATTRIBUTE_THUMBNAIL |
-		NAUTILUS_FILE_ATTRIBUTE_MOUNT;
+		NAUTILUS_FILE_ATTRIBUTE_MOUNT |
+		NAUTILUS_FILE_ATTRIBUTE_IMAGE_INFO;
 }
 
 void
@@ -7768,6 +8167,34 @@ nautilus_file_list_cancel_call_when_ready (NautilusFileListHandle *handle)
 	}
 }
 
+void
+nautilus_file_list_request_full_info (GList *file_list)
+{
+	GList *l, *directories;
+	NautilusFile *file;
+	NautilusDirectory *directory;
+
+	/* Walk backwards, each request goes to the head of the queue. */
+	directories = NULL;
+	for (l = g_list_last (file_list); l != NULL; l = l->prev) {
+		file = NAUTILUS_FILE (l->data);
+		if (file->details->directory == NULL) {
+			continue;
+		}
+
+		directory = file->details->directory;
+		nautilus_directory_request_full_info (directory, file);
+		if (g_list_find (directories, directory) == NULL) {
+			directories = g_list_prepend (directories, nautilus_directory_ref (directory));
+		}
+	}
+
+	for (l = directories; l != NULL; l = l->next) {
+		nautilus_directory_async_state_changed (l->data);
+	}
+	nautilus_directory_list_free (directories);
+}
+
 static void
 thumbnail_limit_changed_callback (gpointer user_data)
 {
@@ -7870,6 +8297,9 @@ nautilus_file_class_init (NautilusFileClass *class)
 	attribute_deep_file_count_q = g_quark_from_static_string ("deep_file_count");
 	attribute_deep_directory_count_q = g_quark_from_static_string ("deep_directory_count");
 	attribute_deep_total_count_q = g_quark_from_static_string ("deep_total_count");
+	attribute_total_size_q = g_quark_from_static_string ("total_size");
+	attribute_dimensions_q = g_quark_from_static_string ("dimensions");
+	attribute_date_taken_q = g_quark_from_static_string ("date_taken");
 	attribute_search_relevance_q = g_quark_from_static_string ("search_relevance");
 	attribute_trashed_on_q = g_quark_from_static_string ("trashed_on");
 	attribute_trashed_on_full_q = g_quark_from_static_string ("trashed_on_full");
@@ -8122,6 +8552,40 @@ nautilus_self_check_file (void)
 
 	nautilus_file_unref (file_1);
 	nautilus_file_unref (file_2);
+
+	/* stored icon positions come with the enumeration subset */
+	{
+		GFileAttributeMatcher *matcher;
+		GFileInfo *info;
+
+		matcher = g_file_attribute_matcher_new (NAUTILUS_FILE_ENUMERATION_ATTRIBUTES);
+		EEL_CHECK_BOOLEAN_RESULT (g_file_attribute_matcher_matches
+					  (matcher, "metadata::" NAUTILUS_METADATA_KEY_ICON_POSITION), TRUE);
+		g_file_attribute_matcher_unref (matcher);
+
+		info = g_file_info_new ();
+		g_file_info_set_name (info, "nautilus-self-check-positioned");
+		g_file_info_set_file_type (info, G_FILE_TYPE_REGULAR);
+		g_file_info_set_attribute_string (info, "metadata::" NAUTILUS_METADATA_KEY_ICON_POSITION,
+						  "64,128");
+
+		file_1 = nautilus_file_get_by_uri ("file:///tmp/nautilus-self-check-positioned");
+		nautilus_file_update_enumerated_info (file_1, info, TRUE);
+
+		EEL_CHECK_STRING_RESULT (nautilus_file_get_metadata
+					 (file_1, NAUTILUS_METADATA_KEY_ICON_POSITION, NULL), "64,128");
+
+		/* Listed again unchanged, it still has only part of its info */
+		EEL_CHECK_BOOLEAN_RESULT (nautilus_file_update_enumerated_info (file_1, info, TRUE), FALSE);
+		EEL_CHECK_BOOLEAN_RESULT (file_1->details->file_info_is_partial, TRUE);
+
+		/* Until the full info comes */
+		nautilus_file_update_info (file_1, info);
+		EEL_CHECK_BOOLEAN_RESULT (file_1->details->file_info_is_partial, FALSE);
+
+		nautilus_file_unref (file_1);
+		g_object_unref (info);
+	}
 }
 
 #endif /* !NAUTILUS_OMIT_SELF_CHECK */
@@ -459,6 +459,15 @@ void                    nautilus_file_list_call_when_ready              (GList
 									 NautilusFileListCallback        callback,
 									 gpointer                        callback_data);
 void                    nautilus_file_list_cancel_call_when_ready       (NautilusFileListHandle         *handle);
+/* Fetch the complete info of files loaded with the enumeration subset,
+ * most important first. Used by views for the files on screen.
+ */
+void                    nautilus_file_list_request_full_info            (GList                          *file_list);
+/* Thumbnails of files on screen are kept when the memory for images
+ * runs short. Calls must be balanced.
+ */
+void                    nautilus_file_set_shown                         (NautilusFile                   *file,
+									 gboolean                        shown);
 
 /* Debugging */
 void                    nautilus_file_dump                              (NautilusFile                   *file);
@@ -476,7 +485,8 @@ struct NautilusFile {
 typedef enum {
 	NAUTILUS_DATE_TYPE_MODIFIED,
 	NAUTILUS_DATE_TYPE_ACCESSED,
-	NAUTILUS_DATE_TYPE_TRASHED
+	NAUTILUS_DATE_TYPE_TRASHED,
+	NAUTILUS_DATE_TYPE_TAKEN
 } NautilusDateType;
 
 typedef struct {
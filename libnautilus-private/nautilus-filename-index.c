@@ -0,0 +1,1947 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+ *
+ * nautilus-filename-index.c: on-disk index of file names for searching
+ * without Tracker.
+ *
+ * Nautilus is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * Nautilus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; see the file COPYING.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <config.h>
+#include "nautilus-filename-index.h"
+
+#include "nautilus-directory-notify.h"
+#include "nautilus-global-preferences.h"
+#include "nautilus-lib-self-check-functions.h"
+#include "nautilus-search-hit.h"
+#define DEBUG_FLAG NAUTILUS_DEBUG_SEARCH
+#include "nautilus-debug.h"
+
+#include <eel/eel-debug.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+/* "NFIX" when read on a little endian machine. An index written with
+ * the other byte order does not match and is simply rebuilt.
+ */
+#define INDEX_MAGIC 0x5849464e
+#define INDEX_VERSION 2
+
+/* Rebuild an index older than this, in seconds */
+#define INDEX_MAX_AGE (24 * 60 * 60)
+/* Rebuild once this many changes were noted since the last build */
+#define MAX_OVERLAY_SIZE 10000
+/* Wait before building again after a build failed, in seconds,
+ * doubling after each failure with the same roots.
+ */
+#define BUILD_RETRY_MIN 60
+#define BUILD_RETRY_MAX INDEX_MAX_AGE
+
+#define HITS_BATCH_SIZE 500
+
+#define NO_PARENT G_MAXUINT32
+
+#define INDEX_ATTRIBUTES \
+	G_FILE_ATTRIBUTE_STANDARD_NAME "," \
+	G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME "," \
+	G_FILE_ATTRIBUTE_STANDARD_IS_BACKUP "," \
+	G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN "," \
+	G_FILE_ATTRIBUTE_STANDARD_TYPE "," \
+	G_FILE_ATTRIBUTE_TIME_MODIFIED "," \
+	G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC "," \
+	G_FILE_ATTRIBUTE_ID_FILE
+
+#define FOLDER_MTIME_ATTRIBUTES \
+	G_FILE_ATTRIBUTE_TIME_MODIFIED "," \
+	G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC
+
+enum {
+	ENTRY_IS_DIRECTORY = 1 << 0,
+	/* The file or one of its parents is hidden */
+	ENTRY_IS_HIDDEN = 1 << 1
+};
+
+/* The index file is a header followed by these sections, each starting
+ * on a multiple of 8 bytes. Offsets into the string section point to
+ * nul terminated strings.
+ *
+ * Folders are numbered in depth first order, so the folders below a
+ * folder are the ones from its own number up to its end. Files are
+ * stored ordered by their folder, and the postings of a trigram are
+ * the numbers of the files whose normalized name contains it.
+ *
+ * Folders also keep their modification time from before they were
+ * read, so a crawl can tell the ones whose files are still the same.
+ */
+typedef struct {
+	guint32 magic;
+	guint32 version;
+	gint64 build_time;
+	guint32 n_dirs;
+	guint32 dirs_offset;
+	guint32 n_entries;
+	guint32 entries_offset;
+	guint32 n_trigrams;
+	guint32 trigrams_offset;
+	guint32 n_postings;
+	guint32 postings_offset;
+	guint32 strings_length;
+	guint32 strings_offset;
+} IndexHeader;
+
+typedef struct {
+	guint32 path;
+	guint32 parent;
+	guint32 end;
+	guint32 flags;
+	/* In microseconds, 0 if a change could have gone unnoticed */
+	gint64 mtime;
+} IndexDir;
+
+typedef struct {
+	guint32 dir;
+	guint32 name;
+	guint32 key; /* the display name, normalized for comparing */
+	guint32 flags;
+	gint64 mtime;
+} IndexEntry;
+
+typedef struct {
+	guint32 trigram;
+	guint32 postings;
+	guint32 count;
+} IndexTrigram;
+
+typedef struct {
+	GMappedFile *file;
+	const IndexHeader *header;
+	const IndexDir *dirs;
+	const IndexEntry *entries;
+	const IndexTrigram *trigrams;
+	const guint32 *postings;
+	const char *strings;
+} IndexReader;
+
+typedef struct {
+	char **roots;
+	IndexReader reader;
+
+	gboolean building;
+	guint build_generation;
+	GCancellable *build_cancellable;
+	/* Failed builds for the current roots, and when to try again */
+	guint build_failures;
+	gint64 build_retry_time;
+
+	/* Paths added and removed since the index was built, with the
+	 * serial of the change.
+	 */
+	GHashTable *added;
+	GHashTable *removed;
+	guint change_serial;
+} FilenameIndex;
+
+typedef struct {
+	char **roots;
+	char *path;
+	guint generation;
+	guint change_serial;
+} BuildJob;
+
+typedef struct {
+	char *path;
+	guint32 parent;
+	gboolean hidden;
+	gint64 mtime;
+} BuildDir;
+
+typedef struct {
+	GArray *dirs;
+	GArray *entries;
+	GByteArray *strings;
+	GHashTable *trigrams; /* trigram -> GArray of entry numbers */
+	GHashTable *visited;
+	/* In seconds */
+	gint64 start_time;
+} IndexBuilder;
+
+struct NautilusFilenameIndexSearch {
+	IndexReader reader;
+	/* Private copy of the query, only used by the searching thread */
+	NautilusQuery *query;
+	GPtrArray *words;
+	char *location;
+	gboolean show_hidden;
+	GList *mime_types;
+	GHashTable *removed;
+	GList *added;
+};
+
+struct NautilusFilenameIndexFolders {
+	IndexReader reader;
+	char *location;
+	/* Path of each indexed folder below the location to its number
+	 * plus one, made on first use.
+	 */
+	GHashTable *numbers;
+};
+
+typedef struct {
+	GList *hits;
+	guint n_hits;
+	NautilusFilenameIndexHitsFunc func;
+	gpointer user_data;
+} HitBatch;
+
+typedef struct {
+	guint32 start;
+	guint32 end;
+} EntryRange;
+
+static FilenameIndex *filename_index;
+
+static guint32
+make_trigram (const char *string)
+{
+	return ((guint8) string[0] << 16) | ((guint8) string[1] << 8) | (guint8) string[2];
+}
+
+/* Whether @path is @location or below it */
+static gboolean
+path_is_below (const char *path,
+	       const char *location,
+	       gsize location_length)
+{
+	if (strncmp (path, location, location_length) != 0) {
+		return FALSE;
+	}
+
+	return path[location_length] == '\0' ||
+		path[location_length] == '/' ||
+		(location_length > 0 && location[location_length - 1] == '/');
+}
+
+static char *
+get_index_path (void)
+{
+	return g_build_filename (g_get_user_cache_dir (), "nautilus",
+				 "filename-index", NULL);
+}
+
+static gint64
+get_folder_mtime (GFileInfo *info)
+{
+	if (!g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_TIME_MODIFIED)) {
+		return 0;
+	}
+
+	return (gint64) g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC +
+		g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+}
+
+/* Reading */
+
+static gboolean
+section_is_valid (gsize size,
+		  guint32 offset,
+		  guint32 count,
+		  gsize item_size)
+{
+	return offset % 8 == 0 &&
+		(guint64) offset + (guint64) count * item_size <= size;
+}
+
+static gboolean
+index_reader_init (IndexReader *reader,
+		   GMappedFile *file)
+{
+	const IndexHeader *header;
+	const char *contents;
+	gsize size;
+
+	contents = g_mapped_file_get_contents (file);
+	size = g_mapped_file_get_length (file);
+	if (contents == NULL || size < sizeof (IndexHeader)) {
+		return FALSE;
+	}
+
+	header = (const IndexHeader *) contents;
+	if (header->magic != INDEX_MAGIC ||
+	    header->version != INDEX_VERSION ||
+	    !section_is_valid (size, header->dirs_offset, header->n_dirs, sizeof (IndexDir)) ||
+	    !section_is_valid (size, header->entries_offset, header->n_entries, sizeof (IndexEntry)) ||
+	    !section_is_valid (size, header->trigrams_offset, header->n_trigrams, sizeof (IndexTrigram)) ||
+	    !section_is_valid (size, header->postings_offset, header->n_postings, sizeof (guint32)) ||
+	    !section_is_valid (size, header->strings_offset, header->strings_length, 1) ||
+	    header->strings_length == 0 ||
+	    contents[header->strings_offset + header->strings_length - 1] != '\0') {
+		return FALSE;
+	}
+
+	reader->file = g_mapped_file_ref (file);
+	reader->header = header;
+	reader->dirs = (const IndexDir *) (contents + header->dirs_offset);
+	reader->entries = (const IndexEntry *) (contents + header->entries_offset);
+	reader->trigrams = (const IndexTrigram *) (contents + header->trigrams_offset);
+	reader->postings = (const guint32 *) (contents + header->postings_offset);
+	reader->strings = contents + header->strings_offset;
+
+	return TRUE;
+}
+
+static void
+index_reader_copy (IndexReader *reader,
+		   const IndexReader *source)
+{
+	*reader = *source;
+	if (reader->file != NULL) {
+		g_mapped_file_ref (reader->file);
+	}
+}
+
+static void
+index_reader_clear (IndexReader *reader)
+{
+	if (reader->file != NULL) {
+		g_mapped_file_unref (reader->file);
+	}
+	memset (reader, 0, sizeof (IndexReader));
+}
+
+static const char *
+index_reader_get_string (const IndexReader *reader,
+			 guint32 offset)
+{
+	if (offset >= reader->header->strings_length) {
+		return "";
+	}
+
+	return reader->strings + offset;
+}
+
+static const IndexTrigram *
+index_reader_lookup_trigram (const IndexReader *reader,
+			     guint32 trigram)
+{
+	guint32 low, high, middle;
+
+	low = 0;
+	high = reader->header->n_trigrams;
+	while (low < high) {
+		middle = low + (high - low) / 2;
+		if (reader->trigrams[middle].trigram < trigram) {
+			low = middle + 1;
+		} else if (reader->trigrams[middle].trigram > trigram) {
+			high = middle;
+		} else {
+			return &reader->trigrams[middle];
+		}
+	}
+
+	return NULL;
+}
+
+/* Number of the first file in folder @dir or after it */
+static guint32
+index_reader_find_entries (const IndexReader *reader,
+			   guint32 dir)
+{
+	guint32 low, high, middle;
+
+	low = 0;
+	high = reader->header->n_entries;
+	while (low < high) {
+		middle = low + (high - low) / 2;
+		if (reader->entries[middle].dir < dir) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+
+	return low;
+}
+
+static gboolean
+index_reader_has_roots (const IndexReader *reader,
+			char **roots)
+{
+	const char *path;
+	guint32 i, n_roots;
+	gint j;
+
+	n_roots = 0;
+	for (i = 0; i < reader->header->n_dirs; i++) {
+		if (reader->dirs[i].parent != NO_PARENT) {
+			continue;
+		}
+
+		path = index_reader_get_string (reader, reader->dirs[i].path);
+		for (j = 0; roots[j] != NULL; j++) {
+			if (strcmp (roots[j], path) == 0) {
+				break;
+			}
+		}
+		if (roots[j] == NULL) {
+			return FALSE;
+		}
+		n_roots++;
+	}
+
+	return n_roots == g_strv_length (roots);
+}
+
+/* Building */
+
+static guint32
+index_builder_add_string (IndexBuilder *builder,
+			  const char *string)
+{
+	guint32 offset;
+
+	offset = builder->strings->len;
+	g_byte_array_append (builder->strings, (const guint8 *) string, strlen (string) + 1);
+
+	return offset;
+}
+
+static void
+index_builder_add_trigrams (IndexBuilder *builder,
+			    const char *key,
+			    guint32 entry)
+{
+	GArray *postings;
+	guint32 trigram;
+	gsize i, length;
+
+	length = strlen (key);
+	for (i = 0; i + 3 <= length; i++) {
+		/* Query words never contain spaces */
+		if (key[i] == ' ' || key[i + 1] == ' ' || key[i + 2] == ' ') {
+			continue;
+		}
+
+		trigram = make_trigram (key + i);
+		postings = g_hash_table_lookup (builder->trigrams, GUINT_TO_POINTER (trigram));
+		if (postings == NULL) {
+			postings = g_array_new (FALSE, FALSE, sizeof (guint32));
+			g_hash_table_insert (builder->trigrams, GUINT_TO_POINTER (trigram), postings);
+		}
+
+		/* Once per file, however often the name contains it */
+		if (postings->len > 0 &&
+		    g_array_index (postings, guint32, postings->len - 1) == entry) {
+			continue;
+		}
+		g_array_append_val (postings, entry);
+	}
+}
+
+static void
+free_postings (gpointer data)
+{
+	g_array_free (data, TRUE);
+}
+
+static void
+index_builder_init (IndexBuilder *builder)
+{
+	builder->dirs = g_array_new (FALSE, FALSE, sizeof (IndexDir));
+	builder->entries = g_array_new (FALSE, FALSE, sizeof (IndexEntry));
+	builder->strings = g_byte_array_new ();
+	builder->trigrams = g_hash_table_new_full (NULL, NULL, NULL, free_postings);
+	builder->visited = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	builder->start_time = g_get_real_time () / G_USEC_PER_SEC;
+
+	/* Offset 0 is the empty string */
+	index_builder_add_string (builder, "");
+}
+
+static void
+index_builder_clear (IndexBuilder *builder)
+{
+	g_array_free (builder->dirs, TRUE);
+	g_array_free (builder->entries, TRUE);
+	g_byte_array_free (builder->strings, TRUE);
+	g_hash_table_destroy (builder->trigrams);
+	g_hash_table_destroy (builder->visited);
+}
+
+static void
+build_dir_free (BuildDir *dir)
+{
+	g_free (dir->path);
+	g_free (dir);
+}
+
+/* A folder changed in the second the walk started, or later, may
+ * change again without its time telling, on file systems that only
+ * keep whole seconds.
+ */
+static gint64
+index_builder_get_folder_mtime (IndexBuilder *builder,
+				GFileInfo *info)
+{
+	gint64 mtime;
+
+	mtime = get_folder_mtime (info);
+	if (mtime / G_USEC_PER_SEC + 1 >= builder->start_time) {
+		return 0;
+	}
+
+	return mtime;
+}
+
+static void
+index_builder_visit_directory (IndexBuilder *builder,
+			       BuildDir *dir,
+			       GQueue *stack,
+			       GCancellable *cancellable)
+{
+	GFileEnumerator *enumerator;
+	GFileInfo *info;
+	GFile *location;
+	IndexDir index_dir;
+	IndexEntry entry;
+	BuildDir *child;
+	const char *name, *display_name, *id;
+	char *key;
+	guint32 dir_number;
+
+	dir_number = builder->dirs->len;
+	index_dir.path = index_builder_add_string (builder, dir->path);
+	index_dir.parent = dir->parent;
+	index_dir.end = 0;
+	index_dir.flags = dir->hidden ? ENTRY_IS_HIDDEN : 0;
+	index_dir.mtime = dir->mtime;
+	g_array_append_val (builder->dirs, index_dir);
+
+	location = g_file_new_for_path (dir->path);
+	enumerator = g_file_enumerate_children (location, INDEX_ATTRIBUTES,
+						G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+						cancellable, NULL);
+	g_object_unref (location);
+	if (enumerator == NULL) {
+		return;
+	}
+
+	while ((info = g_file_enumerator_next_file (enumerator, cancellable, NULL)) != NULL) {
+		name = g_file_info_get_name (info);
+		display_name = g_file_info_get_display_name (info);
+		if (name == NULL || display_name == NULL) {
+			g_object_unref (info);
+			continue;
+		}
+
+		key = nautilus_query_prepare_string (display_name);
+
+		entry.dir = dir_number;
+		entry.name = index_builder_add_string (builder, name);
+		entry.key = index_builder_add_string (builder, key);
+		entry.flags = 0;
+		entry.mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+		if (dir->hidden ||
+		    g_file_info_get_is_hidden (info) ||
+		    g_file_info_get_is_backup (info)) {
+			entry.flags |= ENTRY_IS_HIDDEN;
+		}
+		if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY) {
+			entry.flags |= ENTRY_IS_DIRECTORY;
+		}
+
+		index_builder_add_trigrams (builder, key, builder->entries->len);
+		g_array_append_val (builder->entries, entry);
+		g_free (key);
+
+		id = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_ID_FILE);
+		if ((entry.flags & ENTRY_IS_DIRECTORY) &&
+		    (id == NULL || !g_hash_table_contains (builder->visited, id))) {
+			if (id != NULL) {
+				g_hash_table_add (builder->visited, g_strdup (id));
+			}
+
+			child = g_new0 (BuildDir, 1);
+			child->path = g_build_filename (dir->path, name, NULL);
+			child->parent = dir_number;
+			child->hidden = (entry.flags & ENTRY_IS_HIDDEN) != 0;
+			child->mtime = index_builder_get_folder_mtime (builder, info);
+			g_queue_push_head (stack, child);
+		}
+
+		g_object_unref (info);
+	}
+
+	g_object_unref (enumerator);
+}
+
+static void
+index_builder_walk (IndexBuilder *builder,
+		    char **roots,
+		    GCancellable *cancellable)
+{
+	GQueue *stack;
+	BuildDir *dir;
+	IndexDir *dirs;
+	GFileInfo *info;
+	GFile *location;
+	gint i;
+
+	/* Taking the folders from a stack numbers them depth first */
+	stack = g_queue_new ();
+	for (i = 0; roots[i] != NULL; i++) {
+		dir = g_new0 (BuildDir, 1);
+		dir->path = g_strdup (roots[i]);
+		dir->parent = NO_PARENT;
+
+		location = g_file_new_for_path (dir->path);
+		info = g_file_query_info (location, FOLDER_MTIME_ATTRIBUTES,
+					  G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+					  cancellable, NULL);
+		g_object_unref (location);
+		if (info != NULL) {
+			dir->mtime = index_builder_get_folder_mtime (builder, info);
+			g_object_unref (info);
+		}
+
+		g_queue_push_tail (stack, dir);
+	}
+
+	while (!g_cancellable_is_cancelled (cancellable) &&
+	       (dir = g_queue_pop_head (stack)) != NULL) {
+		index_builder_visit_directory (builder, dir, stack, cancellable);
+		build_dir_free (dir);
+	}
+
+	g_queue_free_full (stack, (GDestroyNotify) build_dir_free);
+
+	/* Each folder's subtree ends where the last of its children's does */
+	dirs = (IndexDir *) builder->dirs->data;
+	for (i = (gint) builder->dirs->len - 1; i >= 0; i--) {
+		dirs[i].end = MAX (dirs[i].end, (guint32) i + 1);
+		if (dirs[i].parent != NO_PARENT) {
+			dirs[dirs[i].parent].end = MAX (dirs[dirs[i].parent].end, dirs[i].end);
+		}
+	}
+}
+
+static gint
+compare_trigrams (gconstpointer a,
+		  gconstpointer b)
+{
+	guint32 trigram_a, trigram_b;
+
+	trigram_a = *(const guint32 *) a;
+	trigram_b = *(const guint32 *) b;
+
+	return trigram_a < trigram_b ? -1 : trigram_a > trigram_b;
+}
+
+static guint32
+append_section (GByteArray *data,
+		gconstpointer section,
+		gsize length)
+{
+	static const guint8 padding[8] = { 0 };
+	guint32 offset;
+
+	g_byte_array_append (data, padding, (8 - data->len % 8) % 8);
+	offset = data->len;
+	g_byte_array_append (data, section, length);
+
+	return offset;
+}
+
+/* Returns NULL if the index would not fit 32 bit offsets */
+static GByteArray *
+index_builder_write (IndexBuilder *builder)
+{
+	IndexHeader header;
+	IndexTrigram trigram;
+	GArray *trigrams, *postings, *list;
+	GByteArray *data;
+	GHashTableIter iter;
+	gpointer key, value;
+	guint64 size;
+	guint i;
+
+	trigrams = g_array_sized_new (FALSE, FALSE, sizeof (guint32),
+				      g_hash_table_size (builder->trigrams));
+	size = 0;
+	g_hash_table_iter_init (&iter, builder->trigrams);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		trigram.trigram = GPOINTER_TO_UINT (key);
+		g_array_append_val (trigrams, trigram.trigram);
+		size += ((GArray *) value)->len;
+	}
+	g_array_sort (trigrams, compare_trigrams);
+
+	size = size * sizeof (guint32) +
+		trigrams->len * sizeof (IndexTrigram) +
+		builder->dirs->len * sizeof (IndexDir) +
+		builder->entries->len * sizeof (IndexEntry) +
+		builder->strings->len +
+		sizeof (IndexHeader) + 5 * 8;
+	if (size > G_MAXUINT32) {
+		g_array_free (trigrams, TRUE);
+		return NULL;
+	}
+
+	postings = g_array_new (FALSE, FALSE, sizeof (guint32));
+	list = g_array_sized_new (FALSE, FALSE, sizeof (IndexTrigram), trigrams->len);
+	for (i = 0; i < trigrams->len; i++) {
+		value = g_hash_table_lookup (builder->trigrams,
+					     GUINT_TO_POINTER (g_array_index (trigrams, guint32, i)));
+		trigram.trigram = g_array_index (trigrams, guint32, i);
+		trigram.postings = postings->len;
+		trigram.count = ((GArray *) value)->len;
+		g_array_append_val (list, trigram);
+		g_array_append_vals (postings, ((GArray *) value)->data, trigram.count);
+	}
+	g_array_free (trigrams, TRUE);
+
+	memset (&header, 0, sizeof (IndexHeader));
+	header.magic = INDEX_MAGIC;
+	header.version = INDEX_VERSION;
+	header.build_time = g_get_real_time () / G_USEC_PER_SEC;
+	header.n_dirs = builder->dirs->len;
+	header.n_entries = builder->entries->len;
+	header.n_trigrams = list->len;
+	header.n_postings = postings->len;
+	header.strings_length = builder->strings->len;
+
+	data = g_byte_array_sized_new (size);
+	g_byte_array_append (data, (const guint8 *) &header, sizeof (IndexHeader));
+	header.dirs_offset = append_section (data, builder->dirs->data,
+					     builder->dirs->len * sizeof (IndexDir));
+	header.entries_offset = append_section (data, builder->entries->data,
+						builder->entries->len * sizeof (IndexEntry));
+	header.trigrams_offset = append_section (data, list->data,
+						 list->len * sizeof (IndexTrigram));
+	header.postings_offset = append_section (data, postings->data,
+						 postings->len * sizeof (guint32));
+	header.strings_offset = append_section (data, builder->strings->data,
+						builder->strings->len);
+	memcpy (data->data, &header, sizeof (IndexHeader));
+
+	g_array_free (list, TRUE);
+	g_array_free (postings, TRUE);
+
+	return data;
+}
+
+static void
+build_job_free (BuildJob *job)
+{
+	g_strfreev (job->roots);
+	g_free (job->path);
+	g_free (job);
+}
+
+static void
+build_thread (GTask *task,
+	      gpointer source_object,
+	      gpointer task_data,
+	      GCancellable *cancellable)
+{
+	BuildJob *job;
+	IndexBuilder builder;
+	GByteArray *data;
+	char *dirname;
+	gboolean success;
+
+	job = task_data;
+
+	index_builder_init (&builder);
+	index_builder_walk (&builder, job->roots, cancellable);
+
+	data = NULL;
+	if (!g_cancellable_is_cancelled (cancellable)) {
+		data = index_builder_write (&builder);
+	}
+	index_builder_clear (&builder);
+
+	success = FALSE;
+	if (data != NULL) {
+		dirname = g_path_get_dirname (job->path);
+		g_mkdir_with_parents (dirname, 0700);
+		g_free (dirname);
+
+		success = g_file_set_contents (job->path, (const char *) data->data, data->len, NULL);
+		g_byte_array_free (data, TRUE);
+	}
+
+	g_task_return_boolean (task, success);
+}
+
+static gboolean
+load_index (void)
+{
+	GMappedFile *file;
+	IndexReader reader;
+	char *path;
+
+	path = get_index_path ();
+	file = g_mapped_file_new (path, FALSE, NULL);
+	g_free (path);
+	if (file == NULL) {
+		return FALSE;
+	}
+
+	memset (&reader, 0, sizeof (IndexReader));
+	if (!index_reader_init (&reader, file) ||
+	    !index_reader_has_roots (&reader, filename_index->roots)) {
+		index_reader_clear (&reader);
+		g_mapped_file_unref (file);
+		return FALSE;
+	}
+	g_mapped_file_unref (file);
+
+	index_reader_clear (&filename_index->reader);
+	filename_index->reader = reader;
+
+	DEBUG ("Filename index loaded, %u files", reader.header->n_entries);
+
+	return TRUE;
+}
+
+static gboolean
+remove_older_change (gpointer key,
+		     gpointer value,
+		     gpointer user_data)
+{
+	return GPOINTER_TO_UINT (value) <= GPOINTER_TO_UINT (user_data);
+}
+
+static gint64
+get_build_retry_delay (guint failures)
+{
+	gint64 delay;
+
+	delay = BUILD_RETRY_MIN;
+	while (failures > 1 && delay < BUILD_RETRY_MAX) {
+		delay *= 2;
+		failures--;
+	}
+
+	return MIN (delay, BUILD_RETRY_MAX);
+}
+
+static void
+build_done_callback (GObject *source_object,
+		     GAsyncResult *result,
+		     gpointer user_data)
+{
+	BuildJob *job;
+
+	job = g_task_get_task_data (G_TASK (result));
+
+	/* Stale if the roots changed or we shut down meanwhile */
+	if (filename_index == NULL ||
+	    job->generation != filename_index->build_generation) {
+		return;
+	}
+
+	filename_index->building = FALSE;
+	g_clear_object (&filename_index->build_cancellable);
+
+	if (!g_task_propagate_boolean (G_TASK (result), NULL) ||
+	    !load_index ()) {
+		filename_index->build_failures++;
+		filename_index->build_retry_time = g_get_monotonic_time () / G_USEC_PER_SEC +
+			get_build_retry_delay (filename_index->build_failures);
+		DEBUG ("Filename index could not be built, %u failures",
+		       filename_index->build_failures);
+		return;
+	}
+
+	filename_index->build_failures = 0;
+	filename_index->build_retry_time = 0;
+
+	/* Changes noted before the walk started are part of the index now */
+	g_hash_table_foreach_remove (filename_index->added, remove_older_change,
+				     GUINT_TO_POINTER (job->change_serial));
+	g_hash_table_foreach_remove (filename_index->removed, remove_older_change,
+				     GUINT_TO_POINTER (job->change_serial));
+}
+
+static void
+start_build (void)
+{
+	BuildJob *job;
+	GTask *task;
+
+	if (filename_index->building) {
+		return;
+	}
+
+	/* A failed build is not tried again on every search */
+	if (filename_index->build_failures > 0 &&
+	    g_get_monotonic_time () / G_USEC_PER_SEC < filename_index->build_retry_time) {
+		return;
+	}
+
+	DEBUG ("Building filename index");
+
+	job = g_new0 (BuildJob, 1);
+	job->roots = g_strdupv (filename_index->roots);
+	job->path = get_index_path ();
+	job->generation = ++filename_index->build_generation;
+	job->change_serial = filename_index->change_serial;
+
+	filename_index->building = TRUE;
+	filename_index->build_cancellable = g_cancellable_new ();
+
+	task = g_task_new (NULL, filename_index->build_cancellable, build_done_callback, NULL);
+	g_task_set_task_data (task, job, (GDestroyNotify) build_job_free);
+	g_task_run_in_thread (task, build_thread);
+	g_object_unref (task);
+}
+
+static void
+cancel_build (void)
+{
+	if (!filename_index->building) {
+		return;
+	}
+
+	g_cancellable_cancel (filename_index->build_cancellable);
+	g_clear_object (&filename_index->build_cancellable);
+	filename_index->building = FALSE;
+	filename_index->build_generation++;
+}
+
+static void
+rebuild_if_old (void)
+{
+	gint64 age;
+
+	if (filename_index->roots[0] == NULL) {
+		return;
+	}
+
+	if (filename_index->reader.file == NULL) {
+		start_build ();
+		return;
+	}
+
+	age = g_get_real_time () / G_USEC_PER_SEC - filename_index->reader.header->build_time;
+	if (age > INDEX_MAX_AGE || age < 0) {
+		start_build ();
+	}
+}
+
+static char **
+get_roots (void)
+{
+	GPtrArray *roots;
+	GFile *location;
+	char **setting;
+	char *path;
+	gint i;
+
+	setting = g_settings_get_strv (nautilus_preferences,
+				       NAUTILUS_PREFERENCES_FILENAME_INDEX_ROOTS);
+
+	roots = g_ptr_array_new ();
+	for (i = 0; setting[i] != NULL; i++) {
+		if (strcmp (setting[i], "~") == 0) {
+			path = g_strdup (g_get_home_dir ());
+		} else if (g_str_has_prefix (setting[i], "~/")) {
+			path = g_build_filename (g_get_home_dir (), setting[i] + 2, NULL);
+		} else {
+			location = g_file_new_for_commandline_arg (setting[i]);
+			path = g_file_get_path (location);
+			g_object_unref (location);
+		}
+
+		/* Only local folders can be indexed */
+		if (path == NULL || !g_path_is_absolute (path)) {
+			g_free (path);
+			continue;
+		}
+
+		location = g_file_new_for_path (path);
+		g_free (path);
+		g_ptr_array_add (roots, g_file_get_path (location));
+		g_object_unref (location);
+	}
+	g_ptr_array_add (roots, NULL);
+	g_strfreev (setting);
+
+	return (char **) g_ptr_array_free (roots, FALSE);
+}
+
+static void
+roots_changed_callback (gpointer callback_data)
+{
+	g_strfreev (filename_index->roots);
+	filename_index->roots = get_roots ();
+
+	cancel_build ();
+	index_reader_clear (&filename_index->reader);
+	g_hash_table_remove_all (filename_index->added);
+	g_hash_table_remove_all (filename_index->removed);
+	filename_index->build_failures = 0;
+	filename_index->build_retry_time = 0;
+
+	if (filename_index->roots[0] == NULL) {
+		return;
+	}
+
+	load_index ();
+	rebuild_if_old ();
+}
+
+static void
+filename_index_free (void)
+{
+	g_signal_handlers_disconnect_by_func (nautilus_preferences,
+					      roots_changed_callback, NULL);
+
+	cancel_build ();
+	index_reader_clear (&filename_index->reader);
+	g_hash_table_destroy (filename_index->added);
+	g_hash_table_destroy (filename_index->removed);
+	g_strfreev (filename_index->roots);
+
+	g_free (filename_index);
+	filename_index = NULL;
+}
+
+void
+nautilus_filename_index_ensure (void)
+{
+	if (filename_index != NULL) {
+		rebuild_if_old ();
+		return;
+	}
+
+	filename_index = g_new0 (FilenameIndex, 1);
+	filename_index->added = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	filename_index->removed = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	eel_debug_call_at_shutdown (filename_index_free);
+
+	g_signal_connect_swapped (nautilus_preferences,
+				  "changed::" NAUTILUS_PREFERENCES_FILENAME_INDEX_ROOTS,
+				  G_CALLBACK (roots_changed_callback), NULL);
+	roots_changed_callback (NULL);
+}
+
+gboolean
+nautilus_filename_index_is_ready (void)
+{
+	return filename_index != NULL && filename_index->reader.file != NULL;
+}
+
+/* Keeping up with changes */
+
+static gboolean
+path_is_indexed (const char *path)
+{
+	gint i;
+
+	for (i = 0; filename_index->roots[i] != NULL; i++) {
+		if (path_is_below (path, filename_index->roots[i],
+				   strlen (filename_index->roots[i]))) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static void
+note_change (GFile *location,
+	     gboolean added)
+{
+	char *path;
+
+	path = g_file_get_path (location);
+	if (path == NULL || !path_is_indexed (path)) {
+		g_free (path);
+		return;
+	}
+
+	filename_index->change_serial++;
+	if (added) {
+		g_hash_table_remove (filename_index->removed, path);
+		g_hash_table_replace (filename_index->added, path,
+				      GUINT_TO_POINTER (filename_index->change_serial));
+	} else {
+		g_hash_table_remove (filename_index->added, path);
+		g_hash_table_replace (filename_index->removed, path,
+				      GUINT_TO_POINTER (filename_index->change_serial));
+	}
+}
+
+static void
+check_overlay_size (void)
+{
+	if (g_hash_table_size (filename_index->added) +
+	    g_hash_table_size (filename_index->removed) > MAX_OVERLAY_SIZE) {
+		start_build ();
+	}
+}
+
+void
+nautilus_filename_index_notify_added (GList *files)
+{
+	GList *l;
+
+	if (filename_index == NULL || filename_index->roots[0] == NULL) {
+		return;
+	}
+
+	for (l = files; l != NULL; l = l->next) {
+		note_change (l->data, TRUE);
+	}
+	check_overlay_size ();
+}
+
+void
+nautilus_filename_index_notify_removed (GList *files)
+{
+	GList *l;
+
+	if (filename_index == NULL || filename_index->roots[0] == NULL) {
+		return;
+	}
+
+	for (l = files; l != NULL; l = l->next) {
+		note_change (l->data, FALSE);
+	}
+	check_overlay_size ();
+}
+
+/* The contents of a moved folder are found at the old place until the
+ * next build, where they are filtered out as below a removed path.
+ */
+void
+nautilus_filename_index_notify_moved (GList *file_pairs)
+{
+	GFilePair *pair;
+	GList *l;
+
+	if (filename_index == NULL || filename_index->roots[0] == NULL) {
+		return;
+	}
+
+	for (l = file_pairs; l != NULL; l = l->next) {
+		pair = l->data;
+		note_change (pair->from, FALSE);
+		note_change (pair->to, TRUE);
+	}
+	check_overlay_size ();
+}
+
+/* Searching */
+
+NautilusFilenameIndexSearch *
+nautilus_filename_index_search_new (NautilusQuery *query)
+{
+	NautilusFilenameIndexSearch *search;
+	GHashTableIter iter;
+	GFile *location;
+	GList *mime_types;
+	gpointer key;
+	char *text, *prepared, *uri;
+	char **words;
+	gint i;
+
+	search = g_new0 (NautilusFilenameIndexSearch, 1);
+
+	uri = nautilus_query_get_location (query);
+	location = g_file_new_for_uri (uri);
+	search->location = g_file_get_path (location);
+	g_object_unref (location);
+
+	text = nautilus_query_get_text (query);
+	mime_types = nautilus_query_get_mime_types (query);
+	search->show_hidden = nautilus_query_get_show_hidden_files (query);
+
+	search->query = nautilus_query_new ();
+	nautilus_query_set_text (search->query, text);
+	nautilus_query_set_location (search->query, uri);
+	nautilus_query_set_mime_types (search->query, mime_types);
+	nautilus_query_set_show_hidden_files (search->query, search->show_hidden);
+	search->mime_types = mime_types;
+	g_free (uri);
+
+	search->words = g_ptr_array_new_with_free_func (g_free);
+	if (text != NULL) {
+		prepared = nautilus_query_prepare_string (text);
+		words = g_strsplit (prepared, " ", -1);
+		for (i = 0; words[i] != NULL; i++) {
+			if (words[i][0] != '\0') {
+				g_ptr_array_add (search->words, g_strdup (words[i]));
+			}
+		}
+		g_strfreev (words);
+		g_free (prepared);
+	}
+	g_free (text);
+
+	search->removed = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	if (filename_index != NULL) {
+		index_reader_copy (&search->reader, &filename_index->reader);
+
+		g_hash_table_iter_init (&iter, filename_index->removed);
+		while (g_hash_table_iter_next (&iter, &key, NULL)) {
+			g_hash_table_add (search->removed, g_strdup (key));
+		}
+
+		g_hash_table_iter_init (&iter, filename_index->added);
+		while (g_hash_table_iter_next (&iter, &key, NULL)) {
+			search->added = g_list_prepend (search->added, g_strdup (key));
+		}
+	}
+
+	return search;
+}
+
+void
+nautilus_filename_index_search_free (NautilusFilenameIndexSearch *search)
+{
+	index_reader_clear (&search->reader);
+	g_object_unref (search->query);
+	g_ptr_array_unref (search->words);
+	g_free (search->location);
+	g_list_free_full (search->mime_types, g_free);
+	g_hash_table_destroy (search->removed);
+	g_list_free_full (search->added, g_free);
+	g_free (search);
+}
+
+static void
+hit_batch_flush (HitBatch *batch)
+{
+	if (batch->hits == NULL) {
+		return;
+	}
+
+	batch->func (g_list_reverse (batch->hits), batch->user_data);
+	batch->hits = NULL;
+	batch->n_hits = 0;
+}
+
+static void
+hit_batch_add (HitBatch *batch,
+	       const char *path,
+	       const char *key,
+	       gint64 mtime,
+	       NautilusQuery *query)
+{
+	NautilusSearchHit *hit;
+	GDateTime *date;
+	gdouble match;
+	char *uri;
+
+	match = nautilus_query_matches_string (query, key);
+	if (match < 0) {
+		return;
+	}
+
+	uri = g_filename_to_uri (path, NULL, NULL);
+	if (uri == NULL) {
+		return;
+	}
+
+	hit = nautilus_search_hit_new (uri);
+	g_free (uri);
+	nautilus_search_hit_set_fts_rank (hit, match);
+	if (mtime > 0) {
+		date = g_date_time_new_from_unix_local (mtime);
+		nautilus_search_hit_set_modification_time (hit, date);
+		g_date_time_unref (date);
+	}
+
+	batch->hits = g_list_prepend (batch->hits, hit);
+	if (++batch->n_hits >= HITS_BATCH_SIZE) {
+		hit_batch_flush (batch);
+	}
+}
+
+static gboolean
+key_matches (NautilusFilenameIndexSearch *search,
+	     const char *key)
+{
+	guint i;
+
+	for (i = 0; i < search->words->len; i++) {
+		if (strstr (key, g_ptr_array_index (search->words, i)) == NULL) {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static gboolean
+mime_type_matches (NautilusFilenameIndexSearch *search,
+		   const char *name,
+		   gboolean is_directory)
+{
+	GList *l;
+	char *mime_type;
+	gboolean found;
+
+	if (search->mime_types == NULL) {
+		return TRUE;
+	}
+
+	/* No content types in the index, go by the name as for files
+	 * not read yet.
+	 */
+	if (is_directory) {
+		mime_type = g_strdup ("inode/directory");
+	} else {
+		mime_type = g_content_type_guess (name, NULL, 0, NULL);
+	}
+
+	found = FALSE;
+	for (l = search->mime_types; l != NULL && !found; l = l->next) {
+		found = g_content_type_is_a (mime_type, l->data);
+	}
+	g_free (mime_type);
+
+	return found;
+}
+
+static gboolean
+entry_was_removed (NautilusFilenameIndexSearch *search,
+		   const IndexEntry *entry,
+		   const char *path)
+{
+	const IndexReader *reader;
+	guint32 dir;
+
+	if (g_hash_table_size (search->removed) == 0) {
+		return FALSE;
+	}
+
+	if (g_hash_table_contains (search->removed, path)) {
+		return TRUE;
+	}
+
+	reader = &search->reader;
+	dir = entry->dir;
+	while (dir < reader->header->n_dirs) {
+		if (g_hash_table_contains (search->removed,
+					   index_reader_get_string (reader, reader->dirs[dir].path))) {
+			return TRUE;
+		}
+
+		/* Parents always come first */
+		if (reader->dirs[dir].parent >= dir) {
+			break;
+		}
+		dir = reader->dirs[dir].parent;
+	}
+
+	return FALSE;
+}
+
+static void
+check_entry (NautilusFilenameIndexSearch *search,
+	     guint32 number,
+	     HitBatch *batch)
+{
+	const IndexReader *reader;
+	const IndexEntry *entry;
+	const char *key, *name;
+	char *path;
+
+	reader = &search->reader;
+	entry = &reader->entries[number];
+
+	if ((entry->flags & ENTRY_IS_HIDDEN) && !search->show_hidden) {
+		return;
+	}
+
+	key = index_reader_get_string (reader, entry->key);
+	if (!key_matches (search, key)) {
+		return;
+	}
+
+	name = index_reader_get_string (reader, entry->name);
+	if (!mime_type_matches (search, name, (entry->flags & ENTRY_IS_DIRECTORY) != 0) ||
+	    entry->dir >= reader->header->n_dirs) {
+		return;
+	}
+
+	path = g_build_filename (index_reader_get_string (reader, reader->dirs[entry->dir].path),
+				 name, NULL);
+	if (!entry_was_removed (search, entry, path)) {
+		hit_batch_add (batch, path, key, entry->mtime, search->query);
+	}
+	g_free (path);
+}
+
+/* The files below the search location, as ranges of file numbers */
+static GArray *
+get_entry_ranges (NautilusFilenameIndexSearch *search)
+{
+	const IndexReader *reader;
+	EntryRange range;
+	GArray *ranges;
+	gsize location_length;
+	guint32 dir, end;
+
+	reader = &search->reader;
+	ranges = g_array_new (FALSE, FALSE, sizeof (EntryRange));
+	location_length = strlen (search->location);
+
+	dir = 0;
+	while (dir < reader->header->n_dirs) {
+		if (!path_is_below (index_reader_get_string (reader, reader->dirs[dir].path),
+				    search->location, location_length)) {
+			dir++;
+			continue;
+		}
+
+		end = CLAMP (reader->dirs[dir].end, dir + 1, reader->header->n_dirs);
+		range.start = index_reader_find_entries (reader, dir);
+		range.end = index_reader_find_entries (reader, end);
+		if (range.start < range.end) {
+			g_array_append_val (ranges, range);
+		}
+		dir = end;
+	}
+
+	return ranges;
+}
+
+static void
+search_index (NautilusFilenameIndexSearch *search,
+	      GCancellable *cancellable,
+	      HitBatch *batch)
+{
+	const IndexReader *reader;
+	const IndexTrigram *trigram, *best;
+	const char *word;
+	EntryRange *range;
+	GArray *ranges;
+	guint32 number, i, r;
+	gsize length, j;
+	guint n_checked;
+
+	reader = &search->reader;
+
+	/* The rarest trigram of the query gives the fewest files to check */
+	best = NULL;
+	for (i = 0; i < search->words->len; i++) {
+		word = g_ptr_array_index (search->words, i);
+		length = strlen (word);
+		for (j = 0; j + 3 <= length; j++) {
+			trigram = index_reader_lookup_trigram (reader, make_trigram (word + j));
+			if (trigram == NULL ||
+			    (guint64) trigram->postings + trigram->count > reader->header->n_postings) {
+				/* No file has it */
+				return;
+			}
+
+			if (best == NULL || trigram->count < best->count) {
+				best = trigram;
+			}
+		}
+	}
+
+	ranges = get_entry_ranges (search);
+	n_checked = 0;
+
+	if (best != NULL) {
+		/* Both the postings and the ranges are in file order */
+		r = 0;
+		for (i = 0; i < best->count && r < ranges->len; i++) {
+			number = reader->postings[best->postings + i];
+			while (r < ranges->len &&
+			       number >= g_array_index (ranges, EntryRange, r).end) {
+				r++;
+			}
+			if (r == ranges->len) {
+				break;
+			}
+			if (number < g_array_index (ranges, EntryRange, r).start) {
+				continue;
+			}
+
+			check_entry (search, number, batch);
+
+			if (++n_checked % 4096 == 0 &&
+			    g_cancellable_is_cancelled (cancellable)) {
+				break;
+			}
+		}
+	} else {
+		/* Only short words, go through all the files */
+		for (r = 0; r < ranges->len; r++) {
+			range = &g_array_index (ranges, EntryRange, r);
+			for (number = range->start; number < range->end; number++) {
+				check_entry (search, number, batch);
+
+				if (++n_checked % 4096 == 0 &&
+				    g_cancellable_is_cancelled (cancellable)) {
+					g_array_free (ranges, TRUE);
+					return;
+				}
+			}
+		}
+	}
+
+	g_array_free (ranges, TRUE);
+}
+
+static void
+search_added (NautilusFilenameIndexSearch *search,
+	      HitBatch *batch)
+{
+	GList *l;
+	char *path, *name, *display_name, *key;
+	gsize location_length;
+
+	location_length = strlen (search->location);
+	for (l = search->added; l != NULL; l = l->next) {
+		path = l->data;
+		if (strcmp (path, search->location) == 0 ||
+		    !path_is_below (path, search->location, location_length)) {
+			continue;
+		}
+
+		if (!search->show_hidden &&
+		    (strstr (path, "/.") != NULL || g_str_has_suffix (path, "~"))) {
+			continue;
+		}
+
+		name = g_path_get_basename (path);
+		display_name = g_filename_display_name (name);
+		key = nautilus_query_prepare_string (display_name);
+
+		if (key_matches (search, key) &&
+		    mime_type_matches (search, name, g_file_test (path, G_FILE_TEST_IS_DIR))) {
+			hit_batch_add (batch, path, key, 0, search->query);
+		}
+
+		g_free (key);
+		g_free (display_name);
+		g_free (name);
+	}
+}
+
+void
+nautilus_filename_index_search_run (NautilusFilenameIndexSearch *search,
+				    GCancellable *cancellable,
+				    NautilusFilenameIndexHitsFunc hits_func,
+				    gpointer user_data)
+{
+	HitBatch batch;
+
+	if (search->location == NULL) {
+		return;
+	}
+
+	memset (&batch, 0, sizeof (HitBatch));
+	batch.func = hits_func;
+	batch.user_data = user_data;
+
+	if (search->reader.file != NULL) {
+		search_index (search, cancellable, &batch);
+	}
+
+	if (!g_cancellable_is_cancelled (cancellable)) {
+		search_added (search, &batch);
+	}
+
+	if (g_cancellable_is_cancelled (cancellable)) {
+		g_list_free_full (batch.hits, g_object_unref);
+		return;
+	}
+
+	hit_batch_flush (&batch);
+}
+
+/* Crawling */
+
+NautilusFilenameIndexFolders *
+nautilus_filename_index_folders_new (NautilusQuery *query)
+{
+	NautilusFilenameIndexFolders *folders;
+	GFile *location;
+	char *uri, *path;
+
+	if (!nautilus_filename_index_is_ready ()) {
+		return NULL;
+	}
+
+	uri = nautilus_query_get_location (query);
+	location = g_file_new_for_uri (uri);
+	path = g_file_get_path (location);
+	g_object_unref (location);
+	g_free (uri);
+	if (path == NULL) {
+		return NULL;
+	}
+
+	folders = g_new0 (NautilusFilenameIndexFolders, 1);
+	index_reader_copy (&folders->reader, &filename_index->reader);
+	folders->location = path;
+
+	return folders;
+}
+
+void
+nautilus_filename_index_folders_free (NautilusFilenameIndexFolders *folders)
+{
+	index_reader_clear (&folders->reader);
+	g_free (folders->location);
+	if (folders->numbers != NULL) {
+		g_hash_table_destroy (folders->numbers);
+	}
+	g_free (folders);
+}
+
+static void
+folders_fill_numbers (NautilusFilenameIndexFolders *folders)
+{
+	const IndexReader *reader;
+	gsize location_length;
+	guint32 dir, end;
+
+	reader = &folders->reader;
+	folders->numbers = g_hash_table_new (g_str_hash, g_str_equal);
+	location_length = strlen (folders->location);
+
+	dir = 0;
+	while (dir < reader->header->n_dirs) {
+		if (!path_is_below (index_reader_get_string (reader, reader->dirs[dir].path),
+				    folders->location, location_length)) {
+			dir++;
+			continue;
+		}
+
+		end = CLAMP (reader->dirs[dir].end, dir + 1, reader->header->n_dirs);
+		for (; dir < end; dir++) {
+			g_hash_table_insert (folders->numbers,
+					     (gpointer) index_reader_get_string (reader, reader->dirs[dir].path),
+					     GUINT_TO_POINTER (dir + 1));
+		}
+	}
+}
+
+gboolean
+nautilus_filename_index_folders_get_unchanged (NautilusFilenameIndexFolders  *folders,
+					       GFile                         *location,
+					       gboolean                       show_hidden,
+					       GCancellable                  *cancellable,
+					       GList                        **subfolders)
+{
+	const IndexReader *reader;
+	GFileInfo *info;
+	GList *list;
+	char *path;
+	guint32 number, end, i;
+	gint64 mtime;
+
+	reader = &folders->reader;
+
+	path = g_file_get_path (location);
+	if (path == NULL) {
+		return FALSE;
+	}
+
+	if (folders->numbers == NULL) {
+		folders_fill_numbers (folders);
+	}
+	number = GPOINTER_TO_UINT (g_hash_table_lookup (folders->numbers, path));
+	g_free (path);
+	if (number == 0 || reader->dirs[number - 1].mtime == 0) {
+		return FALSE;
+	}
+	number--;
+
+	info = g_file_query_info (location, FOLDER_MTIME_ATTRIBUTES,
+				  G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+				  cancellable, NULL);
+	if (info == NULL) {
+		return FALSE;
+	}
+	mtime = get_folder_mtime (info);
+	g_object_unref (info);
+
+	if (mtime != reader->dirs[number].mtime) {
+		return FALSE;
+	}
+
+	/* The subfolders follow the folder, each one with its own
+	 * subtree after it.
+	 */
+	list = NULL;
+	end = CLAMP (reader->dirs[number].end, number + 1, reader->header->n_dirs);
+	for (i = number + 1; i < end; i = CLAMP (reader->dirs[i].end, i + 1, end)) {
+		if (reader->dirs[i].parent != number) {
+			g_list_free_full (list, g_object_unref);
+			return FALSE;
+		}
+
+		if (!show_hidden && (reader->dirs[i].flags & ENTRY_IS_HIDDEN)) {
+			continue;
+		}
+
+		list = g_list_prepend (list,
+				       g_file_new_for_path (index_reader_get_string (reader, reader->dirs[i].path)));
+	}
+
+	*subfolders = g_list_reverse (list);
+
+	return TRUE;
+}
+
+#if !defined (NAUTILUS_OMIT_SELF_CHECK)
+
+static void
+self_check_collect_hits (GList *hits,
+			 gpointer user_data)
+{
+	GList **uris;
+	GList *l;
+
+	uris = user_data;
+	for (l = hits; l != NULL; l = l->next) {
+		*uris = g_list_prepend (*uris, g_strdup (nautilus_search_hit_get_uri (l->data)));
+	}
+	g_list_free_full (hits, g_object_unref);
+}
+
+static int
+self_check_count_hits (NautilusFilenameIndexSearch *search)
+{
+	GList *uris;
+	int count;
+
+	uris = NULL;
+	nautilus_filename_index_search_run (search, NULL, self_check_collect_hits, &uris);
+	count = g_list_length (uris);
+	g_list_free_full (uris, g_free);
+
+	return count;
+}
+
+static void
+self_check_write_file (const char *dir,
+		       const char *name)
+{
+	char *path;
+
+	path = g_build_filename (dir, name, NULL);
+	g_file_set_contents (path, "", 0, NULL);
+	g_free (path);
+}
+
+/* Whole seconds, long enough ago for the index to trust them */
+static void
+self_check_set_mtime (const char *dir,
+		      const char *name,
+		      guint64 mtime)
+{
+	GFile *location;
+	char *path;
+
+	path = g_build_filename (dir, name, NULL);
+	location = g_file_new_for_path (path);
+	g_file_set_attribute_uint64 (location, G_FILE_ATTRIBUTE_TIME_MODIFIED, mtime,
+				     G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS, NULL, NULL);
+	g_object_unref (location);
+	g_free (path);
+}
+
+static int
+self_check_get_unchanged (NautilusFilenameIndexFolders *folders,
+			  const char *path,
+			  gboolean show_hidden)
+{
+	GFile *location;
+	GList *subfolders;
+	int count;
+
+	location = g_file_new_for_path (path);
+	count = -1;
+	if (nautilus_filename_index_folders_get_unchanged (folders, location, show_hidden,
+							   NULL, &subfolders)) {
+		count = g_list_length (subfolders);
+		g_list_free_full (subfolders, g_object_unref);
+	}
+	g_object_unref (location);
+
+	return count;
+}
+
+void
+nautilus_self_check_filename_index (void)
+{
+	IndexBuilder builder;
+	IndexReader reader;
+	NautilusFilenameIndexSearch *search;
+	NautilusFilenameIndexFolders *folders;
+	NautilusQuery *query;
+	GByteArray *data;
+	GMappedFile *mapped;
+	const IndexTrigram *trigram;
+	char *roots[2];
+	char *root, *path, *uri;
+	static const char *files[] = {
+		"alpha.txt", "beta", "sub/alphabet.png", ".hidden/alpha2",
+		"sub", ".hidden"
+	};
+	guint i;
+
+	root = g_dir_make_tmp ("nautilus-filename-index-XXXXXX", NULL);
+	EEL_CHECK_BOOLEAN_RESULT (root != NULL, TRUE);
+	if (root == NULL) {
+		return;
+	}
+
+	path = g_build_filename (root, "sub", NULL);
+	g_mkdir (path, 0700);
+	g_free (path);
+	path = g_build_filename (root, ".hidden", NULL);
+	g_mkdir (path, 0700);
+	g_free (path);
+	for (i = 0; i < 4; i++) {
+		self_check_write_file (root, files[i]);
+	}
+	self_check_set_mtime (root, "", 1000);
+	self_check_set_mtime (root, "sub", 1000);
+	self_check_set_mtime (root, ".hidden", 1000);
+
+	/* on-disk format */
+	roots[0] = root;
+	roots[1] = NULL;
+	index_builder_init (&builder);
+	index_builder_walk (&builder, roots, NULL);
+	data = index_builder_write (&builder);
+	index_builder_clear (&builder);
+
+	path = g_build_filename (root, "index", NULL);
+	g_file_set_contents (path, (const char *) data->data, data->len, NULL);
+	mapped = g_mapped_file_new (path, FALSE, NULL);
+	memset (&reader, 0, sizeof (IndexReader));
+	EEL_CHECK_BOOLEAN_RESULT (index_reader_init (&reader, mapped), TRUE);
+	g_mapped_file_unref (mapped);
+
+	EEL_CHECK_INTEGER_RESULT (reader.header->n_dirs, 3);
+	EEL_CHECK_INTEGER_RESULT (reader.header->n_entries, 6);
+	EEL_CHECK_INTEGER_RESULT (reader.dirs[0].parent, NO_PARENT);
+	EEL_CHECK_INTEGER_RESULT (reader.dirs[0].end, 3);
+	EEL_CHECK_INTEGER_RESULT (reader.dirs[0].mtime, 1000 * G_USEC_PER_SEC);
+	EEL_CHECK_STRING_RESULT (g_strdup (index_reader_get_string (&reader, reader.dirs[0].path)), root);
+	EEL_CHECK_BOOLEAN_RESULT (index_reader_has_roots (&reader, roots), TRUE);
+	roots[0] = (char *) "/nonexistent";
+	EEL_CHECK_BOOLEAN_RESULT (index_reader_has_roots (&reader, roots), FALSE);
+	roots[0] = root;
+
+	/* a truncated index is rejected */
+	g_file_set_contents (path, (const char *) data->data, data->len / 2, NULL);
+	mapped = g_mapped_file_new (path, FALSE, NULL);
+	{
+		IndexReader truncated;
+
+		memset (&truncated, 0, sizeof (IndexReader));
+		EEL_CHECK_BOOLEAN_RESULT (index_reader_init (&truncated, mapped), FALSE);
+	}
+	g_mapped_file_unref (mapped);
+	g_unlink (path);
+	g_free (path);
+	g_byte_array_free (data, TRUE);
+
+	/* trigram lookup */
+	trigram = index_reader_lookup_trigram (&reader, make_trigram ("alp"));
+	EEL_CHECK_BOOLEAN_RESULT (trigram != NULL, TRUE);
+	if (trigram != NULL) {
+		EEL_CHECK_INTEGER_RESULT (trigram->count, 3);
+	}
+	EEL_CHECK_BOOLEAN_RESULT (index_reader_lookup_trigram (&reader, make_trigram ("zzz")) == NULL, TRUE);
+
+	/* searching the index, the added overlay and removal filtering */
+	uri = g_filename_to_uri (root, NULL, NULL);
+	query = nautilus_query_new ();
+	nautilus_query_set_text (query, "alpha");
+	nautilus_query_set_location (query, uri);
+	g_free (uri);
+
+	search = nautilus_filename_index_search_new (query);
+	index_reader_clear (&search->reader);
+	index_reader_copy (&search->reader, &reader);
+	g_hash_table_remove_all (search->removed);
+	g_list_free_full (search->added, g_free);
+	search->added = NULL;
+
+	EEL_CHECK_INTEGER_RESULT (self_check_count_hits (search), 2);
+
+	search->show_hidden = TRUE;
+	EEL_CHECK_INTEGER_RESULT (self_check_count_hits (search), 3);
+	search->show_hidden = FALSE;
+
+	search->added = g_list_prepend (search->added,
+					g_build_filename (root, "new-alpha", NULL));
+	EEL_CHECK_INTEGER_RESULT (self_check_count_hits (search), 3);
+
+	g_hash_table_add (search->removed, g_build_filename (root, "sub", NULL));
+	EEL_CHECK_INTEGER_RESULT (self_check_count_hits (search), 2);
+	g_hash_table_add (search->removed, g_build_filename (root, "alpha.txt", NULL));
+	EEL_CHECK_INTEGER_RESULT (self_check_count_hits (search), 1);
+
+	nautilus_filename_index_search_free (search);
+	g_object_unref (query);
+
+	/* folders left out of a crawl, writing the index touched the root */
+	folders = g_new0 (NautilusFilenameIndexFolders, 1);
+	index_reader_copy (&folders->reader, &reader);
+	folders->location = g_strdup (root);
+	self_check_set_mtime (root, "", 1000);
+
+	EEL_CHECK_INTEGER_RESULT (self_check_get_unchanged (folders, root, FALSE), 1);
+	EEL_CHECK_INTEGER_RESULT (self_check_get_unchanged (folders, root, TRUE), 2);
+	path = g_build_filename (root, "sub", NULL);
+	EEL_CHECK_INTEGER_RESULT (self_check_get_unchanged (folders, path, FALSE), 0);
+	self_check_set_mtime (root, "sub", 2000);
+	EEL_CHECK_INTEGER_RESULT (self_check_get_unchanged (folders, path, FALSE), -1);
+	g_free (path);
+	EEL_CHECK_INTEGER_RESULT (self_check_get_unchanged (folders, "/nonexistent", FALSE), -1);
+
+	/* a folder changed while the index was built is never trusted */
+	self_check_set_mtime (root, "", g_get_real_time () / G_USEC_PER_SEC);
+	index_builder_init (&builder);
+	index_builder_walk (&builder, roots, NULL);
+	EEL_CHECK_INTEGER_RESULT (g_array_index (builder.dirs, IndexDir, 0).mtime, 0);
+	index_builder_clear (&builder);
+
+	nautilus_filename_index_folders_free (folders);
+	index_reader_clear (&reader);
+
+	/* backing off after failed builds */
+	EEL_CHECK_INTEGER_RESULT (get_build_retry_delay (1), BUILD_RETRY_MIN);
+	EEL_CHECK_INTEGER_RESULT (get_build_retry_delay (2), 2 * BUILD_RETRY_MIN);
+	EEL_CHECK_INTEGER_RESULT (get_build_retry_delay (100), BUILD_RETRY_MAX);
+
+	/* The folders come last */
+	for (i = 0; i < G_N_ELEMENTS (files); i++) {
+		path = g_build_filename (root, files[i], NULL);
+		g_remove (path);
+		g_free (path);
+	}
+	g_rmdir (root);
+	g_free (root);
+}
+
+#endif /* !NAUTILUS_OMIT_SELF_CHECK */
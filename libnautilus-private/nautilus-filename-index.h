@@ -0,0 +1,79 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+ *
+ * nautilus-filename-index.h: on-disk index of file names for searching
+ * without Tracker.
+ *
+ * Nautilus is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * Nautilus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; see the file COPYING.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef NAUTILUS_FILENAME_INDEX_H
+#define NAUTILUS_FILENAME_INDEX_H
+
+#include <gio/gio.h>
+#include <libnautilus-private/nautilus-query.h>
+
+/* The index keeps the names of all files below the folders listed in
+ * the "filename-index-roots" preference in a file in the user's cache
+ * directory, with a table from each trigram of the normalized names to
+ * the files containing it. It is read through a memory mapping and
+ * rebuilt in a thread when it is missing, out of date or the roots
+ * change. Files added, removed or moved since it was built are kept in
+ * memory from the directory change notifications.
+ */
+typedef struct NautilusFilenameIndexSearch NautilusFilenameIndexSearch;
+typedef struct NautilusFilenameIndexFolders NautilusFilenameIndexFolders;
+
+/* Called from the search thread with a list of NautilusSearchHits
+ * that it takes ownership of.
+ */
+typedef void (* NautilusFilenameIndexHitsFunc) (GList    *hits,
+						gpointer  user_data);
+
+/* Loads the index, and builds it in the background if needed. */
+void                         nautilus_filename_index_ensure           (void);
+gboolean                     nautilus_filename_index_is_ready         (void);
+
+/* Searching. The search is set up in the main thread and can then be
+ * run from any thread.
+ */
+NautilusFilenameIndexSearch *nautilus_filename_index_search_new       (NautilusQuery                 *query);
+void                         nautilus_filename_index_search_run       (NautilusFilenameIndexSearch   *search,
+								       GCancellable                  *cancellable,
+								       NautilusFilenameIndexHitsFunc  hits_func,
+								       gpointer                       user_data);
+void                         nautilus_filename_index_search_free      (NautilusFilenameIndexSearch   *search);
+
+/* The folders of the index below a query's location, for leaving out
+ * of a crawl the ones not modified since the index was built. Made in
+ * the main thread, NULL if there is no index, and then used from one
+ * thread at a time. For an unchanged folder the index still holds all
+ * of its files, its indexed subfolders are returned as GFiles since
+ * they need a look of their own.
+ */
+NautilusFilenameIndexFolders *nautilus_filename_index_folders_new     (NautilusQuery                 *query);
+gboolean                     nautilus_filename_index_folders_get_unchanged (NautilusFilenameIndexFolders  *folders,
+									    GFile                         *location,
+									    gboolean                       show_hidden,
+									    GCancellable                  *cancellable,
+									    GList                        **subfolders);
+void                         nautilus_filename_index_folders_free    (NautilusFilenameIndexFolders  *folders);
+
+/* Changes since the index was built, lists of GFiles and GFilePairs */
+void                         nautilus_filename_index_notify_added     (GList                         *files);
+void                         nautilus_filename_index_notify_removed   (GList                         *files);
+void                         nautilus_filename_index_notify_moved     (GList                         *file_pairs);
+
+#endif /* NAUTILUS_FILENAME_INDEX_H */
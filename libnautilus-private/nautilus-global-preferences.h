@@ -130,6 +130,13 @@ typedef enum
 #define NAUTILUS_PREFERENCES_SHOW_DIRECTORY_ITEM_COUNTS "show-directory-item-counts"
 #define NAUTILUS_PREFERENCES_SHOW_FILE_THUMBNAILS	"show-image-thumbnails"
 #define NAUTILUS_PREFERENCES_FILE_THUMBNAIL_LIMIT	"thumbnail-limit"
+#define NAUTILUS_PREFERENCES_IMAGE_CACHE_LIMIT		"image-cache-limit"
+
+/* Soft deadline, in milliseconds, for the extension calls of one operation */
+#define NAUTILUS_PREFERENCES_EXTENSION_CALL_DEADLINE	"extension-call-deadline"
+
+/* Folders whose file names are indexed for searching */
+#define NAUTILUS_PREFERENCES_FILENAME_INDEX_ROOTS	"filename-index-roots"
 
 typedef enum
 {
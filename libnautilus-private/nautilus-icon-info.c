@@ -21,6 +21,7 @@
 #include "nautilus-icon-info.h"
 #include "nautilus-icon-names.h"
 #include "nautilus-default-file-icon.h"
+#include "nautilus-pixbuf-budget.h"
 #include <gtk/gtk.h>
 #include <gio/gio.h>
 
@@ -35,6 +36,10 @@ struct _NautilusIconInfo
         char *icon_name;
 
 	gint  orig_scale;
+
+	NautilusPixbufBudgetEntry budget_entry;
+	/* Dropped from the pixbuf budget, waiting to be removed from the caches */
+	gboolean evicted;
 };
 
 struct _NautilusIconInfoClass
@@ -43,6 +48,7 @@ struct _NautilusIconInfoClass
 };
 
 static void schedule_reap_cache (void);
+static void schedule_purge_evicted (void);
 
 G_DEFINE_TYPE (NautilusIconInfo,
 	       nautilus_icon_info,
@@ -85,6 +91,8 @@ nautilus_icon_info_finalize (GObject *object)
 
         icon = NAUTILUS_ICON_INFO (object);
 
+	nautilus_pixbuf_budget_remove (&icon->budget_entry);
+
 	if (!icon->sole_owner && icon->pixbuf) {
 		g_object_remove_toggle_ref (G_OBJECT (icon->pixbuf),
 					    pixbuf_toggle_notify,
@@ -158,16 +166,32 @@ nautilus_icon_info_new_for_icon_info (GtkIconInfo *icon_info,
 typedef struct  {
 	GIcon *icon;
 	int size;
+	int scale;
 } LoadableIconKey;
 
 typedef struct {
 	char *filename;
 	int size;
+	int scale;
 } ThemedIconKey;
 
+typedef struct {
+	char **names;
+	int size;
+	int scale;
+} NamedIconKey;
+
 static GHashTable *loadable_icon_cache = NULL;
 static GHashTable *themed_icon_cache = NULL;
+/* Maps the names of a themed icon to the icon info the theme resolved
+ * them to, so repeated lookups skip the theme entirely. The infos are
+ * shared with themed_icon_cache, which is keyed by the resolved file.
+ */
+static GHashTable *named_icon_cache = NULL;
+/* Loadable icons being loaded in a thread, with the tasks waiting on them */
+static GHashTable *pending_loadable_icons = NULL;
 static guint reap_cache_timeout = 0;
+static guint purge_evicted_id = 0;
 
 #define MICROSEC_PER_SEC ((guint64)1000000L)
 
@@ -214,6 +238,12 @@ reap_cache (gpointer data)
 					     reap_old_icon,
 					     &reapable_icons_left);
 	}
+
+	if (named_icon_cache) {
+		g_hash_table_foreach_remove (named_icon_cache,
+					     reap_old_icon,
+					     &reapable_icons_left);
+	}
 	
 	if (reapable_icons_left) {
 		return TRUE;
@@ -223,6 +253,73 @@ reap_cache (gpointer data)
 	}
 }
 
+static gboolean
+is_evicted_icon (gpointer  key,
+		 gpointer  value,
+		 gpointer  user_info)
+{
+	NautilusIconInfo *icon = value;
+
+	return icon->evicted;
+}
+
+static gboolean
+purge_evicted (gpointer data)
+{
+	purge_evicted_id = 0;
+
+	if (loadable_icon_cache) {
+		g_hash_table_foreach_remove (loadable_icon_cache, is_evicted_icon, NULL);
+	}
+
+	if (themed_icon_cache) {
+		g_hash_table_foreach_remove (themed_icon_cache, is_evicted_icon, NULL);
+	}
+
+	if (named_icon_cache) {
+		g_hash_table_foreach_remove (named_icon_cache, is_evicted_icon, NULL);
+	}
+
+	return FALSE;
+}
+
+static void
+schedule_purge_evicted (void)
+{
+	if (purge_evicted_id == 0) {
+		purge_evicted_id = g_idle_add (purge_evicted, NULL);
+	}
+}
+
+/* Called by the pixbuf budget. Evictions come in bursts, so the icon
+ * is only marked here and all marked icons leave the caches at once.
+ */
+static void
+icon_info_evict (gpointer owner)
+{
+	NautilusIconInfo *icon = owner;
+
+	icon->evicted = TRUE;
+	schedule_purge_evicted ();
+}
+
+static void
+icon_info_account (NautilusIconInfo *icon)
+{
+	if (icon->pixbuf != NULL && !nautilus_pixbuf_budget_is_accounted (&icon->budget_entry)) {
+		nautilus_pixbuf_budget_add (&icon->budget_entry, icon,
+					    nautilus_pixbuf_budget_get_pixbuf_size (icon->pixbuf),
+					    icon_info_evict);
+	}
+}
+
+static NautilusIconInfo *
+icon_info_cache_hit (NautilusIconInfo *icon)
+{
+	nautilus_pixbuf_budget_touch (&icon->budget_entry);
+	return g_object_ref (icon);
+}
+
 static void
 schedule_reap_cache (void)
 {
@@ -243,12 +340,16 @@ nautilus_icon_info_clear_caches (void)
 	if (themed_icon_cache) {
 		g_hash_table_remove_all (themed_icon_cache);
 	}
+
+	if (named_icon_cache) {
+		g_hash_table_remove_all (named_icon_cache);
+	}
 }
 
 static guint
 loadable_icon_key_hash (LoadableIconKey *key)
 {
-	return g_icon_hash (key->icon) ^ key->size;
+	return g_icon_hash (key->icon) ^ key->size ^ (key->scale << 16);
 }
 
 static gboolean
@@ -256,17 +357,19 @@ loadable_icon_key_equal (const LoadableIconKey *a,
 			 const LoadableIconKey *b)
 {
 	return a->size == b->size &&
+		a->scale == b->scale &&
 		g_icon_equal (a->icon, b->icon);
 }
 
 static LoadableIconKey *
-loadable_icon_key_new (GIcon *icon, int size)
+loadable_icon_key_new (GIcon *icon, int size, int scale)
 {
 	LoadableIconKey *key;
 
 	key = g_slice_new (LoadableIconKey);
 	key->icon = g_object_ref (icon);
 	key->size = size;
+	key->scale = scale;
 
 	return key;
 }
@@ -281,7 +384,7 @@ loadable_icon_key_free (LoadableIconKey *key)
 static guint
 themed_icon_key_hash (ThemedIconKey *key)
 {
-	return g_str_hash (key->filename) ^ key->size;
+	return g_str_hash (key->filename) ^ key->size ^ (key->scale << 16);
 }
 
 static gboolean
@@ -289,17 +392,19 @@ themed_icon_key_equal (const ThemedIconKey *a,
 		       const ThemedIconKey *b)
 {
 	return a->size == b->size &&
+		a->scale == b->scale &&
 		g_str_equal (a->filename, b->filename);
 }
 
 static ThemedIconKey *
-themed_icon_key_new (const char *filename, int size)
+themed_icon_key_new (const char *filename, int size, int scale)
 {
 	ThemedIconKey *key;
 
 	key = g_slice_new (ThemedIconKey);
 	key->filename = g_strdup (filename);
 	key->size = size;
+	key->scale = scale;
 
 	return key;
 }
@@ -311,6 +416,96 @@ themed_icon_key_free (ThemedIconKey *key)
 	g_slice_free (ThemedIconKey, key);
 }
 
+static guint
+named_icon_key_hash (NamedIconKey *key)
+{
+	guint hash;
+	int i;
+
+	hash = key->size ^ (key->scale << 16);
+	for (i = 0; key->names[i] != NULL; i++) {
+		hash = hash * 31 + g_str_hash (key->names[i]);
+	}
+
+	return hash;
+}
+
+static gboolean
+named_icon_key_equal (const NamedIconKey *a,
+		      const NamedIconKey *b)
+{
+	int i;
+
+	if (a->size != b->size || a->scale != b->scale) {
+		return FALSE;
+	}
+
+	for (i = 0; a->names[i] != NULL && b->names[i] != NULL; i++) {
+		if (strcmp (a->names[i], b->names[i]) != 0) {
+			return FALSE;
+		}
+	}
+
+	return a->names[i] == NULL && b->names[i] == NULL;
+}
+
+static NamedIconKey *
+named_icon_key_new (const char * const *names, int size, int scale)
+{
+	NamedIconKey *key;
+
+	key = g_slice_new (NamedIconKey);
+	key->names = g_strdupv ((char **) names);
+	key->size = size;
+	key->scale = scale;
+
+	return key;
+}
+
+static void
+named_icon_key_free (NamedIconKey *key)
+{
+	g_strfreev (key->names);
+	g_slice_free (NamedIconKey, key);
+}
+
+static void
+ensure_loadable_icon_cache (void)
+{
+	if (loadable_icon_cache == NULL) {
+		loadable_icon_cache =
+			g_hash_table_new_full ((GHashFunc)loadable_icon_key_hash,
+					       (GEqualFunc)loadable_icon_key_equal,
+					       (GDestroyNotify) loadable_icon_key_free,
+					       (GDestroyNotify) g_object_unref);
+	}
+}
+
+static GdkPixbuf *
+load_loadable_icon (GLoadableIcon *icon,
+		    int            size,
+		    int            scale,
+		    GCancellable  *cancellable)
+{
+	GInputStream *stream;
+	GdkPixbuf *pixbuf;
+
+	pixbuf = NULL;
+	stream = g_loadable_icon_load (icon,
+				       size * scale,
+				       NULL, cancellable, NULL);
+	if (stream) {
+		pixbuf = gdk_pixbuf_new_from_stream_at_scale (stream,
+							      size * scale, size * scale,
+							      TRUE,
+							      cancellable, NULL);
+		g_input_stream_close (stream, NULL, NULL);
+		g_object_unref (stream);
+	}
+
+	return pixbuf;
+}
+
 NautilusIconInfo *
 nautilus_icon_info_lookup (GIcon *icon,
 			   int size,
@@ -322,47 +517,34 @@ nautilus_icon_info_lookup (GIcon *icon,
 	if (G_IS_LOADABLE_ICON (icon)) {
 		LoadableIconKey lookup_key;
 		LoadableIconKey *key;
-		GInputStream *stream;
 		
-		if (loadable_icon_cache == NULL) {
-			loadable_icon_cache =
-				g_hash_table_new_full ((GHashFunc)loadable_icon_key_hash,
-						       (GEqualFunc)loadable_icon_key_equal,
-						       (GDestroyNotify) loadable_icon_key_free,
-						       (GDestroyNotify) g_object_unref);
-		}
+		ensure_loadable_icon_cache ();
 		
 		lookup_key.icon = icon;
 		lookup_key.size = size;
+		lookup_key.scale = scale;
 
 		icon_info = g_hash_table_lookup (loadable_icon_cache, &lookup_key);
 		if (icon_info) {
-			return g_object_ref (icon_info);
+			return icon_info_cache_hit (icon_info);
 		}
 
-		pixbuf = NULL;
-		stream = g_loadable_icon_load (G_LOADABLE_ICON (icon),
-					       size * scale,
-					       NULL, NULL, NULL);
-		if (stream) {
-			pixbuf = gdk_pixbuf_new_from_stream_at_scale (stream,
-								      size * scale, size * scale,
-								      TRUE,
-								      NULL, NULL);
-			g_input_stream_close (stream, NULL, NULL);
-			g_object_unref (stream);
-		}
+		pixbuf = load_loadable_icon (G_LOADABLE_ICON (icon), size, scale, NULL);
 
 		icon_info = nautilus_icon_info_new_for_pixbuf (pixbuf, scale);
+		if (pixbuf != NULL) {
+			g_object_unref (pixbuf);
+		}
 
-		key = loadable_icon_key_new (icon, size);
+		key = loadable_icon_key_new (icon, size, scale);
 		g_hash_table_insert (loadable_icon_cache, key, icon_info);
+		icon_info_account (icon_info);
 
 		return g_object_ref (icon_info);
 	} else if (G_IS_THEMED_ICON (icon)) {
 		const char * const *names;
 		ThemedIconKey lookup_key;
-		ThemedIconKey *key;
+		NamedIconKey named_lookup_key;
 		GtkIconTheme *icon_theme;
 		GtkIconInfo *gtkicon_info;
 		const char *filename;
@@ -373,39 +555,62 @@ nautilus_icon_info_lookup (GIcon *icon,
 						       (GEqualFunc)themed_icon_key_equal,
 						       (GDestroyNotify) themed_icon_key_free,
 						       (GDestroyNotify) g_object_unref);
+			named_icon_cache =
+				g_hash_table_new_full ((GHashFunc)named_icon_key_hash,
+						       (GEqualFunc)named_icon_key_equal,
+						       (GDestroyNotify) named_icon_key_free,
+						       (GDestroyNotify) g_object_unref);
 		}
 		
 		names = g_themed_icon_get_names (G_THEMED_ICON (icon));
 
+		named_lookup_key.names = (char **) names;
+		named_lookup_key.size = size;
+		named_lookup_key.scale = scale;
+
+		icon_info = g_hash_table_lookup (named_icon_cache, &named_lookup_key);
+		if (icon_info) {
+			return icon_info_cache_hit (icon_info);
+		}
+
 		icon_theme = gtk_icon_theme_get_default ();
 		gtkicon_info = gtk_icon_theme_choose_icon_for_scale (icon_theme, (const char **)names,
 								     size, scale, 0);
 
-		if (gtkicon_info == NULL) {
-			return nautilus_icon_info_new_for_pixbuf (NULL, scale);
+		filename = NULL;
+		if (gtkicon_info != NULL) {
+			filename = gtk_icon_info_get_filename (gtkicon_info);
 		}
 
-		filename = gtk_icon_info_get_filename (gtkicon_info);
 		if (filename == NULL) {
-			g_object_unref (gtkicon_info);
-			return nautilus_icon_info_new_for_pixbuf (NULL, scale);
+			/* Remember the miss too, the theme won't change its
+			 * mind until it emits "changed".
+			 */
+			icon_info = nautilus_icon_info_new_for_pixbuf (NULL, scale);
+		} else {
+			lookup_key.filename = (char *)filename;
+			lookup_key.size = size;
+			lookup_key.scale = scale;
+
+			icon_info = g_hash_table_lookup (themed_icon_cache, &lookup_key);
+			if (icon_info) {
+				icon_info_cache_hit (icon_info);
+			} else {
+				icon_info = nautilus_icon_info_new_for_icon_info (gtkicon_info, scale);
+				g_hash_table_insert (themed_icon_cache,
+						     themed_icon_key_new (filename, size, scale),
+						     g_object_ref (icon_info));
+				icon_info_account (icon_info);
+			}
 		}
 
-		lookup_key.filename = (char *)filename;
-		lookup_key.size = size;
+		g_hash_table_insert (named_icon_cache,
+				     named_icon_key_new (names, size, scale),
+				     icon_info);
 
-		icon_info = g_hash_table_lookup (themed_icon_cache, &lookup_key);
-		if (icon_info) {
+		if (gtkicon_info != NULL) {
 			g_object_unref (gtkicon_info);
-			return g_object_ref (icon_info);
 		}
-		
-		icon_info = nautilus_icon_info_new_for_icon_info (gtkicon_info, scale);
-		
-		key = themed_icon_key_new (filename, size);
-		g_hash_table_insert (themed_icon_cache, key, icon_info);
-
-		g_object_unref (gtkicon_info);
 
 		return g_object_ref (icon_info);
 	} else {
@@ -434,6 +639,145 @@ nautilus_icon_info_lookup (GIcon *icon,
         }
 }
 
+/* Like nautilus_icon_info_lookup(), but returns NULL instead of doing
+ * I/O when @icon is a loadable icon that is not in the cache yet.
+ */
+NautilusIconInfo *
+nautilus_icon_info_lookup_cached (GIcon *icon,
+				  int size,
+				  int scale)
+{
+	LoadableIconKey lookup_key;
+	NautilusIconInfo *icon_info;
+
+	if (!G_IS_LOADABLE_ICON (icon)) {
+		return nautilus_icon_info_lookup (icon, size, scale);
+	}
+
+	ensure_loadable_icon_cache ();
+
+	lookup_key.icon = icon;
+	lookup_key.size = size;
+	lookup_key.scale = scale;
+
+	icon_info = g_hash_table_lookup (loadable_icon_cache, &lookup_key);
+	if (icon_info) {
+		return icon_info_cache_hit (icon_info);
+	}
+
+	return NULL;
+}
+
+static void
+load_loadable_icon_thread (GTask        *task,
+			   gpointer      source_object,
+			   gpointer      task_data,
+			   GCancellable *cancellable)
+{
+	LoadableIconKey *key = task_data;
+
+	g_task_return_pointer (task,
+			       load_loadable_icon (G_LOADABLE_ICON (key->icon),
+						   key->size, key->scale,
+						   cancellable),
+			       g_object_unref);
+}
+
+static void
+loadable_icon_loaded (GObject      *source_object,
+		      GAsyncResult *res,
+		      gpointer      user_data)
+{
+	LoadableIconKey *key = user_data;
+	NautilusIconInfo *icon_info;
+	GdkPixbuf *pixbuf;
+	GList *waiting, *l;
+
+	pixbuf = g_task_propagate_pointer (G_TASK (res), NULL);
+
+	icon_info = nautilus_icon_info_new_for_pixbuf (pixbuf, key->scale);
+	if (pixbuf != NULL) {
+		g_object_unref (pixbuf);
+	}
+
+	ensure_loadable_icon_cache ();
+	g_hash_table_replace (loadable_icon_cache,
+			      loadable_icon_key_new (key->icon, key->size, key->scale),
+			      icon_info);
+	icon_info_account (icon_info);
+
+	waiting = g_hash_table_lookup (pending_loadable_icons, key);
+	g_hash_table_steal (pending_loadable_icons, key);
+
+	for (l = waiting; l != NULL; l = l->next) {
+		g_task_return_pointer (l->data, g_object_ref (icon_info), g_object_unref);
+		g_object_unref (l->data);
+	}
+
+	g_list_free (waiting);
+	loadable_icon_key_free (key);
+}
+
+/* Looks up an icon without blocking on I/O. Loadable icons that are
+ * not cached yet are loaded in a thread; requests for an icon that is
+ * already being loaded share the load.
+ */
+void
+nautilus_icon_info_lookup_async (GIcon               *icon,
+				 int                  size,
+				 int                  scale,
+				 GCancellable        *cancellable,
+				 GAsyncReadyCallback  callback,
+				 gpointer             user_data)
+{
+	NautilusIconInfo *icon_info;
+	LoadableIconKey lookup_key;
+	LoadableIconKey *key;
+	GTask *task, *load_task;
+	GList *waiting;
+
+	task = g_task_new (NULL, cancellable, callback, user_data);
+
+	icon_info = nautilus_icon_info_lookup_cached (icon, size, scale);
+	if (icon_info != NULL) {
+		g_task_return_pointer (task, icon_info, g_object_unref);
+		g_object_unref (task);
+		return;
+	}
+
+	if (pending_loadable_icons == NULL) {
+		pending_loadable_icons =
+			g_hash_table_new ((GHashFunc)loadable_icon_key_hash,
+					  (GEqualFunc)loadable_icon_key_equal);
+	}
+
+	lookup_key.icon = icon;
+	lookup_key.size = size;
+	lookup_key.scale = scale;
+
+	if (g_hash_table_lookup_extended (pending_loadable_icons, &lookup_key,
+					  (gpointer *) &key, (gpointer *) &waiting)) {
+		g_hash_table_insert (pending_loadable_icons, key,
+				     g_list_prepend (waiting, task));
+		return;
+	}
+
+	key = loadable_icon_key_new (icon, size, scale);
+	g_hash_table_insert (pending_loadable_icons, key, g_list_prepend (NULL, task));
+
+	load_task = g_task_new (NULL, NULL, loadable_icon_loaded, key);
+	g_task_set_task_data (load_task, key, NULL);
+	g_task_run_in_thread (load_task, load_loadable_icon_thread);
+	g_object_unref (load_task);
+}
+
+NautilusIconInfo *
+nautilus_icon_info_lookup_finish (GAsyncResult  *result,
+				  GError       **error)
+{
+	return g_task_propagate_pointer (G_TASK (result), error);
+}
+
 NautilusIconInfo *
 nautilus_icon_info_lookup_from_name (const char *name,
 				     int size,
@@ -58,6 +58,17 @@ NautilusIconInfo *    nautilus_icon_info_new_for_pixbuf               (GdkPixbuf
 NautilusIconInfo *    nautilus_icon_info_lookup                       (GIcon             *icon,
 								       int                size,
 								       int                scale);
+NautilusIconInfo *    nautilus_icon_info_lookup_cached                (GIcon             *icon,
+								       int                size,
+								       int                scale);
+void                  nautilus_icon_info_lookup_async                 (GIcon             *icon,
+								       int                size,
+								       int                scale,
+								       GCancellable      *cancellable,
+								       GAsyncReadyCallback callback,
+								       gpointer           user_data);
+NautilusIconInfo *    nautilus_icon_info_lookup_finish                (GAsyncResult      *result,
+								       GError           **error);
 NautilusIconInfo *    nautilus_icon_info_lookup_from_name             (const char        *name,
 								       int                size,
 								       int                scale);
@@ -0,0 +1,910 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+ *
+ * nautilus-image-header.c: image size and camera details read from
+ * the headers of image files
+ *
+ * Nautilus is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * Nautilus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; see the file COPYING.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <config.h>
+#include "nautilus-image-header.h"
+
+#include "nautilus-lib-self-check-functions.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/* Bytes read from the start of a file. Most headers fit, the rest is
+ * fetched block by block from where the header points to.
+ */
+#define HEADER_READ_SIZE 16384
+/* Reads allowed past the start, and the largest one */
+#define MAX_EXTRA_READS 8
+#define MAX_EXTRA_READ_SIZE 65536
+/* Sanity limits for TIFF directories */
+#define MAX_IFD_ENTRIES 1024
+#define MAX_SUB_IFDS 4
+
+/* EXIF and TIFF tags */
+#define TAG_IMAGE_WIDTH 0x0100
+#define TAG_IMAGE_LENGTH 0x0101
+#define TAG_MAKE 0x010f
+#define TAG_MODEL 0x0110
+#define TAG_ORIENTATION 0x0112
+#define TAG_DATE_TIME 0x0132
+#define TAG_SUB_IFDS 0x014a
+#define TAG_EXIF_IFD 0x8769
+#define TAG_DATE_TIME_ORIGINAL 0x9003
+#define TAG_DATE_TIME_DIGITIZED 0x9004
+#define TAG_PIXEL_X_DIMENSION 0xa002
+#define TAG_PIXEL_Y_DIMENSION 0xa003
+
+#define TIFF_TYPE_ASCII 2
+#define TIFF_TYPE_SHORT 3
+#define TIFF_TYPE_LONG 4
+
+/* The file being parsed: its start in memory, and for files the stream
+ * to read other blocks from.
+ */
+typedef struct {
+	const guchar *data;
+	gsize length;
+	GInputStream *stream;
+	GCancellable *cancellable;
+	GSList *blocks;
+	int extra_reads;
+} Source;
+
+typedef struct {
+	Source *source;
+	goffset base;
+	gboolean big_endian;
+} Tiff;
+
+typedef struct {
+	guint32 width;
+	guint32 height;
+	guint32 exif_width;
+	guint32 exif_height;
+	guint32 orientation;
+	char *make;
+	char *model;
+	char *date_time;
+	char *date_time_original;
+	char *date_time_digitized;
+} TiffTags;
+
+static const guchar *
+source_get (Source *source,
+	    goffset offset,
+	    gsize length)
+{
+	guchar *block;
+	gsize bytes_read;
+
+	if (offset < 0 || length == 0) {
+		return NULL;
+	}
+
+	if ((guint64) offset + length <= source->length) {
+		return source->data + offset;
+	}
+
+	if (source->stream == NULL ||
+	    !G_IS_SEEKABLE (source->stream) ||
+	    source->extra_reads >= MAX_EXTRA_READS ||
+	    length > MAX_EXTRA_READ_SIZE) {
+		return NULL;
+	}
+	source->extra_reads++;
+
+	if (!g_seekable_seek (G_SEEKABLE (source->stream), offset, G_SEEK_SET,
+			      source->cancellable, NULL)) {
+		return NULL;
+	}
+
+	block = g_malloc (length);
+	if (!g_input_stream_read_all (source->stream, block, length, &bytes_read,
+				      source->cancellable, NULL) ||
+	    bytes_read != length) {
+		g_free (block);
+		return NULL;
+	}
+	source->blocks = g_slist_prepend (source->blocks, block);
+
+	return block;
+}
+
+static guint16
+get_be16 (const guchar *p)
+{
+	return (p[0] << 8) | p[1];
+}
+
+static guint16
+get_le16 (const guchar *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static guint32
+get_be32 (const guchar *p)
+{
+	return ((guint32) p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static guint32
+get_le32 (const guchar *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((guint32) p[3] << 24);
+}
+
+static guint32
+get_le24 (const guchar *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16);
+}
+
+static guint16
+tiff_get16 (Tiff *tiff, const guchar *p)
+{
+	return tiff->big_endian ? get_be16 (p) : get_le16 (p);
+}
+
+static guint32
+tiff_get32 (Tiff *tiff, const guchar *p)
+{
+	return tiff->big_endian ? get_be32 (p) : get_le32 (p);
+}
+
+/* The single SHORT or LONG value of an entry */
+static guint32
+tiff_entry_get_uint (Tiff *tiff, const guchar *entry)
+{
+	switch (tiff_get16 (tiff, entry + 2)) {
+	case TIFF_TYPE_SHORT:
+		return tiff_get16 (tiff, entry + 8);
+	case TIFF_TYPE_LONG:
+		return tiff_get32 (tiff, entry + 8);
+	default:
+		return 0;
+	}
+}
+
+static char *
+tiff_entry_get_string (Tiff *tiff, const guchar *entry)
+{
+	const guchar *p;
+	guint32 count;
+	char *string;
+
+	if (tiff_get16 (tiff, entry + 2) != TIFF_TYPE_ASCII) {
+		return NULL;
+	}
+
+	count = tiff_get32 (tiff, entry + 4);
+	if (count == 0 || count > 1024) {
+		return NULL;
+	}
+
+	if (count <= 4) {
+		p = entry + 8;
+	} else {
+		p = source_get (tiff->source, tiff->base + tiff_get32 (tiff, entry + 8), count);
+		if (p == NULL) {
+			return NULL;
+		}
+	}
+
+	string = g_strndup ((const char *) p, count);
+	g_strstrip (string);
+	if (string[0] == '\0' || !g_utf8_validate (string, -1, NULL)) {
+		g_free (string);
+		return NULL;
+	}
+
+	return string;
+}
+
+static void
+tiff_tags_clear (TiffTags *tags)
+{
+	g_free (tags->make);
+	g_free (tags->model);
+	g_free (tags->date_time);
+	g_free (tags->date_time_original);
+	g_free (tags->date_time_digitized);
+}
+
+static void tiff_read_ifd (Tiff *tiff, guint32 offset, TiffTags *tags, int depth);
+
+/* Raw files keep a small preview in the first directory and the
+ * picture itself in a sub directory, so take the largest.
+ */
+static void
+tiff_read_sub_ifds (Tiff *tiff,
+		    const guchar *entry,
+		    TiffTags *tags,
+		    int depth)
+{
+	TiffTags sub_tags;
+	const guchar *offsets;
+	guint32 count, i;
+
+	if (tiff_get16 (tiff, entry + 2) != TIFF_TYPE_LONG) {
+		return;
+	}
+
+	count = MIN (tiff_get32 (tiff, entry + 4), MAX_SUB_IFDS);
+	if (count == 1) {
+		offsets = entry + 8;
+	} else {
+		offsets = source_get (tiff->source,
+				      tiff->base + tiff_get32 (tiff, entry + 8),
+				      count * 4);
+		if (offsets == NULL) {
+			return;
+		}
+	}
+
+	for (i = 0; i < count; i++) {
+		memset (&sub_tags, 0, sizeof (sub_tags));
+		tiff_read_ifd (tiff, tiff_get32 (tiff, offsets + i * 4), &sub_tags, depth + 1);
+		if ((guint64) sub_tags.width * sub_tags.height >
+		    (guint64) tags->width * tags->height) {
+			tags->width = sub_tags.width;
+			tags->height = sub_tags.height;
+		}
+		tiff_tags_clear (&sub_tags);
+	}
+}
+
+static void
+tiff_read_ifd (Tiff *tiff,
+	       guint32 offset,
+	       TiffTags *tags,
+	       int depth)
+{
+	const guchar *p, *entry;
+	guint16 n_entries, i;
+
+	if (depth > 2 || offset < 8) {
+		return;
+	}
+
+	p = source_get (tiff->source, tiff->base + offset, 2);
+	if (p == NULL) {
+		return;
+	}
+
+	n_entries = tiff_get16 (tiff, p);
+	if (n_entries == 0 || n_entries > MAX_IFD_ENTRIES) {
+		return;
+	}
+
+	p = source_get (tiff->source, tiff->base + offset + 2, n_entries * 12);
+	if (p == NULL) {
+		return;
+	}
+
+	for (i = 0; i < n_entries; i++) {
+		entry = p + i * 12;
+
+		switch (tiff_get16 (tiff, entry)) {
+		case TAG_IMAGE_WIDTH:
+			tags->width = tiff_entry_get_uint (tiff, entry);
+			break;
+		case TAG_IMAGE_LENGTH:
+			tags->height = tiff_entry_get_uint (tiff, entry);
+			break;
+		case TAG_PIXEL_X_DIMENSION:
+			tags->exif_width = tiff_entry_get_uint (tiff, entry);
+			break;
+		case TAG_PIXEL_Y_DIMENSION:
+			tags->exif_height = tiff_entry_get_uint (tiff, entry);
+			break;
+		case TAG_ORIENTATION:
+			tags->orientation = tiff_entry_get_uint (tiff, entry);
+			break;
+		case TAG_MAKE:
+			if (tags->make == NULL) {
+				tags->make = tiff_entry_get_string (tiff, entry);
+			}
+			break;
+		case TAG_MODEL:
+			if (tags->model == NULL) {
+				tags->model = tiff_entry_get_string (tiff, entry);
+			}
+			break;
+		case TAG_DATE_TIME:
+			if (tags->date_time == NULL) {
+				tags->date_time = tiff_entry_get_string (tiff, entry);
+			}
+			break;
+		case TAG_DATE_TIME_ORIGINAL:
+			if (tags->date_time_original == NULL) {
+				tags->date_time_original = tiff_entry_get_string (tiff, entry);
+			}
+			break;
+		case TAG_DATE_TIME_DIGITIZED:
+			if (tags->date_time_digitized == NULL) {
+				tags->date_time_digitized = tiff_entry_get_string (tiff, entry);
+			}
+			break;
+		case TAG_EXIF_IFD:
+			tiff_read_ifd (tiff, tiff_entry_get_uint (tiff, entry), tags, depth + 1);
+			break;
+		case TAG_SUB_IFDS:
+			tiff_read_sub_ifds (tiff, entry, tags, depth);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+/* EXIF dates are "YYYY:MM:DD HH:MM:SS" in the camera's local time */
+static time_t
+parse_exif_date (const char *date)
+{
+	GDateTime *date_time;
+	int year, month, day, hour, minute, second;
+	time_t result;
+
+	if (date == NULL ||
+	    sscanf (date, "%4d:%2d:%2d %2d:%2d:%2d",
+		    &year, &month, &day, &hour, &minute, &second) != 6) {
+		return 0;
+	}
+
+	date_time = g_date_time_new_local (year, month, day, hour, minute, second);
+	if (date_time == NULL) {
+		return 0;
+	}
+
+	result = g_date_time_to_unix (date_time);
+	g_date_time_unref (date_time);
+
+	return result;
+}
+
+/* Reads a TIFF structure, either a TIFF file or the EXIF block of
+ * another format, at @base. Returns FALSE if it is not one.
+ */
+static gboolean
+read_tiff (Source *source,
+	   goffset base,
+	   TiffTags *tags)
+{
+	Tiff tiff;
+	const guchar *p;
+
+	p = source_get (source, base, 8);
+	if (p == NULL) {
+		return FALSE;
+	}
+
+	if (memcmp (p, "II*\0", 4) == 0) {
+		tiff.big_endian = FALSE;
+	} else if (memcmp (p, "MM\0*", 4) == 0) {
+		tiff.big_endian = TRUE;
+	} else {
+		return FALSE;
+	}
+
+	tiff.source = source;
+	tiff.base = base;
+	tiff_read_ifd (&tiff, tiff_get32 (&tiff, p + 4), tags, 0);
+
+	return TRUE;
+}
+
+static void
+header_take_tiff_tags (NautilusImageHeader *header,
+		       TiffTags *tags)
+{
+	header->camera_make = tags->make;
+	header->camera_model = tags->model;
+	tags->make = NULL;
+	tags->model = NULL;
+
+	header->date_taken = parse_exif_date (tags->date_time_original);
+	if (header->date_taken == 0) {
+		header->date_taken = parse_exif_date (tags->date_time_digitized);
+	}
+	if (header->date_taken == 0) {
+		header->date_taken = parse_exif_date (tags->date_time);
+	}
+}
+
+static gboolean
+parse_png (Source *source,
+	   NautilusImageHeader *header)
+{
+	const guchar *p;
+
+	p = source_get (source, 0, 24);
+	if (p == NULL ||
+	    memcmp (p, "\x89PNG\r\n\x1a\n", 8) != 0) {
+		return FALSE;
+	}
+
+	header->format = "PNG";
+	if (memcmp (p + 12, "IHDR", 4) == 0) {
+		header->width = get_be32 (p + 16);
+		header->height = get_be32 (p + 20);
+	}
+
+	return TRUE;
+}
+
+static gboolean
+parse_gif (Source *source,
+	   NautilusImageHeader *header)
+{
+	const guchar *p;
+
+	p = source_get (source, 0, 10);
+	if (p == NULL ||
+	    (memcmp (p, "GIF87a", 6) != 0 && memcmp (p, "GIF89a", 6) != 0)) {
+		return FALSE;
+	}
+
+	header->format = "GIF";
+	header->width = get_le16 (p + 6);
+	header->height = get_le16 (p + 8);
+
+	return TRUE;
+}
+
+static gboolean
+is_jpeg_sof (guchar marker)
+{
+	/* Not DHT, JPG and DAC, which share the range */
+	return marker >= 0xc0 && marker <= 0xcf &&
+		marker != 0xc4 && marker != 0xc8 && marker != 0xcc;
+}
+
+static gboolean
+parse_jpeg (Source *source,
+	    NautilusImageHeader *header,
+	    TiffTags *tags)
+{
+	const guchar *p;
+	goffset position;
+	guint16 length;
+	guchar marker;
+
+	p = source_get (source, 0, 2);
+	if (p == NULL || p[0] != 0xff || p[1] != 0xd8) {
+		return FALSE;
+	}
+
+	header->format = "JPEG";
+
+	/* Walk the segments up to the frame header, which has the size */
+	position = 2;
+	while ((p = source_get (source, position, 4)) != NULL) {
+		if (p[0] != 0xff) {
+			break;
+		}
+
+		marker = p[1];
+		if (marker == 0xff) {
+			/* Fill byte */
+			position++;
+			continue;
+		}
+		if (marker == 0x01 || (marker >= 0xd0 && marker <= 0xd8)) {
+			/* Markers without a segment */
+			position += 2;
+			continue;
+		}
+		if (marker == 0xd9 || marker == 0xda) {
+			/* End of image, or the image data starts */
+			break;
+		}
+
+		length = get_be16 (p + 2);
+		if (length < 2) {
+			break;
+		}
+
+		if (is_jpeg_sof (marker)) {
+			p = source_get (source, position + 4, 5);
+			if (p != NULL) {
+				header->height = get_be16 (p + 1);
+				header->width = get_be16 (p + 3);
+			}
+			break;
+		}
+
+		if (marker == 0xe1 && length >= 16) {
+			p = source_get (source, position + 4, 6);
+			if (p != NULL && memcmp (p, "Exif\0\0", 6) == 0) {
+				read_tiff (source, position + 10, tags);
+			}
+		}
+
+		position += 2 + length;
+	}
+
+	return TRUE;
+}
+
+static gboolean
+parse_webp (Source *source,
+	    NautilusImageHeader *header,
+	    TiffTags *tags)
+{
+	const guchar *p;
+	goffset position, end;
+	guint32 chunk_size;
+	gboolean has_exif;
+
+	p = source_get (source, 0, 12);
+	if (p == NULL ||
+	    memcmp (p, "RIFF", 4) != 0 || memcmp (p + 8, "WEBP", 4) != 0) {
+		return FALSE;
+	}
+
+	header->format = "WebP";
+	end = 8 + (goffset) get_le32 (p + 4);
+	has_exif = FALSE;
+
+	position = 12;
+	while (position + 8 <= end &&
+	       (p = source_get (source, position, 8)) != NULL) {
+		chunk_size = get_le32 (p + 4);
+
+		if (memcmp (p, "VP8X", 4) == 0) {
+			p = source_get (source, position + 8, 10);
+			if (p == NULL) {
+				break;
+			}
+			has_exif = (p[0] & 0x08) != 0;
+			header->width = get_le24 (p + 4) + 1;
+			header->height = get_le24 (p + 7) + 1;
+		} else if (memcmp (p, "VP8 ", 4) == 0) {
+			/* Frame tag and start code come first */
+			p = source_get (source, position + 8, 10);
+			if (p != NULL) {
+				header->width = get_le16 (p + 6) & 0x3fff;
+				header->height = get_le16 (p + 8) & 0x3fff;
+			}
+			break;
+		} else if (memcmp (p, "VP8L", 4) == 0) {
+			p = source_get (source, position + 8, 5);
+			if (p != NULL && p[0] == 0x2f) {
+				header->width = (get_le32 (p + 1) & 0x3fff) + 1;
+				header->height = ((get_le32 (p + 1) >> 14) & 0x3fff) + 1;
+			}
+			break;
+		} else if (memcmp (p, "EXIF", 4) == 0) {
+			read_tiff (source, position + 8, tags);
+			break;
+		}
+
+		if (header->width > 0 && !has_exif) {
+			break;
+		}
+
+		/* Chunks are padded to an even size */
+		position += 8 + chunk_size + (chunk_size & 1);
+	}
+
+	return TRUE;
+}
+
+static NautilusImageHeader *
+parse_source (Source *source)
+{
+	NautilusImageHeader *header;
+	TiffTags tags;
+	guint32 swap;
+
+	header = g_new0 (NautilusImageHeader, 1);
+	memset (&tags, 0, sizeof (tags));
+
+	if (parse_png (source, header) ||
+	    parse_gif (source, header) ||
+	    parse_jpeg (source, header, &tags) ||
+	    parse_webp (source, header, &tags)) {
+		/* The size came from the container */
+	} else if (read_tiff (source, 0, &tags)) {
+		header->format = "TIFF";
+		header->width = tags.width;
+		header->height = tags.height;
+		if (header->width == 0 || header->height == 0) {
+			header->width = tags.exif_width;
+			header->height = tags.exif_height;
+		}
+	} else {
+		tiff_tags_clear (&tags);
+		g_free (header);
+		return NULL;
+	}
+
+	header_take_tiff_tags (header, &tags);
+
+	/* Orientations 5 to 8 turn the picture a quarter */
+	if (tags.orientation >= 5 && tags.orientation <= 8) {
+		swap = header->width;
+		header->width = header->height;
+		header->height = swap;
+	}
+
+	/* Sizes too large for an int are as good as unknown */
+	if (header->width <= 0 || header->height <= 0) {
+		header->width = 0;
+		header->height = 0;
+	}
+
+	tiff_tags_clear (&tags);
+
+	return header;
+}
+
+static void
+source_clear (Source *source)
+{
+	g_slist_free_full (source->blocks, g_free);
+	source->blocks = NULL;
+}
+
+NautilusImageHeader *
+nautilus_image_header_parse (const guchar *data,
+			     gsize length)
+{
+	NautilusImageHeader *header;
+	Source source;
+
+	memset (&source, 0, sizeof (source));
+	source.data = data;
+	source.length = length;
+
+	header = parse_source (&source);
+	source_clear (&source);
+
+	return header;
+}
+
+NautilusImageHeader *
+nautilus_image_header_read (GFile *location,
+			    GCancellable *cancellable,
+			    GError **error)
+{
+	NautilusImageHeader *header;
+	GFileInputStream *stream;
+	Source source;
+	guchar *data;
+	gsize length;
+
+	stream = g_file_read (location, cancellable, error);
+	if (stream == NULL) {
+		return NULL;
+	}
+
+	header = NULL;
+	data = g_malloc (HEADER_READ_SIZE);
+	if (g_input_stream_read_all (G_INPUT_STREAM (stream),
+				     data, HEADER_READ_SIZE, &length,
+				     cancellable, error)) {
+		memset (&source, 0, sizeof (source));
+		source.data = data;
+		source.length = length;
+		source.stream = G_INPUT_STREAM (stream);
+		source.cancellable = cancellable;
+
+		header = parse_source (&source);
+		source_clear (&source);
+
+		if (header == NULL) {
+			g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+					     "Not an image format with a known header");
+		}
+	}
+
+	g_free (data);
+	g_object_unref (stream);
+
+	return header;
+}
+
+void
+nautilus_image_header_free (NautilusImageHeader *header)
+{
+	g_free (header->camera_make);
+	g_free (header->camera_model);
+	g_free (header);
+}
+
+gboolean
+nautilus_image_header_supports (const char *mime_type)
+{
+	/* Most raw formats are TIFF underneath, and have types of their
+	 * own, so the file contents decide.
+	 */
+	return mime_type != NULL &&
+		g_str_has_prefix (mime_type, "image/") &&
+		!g_str_has_prefix (mime_type, "image/svg");
+}
+
+#if !defined (NAUTILUS_OMIT_SELF_CHECK)
+
+static const guchar self_check_png[] = {
+	0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n',
+	0x00, 0x00, 0x00, 0x0d, 'I', 'H', 'D', 'R',
+	0x00, 0x00, 0x02, 0x80, 0x00, 0x00, 0x01, 0xe0,
+	0x08, 0x06, 0x00, 0x00, 0x00
+};
+
+static const guchar self_check_gif[] = {
+	'G', 'I', 'F', '8', '9', 'a', 0x40, 0x01, 0xc8, 0x00, 0x00
+};
+
+static const guchar self_check_jpeg[] = {
+	0xff, 0xd8,
+	0xff, 0xc0, 0x00, 0x11, 0x08, 0x01, 0xe0, 0x02, 0x80, 0x03
+};
+
+/* An APP1 segment with a Make and an Orientation of 6, then the frame */
+#define SELF_CHECK_ORIENTATION_OFFSET 30
+static const guchar self_check_jpeg_exif[] = {
+	0xff, 0xd8,
+	0xff, 0xe1, 0x00, 0x34, 'E', 'x', 'i', 'f', 0x00, 0x00,
+	'I', 'I', '*', 0x00, 0x08, 0x00, 0x00, 0x00,
+	0x02, 0x00,
+	0x12, 0x01, 0x03, 0x00, 0x01, 0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x00,
+	0x0f, 0x01, 0x02, 0x00, 0x06, 0x00, 0x00, 0x00, 0x26, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00,
+	'C', 'a', 'n', 'o', 'n', 0x00,
+	0xff, 0xc0, 0x00, 0x11, 0x08, 0x01, 0xe0, 0x02, 0x80, 0x03
+};
+
+static const guchar self_check_webp_vp8x[] = {
+	'R', 'I', 'F', 'F', 0x16, 0x00, 0x00, 0x00, 'W', 'E', 'B', 'P',
+	'V', 'P', '8', 'X', 0x0a, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x1f, 0x03, 0x00, 0x57, 0x02, 0x00
+};
+
+static const guchar self_check_webp_vp8l[] = {
+	'R', 'I', 'F', 'F', 0x11, 0x00, 0x00, 0x00, 'W', 'E', 'B', 'P',
+	'V', 'P', '8', 'L', 0x05, 0x00, 0x00, 0x00,
+	0x2f, 0x63, 0x40, 0x0c, 0x00
+};
+
+/* A chunk claiming to be larger than any file */
+static const guchar self_check_webp_bad_chunk[] = {
+	'R', 'I', 'F', 'F', 0xff, 0xff, 0xff, 0xff, 'W', 'E', 'B', 'P',
+	'A', 'L', 'P', 'H', 0xf0, 0xff, 0xff, 0xff
+};
+
+static const guchar self_check_tiff_le[] = {
+	'I', 'I', '*', 0x00, 0x08, 0x00, 0x00, 0x00,
+	0x02, 0x00,
+	0x00, 0x01, 0x03, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00,
+	0x01, 0x01, 0x04, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00
+};
+
+static const guchar self_check_tiff_be[] = {
+	'M', 'M', 0x00, '*', 0x00, 0x00, 0x00, 0x08,
+	0x00, 0x02,
+	0x01, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x01, 0x04, 0x00, 0x00, 0x00,
+	0x01, 0x01, 0x00, 0x04, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x03, 0x00,
+	0x00, 0x00, 0x00, 0x00
+};
+
+/* An EXIF directory pointing back at the directory it is in */
+static const guchar self_check_tiff_loop[] = {
+	'I', 'I', '*', 0x00, 0x08, 0x00, 0x00, 0x00,
+	0x03, 0x00,
+	0x00, 0x01, 0x03, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00,
+	0x01, 0x01, 0x04, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00,
+	0x69, 0x87, 0x04, 0x00, 0x01, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00
+};
+
+static const guchar self_check_tiff_bad_offset[] = {
+	'I', 'I', '*', 0x00, 0x00, 0x10, 0x00, 0x00
+};
+
+static void
+self_check_header (const guchar *data,
+		   gsize length,
+		   const char *format,
+		   int width,
+		   int height)
+{
+	NautilusImageHeader *header;
+
+	header = nautilus_image_header_parse (data, length);
+	EEL_CHECK_BOOLEAN_RESULT (header != NULL, TRUE);
+	if (header == NULL) {
+		return;
+	}
+
+	EEL_CHECK_STRING_RESULT (g_strdup (header->format), format);
+	EEL_CHECK_INTEGER_RESULT (header->width, width);
+	EEL_CHECK_INTEGER_RESULT (header->height, height);
+
+	nautilus_image_header_free (header);
+}
+
+void
+nautilus_self_check_image_header (void)
+{
+	NautilusImageHeader *header;
+	guchar data[128];
+
+	/* Not images at all */
+	EEL_CHECK_BOOLEAN_RESULT (nautilus_image_header_parse ((const guchar *) "", 0) == NULL, TRUE);
+	EEL_CHECK_BOOLEAN_RESULT (nautilus_image_header_parse ((const guchar *) "not an image", 12) == NULL, TRUE);
+
+	/* PNG, cut before the size, without an IHDR first, and too wide */
+	self_check_header (self_check_png, sizeof (self_check_png), "PNG", 640, 480);
+	EEL_CHECK_BOOLEAN_RESULT (nautilus_image_header_parse (self_check_png, 20) == NULL, TRUE);
+	memcpy (data, self_check_png, sizeof (self_check_png));
+	memcpy (data + 12, "tEXt", 4);
+	self_check_header (data, sizeof (self_check_png), "PNG", 0, 0);
+	memcpy (data, self_check_png, sizeof (self_check_png));
+	data[16] = 0x80;
+	self_check_header (data, sizeof (self_check_png), "PNG", 0, 0);
+
+	/* GIF */
+	self_check_header (self_check_gif, sizeof (self_check_gif), "GIF", 320, 200);
+	EEL_CHECK_BOOLEAN_RESULT (nautilus_image_header_parse (self_check_gif, 8) == NULL, TRUE);
+
+	/* JPEG, cut in the frame header, and with a segment too short */
+	self_check_header (self_check_jpeg, sizeof (self_check_jpeg), "JPEG", 640, 480);
+	self_check_header (self_check_jpeg, 7, "JPEG", 0, 0);
+	memcpy (data, self_check_jpeg, sizeof (self_check_jpeg));
+	data[5] = 0x01;
+	self_check_header (data, sizeof (self_check_jpeg), "JPEG", 0, 0);
+
+	/* EXIF orientation 6 turns the picture a quarter, 3 does not */
+	self_check_header (self_check_jpeg_exif, sizeof (self_check_jpeg_exif), "JPEG", 480, 640);
+	header = nautilus_image_header_parse (self_check_jpeg_exif, sizeof (self_check_jpeg_exif));
+	EEL_CHECK_STRING_RESULT (g_strdup (header->camera_make), "Canon");
+	nautilus_image_header_free (header);
+	memcpy (data, self_check_jpeg_exif, sizeof (self_check_jpeg_exif));
+	data[SELF_CHECK_ORIENTATION_OFFSET] = 3;
+	self_check_header (data, sizeof (self_check_jpeg_exif), "JPEG", 640, 480);
+	data[SELF_CHECK_ORIENTATION_OFFSET] = 8;
+	self_check_header (data, sizeof (self_check_jpeg_exif), "JPEG", 480, 640);
+	/* Cut in the middle of the EXIF directory */
+	header = nautilus_image_header_parse (self_check_jpeg_exif, 40);
+	EEL_CHECK_INTEGER_RESULT (header->width, 0);
+	EEL_CHECK_BOOLEAN_RESULT (header->camera_make == NULL, TRUE);
+	nautilus_image_header_free (header);
+
+	/* WebP */
+	self_check_header (self_check_webp_vp8x, sizeof (self_check_webp_vp8x), "WebP", 800, 600);
+	self_check_header (self_check_webp_vp8x, 24, "WebP", 0, 0);
+	self_check_header (self_check_webp_vp8l, sizeof (self_check_webp_vp8l), "WebP", 100, 50);
+	self_check_header (self_check_webp_bad_chunk, sizeof (self_check_webp_bad_chunk), "WebP", 0, 0);
+	EEL_CHECK_BOOLEAN_RESULT (nautilus_image_header_parse (self_check_webp_vp8x, 10) == NULL, TRUE);
+
+	/* TIFF, in both byte orders, looping, and pointing past the end */
+	self_check_header (self_check_tiff_le, sizeof (self_check_tiff_le), "TIFF", 1024, 768);
+	self_check_header (self_check_tiff_be, sizeof (self_check_tiff_be), "TIFF", 1024, 768);
+	self_check_header (self_check_tiff_loop, sizeof (self_check_tiff_loop), "TIFF", 1024, 768);
+	self_check_header (self_check_tiff_bad_offset, sizeof (self_check_tiff_bad_offset), "TIFF", 0, 0);
+	self_check_header (self_check_tiff_le, 20, "TIFF", 0, 0);
+}
+
+#endif /* !NAUTILUS_OMIT_SELF_CHECK */
@@ -0,0 +1,59 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+ *
+ * nautilus-image-header.h: image size and camera details read from
+ * the headers of image files
+ *
+ * Nautilus is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * Nautilus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; see the file COPYING.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef NAUTILUS_IMAGE_HEADER_H
+#define NAUTILUS_IMAGE_HEADER_H
+
+#include <gio/gio.h>
+#include <time.h>
+
+/* What the headers of a PNG, JPEG, GIF, WebP or TIFF file (which
+ * includes most camera raw formats) say, without decoding the image.
+ * Only the start of the file is read, plus the few blocks TIFF
+ * directories point to elsewhere.
+ */
+typedef struct {
+	/* Short format name, not translated */
+	const char *format;
+	/* As shown, so already turned by the EXIF orientation. 0 if unknown */
+	int width;
+	int height;
+	/* When the picture was taken, 0 if unknown */
+	time_t date_taken;
+	char *camera_make;
+	char *camera_model;
+} NautilusImageHeader;
+
+/* Blocking, for use from a thread. Fails with G_IO_ERROR_NOT_SUPPORTED
+ * for files in other formats.
+ */
+NautilusImageHeader *nautilus_image_header_read      (GFile        *location,
+						      GCancellable *cancellable,
+						      GError      **error);
+/* For data that is already in memory, returns NULL if not recognized */
+NautilusImageHeader *nautilus_image_header_parse     (const guchar *data,
+						      gsize         length);
+void                 nautilus_image_header_free      (NautilusImageHeader *header);
+
+/* Whether files of the type could have a header we can read */
+gboolean             nautilus_image_header_supports  (const char   *mime_type);
+
+#endif /* NAUTILUS_IMAGE_HEADER_H */
@@ -42,6 +42,11 @@ void nautilus_run_lib_self_checks (void);
 	macro (nautilus_self_check_directory) \
 	macro (nautilus_self_check_file) \
 	macro (nautilus_self_check_canvas_container) \
+	macro (nautilus_self_check_selection_model) \
+	macro (nautilus_self_check_filename_index) \
+	macro (nautilus_self_check_image_header) \
+	macro (nautilus_self_check_bookmark_status) \
+	macro (nautilus_self_check_deep_count_cache) \
 /* Add new self-check functions to the list above this line. */
 
 /* Generate prototypes for all the functions. */
@@ -24,8 +24,16 @@
 #include <config.h>
 #include "nautilus-module.h"
 
+#include "nautilus-global-preferences.h"
+
 #include <eel/eel-debug.h>
+#include <errno.h>
+#include <glib/gstdio.h>
 #include <gmodule.h>
+#include <string.h>
+
+#define DEBUG_FLAG NAUTILUS_DEBUG_EXTENSIONS
+#include "nautilus-debug.h"
 
 #define NAUTILUS_TYPE_MODULE    	(nautilus_module_get_type ())
 #define NAUTILUS_MODULE(obj)		(G_TYPE_CHECK_INSTANCE_CAST ((obj), NAUTILUS_TYPE_MODULE, NautilusModule))
@@ -57,6 +65,45 @@ struct _NautilusModuleClass {
 
 static GList *module_objects = NULL;
 
+/* Modules are only loaded once one of the interfaces their types
+ * implement is asked for. Which interfaces those are is kept in a
+ * manifest in the user cache directory, checked against the mtime and
+ * size of each module; new or changed modules are loaded at setup to
+ * find out.
+ */
+typedef struct {
+	char *path;
+	char **interfaces;
+} PendingModule;
+
+static GList *pending_modules = NULL;
+
+/* Bucket i counts calls that took less than 2^i ms, the last one the rest. */
+#define CALL_STATS_BUCKETS 12
+
+typedef struct {
+	char *name;
+	const char *call;
+	guint calls;
+	guint64 total_time;
+	guint64 max_time;
+	guint64 last_time;
+	guint32 buckets[CALL_STATS_BUCKETS];
+} CallStats;
+
+struct NautilusModuleOperation {
+	const char *call;
+	gint64 start_time;
+	gint64 call_start_time;
+	guint skipped;
+};
+
+static GQuark extension_name_quark;
+/* "module\ncall" -> CallStats */
+static GHashTable *call_stats;
+static guint call_deadline;
+static gboolean call_deadline_initialized;
+
 static GType nautilus_module_get_type (void);
 
 G_DEFINE_TYPE (NautilusModule, nautilus_module, G_TYPE_TYPE_MODULE);
@@ -165,24 +212,80 @@ module_object_weak_notify (gpointer user_data, GObject *object)
 }
 
 static void
-add_module_objects (NautilusModule *module)
+add_type_from_module (GType type,
+		      const char *name)
+{
+	GObject *object;
+
+	object = g_object_new (type, NULL);
+	g_object_weak_ref (object, 
+			   (GWeakNotify)module_object_weak_notify,
+			   NULL);
+
+	if (extension_name_quark == 0) {
+		extension_name_quark = g_quark_from_static_string ("nautilus-extension-name");
+	}
+	g_object_set_qdata_full (object, extension_name_quark,
+				 g_strdup (name), g_free);
+
+	module_objects = g_list_prepend (module_objects, object);
+}
+
+static void
+add_type_interfaces (GType type,
+		     GPtrArray *interfaces)
+{
+	GType *types;
+	guint n_types, i, j;
+	const char *name;
+
+	types = g_type_interfaces (type, &n_types);
+	for (i = 0; i < n_types; i++) {
+		name = g_type_name (types[i]);
+		for (j = 0; j < interfaces->len; j++) {
+			if (strcmp (g_ptr_array_index (interfaces, j), name) == 0) {
+				break;
+			}
+		}
+		if (j == interfaces->len) {
+			g_ptr_array_add (interfaces, g_strdup (name));
+		}
+	}
+	g_free (types);
+}
+
+static void
+add_module_objects (NautilusModule *module,
+		    GPtrArray *interfaces)
 {
 	const GType *types;
 	int num_types;
 	int i;
+	char *name;
 	
 	module->list_types (&types, &num_types);
+
+	name = g_path_get_basename (module->path);
 	
 	for (i = 0; i < num_types; i++) {
 		if (types[i] == 0) { /* Work around broken extensions */
 			break;
 		}
-		nautilus_module_add_type (types[i]);
+		add_type_from_module (types[i], name);
+		if (interfaces != NULL) {
+			add_type_interfaces (types[i], interfaces);
+		}
 	}
+
+	g_free (name);
 }
 
+/* If interfaces is not NULL, the names of the interfaces implemented
+ * by the module's types are added to it.
+ */
 static NautilusModule *
-nautilus_module_load_file (const char *filename)
+nautilus_module_load_file (const char *filename,
+			   GPtrArray *interfaces)
 {
 	NautilusModule *module;
 	
@@ -190,7 +293,7 @@ nautilus_module_load_file (const char *filename)
 	module->path = g_strdup (filename);
 	
 	if (g_type_module_use (G_TYPE_MODULE (module))) {
-		add_module_objects (module);
+		add_module_objects (module, interfaces);
 		g_type_module_unuse (G_TYPE_MODULE (module));
 		return module;
 	} else {
@@ -199,15 +302,87 @@ nautilus_module_load_file (const char *filename)
 	}
 }
 
+static char *
+get_manifest_path (void)
+{
+	return g_build_filename (g_get_user_cache_dir (), "nautilus",
+				 "extensions-manifest", NULL);
+}
+
+static gboolean
+manifest_entry_is_valid (GKeyFile *manifest,
+			 const char *name,
+			 GStatBuf *statbuf)
+{
+	GError *error;
+	gint64 mtime;
+	guint64 size;
+
+	error = NULL;
+	mtime = g_key_file_get_int64 (manifest, name, "MTime", &error);
+	if (error == NULL) {
+		size = g_key_file_get_uint64 (manifest, name, "Size", &error);
+	}
+	if (error != NULL) {
+		g_error_free (error);
+		return FALSE;
+	}
+
+	return mtime == (gint64) statbuf->st_mtime &&
+		size == (guint64) statbuf->st_size &&
+		g_key_file_has_key (manifest, name, "Interfaces", NULL);
+}
+
+static void
+save_manifest (GKeyFile *manifest)
+{
+	char *path, *dirname, *data;
+	gsize length;
+	GError *error;
+
+	path = get_manifest_path ();
+	dirname = g_path_get_dirname (path);
+	data = g_key_file_to_data (manifest, &length, NULL);
+
+	error = NULL;
+	if (g_mkdir_with_parents (dirname, 0700) != 0 ||
+	    !g_file_set_contents (path, data, length, &error)) {
+		DEBUG ("Could not save the extension manifest: %s",
+		       error != NULL ? error->message : g_strerror (errno));
+		g_clear_error (&error);
+	}
+
+	g_free (data);
+	g_free (dirname);
+	g_free (path);
+}
+
 static void
 load_module_dir (const char *dirname)
 {
 	GDir *dir;
+	GKeyFile *manifest, *new_manifest;
+	char *manifest_path;
+	char **interfaces, **groups;
+	gsize n_groups, n_modules;
+	gboolean changed;
+	GStatBuf statbuf;
+	GPtrArray *array;
+	PendingModule *pending;
 	
 	dir = g_dir_open (dirname, 0, NULL);
 	
 	if (dir) {
 		const char *name;
+
+		manifest = g_key_file_new ();
+		manifest_path = get_manifest_path ();
+		g_key_file_load_from_file (manifest, manifest_path, G_KEY_FILE_NONE, NULL);
+		g_free (manifest_path);
+
+		new_manifest = g_key_file_new ();
+		changed = FALSE;
+		n_modules = 0;
 		
 		while ((name = g_dir_read_name (dir))) {
 			if (g_str_has_suffix (name, "." G_MODULE_SUFFIX)) {
@@ -216,15 +391,107 @@ load_module_dir (const char *dirname)
 				filename = g_build_filename (dirname, 
 							     name, 
 							     NULL);
-				nautilus_module_load_file (filename);
-				g_free (filename);
+
+				if (g_stat (filename, &statbuf) != 0) {
+					g_free (filename);
+					continue;
+				}
+
+				if (manifest_entry_is_valid (manifest, name, &statbuf)) {
+					interfaces = g_key_file_get_string_list (manifest, name, "Interfaces",
+										 NULL, NULL);
+					if (interfaces == NULL) {
+						interfaces = g_new0 (char *, 1);
+					}
+
+					pending = g_new0 (PendingModule, 1);
+					pending->path = filename;
+					pending->interfaces = g_strdupv (interfaces);
+					pending_modules = g_list_prepend (pending_modules, pending);
+				} else {
+					array = g_ptr_array_new_with_free_func (g_free);
+					if (nautilus_module_load_file (filename, array) == NULL) {
+						/* Try again next time. */
+						g_ptr_array_free (array, TRUE);
+						g_free (filename);
+						continue;
+					}
+					g_ptr_array_add (array, NULL);
+					interfaces = g_strdupv ((char **) array->pdata);
+					g_ptr_array_free (array, TRUE);
+					g_free (filename);
+					changed = TRUE;
+				}
+
+				g_key_file_set_int64 (new_manifest, name, "MTime", statbuf.st_mtime);
+				g_key_file_set_uint64 (new_manifest, name, "Size", statbuf.st_size);
+				g_key_file_set_string_list (new_manifest, name, "Interfaces",
+							    (const char * const *) interfaces,
+							    g_strv_length (interfaces));
+				g_strfreev (interfaces);
+				n_modules++;
 			}
 		}
 
+		/* Modules may have been removed too. */
+		groups = g_key_file_get_groups (manifest, &n_groups);
+		g_strfreev (groups);
+		if (changed || n_groups != n_modules) {
+			save_manifest (new_manifest);
+		}
+
+		g_key_file_free (new_manifest);
+		g_key_file_free (manifest);
 		g_dir_close (dir);
 	}
 }
 
+static gboolean
+pending_module_implements (PendingModule *pending,
+			   const char *interface)
+{
+	char **p;
+
+	for (p = pending->interfaces; *p != NULL; p++) {
+		if (strcmp (*p, interface) == 0) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static void
+pending_module_free (PendingModule *pending)
+{
+	g_free (pending->path);
+	g_strfreev (pending->interfaces);
+	g_free (pending);
+}
+
+static void
+load_pending_modules_for_type (GType type)
+{
+	GList *l, *next;
+	PendingModule *pending;
+
+	for (l = pending_modules; l != NULL; l = next) {
+		next = l->next;
+		pending = l->data;
+
+		if (G_TYPE_IS_INTERFACE (type) &&
+		    !pending_module_implements (pending, g_type_name (type))) {
+			continue;
+		}
+
+		pending_modules = g_list_delete_link (pending_modules, l);
+
+		DEBUG ("Loading %s for %s", pending->path, g_type_name (type));
+		nautilus_module_load_file (pending->path, NULL);
+		pending_module_free (pending);
+	}
+}
+
 static void
 free_module_objects (void)
 {
@@ -236,6 +503,9 @@ free_module_objects (void)
 	}
 	
 	g_list_free (module_objects);
+
+	g_list_free_full (pending_modules, (GDestroyNotify) pending_module_free);
+	pending_modules = NULL;
 }
 
 void
@@ -257,6 +527,8 @@ nautilus_module_get_extensions_for_type (GType type)
 {
 	GList *l;
 	GList *ret = NULL;
+
+	load_pending_modules_for_type (type);
 	
 	for (l = module_objects; l != NULL; l = l->next) {
 		if (G_TYPE_CHECK_INSTANCE_TYPE (G_OBJECT (l->data),
@@ -284,12 +556,215 @@ nautilus_module_extension_list_free (GList *extensions)
 void   
 nautilus_module_add_type (GType type)
 {
-	GObject *object;
-	
-	object = g_object_new (type, NULL);
-	g_object_weak_ref (object, 
-			   (GWeakNotify)module_object_weak_notify,
-			   NULL);
+	add_type_from_module (type, g_type_name (type));
+}
 
-	module_objects = g_list_prepend (module_objects, object);
+static const char *
+get_extension_name (GObject *extension)
+{
+	const char *name;
+
+	name = NULL;
+	if (extension_name_quark != 0) {
+		name = g_object_get_qdata (extension, extension_name_quark);
+	}
+
+	return name != NULL ? name : G_OBJECT_TYPE_NAME (extension);
+}
+
+static void
+call_stats_free (void)
+{
+	GHashTableIter iter;
+	CallStats *stats;
+
+	g_hash_table_iter_init (&iter, call_stats);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &stats)) {
+		DEBUG ("%s %s: %u calls, %" G_GUINT64_FORMAT " ms total, %" G_GUINT64_FORMAT " ms max",
+		       stats->name, stats->call, stats->calls,
+		       stats->total_time / 1000, stats->max_time / 1000);
+	}
+
+	g_hash_table_destroy (call_stats);
+	call_stats = NULL;
+}
+
+static void
+call_stats_entry_free (CallStats *stats)
+{
+	g_free (stats->name);
+	g_free (stats);
+}
+
+static CallStats *
+lookup_call_stats (GObject *extension,
+		   const char *call,
+		   gboolean create)
+{
+	CallStats *stats;
+	const char *name;
+	char *key;
+
+	if (call_stats == NULL) {
+		if (!create) {
+			return NULL;
+		}
+		call_stats = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+						    (GDestroyNotify) call_stats_entry_free);
+		eel_debug_call_at_shutdown (call_stats_free);
+	}
+
+	name = get_extension_name (extension);
+	key = g_strconcat (name, "\n", call, NULL);
+	stats = g_hash_table_lookup (call_stats, key);
+
+	if (stats == NULL && create) {
+		stats = g_new0 (CallStats, 1);
+		stats->name = g_strdup (name);
+		stats->call = call;
+		g_hash_table_insert (call_stats, key, stats);
+	} else {
+		g_free (key);
+	}
+
+	return stats;
+}
+
+static void
+call_deadline_changed_callback (gpointer user_data)
+{
+	call_deadline = g_settings_get_uint (nautilus_preferences,
+					     NAUTILUS_PREFERENCES_EXTENSION_CALL_DEADLINE);
+}
+
+static guint
+get_call_deadline (void)
+{
+	if (!call_deadline_initialized) {
+		call_deadline_initialized = TRUE;
+		call_deadline_changed_callback (NULL);
+		g_signal_connect_swapped (nautilus_preferences,
+					  "changed::" NAUTILUS_PREFERENCES_EXTENSION_CALL_DEADLINE,
+					  G_CALLBACK (call_deadline_changed_callback),
+					  NULL);
+	}
+
+	return call_deadline;
+}
+
+/* The call name must be a static string. */
+void
+nautilus_module_record_call (GObject *extension,
+			     const char *call,
+			     gint64 elapsed_usec)
+{
+	CallStats *stats;
+	guint bucket;
+	gint64 msec;
+
+	stats = lookup_call_stats (extension, call, TRUE);
+
+	elapsed_usec = MAX (elapsed_usec, 0);
+	stats->calls++;
+	stats->total_time += elapsed_usec;
+	stats->max_time = MAX (stats->max_time, (guint64) elapsed_usec);
+	stats->last_time = elapsed_usec;
+
+	bucket = 0;
+	for (msec = elapsed_usec / 1000; msec > 0 && bucket < CALL_STATS_BUCKETS - 1; msec >>= 1) {
+		bucket++;
+	}
+	stats->buckets[bucket]++;
+
+	if (get_call_deadline () != 0 &&
+	    elapsed_usec >= (gint64) get_call_deadline () * 1000) {
+		DEBUG ("%s %s took %" G_GINT64_FORMAT " ms",
+		       stats->name, call, elapsed_usec / 1000);
+	}
+}
+
+/* The call name must be a static string. */
+NautilusModuleOperation *
+nautilus_module_operation_new (const char *call)
+{
+	NautilusModuleOperation *operation;
+
+	operation = g_new0 (NautilusModuleOperation, 1);
+	operation->call = call;
+	operation->start_time = g_get_monotonic_time ();
+
+	return operation;
+}
+
+gboolean
+nautilus_module_operation_begin_call (NautilusModuleOperation *operation,
+				      GObject *extension)
+{
+	CallStats *stats;
+	guint deadline;
+
+	deadline = get_call_deadline ();
+	if (deadline != 0 &&
+	    g_get_monotonic_time () - operation->start_time >= (gint64) deadline * 1000) {
+		stats = lookup_call_stats (extension, operation->call, FALSE);
+		if (stats != NULL && stats->last_time >= (guint64) deadline * 1000 / 2) {
+			DEBUG ("Skipping %s for %s, past the deadline",
+			       stats->name, operation->call);
+			operation->skipped++;
+			return FALSE;
+		}
+	}
+
+	operation->call_start_time = g_get_monotonic_time ();
+
+	return TRUE;
+}
+
+void
+nautilus_module_operation_end_call (NautilusModuleOperation *operation,
+				    GObject *extension)
+{
+	nautilus_module_record_call (extension, operation->call,
+				    g_get_monotonic_time () - operation->call_start_time);
+}
+
+void
+nautilus_module_operation_free (NautilusModuleOperation *operation)
+{
+	if (operation->skipped > 0) {
+		DEBUG ("%s took %" G_GINT64_FORMAT " ms, %u extensions skipped",
+		       operation->call,
+		       (g_get_monotonic_time () - operation->start_time) / 1000,
+		       operation->skipped);
+	}
+
+	g_free (operation);
+}
+
+GVariant *
+nautilus_module_get_call_stats (void)
+{
+	GVariantBuilder builder;
+	GHashTableIter iter;
+	CallStats *stats;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(ssuttau)"));
+
+	if (call_stats != NULL) {
+		g_hash_table_iter_init (&iter, call_stats);
+		while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &stats)) {
+			g_variant_builder_add (&builder, "(ssutt@au)",
+					       stats->name,
+					       stats->call,
+					       stats->calls,
+					       stats->total_time,
+					       stats->max_time,
+					       g_variant_new_fixed_array (G_VARIANT_TYPE_UINT32,
+									  stats->buckets,
+									  CALL_STATS_BUCKETS,
+									  sizeof (guint32)));
+		}
+	}
+
+	return g_variant_builder_end (&builder);
 }
@@ -36,6 +36,33 @@ void   nautilus_module_extension_list_free     (GList *list);
  * without putting them in separate shared libraries */
 void   nautilus_module_add_type                (GType  type);
 
+/* Accounting of calls into extensions. An operation groups the calls
+ * made for one user action, such as building a menu. Once it has run
+ * past the soft deadline from the preferences, extensions whose last
+ * call of the same kind took more than half of it are skipped for the
+ * rest of the operation: begin_call returns FALSE for them.
+ */
+typedef struct NautilusModuleOperation NautilusModuleOperation;
+
+NautilusModuleOperation *nautilus_module_operation_new        (const char              *call);
+gboolean                 nautilus_module_operation_begin_call (NautilusModuleOperation *operation,
+							       GObject                 *extension);
+void                     nautilus_module_operation_end_call   (NautilusModuleOperation *operation,
+							       GObject                 *extension);
+void                     nautilus_module_operation_free       (NautilusModuleOperation *operation);
+
+/* For calls that are timed by the caller, e.g. asynchronous ones. */
+void                     nautilus_module_record_call          (GObject                 *extension,
+							       const char              *call,
+							       gint64                   elapsed_usec);
+
+/* Returns a floating a(ssuttau) variant: for each extension module and
+ * kind of call, the number of calls, total and maximum time in
+ * microseconds, and a histogram of call times in power of two
+ * milliseconds buckets.
+ */
+GVariant *               nautilus_module_get_call_stats       (void);
+
 G_END_DECLS
 
 #endif
@@ -165,6 +165,12 @@ nautilus_monitor_directory (GFile *location)
 	return ret;
 }
 
+gboolean
+nautilus_monitor_is_watching (NautilusMonitor *monitor)
+{
+	return monitor->monitor != NULL;
+}
+
 void 
 nautilus_monitor_cancel (NautilusMonitor *monitor)
 {
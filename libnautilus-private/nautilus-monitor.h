@@ -32,5 +32,7 @@ typedef struct NautilusMonitor NautilusMonitor;
 gboolean         nautilus_monitor_active    (void);
 NautilusMonitor *nautilus_monitor_directory (GFile *location);
 void             nautilus_monitor_cancel    (NautilusMonitor *monitor);
+/* TRUE if changes to the directory are being reported */
+gboolean         nautilus_monitor_is_watching (NautilusMonitor *monitor);
 
 #endif /* NAUTILUS_MONITOR_H */
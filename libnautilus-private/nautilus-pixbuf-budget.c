@@ -0,0 +1,195 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+ *
+ * nautilus-pixbuf-budget.c: global memory limit for cached pixbufs.
+ *
+ * Nautilus is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * Nautilus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; see the file COPYING.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <config.h>
+#include "nautilus-pixbuf-budget.h"
+
+#include "nautilus-global-preferences.h"
+
+#define DEBUG_FLAG NAUTILUS_DEBUG_FILE
+#include "nautilus-debug.h"
+
+/* Least recently used entries at the head. The queue links are the
+ * ones embedded in the entries, so accounting never allocates. Pinned
+ * entries are kept apart, so eviction does not have to skip them.
+ */
+static GQueue lru = G_QUEUE_INIT;
+static GQueue pinned_entries = G_QUEUE_INIT;
+static guint64 resident_bytes;
+static guint64 evictions;
+static guint64 limit;
+static gboolean limit_initialized;
+
+static void
+limit_changed_callback (gpointer user_data)
+{
+	g_settings_get (nautilus_preferences,
+			NAUTILUS_PREFERENCES_IMAGE_CACHE_LIMIT,
+			"t", &limit);
+}
+
+static void
+ensure_limit (void)
+{
+	if (limit_initialized) {
+		return;
+	}
+
+	limit_initialized = TRUE;
+	limit_changed_callback (NULL);
+	g_signal_connect_swapped (nautilus_preferences,
+				  "changed::" NAUTILUS_PREFERENCES_IMAGE_CACHE_LIMIT,
+				  G_CALLBACK (limit_changed_callback),
+				  NULL);
+}
+
+gsize
+nautilus_pixbuf_budget_get_pixbuf_size (GdkPixbuf *pixbuf)
+{
+	if (pixbuf == NULL) {
+		return 0;
+	}
+
+	return (gsize) gdk_pixbuf_get_rowstride (pixbuf) * gdk_pixbuf_get_height (pixbuf);
+}
+
+gboolean
+nautilus_pixbuf_budget_is_accounted (NautilusPixbufBudgetEntry *entry)
+{
+	return entry->evict != NULL;
+}
+
+static void
+evict_until_under_limit (NautilusPixbufBudgetEntry *keep)
+{
+	NautilusPixbufBudgetEntry *entry;
+	NautilusPixbufBudgetEvictFunc evict;
+	gpointer owner;
+
+	/* A limit of 0 means no limit */
+	while (limit != 0 && resident_bytes > limit) {
+		/* The link is the first member of the entry */
+		entry = (NautilusPixbufBudgetEntry *) lru.head;
+		if (entry == NULL || entry == keep) {
+			break;
+		}
+
+		owner = entry->link.data;
+		evict = entry->evict;
+		nautilus_pixbuf_budget_remove (entry);
+		evictions++;
+
+		evict (owner);
+	}
+
+	DEBUG ("%" G_GUINT64_FORMAT " bytes resident, %" G_GUINT64_FORMAT " evictions",
+	       resident_bytes, evictions);
+}
+
+void
+nautilus_pixbuf_budget_add (NautilusPixbufBudgetEntry     *entry,
+			    gpointer                       owner,
+			    gsize                          bytes,
+			    NautilusPixbufBudgetEvictFunc  evict)
+{
+	ensure_limit ();
+
+	if (nautilus_pixbuf_budget_is_accounted (entry)) {
+		resident_bytes -= entry->bytes;
+		g_queue_unlink (entry->pinned ? &pinned_entries : &lru, &entry->link);
+	}
+
+	entry->link.data = owner;
+	entry->link.prev = entry->link.next = NULL;
+	entry->bytes = bytes;
+	entry->evict = evict;
+
+	g_queue_push_tail_link (entry->pinned ? &pinned_entries : &lru, &entry->link);
+	resident_bytes += bytes;
+
+	if (limit != 0 && resident_bytes > limit) {
+		evict_until_under_limit (entry);
+	}
+}
+
+void
+nautilus_pixbuf_budget_touch (NautilusPixbufBudgetEntry *entry)
+{
+	if (!nautilus_pixbuf_budget_is_accounted (entry) ||
+	    entry->pinned ||
+	    lru.tail == &entry->link) {
+		return;
+	}
+
+	g_queue_unlink (&lru, &entry->link);
+	g_queue_push_tail_link (&lru, &entry->link);
+}
+
+void
+nautilus_pixbuf_budget_remove (NautilusPixbufBudgetEntry *entry)
+{
+	if (!nautilus_pixbuf_budget_is_accounted (entry)) {
+		return;
+	}
+
+	g_queue_unlink (entry->pinned ? &pinned_entries : &lru, &entry->link);
+	resident_bytes -= entry->bytes;
+
+	entry->link.data = NULL;
+	entry->bytes = 0;
+	entry->evict = NULL;
+}
+
+void
+nautilus_pixbuf_budget_set_pinned (NautilusPixbufBudgetEntry *entry,
+				   gboolean pinned)
+{
+	if (entry->pinned == pinned) {
+		return;
+	}
+
+	if (!nautilus_pixbuf_budget_is_accounted (entry)) {
+		entry->pinned = pinned;
+		return;
+	}
+
+	g_queue_unlink (entry->pinned ? &pinned_entries : &lru, &entry->link);
+	entry->pinned = pinned;
+	g_queue_push_tail_link (pinned ? &pinned_entries : &lru, &entry->link);
+
+	/* What went over the limit while pinned can go now, starting with
+	 * what has not been used for longest.
+	 */
+	if (!pinned && limit != 0 && resident_bytes > limit) {
+		evict_until_under_limit (NULL);
+	}
+}
+
+guint64
+nautilus_pixbuf_budget_get_resident_bytes (void)
+{
+	return resident_bytes;
+}
+
+guint64
+nautilus_pixbuf_budget_get_evictions (void)
+{
+	return evictions;
+}
@@ -0,0 +1,64 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+ *
+ * nautilus-pixbuf-budget.h: global memory limit for cached pixbufs.
+ *
+ * Nautilus is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * Nautilus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; see the file COPYING.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef NAUTILUS_PIXBUF_BUDGET_H
+#define NAUTILUS_PIXBUF_BUDGET_H
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+/* Caches holding on to pixbufs (icon infos, file thumbnails) embed a
+ * NautilusPixbufBudgetEntry and report the bytes they keep alive. When
+ * the total goes over the "image-cache-limit" preference, the least
+ * recently used entries are handed back to their owners through the
+ * evict function, which must drop the pixbufs; they are expected to be
+ * reloaded on demand.
+ */
+typedef void (* NautilusPixbufBudgetEvictFunc) (gpointer owner);
+
+typedef struct {
+	GList link;
+	gsize bytes;
+	NautilusPixbufBudgetEvictFunc evict;
+	gboolean pinned;
+} NautilusPixbufBudgetEntry;
+
+gsize   nautilus_pixbuf_budget_get_pixbuf_size    (GdkPixbuf                     *pixbuf);
+
+/* Starts accounting for @entry, or updates its size if it is already
+ * accounted for, and marks it as the most recently used one.
+ */
+void    nautilus_pixbuf_budget_add                (NautilusPixbufBudgetEntry     *entry,
+						   gpointer                       owner,
+						   gsize                          bytes,
+						   NautilusPixbufBudgetEvictFunc  evict);
+void    nautilus_pixbuf_budget_touch              (NautilusPixbufBudgetEntry     *entry);
+void    nautilus_pixbuf_budget_remove             (NautilusPixbufBudgetEntry     *entry);
+gboolean nautilus_pixbuf_budget_is_accounted      (NautilusPixbufBudgetEntry     *entry);
+/* Pinned entries count towards the total but are never evicted, for
+ * pixbufs that are on screen. The flag stays with the entry when it is
+ * removed and added again.
+ */
+void    nautilus_pixbuf_budget_set_pinned         (NautilusPixbufBudgetEntry     *entry,
+						   gboolean                       pinned);
+
+guint64 nautilus_pixbuf_budget_get_resident_bytes (void);
+guint64 nautilus_pixbuf_budget_get_evictions      (void);
+
+#endif /* NAUTILUS_PIXBUF_BUDGET_H */
@@ -21,44 +21,376 @@
 
 #include "config.h"
 
-#include <stdio.h>
-#include <string.h>
 #include <stdarg.h>
-#include <signal.h>
+#include <string.h>
 #include <time.h>
 #include <unistd.h>
 
 #include <glib.h>
-#include <glib/gstdio.h>
 
 #include "nautilus-profile.h"
 
+/* Must be a power of two. */
+#define RING_SIZE 16384
+#define TEXT_SIZE 48
+
+typedef struct {
+        guint64 time_ns;
+        const char *category;
+        const char *name;
+        guint span_id;
+        gint64 value;
+        char phase;
+        char text[TEXT_SIZE];
+} TraceEvent;
+
+/* An async span begun on this thread and not ended yet. Pointers are
+ * reused once an object is freed, so they cannot be written out as ids
+ * themselves.
+ */
+typedef struct {
+        const char *category;
+        const char *name;
+        gconstpointer id;
+        guint span_id;
+} OpenSpan;
+
+/* Each thread writes only to its own ring, so recording an event takes
+ * no lock: the slot is filled in and then the head is advanced
+ * atomically, which publishes the event to nautilus_profile_dump().
+ * Old events are overwritten once the ring is full. The open spans are
+ * only ever touched by the owning thread.
+ */
+typedef struct {
+        guint thread_id;
+        volatile gint head;
+        GArray *open_spans;
+        TraceEvent events[RING_SIZE];
+} TraceRing;
+
+gboolean nautilus_profile_enabled = FALSE;
+
+static char *trace_filename;
+static GPrivate current_ring;
+/* Protects the list of rings, not their contents. */
+static GMutex rings_mutex;
+static GPtrArray *rings;
+static volatile gint last_span_id;
+
+static guint64
+get_time_ns (void)
+{
+        struct timespec ts;
+
+        clock_gettime (CLOCK_MONOTONIC, &ts);
+        return (guint64) ts.tv_sec * G_GUINT64_CONSTANT (1000000000) + ts.tv_nsec;
+}
+
+static TraceRing *
+get_ring (void)
+{
+        TraceRing *ring;
+
+        ring = g_private_get (&current_ring);
+        if (G_UNLIKELY (ring == NULL)) {
+                /* Rings are never freed, so that events recorded by
+                 * threads that have already exited still get dumped.
+                 */
+                ring = g_new0 (TraceRing, 1);
+                ring->open_spans = g_array_new (FALSE, FALSE, sizeof (OpenSpan));
+
+                g_mutex_lock (&rings_mutex);
+                if (rings == NULL) {
+                        rings = g_ptr_array_new ();
+                }
+                ring->thread_id = rings->len + 1;
+                g_ptr_array_add (rings, ring);
+                g_mutex_unlock (&rings_mutex);
+
+                g_private_set (&current_ring, ring);
+        }
+
+        return ring;
+}
+
+static TraceEvent *
+ring_begin_event (TraceRing *ring)
+{
+        guint head;
+
+        head = (guint) ring->head;
+        return &ring->events[head & (RING_SIZE - 1)];
+}
+
+static void
+ring_end_event (TraceRing *ring)
+{
+        g_atomic_int_set (&ring->head, ring->head + 1);
+}
+
 void
 _nautilus_profile_log (const char *func,
-                       const char *note,
+                       char        phase,
                        const char *format,
                        ...)
 {
+        TraceRing *ring;
+        TraceEvent *event;
         va_list args;
-        char   *str;
-        char   *formatted;
+
+        ring = get_ring ();
+        event = ring_begin_event (ring);
+
+        event->time_ns = get_time_ns ();
+        event->category = "nautilus";
+        event->name = func != NULL ? func : "";
+        event->span_id = 0;
+        event->value = 0;
+        event->phase = phase;
 
         if (format == NULL) {
-                formatted = g_strdup ("");
+                event->text[0] = '\0';
         } else {
                 va_start (args, format);
-                formatted = g_strdup_vprintf (format, args);
+                g_vsnprintf (event->text, TEXT_SIZE, format, args);
                 va_end (args);
         }
 
-        if (func != NULL) {
-                str = g_strdup_printf ("MARK: %s %s: %s %s", g_get_prgname(), func, note ? note : "", formatted);
+        ring_end_event (ring);
+}
+
+static guint
+ring_begin_span (TraceRing    *ring,
+                 const char   *category,
+                 const char   *name,
+                 gconstpointer id)
+{
+        OpenSpan span;
+
+        span.category = category;
+        span.name = name;
+        span.id = id;
+        span.span_id = (guint) g_atomic_int_add (&last_span_id, 1) + 1;
+        g_array_append_val (ring->open_spans, span);
+
+        return span.span_id;
+}
+
+/* Only a handful of spans are open at any time, and the one ending is
+ * usually among the latest, so the array is searched from its end.
+ * Spans that share category, name and id end in reverse order.
+ */
+static guint
+ring_end_span (TraceRing    *ring,
+               const char   *category,
+               const char   *name,
+               gconstpointer id)
+{
+        OpenSpan *span;
+        guint span_id;
+        guint i;
+
+        for (i = ring->open_spans->len; i > 0; i--) {
+                span = &g_array_index (ring->open_spans, OpenSpan, i - 1);
+                if (span->id == id &&
+                    strcmp (span->name, name) == 0 &&
+                    strcmp (span->category, category) == 0) {
+                        span_id = span->span_id;
+                        g_array_remove_index_fast (ring->open_spans, i - 1);
+                        return span_id;
+                }
+        }
+
+        /* Begun before tracing was enabled. */
+        return 0;
+}
+
+void
+_nautilus_profile_event (const char   *category,
+                         const char   *name,
+                         char          phase,
+                         gconstpointer id,
+                         gint64        value)
+{
+        TraceRing *ring;
+        TraceEvent *event;
+
+        ring = get_ring ();
+        event = ring_begin_event (ring);
+
+        event->time_ns = get_time_ns ();
+        event->category = category;
+        event->name = name;
+        if (phase == NAUTILUS_PROFILE_PHASE_ASYNC_BEGIN) {
+                event->span_id = ring_begin_span (ring, category, name, id);
+        } else if (phase == NAUTILUS_PROFILE_PHASE_ASYNC_END) {
+                event->span_id = ring_end_span (ring, category, name, id);
         } else {
-                str = g_strdup_printf ("MARK: %s: %s %s", g_get_prgname(), note ? note : "", formatted);
+                event->span_id = 0;
+        }
+        event->value = value;
+        event->phase = phase;
+        event->text[0] = '\0';
+
+        ring_end_event (ring);
+}
+
+static void
+append_escaped (GString    *json,
+                const char *str,
+                gssize      len)
+{
+        const char *end;
+        const char *p;
+
+        /* Messages may have been cut in the middle of a character. */
+        g_utf8_validate (str, len, &end);
+
+        g_string_append_c (json, '"');
+        for (p = str; p < end; p++) {
+                switch (*p) {
+                case '"':
+                case '\\':
+                        g_string_append_c (json, '\\');
+                        g_string_append_c (json, *p);
+                        break;
+                default:
+                        if ((guchar) *p < 0x20) {
+                                g_string_append_printf (json, "\\u%04x", (guchar) *p);
+                        } else {
+                                g_string_append_c (json, *p);
+                        }
+                        break;
+                }
+        }
+        g_string_append_c (json, '"');
+}
+
+static void
+append_event (GString          *json,
+              const TraceEvent *event,
+              guint             pid,
+              guint             tid)
+{
+        g_string_append (json, "{\"name\":");
+        append_escaped (json, event->name, -1);
+        g_string_append (json, ",\"cat\":");
+        append_escaped (json, event->category, -1);
+        g_string_append_printf (json,
+                                ",\"ph\":\"%c\",\"pid\":%u,\"tid\":%u,"
+                                "\"ts\":%" G_GUINT64_FORMAT ".%03u",
+                                event->phase, pid, tid,
+                                event->time_ns / 1000,
+                                (guint) (event->time_ns % 1000));
+
+        switch (event->phase) {
+        case NAUTILUS_PROFILE_PHASE_ASYNC_BEGIN:
+        case NAUTILUS_PROFILE_PHASE_ASYNC_END:
+                g_string_append_printf (json, ",\"id\":\"0x%x\"", event->span_id);
+                break;
+        case NAUTILUS_PROFILE_PHASE_INSTANT:
+                g_string_append (json, ",\"s\":\"t\"");
+                break;
+        case NAUTILUS_PROFILE_PHASE_COUNTER:
+                g_string_append_printf (json, ",\"args\":{\"value\":%" G_GINT64_FORMAT "}",
+                                        event->value);
+                break;
+        default:
+                break;
+        }
+
+        if (event->text[0] != '\0') {
+                g_string_append (json, ",\"args\":{\"msg\":");
+                append_escaped (json, event->text, strnlen (event->text, TEXT_SIZE));
+                g_string_append_c (json, '}');
+        }
+
+        g_string_append (json, "},\n");
+}
+
+/* Writes every event still held in the rings as Chrome trace event
+ * JSON. Other threads may keep recording while this runs; events they
+ * overwrite during the copy are skipped rather than written torn.
+ */
+gboolean
+nautilus_profile_dump (const char *filename,
+                       GError    **error)
+{
+        GString *json;
+        TraceRing *ring;
+        TraceEvent event;
+        guint pid;
+        guint head, first, i, j;
+        gboolean ret;
+
+        json = g_string_new ("{\"traceEvents\":[\n");
+        pid = (guint) getpid ();
+
+        g_mutex_lock (&rings_mutex);
+        for (i = 0; rings != NULL && i < rings->len; i++) {
+                ring = g_ptr_array_index (rings, i);
+
+                head = (guint) g_atomic_int_get (&ring->head);
+                first = head > RING_SIZE ? head - RING_SIZE : 0;
+
+                for (j = first; j < head; j++) {
+                        event = ring->events[j & (RING_SIZE - 1)];
+                        /* Once the head is RING_SIZE past the slot, the
+                         * writer may be filling it in again.
+                         */
+                        if ((guint) g_atomic_int_get (&ring->head) - j >= RING_SIZE) {
+                                continue;
+                        }
+                        append_event (json, &event, pid, ring->thread_id);
+                }
+        }
+        g_mutex_unlock (&rings_mutex);
+
+        /* Drop the separator after the last event. */
+        if (json->str[json->len - 2] == ',') {
+                g_string_truncate (json, json->len - 2);
+                g_string_append_c (json, '\n');
         }
+        g_string_append (json, "],\"displayTimeUnit\":\"ns\"}\n");
+
+        ret = g_file_set_contents (filename, json->str, json->len, error);
+        g_string_free (json, TRUE);
+
+        return ret;
+}
+
+void
+nautilus_profile_init (void)
+{
+        const char *filename;
 
-        g_free (formatted);
+        filename = g_getenv ("NAUTILUS_TRACE");
+        if (filename == NULL || filename[0] == '\0') {
+                return;
+        }
+
+        g_free (trace_filename);
+        trace_filename = g_strdup (filename);
+        nautilus_profile_enabled = TRUE;
+}
+
+void
+nautilus_profile_shut_down (void)
+{
+        GError *error;
+
+        if (trace_filename == NULL) {
+                return;
+        }
+
+        nautilus_profile_enabled = FALSE;
+
+        error = NULL;
+        if (!nautilus_profile_dump (trace_filename, &error)) {
+                g_warning ("Could not write trace to %s: %s",
+                           trace_filename, error->message);
+                g_error_free (error);
+        }
 
-        g_access (str, F_OK);
-        g_free (str);
+        g_clear_pointer (&trace_filename, g_free);
 }
@@ -18,10 +18,12 @@
  * Authors: William Jon McCann <mccann@jhu.edu>
  *
  * Can be profiled like so:
- *       strace -ttt -f -o /tmp/logfile.strace nautilus
- *       python plot-timeline.py -o prettygraph.png /tmp/logfile.strace
+ *       NAUTILUS_TRACE=/tmp/nautilus-trace.json nautilus
  *
- *       See: http://www.gnome.org/~federico/news-2006-03.html#09
+ * and the resulting file loaded into chrome://tracing or any other
+ * viewer that understands the Chrome trace event format. Events are
+ * recorded into per-thread ring buffers, so only the most recent ones
+ * are kept for long running sessions.
  */
 
 #ifndef __NAUTILUS_PROFILE_H
@@ -31,26 +33,69 @@
 
 G_BEGIN_DECLS
 
-#ifdef ENABLE_PROFILING
+#define NAUTILUS_PROFILE_PHASE_BEGIN       'B'
+#define NAUTILUS_PROFILE_PHASE_END         'E'
+#define NAUTILUS_PROFILE_PHASE_INSTANT     'i'
+#define NAUTILUS_PROFILE_PHASE_ASYNC_BEGIN 'b'
+#define NAUTILUS_PROFILE_PHASE_ASYNC_END   'e'
+#define NAUTILUS_PROFILE_PHASE_COUNTER     'C'
+
+/* Only read by the macros below; use nautilus_profile_init() to change it. */
+extern gboolean nautilus_profile_enabled;
+
+#define NAUTILUS_PROFILE_IF_ENABLED(call) \
+        G_STMT_START { if (G_UNLIKELY (nautilus_profile_enabled)) { call; } } G_STMT_END
+
+/* Spans and messages attributed to the calling function. The format
+ * arguments are not evaluated unless tracing is enabled.
+ */
 #ifdef G_HAVE_ISO_VARARGS
-#define nautilus_profile_start(...) _nautilus_profile_log (G_STRFUNC, "start", __VA_ARGS__)
-#define nautilus_profile_end(...)   _nautilus_profile_log (G_STRFUNC, "end", __VA_ARGS__)
-#define nautilus_profile_msg(...)   _nautilus_profile_log (NULL, NULL, __VA_ARGS__)
+#define nautilus_profile_start(...) \
+        NAUTILUS_PROFILE_IF_ENABLED (_nautilus_profile_log (G_STRFUNC, NAUTILUS_PROFILE_PHASE_BEGIN, __VA_ARGS__))
+#define nautilus_profile_end(...) \
+        NAUTILUS_PROFILE_IF_ENABLED (_nautilus_profile_log (G_STRFUNC, NAUTILUS_PROFILE_PHASE_END, __VA_ARGS__))
+#define nautilus_profile_msg(...) \
+        NAUTILUS_PROFILE_IF_ENABLED (_nautilus_profile_log (G_STRFUNC, NAUTILUS_PROFILE_PHASE_INSTANT, __VA_ARGS__))
 #elif defined(G_HAVE_GNUC_VARARGS)
-#define nautilus_profile_start(format...) _nautilus_profile_log (G_STRFUNC, "start", format)
-#define nautilus_profile_end(format...)   _nautilus_profile_log (G_STRFUNC, "end", format)
-#define nautilus_profile_msg(format...)   _nautilus_profile_log (NULL, NULL, format)
-#endif
-#else
-#define nautilus_profile_start(...)
-#define nautilus_profile_end(...)
-#define nautilus_profile_msg(...)
+#define nautilus_profile_start(format...) \
+        NAUTILUS_PROFILE_IF_ENABLED (_nautilus_profile_log (G_STRFUNC, NAUTILUS_PROFILE_PHASE_BEGIN, format))
+#define nautilus_profile_end(format...) \
+        NAUTILUS_PROFILE_IF_ENABLED (_nautilus_profile_log (G_STRFUNC, NAUTILUS_PROFILE_PHASE_END, format))
+#define nautilus_profile_msg(format...) \
+        NAUTILUS_PROFILE_IF_ENABLED (_nautilus_profile_log (G_STRFUNC, NAUTILUS_PROFILE_PHASE_INSTANT, format))
 #endif
 
+/* Spans that start and finish in different places, possibly overlapping
+ * with each other, such as the directory jobs. Category and name must be
+ * static strings. Begin and end have to be called from the same thread,
+ * which matches them on category, name and id; each span is written out
+ * with an id of its own, so spans sharing all three still stay apart.
+ */
+#define nautilus_profile_async_begin(category, name, id) \
+        NAUTILUS_PROFILE_IF_ENABLED (_nautilus_profile_event (category, name, NAUTILUS_PROFILE_PHASE_ASYNC_BEGIN, id, 0))
+#define nautilus_profile_async_end(category, name, id) \
+        NAUTILUS_PROFILE_IF_ENABLED (_nautilus_profile_event (category, name, NAUTILUS_PROFILE_PHASE_ASYNC_END, id, 0))
+
+/* A sampled integer value, drawn as a graph by trace viewers. */
+#define nautilus_profile_counter(category, name, value) \
+        NAUTILUS_PROFILE_IF_ENABLED (_nautilus_profile_event (category, name, NAUTILUS_PROFILE_PHASE_COUNTER, NULL, value))
+
+/* Reads NAUTILUS_TRACE and starts recording if it names a file. */
+void            nautilus_profile_init    (void);
+/* Writes the trace to the NAUTILUS_TRACE file, if any. */
+void            nautilus_profile_shut_down (void);
+gboolean        nautilus_profile_dump    (const char *filename,
+                                          GError    **error);
+
 void            _nautilus_profile_log    (const char *func,
-                                          const char *note,
+                                          char        phase,
                                           const char *format,
                                           ...) G_GNUC_PRINTF (3, 4);
+void            _nautilus_profile_event  (const char   *category,
+                                          const char   *name,
+                                          char          phase,
+                                          gconstpointer id,
+                                          gint64        value);
 
 G_END_DECLS
 
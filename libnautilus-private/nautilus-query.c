@@ -25,6 +25,7 @@
 
 #include <eel/eel-glib-extensions.h>
 #include <glib/gi18n.h>
+#include <gio/gio.h>
 
 #include "nautilus-file-utilities.h"
 #include "nautilus-query.h"
@@ -76,8 +77,11 @@ nautilus_query_init (NautilusQuery *query)
 	query->details->location_uri = nautilus_get_home_directory_uri ();
 }
 
-static gchar *
-prepare_string_for_compare (const gchar *string)
+/* Returns @string normalized the way names and query words are before
+ * they are compared.
+ */
+gchar *
+nautilus_query_prepare_string (const gchar *string)
 {
 	gchar *normalized, *res;
 
@@ -88,6 +92,18 @@ prepare_string_for_compare (const gchar *string)
 	return res;
 }
 
+static void
+prepare_words (NautilusQuery *query)
+{
+	gchar *prepared_string;
+
+	if (!query->details->prepared_words) {
+		prepared_string = nautilus_query_prepare_string (query->details->text);
+		query->details->prepared_words = g_strsplit (prepared_string, " ", -1);
+		g_free (prepared_string);
+	}
+}
+
 gdouble
 nautilus_query_matches_string (NautilusQuery *query,
 			       const gchar *string)
@@ -101,13 +117,9 @@ nautilus_query_matches_string (NautilusQuery *query,
 		return -1;
 	}
 
-	if (!query->details->prepared_words) {
-		prepared_string = prepare_string_for_compare (query->details->text);
-		query->details->prepared_words = g_strsplit (prepared_string, " ", -1);
-		g_free (prepared_string);
-	}
+	prepare_words (query);
 
-	prepared_string = prepare_string_for_compare (string);
+	prepared_string = nautilus_query_prepare_string (string);
 	found = TRUE;
 	ptr = NULL;
 	nonexact_malus = 0;
@@ -132,6 +144,71 @@ nautilus_query_matches_string (NautilusQuery *query,
 	return retval;
 }
 
+/* Returns TRUE if everything @query matches is also matched by @other,
+ * that is if @query was made from @other by typing more characters or
+ * words, or by narrowing the mime type filter. The hits of @other can
+ * then be filtered instead of searching again.
+ */
+gboolean
+nautilus_query_is_refinement_of (NautilusQuery *query,
+				 NautilusQuery *other)
+{
+	GList *l, *m;
+	gboolean contained;
+	gint i, j;
+
+	if (!query->details->text || !other->details->text) {
+		return FALSE;
+	}
+
+	if (g_strcmp0 (query->details->location_uri, other->details->location_uri) != 0) {
+		return FALSE;
+	}
+
+	if (query->details->show_hidden && !other->details->show_hidden) {
+		return FALSE;
+	}
+
+	prepare_words (query);
+	prepare_words (other);
+
+	/* A name containing all the new words contains all the old ones
+	 * if each old word is part of a new one.
+	 */
+	for (i = 0; other->details->prepared_words[i] != NULL; i++) {
+		contained = FALSE;
+		for (j = 0; query->details->prepared_words[j] != NULL && !contained; j++) {
+			contained = strstr (query->details->prepared_words[j],
+					    other->details->prepared_words[i]) != NULL;
+		}
+
+		if (!contained) {
+			return FALSE;
+		}
+	}
+
+	if (other->details->mime_types == NULL) {
+		return TRUE;
+	}
+
+	if (query->details->mime_types == NULL) {
+		return FALSE;
+	}
+
+	for (l = query->details->mime_types; l != NULL; l = l->next) {
+		contained = FALSE;
+		for (m = other->details->mime_types; m != NULL && !contained; m = m->next) {
+			contained = g_content_type_is_a (l->data, m->data);
+		}
+
+		if (!contained) {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
 NautilusQuery *
 nautilus_query_new (void)
 {
@@ -60,7 +60,9 @@ GList *        nautilus_query_get_mime_types     (NautilusQuery *query);
 void           nautilus_query_set_mime_types     (NautilusQuery *query, GList *mime_types);
 void           nautilus_query_add_mime_type      (NautilusQuery *query, const char *mime_type);
 
+gchar *        nautilus_query_prepare_string     (const gchar *string);
 gdouble        nautilus_query_matches_string     (NautilusQuery *query, const gchar *string);
+gboolean       nautilus_query_is_refinement_of   (NautilusQuery *query, NautilusQuery *other);
 
 char *         nautilus_query_to_readable_string (NautilusQuery *query);
 NautilusQuery *nautilus_query_load               (char *file);
@@ -36,6 +36,13 @@
 #include <string.h>
 #include <sys/time.h>
 
+/* Every hit is listed, but monitoring a file watches its folder and
+ * broad searches find files in thousands of folders. Only the files
+ * that views show or have selected, and then the best ones, are
+ * monitored, up to this many. The others are read once.
+ */
+#define MAX_MONITORED_RESULTS 1000
+
 struct NautilusSearchDirectoryDetails {
 	NautilusQuery *query;
 	char *saved_search_uri;
@@ -45,9 +52,19 @@ struct NautilusSearchDirectoryDetails {
 
 	gboolean search_running;
 	gboolean search_loaded;
-
-	GList *files;
+	/* The query was narrowed while searching, so hits found for the
+	 * previous one have to be checked against it.
+	 */
+	gboolean search_refined;
+
+	/* All hits, best first */
+	GSequence *results;
+	GHashTable *results_by_uri;
+	/* The file of each result to its place in results */
 	GHashTable *files_hash;
+	/* Results that views show or have selected */
+	GHashTable *shown_files;
+	guint n_monitored;
 
 	GList *monitor_list;
 	GList *callback_list;
@@ -56,6 +73,15 @@ struct NautilusSearchDirectoryDetails {
 	NautilusDirectory *base_model;
 };
 
+typedef struct {
+	char *uri;
+	gdouble relevance;
+	NautilusFile *file;
+	gboolean monitored;
+	/* Waiting for the file to be read */
+	gboolean reading;
+} SearchResult;
+
 typedef struct {
 	gboolean monitor_hidden_files;
 	NautilusFileAttributes monitor_attributes;
@@ -91,33 +117,131 @@ static void search_engine_hits_added (NautilusSearchEngine *engine, GList *hits,
 static void search_engine_error (NautilusSearchEngine *engine, const char *error, NautilusSearchDirectory *search);
 static void search_callback_file_ready_callback (NautilusFile *file, gpointer data);
 static void file_changed (NautilusFile *file, NautilusSearchDirectory *search);
+static void result_file_ready_callback (NautilusFile *file, gpointer data);
 
 static void
-reset_file_list (NautilusSearchDirectory *search)
+result_set_monitored (NautilusSearchDirectory *search,
+		      SearchResult *result,
+		      gboolean monitored)
 {
-	GList *list, *monitor_list;
-	NautilusFile *file;
+	GList *monitor_list;
 	SearchMonitor *monitor;
 
-	/* Remove file connections */
-	for (list = search->details->files; list != NULL; list = list->next) {
-		file = list->data;
+	if (result->monitored == monitored) {
+		return;
+	}
 
-		/* Disconnect change handler */
-		g_signal_handlers_disconnect_by_func (file, file_changed, search);
+	result->monitored = monitored;
+	if (monitored) {
+		search->details->n_monitored++;
+	} else {
+		search->details->n_monitored--;
+	}
 
-		/* Remove monitors */
-		for (monitor_list = search->details->monitor_list; monitor_list; 
-		     monitor_list = monitor_list->next) {
-			monitor = monitor_list->data;
-			nautilus_file_monitor_remove (file, monitor);
+	for (monitor_list = search->details->monitor_list; monitor_list;
+	     monitor_list = monitor_list->next) {
+		monitor = monitor_list->data;
+		if (monitored) {
+			nautilus_file_monitor_add (result->file, monitor, monitor->monitor_attributes);
+		} else {
+			nautilus_file_monitor_remove (result->file, monitor);
 		}
 	}
-	
-	nautilus_file_list_free (search->details->files);
-	search->details->files = NULL;
+}
+
+/* A file that is not monitored is read once, for views to list it */
+static void
+result_read_file (NautilusSearchDirectory *search,
+		  SearchResult *result)
+{
+	if (result->monitored || result->reading ||
+	    search->details->monitor_list == NULL ||
+	    nautilus_file_check_if_ready (result->file, NAUTILUS_FILE_ATTRIBUTES_FOR_ICON)) {
+		return;
+	}
+
+	result->reading = TRUE;
+	nautilus_file_call_when_ready (result->file, NAUTILUS_FILE_ATTRIBUTES_FOR_ICON,
+				       result_file_ready_callback, search);
+}
+
+static void
+remove_file_connections (NautilusSearchDirectory *search,
+			 SearchResult *result)
+{
+	/* Disconnect change handler */
+	g_signal_handlers_disconnect_by_func (result->file, file_changed, search);
+
+	/* Remove monitors */
+	result_set_monitored (search, result, FALSE);
+
+	if (result->reading) {
+		nautilus_file_cancel_call_when_ready (result->file, result_file_ready_callback, search);
+		result->reading = FALSE;
+	}
+}
+
+static void
+search_result_free (SearchResult *result)
+{
+	g_free (result->uri);
+	nautilus_file_unref (result->file);
+	g_free (result);
+}
+
+static gint
+compare_results (gconstpointer a,
+		 gconstpointer b,
+		 gpointer user_data)
+{
+	const SearchResult *result_a = a;
+	const SearchResult *result_b = b;
+
+	if (result_a->relevance > result_b->relevance) {
+		return -1;
+	}
+	if (result_a->relevance < result_b->relevance) {
+		return 1;
+	}
+	return 0;
+}
+
+/* The files of all results, best first */
+static GList *
+get_result_files (NautilusSearchDirectory *search)
+{
+	GSequenceIter *iter;
+	SearchResult *result;
+	GList *files;
 
+	files = NULL;
+	for (iter = g_sequence_get_begin_iter (search->details->results);
+	     !g_sequence_iter_is_end (iter);
+	     iter = g_sequence_iter_next (iter)) {
+		result = g_sequence_get (iter);
+		files = g_list_prepend (files, result->file);
+	}
+
+	return g_list_reverse (files);
+}
+
+static void
+reset_file_list (NautilusSearchDirectory *search)
+{
+	GHashTableIter iter;
+	gpointer value;
+
+	/* Remove file connections */
+	g_hash_table_iter_init (&iter, search->details->files_hash);
+	while (g_hash_table_iter_next (&iter, NULL, &value)) {
+		remove_file_connections (search, g_sequence_get (value));
+	}
+
+	g_hash_table_remove_all (search->details->shown_files);
 	g_hash_table_remove_all (search->details->files_hash);
+	g_hash_table_remove_all (search->details->results_by_uri);
+	g_sequence_remove_range (g_sequence_get_begin_iter (search->details->results),
+				 g_sequence_get_end_iter (search->details->results));
 }
 
 static void
@@ -160,6 +284,7 @@ start_search (NautilusSearchDirectory *search)
 	/* We need to start the search engine */
 	search->details->search_running = TRUE;
 	search->details->search_loaded = FALSE;
+	search->details->search_refined = FALSE;
 
 	set_hidden_files (search);
 	nautilus_search_provider_set_query (NAUTILUS_SEARCH_PROVIDER (search->details->engine),
@@ -208,10 +333,11 @@ search_monitor_add (NautilusDirectory *directory,
 		    NautilusDirectoryCallback callback,
 		    gpointer callback_data)
 {
-	GList *list;
+	GList *files;
 	SearchMonitor *monitor;
 	NautilusSearchDirectory *search;
-	NautilusFile *file;
+	SearchResult *result;
+	GSequenceIter *iter;
 
 	search = NAUTILUS_SEARCH_DIRECTORY (directory);
 
@@ -221,16 +347,24 @@ search_monitor_add (NautilusDirectory *directory,
 	monitor->client = client;
 
 	search->details->monitor_list = g_list_prepend (search->details->monitor_list, monitor);
-	
+
 	if (callback != NULL) {
-		(* callback) (directory, search->details->files, callback_data);
+		files = get_result_files (search);
+		(* callback) (directory, files, callback_data);
+		g_list_free (files);
 	}
-	
-	for (list = search->details->files; list != NULL; list = list->next) {
-		file = list->data;
+
+	for (iter = g_sequence_get_begin_iter (search->details->results);
+	     !g_sequence_iter_is_end (iter);
+	     iter = g_sequence_iter_next (iter)) {
+		result = g_sequence_get (iter);
 
 		/* Add monitors */
-		nautilus_file_monitor_add (file, monitor, file_attributes);
+		if (result->monitored) {
+			nautilus_file_monitor_add (result->file, monitor, file_attributes);
+		} else {
+			result_read_file (search, result);
+		}
 	}
 
 	start_search (search);
@@ -239,13 +373,14 @@ search_monitor_add (NautilusDirectory *directory,
 static void
 search_monitor_remove_file_monitors (SearchMonitor *monitor, NautilusSearchDirectory *search)
 {
-	GList *list;
-	NautilusFile *file;
-	
-	for (list = search->details->files; list != NULL; list = list->next) {
-		file = list->data;
+	GHashTableIter iter;
+	gpointer file, value;
 
-		nautilus_file_monitor_remove (file, monitor);
+	g_hash_table_iter_init (&iter, search->details->files_hash);
+	while (g_hash_table_iter_next (&iter, &file, &value)) {
+		if (((SearchResult *) g_sequence_get (value))->monitored) {
+			nautilus_file_monitor_remove (file, monitor);
+		}
 	}
 }
 
@@ -447,8 +582,9 @@ search_call_when_ready (NautilusDirectory *directory,
 		/* We might need to start the search engine */
 		start_search (search);
 	} else {
-		search_callback->file_list = nautilus_file_list_copy (search->details->files);
-		search_callback->non_ready_hash = file_list_to_hash_table (search->details->files);
+		search_callback->file_list = get_result_files (search);
+		nautilus_file_list_ref (search_callback->file_list);
+		search_callback->non_ready_hash = file_list_to_hash_table (search_callback->file_list);
 
 		if (!search_callback->non_ready_hash) {
 			/* If there are no ready files, we invoke the callback
@@ -498,8 +634,9 @@ search_cancel_callback (NautilusDirectory *directory,
 static void
 search_callback_add_pending_file_callbacks (SearchCallback *callback)
 {
-	callback->file_list = nautilus_file_list_copy (callback->search_directory->details->files);
-	callback->non_ready_hash = file_list_to_hash_table (callback->search_directory->details->files);
+	callback->file_list = get_result_files (callback->search_directory);
+	nautilus_file_list_ref (callback->file_list);
+	callback->non_ready_hash = file_list_to_hash_table (callback->file_list);
 
 	search_callback_add_file_callbacks (callback);
 }
@@ -524,18 +661,208 @@ search_directory_ensure_loaded (NautilusSearchDirectory *search)
 	search->details->pending_callback_list = NULL;
 }
 
+/* The name a file would be shown with, from its URI */
+static char *
+get_display_name_for_uri (const char *uri)
+{
+	const char *start, *end;
+	char *name, *display_name;
+
+	end = uri + strlen (uri);
+	if (end > uri && end[-1] == '/') {
+		end--;
+	}
+	for (start = end; start > uri && start[-1] != '/'; start--) {
+	}
+
+	name = g_uri_unescape_segment (start, end, NULL);
+	if (name == NULL) {
+		return g_strndup (start, end - start);
+	}
+
+	display_name = g_filename_display_name (name);
+	g_free (name);
+
+	return display_name;
+}
+
+/* Matches a result against a query the way the search engines do, by
+ * its name and, if the query has any, by its mime type.
+ */
+static gboolean
+result_matches_query (SearchResult *result,
+		      NautilusQuery *query,
+		      GList *mime_types)
+{
+	char *display_name, *mime_type;
+	gboolean found;
+	GList *l;
+
+	if (result->file != NULL) {
+		display_name = nautilus_file_get_display_name (result->file);
+	} else {
+		display_name = get_display_name_for_uri (result->uri);
+	}
+	found = nautilus_query_matches_string (query, display_name) > -1;
+
+	if (found && mime_types != NULL) {
+		/* Hits are often not loaded yet, guess from the name then */
+		if (result->file != NULL &&
+		    nautilus_file_check_if_ready (result->file, NAUTILUS_FILE_ATTRIBUTE_INFO)) {
+			mime_type = nautilus_file_get_mime_type (result->file);
+		} else {
+			mime_type = g_content_type_guess (display_name, NULL, 0, NULL);
+		}
+
+		found = FALSE;
+		for (l = mime_types; l != NULL && !found; l = l->next) {
+			found = g_content_type_is_a (mime_type, l->data);
+		}
+		g_free (mime_type);
+	}
+
+	g_free (display_name);
+
+	return found;
+}
+
+static void
+result_file_ready_callback (NautilusFile *file,
+			    gpointer data)
+{
+	NautilusSearchDirectory *search;
+	GSequenceIter *iter;
+
+	search = NAUTILUS_SEARCH_DIRECTORY (data);
+	iter = g_hash_table_lookup (search->details->files_hash, file);
+	if (iter != NULL) {
+		((SearchResult *) g_sequence_get (iter))->reading = FALSE;
+	}
+}
+
+static void
+result_add_file (NautilusSearchDirectory *search,
+		 GSequenceIter *iter)
+{
+	SearchResult *result;
+
+	result = g_sequence_get (iter);
+	result->file = nautilus_file_get_by_uri (result->uri);
+	nautilus_file_set_search_relevance (result->file, result->relevance);
+
+	g_signal_connect (result->file, "changed", G_CALLBACK (file_changed), search);
+
+	g_hash_table_insert (search->details->files_hash, result->file, iter);
+}
+
+/* Returns the file of the result, which it no longer has */
+static NautilusFile *
+result_remove_file (NautilusSearchDirectory *search,
+		    GSequenceIter *iter)
+{
+	SearchResult *result;
+	NautilusFile *file;
+
+	result = g_sequence_get (iter);
+	remove_file_connections (search, result);
+
+	file = result->file;
+	result->file = NULL;
+	g_hash_table_remove (search->details->shown_files, file);
+	g_hash_table_remove (search->details->files_hash, file);
+
+	return file;
+}
+
+/* Monitors the results that views show or have selected, and then the
+ * best ones, up to MAX_MONITORED_RESULTS. The others are read once.
+ */
+static void
+update_monitored_results (NautilusSearchDirectory *search)
+{
+	GSequenceIter *iter;
+	SearchResult *result;
+	guint n_shown, n_best, n_seen;
+	gboolean monitored;
+
+	n_shown = MIN (g_hash_table_size (search->details->shown_files), MAX_MONITORED_RESULTS);
+	n_best = MAX_MONITORED_RESULTS - n_shown;
+	n_seen = 0;
+
+	for (iter = g_sequence_get_begin_iter (search->details->results);
+	     !g_sequence_iter_is_end (iter);
+	     iter = g_sequence_iter_next (iter)) {
+		/* Nothing further down is or will be monitored */
+		if (n_shown == 0 && n_best == 0 &&
+		    n_seen == search->details->n_monitored) {
+			break;
+		}
+
+		result = g_sequence_get (iter);
+		if (g_hash_table_contains (search->details->shown_files, result->file)) {
+			monitored = n_shown > 0;
+			if (monitored) {
+				n_shown--;
+			}
+		} else {
+			monitored = n_best > 0;
+			if (monitored) {
+				n_best--;
+			}
+		}
+
+		result_set_monitored (search, result, monitored);
+		if (monitored) {
+			n_seen++;
+		} else {
+			result_read_file (search, result);
+		}
+	}
+}
+
+static void
+emit_results_changed (NautilusSearchDirectory *search,
+		      GList *added,
+		      GList *removed)
+{
+	NautilusFile *file;
+
+	if (removed != NULL) {
+		/* Views drop changed files the directory no longer contains */
+		nautilus_directory_emit_files_changed (NAUTILUS_DIRECTORY (search), removed);
+		nautilus_file_list_free (removed);
+	}
+
+	if (added != NULL) {
+		added = g_list_reverse (added);
+		nautilus_directory_emit_files_added (NAUTILUS_DIRECTORY (search), added);
+		g_list_free (added);
+	}
+
+	file = nautilus_directory_get_corresponding_file (NAUTILUS_DIRECTORY (search));
+	nautilus_file_emit_changed (file);
+	nautilus_file_unref (file);
+}
+
 static void
 search_engine_hits_added (NautilusSearchEngine *engine, GList *hits, 
 			  NautilusSearchDirectory *search)
 {
 	GList *hit_list;
-	GList *file_list;
-	NautilusFile *file;
-	SearchMonitor *monitor;
-	GList *monitor_list;
+	GList *added, *l;
+	GList *mime_types;
+	GSequenceIter *iter;
+	SearchResult *result;
+
+	mime_types = NULL;
+	if (search->details->search_refined) {
+		mime_types = nautilus_query_get_mime_types (search->details->query);
+	}
 
-	file_list = NULL;
+	/* Hits from the crawling providers come scored already */
+	nautilus_search_hit_list_compute_scores (hits, search->details->query);
 
+	added = NULL;
 	for (hit_list = hits; hit_list != NULL; hit_list = hit_list->next) {
 		NautilusSearchHit *hit = hit_list->data;
 		const char *uri;
@@ -546,31 +873,37 @@ search_engine_hits_added (NautilusSearchEngine *engine, GList *hits,
 			continue;
 		}
 
-		nautilus_search_hit_compute_scores (hit, search->details->query);
-
-		file = nautilus_file_get_by_uri (uri);
-		nautilus_file_set_search_relevance (file, nautilus_search_hit_get_relevance (hit));
+		if (g_hash_table_contains (search->details->results_by_uri, uri)) {
+			continue;
+		}
 
-		for (monitor_list = search->details->monitor_list; monitor_list; monitor_list = monitor_list->next) {
-			monitor = monitor_list->data;
+		result = g_new0 (SearchResult, 1);
+		result->uri = g_strdup (uri);
+		result->relevance = nautilus_search_hit_get_relevance (hit);
 
-			/* Add monitors */
-			nautilus_file_monitor_add (file, monitor, monitor->monitor_attributes);
+		/* Found before the query was narrowed */
+		if (search->details->search_refined &&
+		    !result_matches_query (result, search->details->query, mime_types)) {
+			search_result_free (result);
+			continue;
 		}
 
-		g_signal_connect (file, "changed", G_CALLBACK (file_changed), search),
-
-		file_list = g_list_prepend (file_list, file);
-		g_hash_table_add (search->details->files_hash, file);
+		iter = g_sequence_insert_sorted (search->details->results, result,
+						 compare_results, NULL);
+		g_hash_table_insert (search->details->results_by_uri, result->uri, iter);
+		result_add_file (search, iter);
+		added = g_list_prepend (added, result->file);
 	}
 	
-	search->details->files = g_list_concat (search->details->files, file_list);
-
-	nautilus_directory_emit_files_added (NAUTILUS_DIRECTORY (search), file_list);
+	g_list_free_full (mime_types, g_free);
 
-	file = nautilus_directory_get_corresponding_file (NAUTILUS_DIRECTORY (search));
-	nautilus_file_emit_changed (file);
-	nautilus_file_unref (file);
+	/* Better hits take the monitors of the ones they pushed down */
+	update_monitored_results (search);
+	for (l = added; l != NULL; l = l->next) {
+		iter = g_hash_table_lookup (search->details->files_hash, l->data);
+		result_read_file (search, g_sequence_get (iter));
+	}
+	emit_results_changed (search, added, NULL);
 
 	search_directory_ensure_loaded (search);
 }
@@ -629,7 +962,7 @@ search_contains_file (NautilusDirectory *directory,
 	NautilusSearchDirectory *search;
 
 	search = NAUTILUS_SEARCH_DIRECTORY (directory);
-	return (g_hash_table_lookup (search->details->files_hash, file) != NULL);
+	return g_hash_table_contains (search->details->files_hash, file);
 }
 
 static GList *
@@ -639,7 +972,7 @@ search_get_file_list (NautilusDirectory *directory)
 
 	search = NAUTILUS_SEARCH_DIRECTORY (directory);
 
-	return nautilus_file_list_copy (search->details->files);
+	return nautilus_file_list_ref (get_result_files (search));
 }
 
 
@@ -755,6 +1088,9 @@ search_finalize (GObject *object)
 	g_free (search->details->saved_search_uri);
 
 	g_hash_table_destroy (search->details->files_hash);
+	g_hash_table_destroy (search->details->shown_files);
+	g_hash_table_destroy (search->details->results_by_uri);
+	g_sequence_free (search->details->results);
 
 	G_OBJECT_CLASS (nautilus_search_directory_parent_class)->finalize (object);
 }
@@ -765,7 +1101,11 @@ nautilus_search_directory_init (NautilusSearchDirectory *search)
 	search->details = G_TYPE_INSTANCE_GET_PRIVATE (search, NAUTILUS_TYPE_SEARCH_DIRECTORY,
 						       NautilusSearchDirectoryDetails);
 
+	search->details->results = g_sequence_new ((GDestroyNotify) search_result_free);
+	search->details->results_by_uri = g_hash_table_new (g_str_hash, g_str_equal);
 	search->details->files_hash = g_hash_table_new (g_direct_hash, g_direct_equal);
+	search->details->shown_files = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+							     (GDestroyNotify) nautilus_file_unref, NULL);
 
 	search->details->engine = nautilus_search_engine_new ();
 	g_signal_connect (search->details->engine, "hits-added",
@@ -899,6 +1239,84 @@ nautilus_search_directory_set_query (NautilusSearchDirectory *search,
 	nautilus_file_unref (file);
 }
 
+/* Narrows the search to @query without starting over, if @query only
+ * matches a subset of what the current query matches. The files that
+ * do not match any more are removed and the running search goes on
+ * with the new query. Returns FALSE if the search has to be reloaded.
+ */
+gboolean
+nautilus_search_directory_refine_query (NautilusSearchDirectory *search,
+					NautilusQuery *query)
+{
+	GList *removed, *mime_types;
+	GSequenceIter *iter, *next;
+	SearchResult *result;
+
+	if (!search->details->search_running ||
+	    search->details->query == NULL ||
+	    search->details->query == query) {
+		return FALSE;
+	}
+
+	/* Hidden files follow the monitors, not the query editor */
+	nautilus_query_set_show_hidden_files (query,
+					      nautilus_query_get_show_hidden_files (search->details->query));
+
+	if (!nautilus_query_is_refinement_of (query, search->details->query)) {
+		return FALSE;
+	}
+
+	nautilus_search_directory_set_query (search, query);
+	nautilus_search_provider_set_query (NAUTILUS_SEARCH_PROVIDER (search->details->engine),
+					    query);
+	search->details->search_refined = TRUE;
+
+	mime_types = nautilus_query_get_mime_types (query);
+	removed = NULL;
+	for (iter = g_sequence_get_begin_iter (search->details->results);
+	     !g_sequence_iter_is_end (iter); iter = next) {
+		next = g_sequence_iter_next (iter);
+		result = g_sequence_get (iter);
+
+		if (result_matches_query (result, query, mime_types)) {
+			continue;
+		}
+
+		removed = g_list_prepend (removed, result_remove_file (search, iter));
+		g_hash_table_remove (search->details->results_by_uri, result->uri);
+		g_sequence_remove (iter);
+	}
+	g_list_free_full (mime_types, g_free);
+
+	/* The next best results take over their monitors */
+	if (removed != NULL) {
+		update_monitored_results (search);
+		emit_results_changed (search, NULL, removed);
+	}
+
+	return TRUE;
+}
+
+/* Tells which results views show or have selected, these are the ones
+ * monitored first.
+ */
+void
+nautilus_search_directory_set_shown_files (NautilusSearchDirectory *search,
+					   GList *files)
+{
+	GList *l;
+
+	g_hash_table_remove_all (search->details->shown_files);
+	for (l = files; l != NULL; l = l->next) {
+		if (g_hash_table_contains (search->details->files_hash, l->data) &&
+		    !g_hash_table_contains (search->details->shown_files, l->data)) {
+			g_hash_table_add (search->details->shown_files, nautilus_file_ref (l->data));
+		}
+	}
+
+	update_monitored_results (search);
+}
+
 NautilusQuery *
 nautilus_search_directory_get_query (NautilusSearchDirectory *search)
 {
@@ -64,6 +64,12 @@ void           nautilus_search_directory_save_to_file    (NautilusSearchDirector
 NautilusQuery *nautilus_search_directory_get_query       (NautilusSearchDirectory *search);
 void           nautilus_search_directory_set_query       (NautilusSearchDirectory *search,
 							  NautilusQuery           *query);
+gboolean       nautilus_search_directory_refine_query    (NautilusSearchDirectory *search,
+							  NautilusQuery           *query);
+
+/* Results on screen or selected, which are monitored before others */
+void           nautilus_search_directory_set_shown_files (NautilusSearchDirectory *search,
+							  GList                   *files);
 
 NautilusDirectory *
                nautilus_search_directory_get_base_model (NautilusSearchDirectory  *search);
@@ -0,0 +1,252 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * nautilus-search-engine-index.c: search provider using the filename index
+ *
+ * Nautilus is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * Nautilus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; see the file COPYING.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <config.h>
+#include "nautilus-filename-index.h"
+#include "nautilus-search-hit.h"
+#include "nautilus-search-provider.h"
+#include "nautilus-search-engine-index.h"
+#define DEBUG_FLAG NAUTILUS_DEBUG_SEARCH
+#include "nautilus-debug.h"
+
+#include <glib.h>
+#include <gio/gio.h>
+
+typedef struct {
+	NautilusSearchEngineIndex *engine;
+	GCancellable *cancellable;
+	NautilusQuery *query;
+	NautilusFilenameIndexSearch *search;
+} SearchThreadData;
+
+struct NautilusSearchEngineIndexDetails {
+	NautilusQuery *query;
+
+	SearchThreadData *active_search;
+};
+
+static void nautilus_search_provider_init (NautilusSearchProviderIface  *iface);
+
+G_DEFINE_TYPE_WITH_CODE (NautilusSearchEngineIndex,
+			 nautilus_search_engine_index,
+			 G_TYPE_OBJECT,
+			 G_IMPLEMENT_INTERFACE (NAUTILUS_TYPE_SEARCH_PROVIDER,
+						nautilus_search_provider_init))
+
+static void
+finalize (GObject *object)
+{
+	NautilusSearchEngineIndex *index;
+
+	index = NAUTILUS_SEARCH_ENGINE_INDEX (object);
+	g_clear_object (&index->details->query);
+
+	G_OBJECT_CLASS (nautilus_search_engine_index_parent_class)->finalize (object);
+}
+
+static SearchThreadData *
+search_thread_data_new (NautilusSearchEngineIndex *engine,
+			NautilusQuery *query)
+{
+	SearchThreadData *data;
+
+	data = g_new0 (SearchThreadData, 1);
+	data->engine = g_object_ref (engine);
+	data->cancellable = g_cancellable_new ();
+	data->query = g_object_ref (query);
+	data->search = nautilus_filename_index_search_new (query);
+
+	return data;
+}
+
+static void
+search_thread_data_free (SearchThreadData *data)
+{
+	nautilus_filename_index_search_free (data->search);
+	g_object_unref (data->cancellable);
+	g_object_unref (data->query);
+	g_object_unref (data->engine);
+
+	g_free (data);
+}
+
+static gboolean
+search_thread_done_idle (gpointer user_data)
+{
+	SearchThreadData *data = user_data;
+	NautilusSearchEngineIndex *engine = data->engine;
+
+	DEBUG ("Index engine done");
+
+	/* A stopped search may finish after a new one was started */
+	if (engine->details->active_search == data) {
+		engine->details->active_search = NULL;
+	}
+	nautilus_search_provider_finished (NAUTILUS_SEARCH_PROVIDER (engine));
+
+	search_thread_data_free (data);
+
+	return FALSE;
+}
+
+typedef struct {
+	GList *hits;
+	SearchThreadData *thread_data;
+} SearchHitsData;
+
+static gboolean
+search_thread_add_hits_idle (gpointer user_data)
+{
+	SearchHitsData *data = user_data;
+
+	DEBUG ("Index engine add hits");
+
+	if (!g_cancellable_is_cancelled (data->thread_data->cancellable)) {
+		nautilus_search_provider_hits_added (NAUTILUS_SEARCH_PROVIDER (data->thread_data->engine),
+						     data->hits);
+	}
+
+	g_list_free_full (data->hits, g_object_unref);
+	g_free (data);
+
+	return FALSE;
+}
+
+static void
+send_hits (GList *hits,
+	   gpointer user_data)
+{
+	SearchThreadData *thread_data = user_data;
+	SearchHitsData *data;
+	NautilusSearchHitScorer *scorer;
+	GList *l;
+
+	scorer = nautilus_search_hit_scorer_new (thread_data->query);
+	for (l = hits; l != NULL; l = l->next) {
+		nautilus_search_hit_scorer_compute (scorer, l->data);
+	}
+	nautilus_search_hit_scorer_free (scorer);
+
+	data = g_new (SearchHitsData, 1);
+	data->hits = hits;
+	data->thread_data = thread_data;
+	g_idle_add (search_thread_add_hits_idle, data);
+}
+
+static gpointer
+search_thread_func (gpointer user_data)
+{
+	SearchThreadData *data;
+
+	data = user_data;
+
+	nautilus_filename_index_search_run (data->search, data->cancellable,
+					    send_hits, data);
+
+	g_idle_add (search_thread_done_idle, data);
+
+	return NULL;
+}
+
+static void
+nautilus_search_engine_index_start (NautilusSearchProvider *provider)
+{
+	NautilusSearchEngineIndex *index;
+	SearchThreadData *data;
+	GThread *thread;
+
+	index = NAUTILUS_SEARCH_ENGINE_INDEX (provider);
+
+	if (index->details->active_search != NULL) {
+		return;
+	}
+
+	DEBUG ("Index engine start");
+
+	data = search_thread_data_new (index, index->details->query);
+
+	thread = g_thread_new ("nautilus-search-index", search_thread_func, data);
+	index->details->active_search = data;
+
+	g_thread_unref (thread);
+}
+
+static void
+nautilus_search_engine_index_stop (NautilusSearchProvider *provider)
+{
+	NautilusSearchEngineIndex *index;
+
+	index = NAUTILUS_SEARCH_ENGINE_INDEX (provider);
+
+	if (index->details->active_search != NULL) {
+		DEBUG ("Index engine stop");
+		g_cancellable_cancel (index->details->active_search->cancellable);
+		index->details->active_search = NULL;
+	}
+}
+
+static void
+nautilus_search_engine_index_set_query (NautilusSearchProvider *provider,
+					NautilusQuery          *query)
+{
+	NautilusSearchEngineIndex *index;
+
+	index = NAUTILUS_SEARCH_ENGINE_INDEX (provider);
+
+	g_object_ref (query);
+	g_clear_object (&index->details->query);
+	index->details->query = query;
+}
+
+static void
+nautilus_search_provider_init (NautilusSearchProviderIface *iface)
+{
+	iface->set_query = nautilus_search_engine_index_set_query;
+	iface->start = nautilus_search_engine_index_start;
+	iface->stop = nautilus_search_engine_index_stop;
+}
+
+static void
+nautilus_search_engine_index_class_init (NautilusSearchEngineIndexClass *class)
+{
+	GObjectClass *gobject_class;
+
+	gobject_class = G_OBJECT_CLASS (class);
+	gobject_class->finalize = finalize;
+
+	g_type_class_add_private (class, sizeof (NautilusSearchEngineIndexDetails));
+}
+
+static void
+nautilus_search_engine_index_init (NautilusSearchEngineIndex *engine)
+{
+	engine->details = G_TYPE_INSTANCE_GET_PRIVATE (engine, NAUTILUS_TYPE_SEARCH_ENGINE_INDEX,
+						       NautilusSearchEngineIndexDetails);
+}
+
+NautilusSearchEngineIndex *
+nautilus_search_engine_index_new (void)
+{
+	NautilusSearchEngineIndex *engine;
+
+	engine = g_object_new (NAUTILUS_TYPE_SEARCH_ENGINE_INDEX, NULL);
+
+	return engine;
+}
@@ -21,6 +21,7 @@
  */
 
 #include <config.h>
+#include "nautilus-filename-index.h"
 #include "nautilus-search-hit.h"
 #include "nautilus-search-provider.h"
 #include "nautilus-search-engine-simple.h"
@@ -49,12 +50,20 @@ typedef struct {
 	GQueue *directories; /* GFiles */
 
 	GHashTable *visited;
+	/* Folders that the index provider answers for */
+	NautilusFilenameIndexFolders *indexed_folders;
 
 	gboolean recursive;
 	gint n_processed_files;
 	GList *hits;
 
 	NautilusQuery *query;
+
+	/* Refinement of the query handed over by the main thread, taken
+	 * up before the next directory is visited.
+	 */
+	GMutex refined_query_mutex;
+	NautilusQuery *refined_query;
 } SearchThreadData;
 
 
@@ -62,6 +71,7 @@ struct NautilusSearchEngineSimpleDetails {
 	NautilusQuery *query;
 
 	SearchThreadData *active_search;
+	NautilusFilenameIndexFolders *indexed_folders;
 
 	gboolean recursive;
 	gboolean query_finished;
@@ -84,6 +94,9 @@ finalize (GObject *object)
 
 	simple = NAUTILUS_SEARCH_ENGINE_SIMPLE (object);
 	g_clear_object (&simple->details->query);
+	if (simple->details->indexed_folders != NULL) {
+		nautilus_filename_index_folders_free (simple->details->indexed_folders);
+	}
 
 	G_OBJECT_CLASS (nautilus_search_engine_simple_parent_class)->finalize (object);
 }
@@ -102,6 +115,7 @@ search_thread_data_new (NautilusSearchEngineSimple *engine,
 	data->directories = g_queue_new ();
 	data->visited = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 	data->query = g_object_ref (query);
+	g_mutex_init (&data->refined_query_mutex);
 
 	uri = nautilus_query_get_location (query);
 	location = g_file_new_for_uri (uri);
@@ -111,6 +125,16 @@ search_thread_data_new (NautilusSearchEngineSimple *engine,
 	data->mime_types = nautilus_query_get_mime_types (query);
 
 	data->cancellable = g_cancellable_new ();
+
+	/* Without recursion the index, which always goes deep, has
+	 * nothing to answer for.
+	 */
+	if (engine->details->recursive) {
+		data->indexed_folders = engine->details->indexed_folders;
+	} else if (engine->details->indexed_folders != NULL) {
+		nautilus_filename_index_folders_free (engine->details->indexed_folders);
+	}
+	engine->details->indexed_folders = NULL;
 	
 	return data;
 }
@@ -122,8 +146,13 @@ search_thread_data_free (SearchThreadData *data)
 			 (GFunc)g_object_unref, NULL);
 	g_queue_free (data->directories);
 	g_hash_table_destroy (data->visited);
+	if (data->indexed_folders != NULL) {
+		nautilus_filename_index_folders_free (data->indexed_folders);
+	}
 	g_object_unref (data->cancellable);
 	g_object_unref (data->query);
+	g_clear_object (&data->refined_query);
+	g_mutex_clear (&data->refined_query_mutex);
 	g_list_free_full (data->mime_types, g_free);
 	g_list_free_full (data->hits, g_object_unref);
 	g_object_unref (data->engine);
@@ -175,10 +204,19 @@ static void
 send_batch (SearchThreadData *thread_data)
 {
 	SearchHitsData *data;
+	NautilusSearchHitScorer *scorer;
+	GList *l;
 	
 	thread_data->n_processed_files = 0;
 	
 	if (thread_data->hits) {
+		/* Score here rather than in the main thread */
+		scorer = nautilus_search_hit_scorer_new (thread_data->query);
+		for (l = thread_data->hits; l != NULL; l = l->next) {
+			nautilus_search_hit_scorer_compute (scorer, l->data);
+		}
+		nautilus_search_hit_scorer_free (scorer);
+
 		data = g_new (SearchHitsData, 1);
 		data->hits = thread_data->hits;
 		data->thread_data = thread_data;
@@ -208,6 +246,21 @@ visit_directory (GFile *dir, SearchThreadData *data)
 	GList *l;
 	const char *id;
 	gboolean visited;
+	GList *subfolders;
+
+	/* The index provider finds the files of folders that did not
+	 * change since it was built, only their subfolders need a look.
+	 */
+	if (data->indexed_folders != NULL &&
+	    nautilus_filename_index_folders_get_unchanged (data->indexed_folders, dir,
+							   nautilus_query_get_show_hidden_files (data->query),
+							   data->cancellable, &subfolders)) {
+		for (l = subfolders; l != NULL; l = l->next) {
+			g_queue_push_tail (data->directories, l->data);
+		}
+		g_list_free (subfolders);
+		return;
+	}
 
 	enumerator = g_file_enumerate_children (dir,
 						data->mime_types != NULL ?
@@ -299,6 +352,26 @@ visit_directory (GFile *dir, SearchThreadData *data)
 }
 
 
+static void
+search_thread_take_refined_query (SearchThreadData *data)
+{
+	NautilusQuery *query;
+
+	g_mutex_lock (&data->refined_query_mutex);
+	query = data->refined_query;
+	data->refined_query = NULL;
+	g_mutex_unlock (&data->refined_query_mutex);
+
+	if (query == NULL) {
+		return;
+	}
+
+	g_object_unref (data->query);
+	data->query = query;
+	g_list_free_full (data->mime_types, g_free);
+	data->mime_types = nautilus_query_get_mime_types (query);
+}
+
 static gpointer 
 search_thread_func (gpointer user_data)
 {
@@ -322,6 +395,7 @@ search_thread_func (gpointer user_data)
 	
 	while (!g_cancellable_is_cancelled (data->cancellable) &&
 	       (dir = g_queue_pop_head (data->directories)) != NULL) {
+		search_thread_take_refined_query (data);
 		visit_directory (dir, data);
 		g_object_unref (dir);
 	}
@@ -380,6 +454,20 @@ nautilus_search_engine_simple_set_query (NautilusSearchProvider *provider,
 
 	simple = NAUTILUS_SEARCH_ENGINE_SIMPLE (provider);
 
+	/* A narrower query does not need a new crawl, the running one
+	 * just goes on with it.
+	 */
+	if (simple->details->active_search != NULL &&
+	    simple->details->query != NULL &&
+	    nautilus_query_is_refinement_of (query, simple->details->query)) {
+		DEBUG ("Simple engine refine");
+
+		g_mutex_lock (&simple->details->active_search->refined_query_mutex);
+		g_clear_object (&simple->details->active_search->refined_query);
+		simple->details->active_search->refined_query = g_object_ref (query);
+		g_mutex_unlock (&simple->details->active_search->refined_query_mutex);
+	}
+
 	g_object_ref (query);
 	g_clear_object (&simple->details->query);
 	simple->details->query = query;
@@ -457,6 +545,17 @@ nautilus_search_engine_simple_init (NautilusSearchEngineSimple *engine)
 						       NautilusSearchEngineSimpleDetails);
 }
 
+/* Takes @folders, which may be NULL, for the next search started */
+void
+nautilus_search_engine_simple_set_indexed_folders (NautilusSearchEngineSimple   *simple,
+						   NautilusFilenameIndexFolders *folders)
+{
+	if (simple->details->indexed_folders != NULL) {
+		nautilus_filename_index_folders_free (simple->details->indexed_folders);
+	}
+	simple->details->indexed_folders = folders;
+}
+
 NautilusSearchEngineSimple *
 nautilus_search_engine_simple_new (void)
 {
@@ -27,6 +27,8 @@
 #include "nautilus-search-engine.h"
 #include "nautilus-search-engine-simple.h"
 #include "nautilus-search-engine-model.h"
+#include "nautilus-search-engine-index.h"
+#include "nautilus-filename-index.h"
 #define DEBUG_FLAG NAUTILUS_DEBUG_SEARCH
 #include "nautilus-debug.h"
 
@@ -34,6 +36,15 @@
 #include "nautilus-search-engine-tracker.h"
 #endif
 
+/* Merged hits are passed on at most this often, in milliseconds */
+#define MERGE_INTERVAL 100
+
+typedef struct {
+	gint64 start_time;
+	guint n_hits;
+	guint n_new_hits;
+} ProviderStats;
+
 struct NautilusSearchEngineDetails
 {
 #ifdef ENABLE_TRACKER
@@ -41,8 +52,19 @@ struct NautilusSearchEngineDetails
 #endif
 	NautilusSearchEngineSimple *simple;
 	NautilusSearchEngineModel *model;
+	NautilusSearchEngineIndex *index;
 
+	NautilusQuery *query;
+
+	/* URIs of the hits passed on, kept in uri_chunk */
 	GHashTable *uris;
+	GStringChunk *uri_chunk;
+
+	GList *pending_hits;
+	guint merge_timeout_id;
+
+	GHashTable *provider_stats;
+
 	guint providers_running;
 	guint providers_finished;
 	guint providers_error;
@@ -64,13 +86,34 @@ nautilus_search_engine_set_query (NautilusSearchProvider *provider,
 				  NautilusQuery          *query)
 {
 	NautilusSearchEngine *engine = NAUTILUS_SEARCH_ENGINE (provider);
+
+	g_object_ref (query);
+	g_clear_object (&engine->details->query);
+	engine->details->query = query;
+
 #ifdef ENABLE_TRACKER
 	nautilus_search_provider_set_query (NAUTILUS_SEARCH_PROVIDER (engine->details->tracker), query);
 #endif
 	nautilus_search_provider_set_query (NAUTILUS_SEARCH_PROVIDER (engine->details->model), query);
+	nautilus_search_provider_set_query (NAUTILUS_SEARCH_PROVIDER (engine->details->index), query);
 	nautilus_search_provider_set_query (NAUTILUS_SEARCH_PROVIDER (engine->details->simple), query);
 }
 
+static void
+provider_start (NautilusSearchEngine   *engine,
+		NautilusSearchProvider *provider)
+{
+	ProviderStats *stats;
+
+	stats = g_hash_table_lookup (engine->details->provider_stats, provider);
+	stats->start_time = g_get_monotonic_time ();
+	stats->n_hits = 0;
+	stats->n_new_hits = 0;
+
+	nautilus_search_provider_start (provider);
+	engine->details->providers_running++;
+}
+
 static void
 search_engine_start_real (NautilusSearchEngine *engine)
 {
@@ -85,16 +128,23 @@ search_engine_start_real (NautilusSearchEngine *engine)
 	g_object_ref (engine);
 
 #ifdef ENABLE_TRACKER
-	nautilus_search_provider_start (NAUTILUS_SEARCH_PROVIDER (engine->details->tracker));
-	engine->details->providers_running++;
+	provider_start (engine, NAUTILUS_SEARCH_PROVIDER (engine->details->tracker));
 #endif
 	if (nautilus_search_engine_model_get_model (engine->details->model)) {
-		nautilus_search_provider_start (NAUTILUS_SEARCH_PROVIDER (engine->details->model));
-		engine->details->providers_running++;
+		provider_start (engine, NAUTILUS_SEARCH_PROVIDER (engine->details->model));
 	}
 
-	nautilus_search_provider_start (NAUTILUS_SEARCH_PROVIDER (engine->details->simple));
-	engine->details->providers_running++;
+	/* The index answers at once for the folders it covers, the crawl
+	 * below only lists the ones that changed since it was built.
+	 */
+	nautilus_filename_index_ensure ();
+	if (nautilus_filename_index_is_ready ()) {
+		provider_start (engine, NAUTILUS_SEARCH_PROVIDER (engine->details->index));
+	}
+	nautilus_search_engine_simple_set_indexed_folders (engine->details->simple,
+							   nautilus_filename_index_folders_new (engine->details->query));
+
+	provider_start (engine, NAUTILUS_SEARCH_PROVIDER (engine->details->simple));
 }
 
 static void
@@ -136,10 +186,49 @@ nautilus_search_engine_stop (NautilusSearchProvider *provider)
 	nautilus_search_provider_stop (NAUTILUS_SEARCH_PROVIDER (engine->details->tracker));
 #endif
 	nautilus_search_provider_stop (NAUTILUS_SEARCH_PROVIDER (engine->details->model));
+	nautilus_search_provider_stop (NAUTILUS_SEARCH_PROVIDER (engine->details->index));
 	nautilus_search_provider_stop (NAUTILUS_SEARCH_PROVIDER (engine->details->simple));
 
 	engine->details->running = FALSE;
 	engine->details->restart = FALSE;
+
+	g_list_free_full (engine->details->pending_hits, g_object_unref);
+	engine->details->pending_hits = NULL;
+	if (engine->details->merge_timeout_id != 0) {
+		g_source_remove (engine->details->merge_timeout_id);
+		engine->details->merge_timeout_id = 0;
+	}
+}
+
+static void
+flush_pending_hits (NautilusSearchEngine *engine)
+{
+	GList *hits;
+
+	if (engine->details->pending_hits == NULL) {
+		return;
+	}
+
+	hits = g_list_reverse (engine->details->pending_hits);
+	engine->details->pending_hits = NULL;
+
+	nautilus_search_provider_hits_added (NAUTILUS_SEARCH_PROVIDER (engine), hits);
+	g_list_free_full (hits, g_object_unref);
+}
+
+static gboolean
+merge_timeout_callback (gpointer user_data)
+{
+	NautilusSearchEngine *engine = user_data;
+
+	if (engine->details->pending_hits == NULL) {
+		engine->details->merge_timeout_id = 0;
+		return FALSE;
+	}
+
+	flush_pending_hits (engine);
+
+	return TRUE;
 }
 
 static void
@@ -147,7 +236,7 @@ search_provider_hits_added (NautilusSearchProvider *provider,
 			    GList                  *hits,
 			    NautilusSearchEngine   *engine)
 {
-	GList *added = NULL;
+	ProviderStats *stats;
 	GList *l;
 
 	if (!engine->details->running || engine->details->restart) {
@@ -156,21 +245,34 @@ search_provider_hits_added (NautilusSearchProvider *provider,
 		return;
 	}
 
+	stats = g_hash_table_lookup (engine->details->provider_stats, provider);
+
 	for (l = hits; l != NULL; l = l->next) {
 		NautilusSearchHit *hit = l->data;
-		int count;
 		const char *uri;
 
+		stats->n_hits++;
+
 		uri = nautilus_search_hit_get_uri (hit);
-		count = GPOINTER_TO_INT (g_hash_table_lookup (engine->details->uris, uri));
-		if (count == 0)
-			added = g_list_prepend (added, hit);
-		g_hash_table_replace (engine->details->uris, g_strdup (uri), GINT_TO_POINTER (++count));
+		if (g_hash_table_contains (engine->details->uris, uri)) {
+			continue;
+		}
+
+		g_hash_table_add (engine->details->uris,
+				  g_string_chunk_insert (engine->details->uri_chunk, uri));
+		engine->details->pending_hits = g_list_prepend (engine->details->pending_hits,
+								g_object_ref (hit));
+		stats->n_new_hits++;
 	}
-	if (added != NULL) {
-		added = g_list_reverse (added);
-		nautilus_search_provider_hits_added (NAUTILUS_SEARCH_PROVIDER (engine), added);
-		g_list_free (added);
+
+	/* The first hits go out right away, later ones are gathered so
+	 * that the views are not updated for each small batch.
+	 */
+	if (engine->details->merge_timeout_id == 0 &&
+	    engine->details->pending_hits != NULL) {
+		flush_pending_hits (engine);
+		engine->details->merge_timeout_id =
+			g_timeout_add (MERGE_INTERVAL, merge_timeout_callback, engine);
 	}
 }
 
@@ -183,6 +285,12 @@ check_providers_status (NautilusSearchEngine *engine)
 		return;
 	}
 
+	flush_pending_hits (engine);
+	if (engine->details->merge_timeout_id != 0) {
+		g_source_remove (engine->details->merge_timeout_id);
+		engine->details->merge_timeout_id = 0;
+	}
+
 	if (num_finished == engine->details->providers_error) {
 		DEBUG ("Search engine error");
 		nautilus_search_provider_error (NAUTILUS_SEARCH_PROVIDER (engine),
@@ -194,6 +302,7 @@ check_providers_status (NautilusSearchEngine *engine)
 
 	engine->details->running = FALSE;
 	g_hash_table_remove_all (engine->details->uris);
+	g_string_chunk_clear (engine->details->uri_chunk);
 
 	if (engine->details->restart) {
 		DEBUG ("Restarting engine");
@@ -203,6 +312,20 @@ check_providers_status (NautilusSearchEngine *engine)
 	g_object_unref (engine);
 }
 
+static void
+debug_provider_stats (NautilusSearchEngine   *engine,
+		      NautilusSearchProvider *provider,
+		      const char             *what)
+{
+	ProviderStats *stats;
+
+	stats = g_hash_table_lookup (engine->details->provider_stats, provider);
+	DEBUG ("Search provider %s %s after %" G_GINT64_FORMAT " ms, %u hits, %u new",
+	       G_OBJECT_TYPE_NAME (provider), what,
+	       (g_get_monotonic_time () - stats->start_time) / 1000,
+	       stats->n_hits, stats->n_new_hits);
+}
+
 static void
 search_provider_error (NautilusSearchProvider *provider,
 		       const char             *error_message,
@@ -210,6 +333,7 @@ search_provider_error (NautilusSearchProvider *provider,
 
 {
 	DEBUG ("Search provider error: %s", error_message);
+	debug_provider_stats (engine, provider, "failed");
 	engine->details->providers_error++;
 
 	check_providers_status (engine);
@@ -220,7 +344,7 @@ search_provider_finished (NautilusSearchProvider *provider,
 			  NautilusSearchEngine   *engine)
 
 {
-	DEBUG ("Search provider finished");
+	debug_provider_stats (engine, provider, "finished");
 	engine->details->providers_finished++;
 
 	check_providers_status (engine);
@@ -230,6 +354,9 @@ static void
 connect_provider_signals (NautilusSearchEngine   *engine,
 			  NautilusSearchProvider *provider)
 {
+	g_hash_table_insert (engine->details->provider_stats, provider,
+			     g_new0 (ProviderStats, 1));
+
 	g_signal_connect (provider, "hits-added",
 			  G_CALLBACK (search_provider_hits_added),
 			  engine);
@@ -254,13 +381,21 @@ nautilus_search_engine_finalize (GObject *object)
 {
 	NautilusSearchEngine *engine = NAUTILUS_SEARCH_ENGINE (object);
 
+	if (engine->details->merge_timeout_id != 0) {
+		g_source_remove (engine->details->merge_timeout_id);
+	}
+	g_list_free_full (engine->details->pending_hits, g_object_unref);
 	g_hash_table_destroy (engine->details->uris);
+	g_string_chunk_free (engine->details->uri_chunk);
+	g_hash_table_destroy (engine->details->provider_stats);
 
 #ifdef ENABLE_TRACKER
 	g_clear_object (&engine->details->tracker);
 #endif
 	g_clear_object (&engine->details->model);
+	g_clear_object (&engine->details->index);
 	g_clear_object (&engine->details->simple);
+	g_clear_object (&engine->details->query);
 
 	G_OBJECT_CLASS (nautilus_search_engine_parent_class)->finalize (object);
 }
@@ -284,7 +419,9 @@ nautilus_search_engine_init (NautilusSearchEngine *engine)
 						       NAUTILUS_TYPE_SEARCH_ENGINE,
 						       NautilusSearchEngineDetails);
 
-	engine->details->uris = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	engine->details->uris = g_hash_table_new (g_str_hash, g_str_equal);
+	engine->details->uri_chunk = g_string_chunk_new (4096);
+	engine->details->provider_stats = g_hash_table_new_full (NULL, NULL, NULL, g_free);
 
 #ifdef ENABLE_TRACKER
 	engine->details->tracker = nautilus_search_engine_tracker_new ();
@@ -293,6 +430,9 @@ nautilus_search_engine_init (NautilusSearchEngine *engine)
 	engine->details->model = nautilus_search_engine_model_new ();
 	connect_provider_signals (engine, NAUTILUS_SEARCH_PROVIDER (engine->details->model));
 
+	engine->details->index = nautilus_search_engine_index_new ();
+	connect_provider_signals (engine, NAUTILUS_SEARCH_PROVIDER (engine->details->index));
+
 	engine->details->simple = nautilus_search_engine_simple_new ();
 	connect_provider_signals (engine, NAUTILUS_SEARCH_PROVIDER (engine->details->simple));
 }
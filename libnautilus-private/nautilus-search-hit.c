@@ -37,6 +37,7 @@ struct NautilusSearchHitDetails
 	gdouble    fts_rank;
 
 	gdouble    relevance;
+	gboolean   scored;
 };
 
 enum {
@@ -50,50 +51,95 @@ enum {
 
 G_DEFINE_TYPE (NautilusSearchHit, nautilus_search_hit, G_TYPE_OBJECT)
 
-void
-nautilus_search_hit_compute_scores (NautilusSearchHit *hit,
-				    NautilusQuery     *query)
+struct NautilusSearchHitScorer
 {
+	/* The query location, without a trailing slash */
+	char      *location_uri;
+	gsize      location_length;
+
 	GDateTime *now;
-	char *query_uri;
-	GFile *query_location;
-	GFile *hit_location;
+};
+
+NautilusSearchHitScorer *
+nautilus_search_hit_scorer_new (NautilusQuery *query)
+{
+	NautilusSearchHitScorer *scorer;
+
+	scorer = g_new0 (NautilusSearchHitScorer, 1);
+	scorer->location_uri = nautilus_query_get_location (query);
+	if (scorer->location_uri == NULL) {
+		scorer->location_uri = g_strdup ("");
+	}
+	scorer->location_length = strlen (scorer->location_uri);
+	if (scorer->location_length > 0 &&
+	    scorer->location_uri[scorer->location_length - 1] == '/') {
+		scorer->location_length--;
+	}
+	scorer->now = g_date_time_new_now_local ();
+
+	return scorer;
+}
+
+void
+nautilus_search_hit_scorer_free (NautilusSearchHitScorer *scorer)
+{
+	g_free (scorer->location_uri);
+	g_date_time_unref (scorer->now);
+	g_free (scorer);
+}
+
+/* Number of folders between the query location and the hit, or -1 if
+ * the hit is not below the location. Works on the URIs directly, which
+ * are escaped the same way for the location and its children.
+ */
+static gint
+get_folder_depth (NautilusSearchHitScorer *scorer,
+		  const char              *uri)
+{
+	const char *p;
+	gint depth;
+
+	if (scorer->location_length == 0 ||
+	    strncmp (uri, scorer->location_uri, scorer->location_length) != 0) {
+		return -1;
+	}
+
+	p = uri + scorer->location_length;
+	if (p[0] != '/' || p[1] == '\0' || (p[1] == '/' && p[2] == '\0')) {
+		return -1;
+	}
+
+	depth = 0;
+	for (p = p + 1; *p != '\0'; p++) {
+		if (*p == '/' && p[1] != '\0') {
+			depth++;
+		}
+	}
+
+	return depth;
+}
+
+void
+nautilus_search_hit_scorer_compute (NautilusSearchHitScorer *scorer,
+				    NautilusSearchHit       *hit)
+{
 	GTimeSpan m_diff = G_MAXINT64;
 	GTimeSpan a_diff = G_MAXINT64;
 	GTimeSpan t_diff = G_MAXINT64;
 	gdouble recent_bonus = 0.0;
 	gdouble proximity_bonus = 0.0;
 	gdouble match_bonus = 0.0;
+	gint dir_count;
 
-	query_uri = nautilus_query_get_location (query);
-	query_location = g_file_new_for_uri (query_uri);
-	hit_location = g_file_new_for_uri (hit->details->uri);
-
-	if (g_file_has_prefix (hit_location, query_location)) {
-		GFile *parent, *location;
-		guint dir_count = 0;
-
-		parent = g_file_get_parent (hit_location);
-
-		while (!g_file_equal (parent, query_location)) {
-			dir_count++;
-			location = parent;
-			parent = g_file_get_parent (location);
-			g_object_unref (location);
-		}
-		g_object_unref (parent);
-
-		if (dir_count < 10) {
-			proximity_bonus = 10000.0 - 1000.0 * dir_count;
-		}
+	dir_count = get_folder_depth (scorer, hit->details->uri);
+	if (dir_count >= 0 && dir_count < 10) {
+		proximity_bonus = 10000.0 - 1000.0 * dir_count;
 	}
-	g_object_unref (hit_location);
 
-	now = g_date_time_new_now_local ();
 	if (hit->details->modification_time != NULL)
-		m_diff = g_date_time_difference (now, hit->details->modification_time);
+		m_diff = g_date_time_difference (scorer->now, hit->details->modification_time);
 	if (hit->details->access_time != NULL)
-		a_diff = g_date_time_difference (now, hit->details->access_time);
+		a_diff = g_date_time_difference (scorer->now, hit->details->access_time);
 	m_diff /= G_TIME_SPAN_DAY;
 	a_diff /= G_TIME_SPAN_DAY;
 	t_diff = MIN (m_diff, a_diff);
@@ -118,12 +164,49 @@ nautilus_search_hit_compute_scores (NautilusSearchHit *hit,
 	}
 
 	hit->details->relevance = recent_bonus + proximity_bonus + match_bonus;
+	hit->details->scored = TRUE;
 	DEBUG ("Hit %s computed relevance %.2f (%.2f + %.2f + %.2f)", hit->details->uri, hit->details->relevance,
 	       proximity_bonus, recent_bonus, match_bonus);
+}
+
+void
+nautilus_search_hit_compute_scores (NautilusSearchHit *hit,
+				    NautilusQuery     *query)
+{
+	NautilusSearchHitScorer *scorer;
+
+	scorer = nautilus_search_hit_scorer_new (query);
+	nautilus_search_hit_scorer_compute (scorer, hit);
+	nautilus_search_hit_scorer_free (scorer);
+}
+
+/* Scores the hits that were not scored yet, in one pass with a single
+ * time for all of them.
+ */
+void
+nautilus_search_hit_list_compute_scores (GList         *hits,
+					 NautilusQuery *query)
+{
+	NautilusSearchHitScorer *scorer;
+	NautilusSearchHit *hit;
+	GList *l;
+
+	scorer = NULL;
+	for (l = hits; l != NULL; l = l->next) {
+		hit = l->data;
+		if (hit->details->scored) {
+			continue;
+		}
 
-	g_date_time_unref (now);
-	g_free (query_uri);
-	g_object_unref (query_location);
+		if (scorer == NULL) {
+			scorer = nautilus_search_hit_scorer_new (query);
+		}
+		nautilus_search_hit_scorer_compute (scorer, hit);
+	}
+
+	if (scorer != NULL) {
+		nautilus_search_hit_scorer_free (scorer);
+	}
 }
 
 const char *
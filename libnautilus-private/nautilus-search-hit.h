@@ -32,6 +32,7 @@
 #define NAUTILUS_SEARCH_HIT_GET_CLASS(obj)    (G_TYPE_INSTANCE_GET_CLASS ((obj), NAUTILUS_TYPE_SEARCH_HIT, NautilusSearchHitClass))
 
 typedef struct NautilusSearchHitDetails NautilusSearchHitDetails;
+typedef struct NautilusSearchHitScorer NautilusSearchHitScorer;
 
 typedef struct NautilusSearchHit {
 	GObject parent;
@@ -55,6 +56,16 @@ void                nautilus_search_hit_set_access_time       (NautilusSearchHit
 
 void                nautilus_search_hit_compute_scores        (NautilusSearchHit *hit,
 							       NautilusQuery     *query);
+void                nautilus_search_hit_list_compute_scores   (GList             *hits,
+							       NautilusQuery     *query);
+
+/* Scores many hits against the same query and time; can be used from
+ * any thread.
+ */
+NautilusSearchHitScorer *nautilus_search_hit_scorer_new     (NautilusQuery           *query);
+void                     nautilus_search_hit_scorer_compute (NautilusSearchHitScorer *scorer,
+							     NautilusSearchHit       *hit);
+void                     nautilus_search_hit_scorer_free    (NautilusSearchHitScorer *scorer);
 
 const char *        nautilus_search_hit_get_uri               (NautilusSearchHit *hit);
 gdouble             nautilus_search_hit_get_relevance         (NautilusSearchHit *hit);
@@ -0,0 +1,664 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+ *
+ * nautilus-selection-model.c: view independent selection storage.
+ *
+ * Nautilus is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * Nautilus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; see the file COPYING.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <config.h>
+#include "nautilus-selection-model.h"
+
+#include <string.h>
+#include "nautilus-lib-self-check-functions.h"
+
+/* The bitset is split in chunks of CHUNK_BITS bits. A chunk with no
+ * bits set or with all bits set has no storage at all, so selecting
+ * everything in a huge directory only touches the chunk headers.
+ */
+#define CHUNK_BITS 4096
+#define CHUNK_WORDS (CHUNK_BITS / 64)
+
+typedef struct {
+	/* NULL when count is 0 or CHUNK_BITS */
+	guint64 *words;
+	guint count;
+} Chunk;
+
+struct NautilusSelectionModel {
+	GPtrArray *files;
+	GHashTable *indexes;
+	GArray *free_indexes;
+	GArray *chunks;
+	guint n_files;
+	guint count;
+
+	NautilusSelectionModelSyncFunc sync_func;
+	gpointer sync_data;
+	gboolean invalid;
+};
+
+static inline guint
+word_popcount (guint64 word)
+{
+#if defined (__GNUC__)
+	return __builtin_popcountll (word);
+#else
+	guint count;
+
+	for (count = 0; word != 0; count++) {
+		word &= word - 1;
+	}
+	return count;
+#endif
+}
+
+static inline guint
+word_first_bit (guint64 word)
+{
+#if defined (__GNUC__)
+	return __builtin_ctzll (word);
+#else
+	guint bit;
+
+	for (bit = 0; (word & 1) == 0; bit++) {
+		word >>= 1;
+	}
+	return bit;
+#endif
+}
+
+/* Mask with bits first..last (inclusive) set. */
+static inline guint64
+word_mask (guint first, guint last)
+{
+	guint64 high;
+
+	high = last == 63 ? G_MAXUINT64 : (G_GUINT64_CONSTANT (1) << (last + 1)) - 1;
+	return high & ~((G_GUINT64_CONSTANT (1) << first) - 1);
+}
+
+/* Sets or clears bits first..last (inclusive) of a chunk and
+ * returns the change in the number of set bits.
+ */
+static int
+chunk_fill (Chunk *chunk,
+	    guint first,
+	    guint last,
+	    gboolean value)
+{
+	guint old_count, w, first_word, last_word;
+	guint64 mask, old_word;
+
+	old_count = chunk->count;
+
+	if (first == 0 && last == CHUNK_BITS - 1) {
+		g_free (chunk->words);
+		chunk->words = NULL;
+		chunk->count = value ? CHUNK_BITS : 0;
+		return (int) chunk->count - (int) old_count;
+	}
+
+	if ((value && chunk->count == CHUNK_BITS) ||
+	    (!value && chunk->count == 0)) {
+		return 0;
+	}
+
+	if (chunk->words == NULL) {
+		chunk->words = g_new (guint64, CHUNK_WORDS);
+		memset (chunk->words, chunk->count == 0 ? 0 : 0xff,
+			CHUNK_WORDS * sizeof (guint64));
+	}
+
+	first_word = first / 64;
+	last_word = last / 64;
+	for (w = first_word; w <= last_word; w++) {
+		mask = word_mask (w == first_word ? first % 64 : 0,
+				  w == last_word ? last % 64 : 63);
+		old_word = chunk->words[w];
+		chunk->words[w] = value ? old_word | mask : old_word & ~mask;
+		chunk->count += word_popcount (chunk->words[w]);
+		chunk->count -= word_popcount (old_word);
+	}
+
+	if (chunk->count == 0 || chunk->count == CHUNK_BITS) {
+		g_free (chunk->words);
+		chunk->words = NULL;
+	}
+
+	return (int) chunk->count - (int) old_count;
+}
+
+static gboolean
+chunk_get (Chunk *chunk,
+	   guint bit)
+{
+	if (chunk->words == NULL) {
+		return chunk->count != 0;
+	}
+	return (chunk->words[bit / 64] & (G_GUINT64_CONSTANT (1) << (bit % 64))) != 0;
+}
+
+/* Sets or clears bits start..end-1 of the whole bitset. */
+static void
+model_fill (NautilusSelectionModel *model,
+	    guint start,
+	    guint end,
+	    gboolean value)
+{
+	guint chunk_index, first, last;
+	Chunk *chunk;
+
+	while (start < end) {
+		chunk_index = start / CHUNK_BITS;
+		first = start % CHUNK_BITS;
+		last = MIN (end - chunk_index * CHUNK_BITS, CHUNK_BITS) - 1;
+
+		chunk = &g_array_index (model->chunks, Chunk, chunk_index);
+		model->count += chunk_fill (chunk, first, last, value);
+
+		start = (chunk_index + 1) * CHUNK_BITS;
+	}
+}
+
+static void
+model_set_bit (NautilusSelectionModel *model,
+	       guint index,
+	       gboolean value)
+{
+	Chunk *chunk;
+
+	chunk = &g_array_index (model->chunks, Chunk, index / CHUNK_BITS);
+	model->count += chunk_fill (chunk, index % CHUNK_BITS, index % CHUNK_BITS, value);
+}
+
+static void
+model_sync (NautilusSelectionModel *model)
+{
+	if (!model->invalid) {
+		return;
+	}
+
+	/* Cleared first, the sync function changes the selection itself. */
+	model->invalid = FALSE;
+	model->sync_func (model, model->sync_data);
+}
+
+static void
+model_free_chunks (NautilusSelectionModel *model)
+{
+	guint i;
+
+	for (i = 0; i < model->chunks->len; i++) {
+		g_free (g_array_index (model->chunks, Chunk, i).words);
+	}
+	g_array_set_size (model->chunks, 0);
+	model->count = 0;
+}
+
+NautilusSelectionModel *
+nautilus_selection_model_new (void)
+{
+	NautilusSelectionModel *model;
+
+	model = g_new0 (NautilusSelectionModel, 1);
+	model->files = g_ptr_array_new ();
+	model->indexes = g_hash_table_new (g_direct_hash, g_direct_equal);
+	model->free_indexes = g_array_new (FALSE, FALSE, sizeof (guint));
+	model->chunks = g_array_new (FALSE, TRUE, sizeof (Chunk));
+
+	return model;
+}
+
+void
+nautilus_selection_model_destroy (NautilusSelectionModel *model)
+{
+	if (model == NULL) {
+		return;
+	}
+
+	nautilus_selection_model_clear (model);
+
+	g_ptr_array_free (model->files, TRUE);
+	g_hash_table_destroy (model->indexes);
+	g_array_free (model->free_indexes, TRUE);
+	g_array_free (model->chunks, TRUE);
+	g_free (model);
+}
+
+guint
+nautilus_selection_model_add_file (NautilusSelectionModel *model,
+				   NautilusFile           *file)
+{
+	gpointer value;
+	guint index;
+
+	g_return_val_if_fail (NAUTILUS_IS_FILE (file), 0);
+
+	value = g_hash_table_lookup (model->indexes, file);
+	if (value != NULL) {
+		return GPOINTER_TO_UINT (value) - 1;
+	}
+
+	if (model->free_indexes->len > 0) {
+		index = g_array_index (model->free_indexes, guint,
+				       model->free_indexes->len - 1);
+		g_array_set_size (model->free_indexes, model->free_indexes->len - 1);
+		g_ptr_array_index (model->files, index) = file;
+	} else {
+		index = model->files->len;
+		g_ptr_array_add (model->files, file);
+		if (model->chunks->len * CHUNK_BITS < model->files->len) {
+			g_array_set_size (model->chunks, model->chunks->len + 1);
+		}
+	}
+
+	nautilus_file_ref (file);
+	g_hash_table_insert (model->indexes, file, GUINT_TO_POINTER (index + 1));
+	model->n_files++;
+
+	return index;
+}
+
+void
+nautilus_selection_model_remove_file (NautilusSelectionModel *model,
+				      NautilusFile           *file)
+{
+	gpointer value;
+	guint index;
+
+	value = g_hash_table_lookup (model->indexes, file);
+	if (value == NULL) {
+		return;
+	}
+	index = GPOINTER_TO_UINT (value) - 1;
+
+	model_set_bit (model, index, FALSE);
+	g_hash_table_remove (model->indexes, file);
+	g_ptr_array_index (model->files, index) = NULL;
+	g_array_append_val (model->free_indexes, index);
+	model->n_files--;
+
+	nautilus_file_unref (file);
+}
+
+/* Removes the files of a directory that is no longer shown, such as an
+ * unloaded subdirectory of the list view.
+ */
+void
+nautilus_selection_model_remove_directory_files (NautilusSelectionModel *model,
+						 NautilusDirectory      *directory)
+{
+	NautilusFile *file;
+	guint i;
+
+	for (i = 0; i < model->files->len; i++) {
+		file = g_ptr_array_index (model->files, i);
+		if (file != NULL && nautilus_directory_contains_file (directory, file)) {
+			nautilus_selection_model_remove_file (model, file);
+		}
+	}
+}
+
+void
+nautilus_selection_model_clear (NautilusSelectionModel *model)
+{
+	guint i;
+
+	for (i = 0; i < model->files->len; i++) {
+		nautilus_file_unref (g_ptr_array_index (model->files, i));
+	}
+
+	g_ptr_array_set_size (model->files, 0);
+	g_hash_table_remove_all (model->indexes);
+	g_array_set_size (model->free_indexes, 0);
+	model_free_chunks (model);
+	model->n_files = 0;
+	model->invalid = FALSE;
+}
+
+guint
+nautilus_selection_model_get_n_files (NautilusSelectionModel *model)
+{
+	return model->n_files;
+}
+
+gboolean
+nautilus_selection_model_get_index (NautilusSelectionModel *model,
+				    NautilusFile           *file,
+				    guint                  *index)
+{
+	gpointer value;
+
+	value = g_hash_table_lookup (model->indexes, file);
+	if (value == NULL) {
+		return FALSE;
+	}
+
+	if (index != NULL) {
+		*index = GPOINTER_TO_UINT (value) - 1;
+	}
+	return TRUE;
+}
+
+NautilusFile *
+nautilus_selection_model_get_file (NautilusSelectionModel *model,
+				   guint                   index)
+{
+	if (index >= model->files->len) {
+		return NULL;
+	}
+	return g_ptr_array_index (model->files, index);
+}
+
+void
+nautilus_selection_model_set_selected (NautilusSelectionModel *model,
+				       NautilusFile           *file,
+				       gboolean                selected)
+{
+	guint index;
+
+	if (!nautilus_selection_model_get_index (model, file, &index)) {
+		return;
+	}
+
+	model_sync (model);
+	model_set_bit (model, index, selected);
+}
+
+gboolean
+nautilus_selection_model_is_selected (NautilusSelectionModel *model,
+				      NautilusFile           *file)
+{
+	guint index;
+
+	if (!nautilus_selection_model_get_index (model, file, &index)) {
+		return FALSE;
+	}
+
+	model_sync (model);
+	return chunk_get (&g_array_index (model->chunks, Chunk, index / CHUNK_BITS),
+			  index % CHUNK_BITS);
+}
+
+/* Selects the files with indexes from @start up to, but not
+ * including, @end.
+ */
+void
+nautilus_selection_model_select_range (NautilusSelectionModel *model,
+				       guint                   start,
+				       guint                   end)
+{
+	guint i, index;
+
+	end = MIN (end, model->files->len);
+	if (start >= end) {
+		return;
+	}
+
+	model_sync (model);
+	model_fill (model, start, end, TRUE);
+
+	/* Holes left by removed files must stay unselected. */
+	for (i = 0; i < model->free_indexes->len; i++) {
+		index = g_array_index (model->free_indexes, guint, i);
+		if (index >= start && index < end) {
+			model_set_bit (model, index, FALSE);
+		}
+	}
+}
+
+void
+nautilus_selection_model_unselect_range (NautilusSelectionModel *model,
+					 guint                   start,
+					 guint                   end)
+{
+	end = MIN (end, model->files->len);
+	if (start >= end) {
+		return;
+	}
+
+	model_sync (model);
+	model_fill (model, start, end, FALSE);
+}
+
+void
+nautilus_selection_model_select_all (NautilusSelectionModel *model)
+{
+	model->invalid = FALSE;
+	nautilus_selection_model_select_range (model, 0, model->files->len);
+}
+
+void
+nautilus_selection_model_unselect_all (NautilusSelectionModel *model)
+{
+	guint i;
+
+	model->invalid = FALSE;
+	for (i = 0; i < model->chunks->len; i++) {
+		chunk_fill (&g_array_index (model->chunks, Chunk, i), 0, CHUNK_BITS - 1, FALSE);
+	}
+	model->count = 0;
+}
+
+guint
+nautilus_selection_model_get_count (NautilusSelectionModel *model)
+{
+	model_sync (model);
+	return model->count;
+}
+
+void
+nautilus_selection_model_set_sync_func (NautilusSelectionModel        *model,
+					NautilusSelectionModelSyncFunc sync_func,
+					gpointer                       user_data)
+{
+	model->sync_func = sync_func;
+	model->sync_data = user_data;
+}
+
+void
+nautilus_selection_model_invalidate (NautilusSelectionModel *model)
+{
+	g_return_if_fail (model->sync_func != NULL);
+
+	model->invalid = TRUE;
+}
+
+GList *
+nautilus_selection_model_get_files (NautilusSelectionModel *model)
+{
+	NautilusSelectionIter iter;
+	NautilusFile *file;
+	GList *files;
+
+	files = NULL;
+	nautilus_selection_iter_init (&iter, model);
+	while (nautilus_selection_iter_next (&iter, &file)) {
+		files = g_list_prepend (files, nautilus_file_ref (file));
+	}
+
+	return g_list_reverse (files);
+}
+
+void
+nautilus_selection_iter_init (NautilusSelectionIter  *iter,
+			      NautilusSelectionModel *model)
+{
+	model_sync (model);
+	iter->model = model;
+	iter->index = 0;
+}
+
+gboolean
+nautilus_selection_iter_next (NautilusSelectionIter  *iter,
+			      NautilusFile          **file)
+{
+	NautilusSelectionModel *model;
+	Chunk *chunk;
+	guint chunk_index, bit, w, found;
+	guint64 word;
+
+	model = iter->model;
+
+	while (iter->index < model->files->len) {
+		chunk_index = iter->index / CHUNK_BITS;
+		chunk = &g_array_index (model->chunks, Chunk, chunk_index);
+
+		if (chunk->count == 0) {
+			iter->index = (chunk_index + 1) * CHUNK_BITS;
+			continue;
+		}
+
+		bit = iter->index % CHUNK_BITS;
+		if (chunk->words == NULL) {
+			found = iter->index;
+		} else {
+			w = bit / 64;
+			word = chunk->words[w] & ~((G_GUINT64_CONSTANT (1) << (bit % 64)) - 1);
+			while (word == 0 && ++w < CHUNK_WORDS) {
+				word = chunk->words[w];
+			}
+			if (word == 0) {
+				iter->index = (chunk_index + 1) * CHUNK_BITS;
+				continue;
+			}
+			found = chunk_index * CHUNK_BITS + w * 64 + word_first_bit (word);
+		}
+
+		if (found >= model->files->len) {
+			break;
+		}
+
+		iter->index = found + 1;
+		if (g_ptr_array_index (model->files, found) != NULL) {
+			if (file != NULL) {
+				*file = g_ptr_array_index (model->files, found);
+			}
+			return TRUE;
+		}
+	}
+
+	iter->index = model->files->len;
+	return FALSE;
+}
+
+#if !defined (NAUTILUS_OMIT_SELF_CHECK)
+
+static guint
+check_count_by_iterating (NautilusSelectionModel *model)
+{
+	NautilusSelectionIter iter;
+	guint count;
+
+	count = 0;
+	nautilus_selection_iter_init (&iter, model);
+	while (nautilus_selection_iter_next (&iter, NULL)) {
+		count++;
+	}
+	return count;
+}
+
+static void
+check_sync_func (NautilusSelectionModel *model,
+		 gpointer user_data)
+{
+	guint *n_syncs;
+
+	n_syncs = user_data;
+	(*n_syncs)++;
+
+	nautilus_selection_model_unselect_all (model);
+	nautilus_selection_model_select_range (model, 0, 3);
+}
+
+void
+nautilus_self_check_selection_model (void)
+{
+	NautilusSelectionModel *model;
+	NautilusDirectory *directory;
+	NautilusFile *file, *removed;
+	char *uri;
+	guint i, n_syncs;
+
+	model = nautilus_selection_model_new ();
+	removed = NULL;
+
+	for (i = 0; i < 5000; i++) {
+		uri = g_strdup_printf ("file:///nautilus-selection-self-check/%u", i);
+		file = nautilus_file_get_by_uri (uri);
+		EEL_CHECK_INTEGER_RESULT (nautilus_selection_model_add_file (model, file), i);
+		if (i == 4100) {
+			removed = nautilus_file_ref (file);
+		}
+		nautilus_file_unref (file);
+		g_free (uri);
+	}
+
+	EEL_CHECK_INTEGER_RESULT (nautilus_selection_model_get_count (model), 0);
+	EEL_CHECK_INTEGER_RESULT (check_count_by_iterating (model), 0);
+
+	nautilus_selection_model_select_all (model);
+	EEL_CHECK_INTEGER_RESULT (nautilus_selection_model_get_count (model), 5000);
+	EEL_CHECK_INTEGER_RESULT (check_count_by_iterating (model), 5000);
+
+	nautilus_selection_model_unselect_range (model, 10, 20);
+	EEL_CHECK_INTEGER_RESULT (nautilus_selection_model_get_count (model), 4990);
+	EEL_CHECK_BOOLEAN_RESULT (nautilus_selection_model_is_selected
+				  (model, nautilus_selection_model_get_file (model, 15)), FALSE);
+	EEL_CHECK_BOOLEAN_RESULT (nautilus_selection_model_is_selected
+				  (model, nautilus_selection_model_get_file (model, 20)), TRUE);
+
+	nautilus_selection_model_remove_file (model, removed);
+	EEL_CHECK_INTEGER_RESULT (nautilus_selection_model_get_n_files (model), 4999);
+	EEL_CHECK_INTEGER_RESULT (nautilus_selection_model_get_count (model), 4989);
+
+	nautilus_selection_model_select_range (model, 4000, 5000);
+	EEL_CHECK_INTEGER_RESULT (nautilus_selection_model_get_count (model), 4989);
+	EEL_CHECK_INTEGER_RESULT (check_count_by_iterating (model), 4989);
+
+	EEL_CHECK_INTEGER_RESULT (nautilus_selection_model_add_file (model, removed), 4100);
+	EEL_CHECK_BOOLEAN_RESULT (nautilus_selection_model_is_selected (model, removed), FALSE);
+
+	nautilus_selection_model_unselect_all (model);
+	nautilus_selection_model_set_selected (model, removed, TRUE);
+	EEL_CHECK_INTEGER_RESULT (nautilus_selection_model_get_count (model), 1);
+	EEL_CHECK_INTEGER_RESULT (check_count_by_iterating (model), 1);
+
+	n_syncs = 0;
+	nautilus_selection_model_set_sync_func (model, check_sync_func, &n_syncs);
+	nautilus_selection_model_invalidate (model);
+	nautilus_selection_model_invalidate (model);
+	EEL_CHECK_INTEGER_RESULT (n_syncs, 0);
+	EEL_CHECK_INTEGER_RESULT (nautilus_selection_model_get_count (model), 3);
+	EEL_CHECK_BOOLEAN_RESULT (nautilus_selection_model_is_selected (model, removed), FALSE);
+	EEL_CHECK_INTEGER_RESULT (n_syncs, 1);
+
+	nautilus_selection_model_invalidate (model);
+	nautilus_selection_model_select_all (model);
+	EEL_CHECK_INTEGER_RESULT (nautilus_selection_model_get_count (model), 5000);
+	EEL_CHECK_INTEGER_RESULT (n_syncs, 1);
+
+	directory = nautilus_directory_get_by_uri ("file:///nautilus-selection-self-check");
+	nautilus_selection_model_remove_directory_files (model, directory);
+	EEL_CHECK_INTEGER_RESULT (nautilus_selection_model_get_n_files (model), 0);
+	EEL_CHECK_INTEGER_RESULT (nautilus_selection_model_get_count (model), 0);
+	nautilus_directory_unref (directory);
+
+	nautilus_file_unref (removed);
+	nautilus_selection_model_destroy (model);
+}
+
+#endif /* !NAUTILUS_OMIT_SELF_CHECK */
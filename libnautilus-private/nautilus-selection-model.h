@@ -0,0 +1,105 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+ *
+ * nautilus-selection-model.h: view independent selection storage.
+ *
+ * Nautilus is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * Nautilus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; see the file COPYING.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef NAUTILUS_SELECTION_MODEL_H
+#define NAUTILUS_SELECTION_MODEL_H
+
+#include <libnautilus-private/nautilus-directory.h>
+#include <libnautilus-private/nautilus-file.h>
+
+/* A NautilusSelectionModel keeps a table of the files shown by a view,
+ * each file getting a small integer index, and stores which of them are
+ * selected as a compressed bitset over those indexes. Selecting a range
+ * or everything costs one operation per 4096 files, and walking the
+ * selection with a NautilusSelectionIter does not allocate.
+ */
+typedef struct NautilusSelectionModel NautilusSelectionModel;
+
+typedef struct {
+	NautilusSelectionModel *model;
+	guint index;
+} NautilusSelectionIter;
+
+/* Called to bring an invalidated selection up to date; it is expected
+ * to set the selected files again after nautilus_selection_model_unselect_all().
+ */
+typedef void (* NautilusSelectionModelSyncFunc) (NautilusSelectionModel *model,
+						 gpointer                user_data);
+
+NautilusSelectionModel *nautilus_selection_model_new            (void);
+void                    nautilus_selection_model_destroy        (NautilusSelectionModel *model);
+
+/* File table. Files keep their index until they are removed; freed
+ * indexes are reused by later additions.
+ */
+guint                   nautilus_selection_model_add_file       (NautilusSelectionModel *model,
+									 NautilusFile           *file);
+void                    nautilus_selection_model_remove_file    (NautilusSelectionModel *model,
+									 NautilusFile           *file);
+void                    nautilus_selection_model_remove_directory_files (NautilusSelectionModel *model,
+									 NautilusDirectory      *directory);
+void                    nautilus_selection_model_clear          (NautilusSelectionModel *model);
+guint                   nautilus_selection_model_get_n_files    (NautilusSelectionModel *model);
+gboolean                nautilus_selection_model_get_index      (NautilusSelectionModel *model,
+									 NautilusFile           *file,
+									 guint                  *index);
+NautilusFile *          nautilus_selection_model_get_file       (NautilusSelectionModel *model,
+									 guint                   index);
+
+/* Selection */
+void                    nautilus_selection_model_set_selected   (NautilusSelectionModel *model,
+									 NautilusFile           *file,
+									 gboolean                selected);
+gboolean                nautilus_selection_model_is_selected    (NautilusSelectionModel *model,
+									 NautilusFile           *file);
+void                    nautilus_selection_model_select_range   (NautilusSelectionModel *model,
+									 guint                   start,
+									 guint                   end);
+void                    nautilus_selection_model_unselect_range (NautilusSelectionModel *model,
+									 guint                   start,
+									 guint                   end);
+void                    nautilus_selection_model_select_all     (NautilusSelectionModel *model);
+void                    nautilus_selection_model_unselect_all   (NautilusSelectionModel *model);
+guint                   nautilus_selection_model_get_count      (NautilusSelectionModel *model);
+
+/* For views that can only tell that their selection changed, not how:
+ * invalidating is free, and the sync function is called once before
+ * the selection is next read or partly changed. Selecting or
+ * unselecting everything makes the selection valid again without it.
+ */
+void                    nautilus_selection_model_set_sync_func  (NautilusSelectionModel        *model,
+									 NautilusSelectionModelSyncFunc sync_func,
+									 gpointer                       user_data);
+void                    nautilus_selection_model_invalidate     (NautilusSelectionModel *model);
+
+/* Returns a newly allocated list of referenced files, for the callers
+ * that still need a GList.
+ */
+GList *                 nautilus_selection_model_get_files      (NautilusSelectionModel *model);
+
+/* Iteration over the selected files in index order. The files returned
+ * are not referenced; the model must not be changed while iterating.
+ */
+void                    nautilus_selection_iter_init            (NautilusSelectionIter  *iter,
+									 NautilusSelectionModel *model);
+gboolean                nautilus_selection_iter_next            (NautilusSelectionIter  *iter,
+									 NautilusFile          **file);
+
+#endif /* NAUTILUS_SELECTION_MODEL_H */
@@ -302,6 +302,16 @@ vfs_file_get_date (NautilusFile *file,
 			*date = file->details->trash_time;
 		}
 		return TRUE;
+	case NAUTILUS_DATE_TYPE_TAKEN:
+		/* Only known once the image header was read, if it has one */
+		if (!file->details->image_info_is_up_to_date ||
+		    file->details->image_date_taken == 0) {
+			return FALSE;
+		}
+		if (date != NULL) {
+			*date = file->details->image_date_taken;
+		}
+		return TRUE;
 	}
 	return FALSE;
 }
@@ -0,0 +1,156 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+ *
+ * nautilus-warm-directories.c: keep recently viewed directories loaded.
+ *
+ * Nautilus is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * Nautilus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; see the file COPYING.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <config.h>
+#include "nautilus-warm-directories.h"
+
+#include "nautilus-directory-private.h"
+#include "nautilus-file-private.h"
+#include "nautilus-vfs-directory.h"
+
+#include <eel/eel-debug.h>
+
+#define DEBUG_FLAG NAUTILUS_DEBUG_DIRECTORY_VIEW
+#include "nautilus-debug.h"
+
+#define MAX_WARM_DIRECTORIES 8
+#define MAX_WARM_BYTES (64 * 1024 * 1024)
+/* Rough cost of a loaded file: the object, its details and the
+ * strings and icon hanging off them.
+ */
+#define BYTES_PER_FILE (sizeof (NautilusFile) + sizeof (NautilusFileDetails) + 256)
+
+/* The monitor client shared by all the warm directories. */
+static char warm_client;
+
+/* Most recently viewed first. */
+static GQueue warm = G_QUEUE_INIT;
+static gboolean shutdown_registered;
+
+static gsize
+get_directory_bytes (NautilusDirectory *directory)
+{
+	return g_list_length (directory->details->file_list) * BYTES_PER_FILE;
+}
+
+static void
+release_directory (NautilusDirectory *directory)
+{
+	char *uri;
+
+	uri = nautilus_directory_get_uri (directory);
+	DEBUG ("Releasing warm directory %s", uri);
+	g_free (uri);
+
+	nautilus_directory_file_monitor_remove (directory, &warm_client);
+	nautilus_directory_unref (directory);
+}
+
+static void
+trim (void)
+{
+	GList *l, *next;
+	gsize bytes;
+	guint count;
+
+	/* Always keep the most recent one if it fits by itself. */
+	bytes = 0;
+	count = 0;
+	for (l = warm.head; l != NULL; l = next) {
+		next = l->next;
+
+		bytes += get_directory_bytes (l->data);
+		count++;
+
+		if (count > MAX_WARM_DIRECTORIES || bytes > MAX_WARM_BYTES) {
+			release_directory (l->data);
+			g_queue_delete_link (&warm, l);
+		}
+	}
+}
+
+static void
+warm_directories_shutdown (void)
+{
+	NautilusDirectory *directory;
+
+	while ((directory = g_queue_pop_head (&warm)) != NULL) {
+		release_directory (directory);
+	}
+}
+
+void
+nautilus_warm_directories_add (NautilusDirectory *directory)
+{
+	GList *link;
+	char *uri;
+
+	g_return_if_fail (NAUTILUS_IS_DIRECTORY (directory));
+
+	/* Search results and other virtual folders are rebuilt anyway. */
+	if (!NAUTILUS_IS_VFS_DIRECTORY (directory)) {
+		return;
+	}
+
+	if (!shutdown_registered) {
+		eel_debug_call_at_shutdown (warm_directories_shutdown);
+		shutdown_registered = TRUE;
+	}
+
+	link = g_queue_find (&warm, directory);
+	if (link != NULL) {
+		g_queue_unlink (&warm, link);
+		g_queue_push_head_link (&warm, link);
+	} else {
+		uri = nautilus_directory_get_uri (directory);
+		DEBUG ("Keeping %s warm", uri);
+		g_free (uri);
+
+		/* Only the file list is needed, the rest is loaded again
+		 * for the files that get shown.
+		 */
+		nautilus_directory_file_monitor_add (directory, &warm_client,
+						     TRUE, 0, NULL, NULL);
+		g_queue_push_head (&warm, nautilus_directory_ref (directory));
+	}
+
+	trim ();
+}
+
+gboolean
+nautilus_warm_directories_revisit (NautilusDirectory *directory)
+{
+	GList *link;
+
+	link = g_queue_find (&warm, directory);
+	if (link == NULL) {
+		return FALSE;
+	}
+
+	g_queue_unlink (&warm, link);
+	g_queue_push_head_link (&warm, link);
+
+	if (directory->details->monitor == NULL ||
+	    !nautilus_monitor_is_watching (directory->details->monitor)) {
+		nautilus_directory_revalidate_file_list (directory);
+	}
+
+	return TRUE;
+}
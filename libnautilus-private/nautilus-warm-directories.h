@@ -0,0 +1,39 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+ *
+ * nautilus-warm-directories.h: keep recently viewed directories loaded.
+ *
+ * Nautilus is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * Nautilus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; see the file COPYING.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef NAUTILUS_WARM_DIRECTORIES_H
+#define NAUTILUS_WARM_DIRECTORIES_H
+
+#include <libnautilus-private/nautilus-directory.h>
+
+/* A directory a view navigates away from keeps its file list loaded,
+ * and monitored for changes, while it is among the most recently
+ * viewed ones, so going back to it shows its files right away. The
+ * number of directories and the estimated memory they use are bounded.
+ */
+void     nautilus_warm_directories_add     (NautilusDirectory *directory);
+
+/* Called when a view shows the directory again. Directories whose
+ * changes can't be monitored are enumerated again in the background.
+ * Returns TRUE if the directory was still loaded.
+ */
+gboolean nautilus_warm_directories_revisit (NautilusDirectory *directory);
+
+#endif /* NAUTILUS_WARM_DIRECTORIES_H */
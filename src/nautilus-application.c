@@ -40,6 +40,7 @@
 #include "nautilus-progress-ui-handler.h"
 #include "nautilus-self-check-functions.h"
 #include "nautilus-shell-search-provider.h"
+#include "nautilus-startup-benchmark.h"
 #include "nautilus-window.h"
 #include "nautilus-window-private.h"
 #include "nautilus-window-slot.h"
@@ -47,6 +48,7 @@
 #include <libnautilus-private/nautilus-directory-private.h>
 #include <libnautilus-private/nautilus-file-utilities.h>
 #include <libnautilus-private/nautilus-file-operations.h>
+#include <libnautilus-private/nautilus-filename-index.h>
 #include <libnautilus-private/nautilus-global-preferences.h>
 #include <libnautilus-private/nautilus-lib-self-check-functions.h>
 #include <libnautilus-private/nautilus-module.h>
@@ -92,13 +94,16 @@ struct _NautilusApplicationPriv {
 	GtkWidget *connect_server_window;
 
 	NautilusShellSearchProvider *search_provider;
+	guint search_provider_idle_id;
 };
 
 NautilusBookmarkList *
 nautilus_application_get_bookmarks (NautilusApplication *application)
 {
 	if (!application->priv->bookmark_list) {
+		nautilus_startup_benchmark_begin_phase ("Bookmarks");
 		application->priv->bookmark_list = nautilus_bookmark_list_new ();
+		nautilus_startup_benchmark_end_phase ("Bookmarks");
 	}
 
 	return application->priv->bookmark_list;
@@ -268,8 +273,8 @@ menu_provider_init_callback (void)
         nautilus_module_extension_list_free (providers);
 }
 
-static void
-mark_desktop_files_trusted (void)
+static gboolean
+mark_desktop_files_trusted (gpointer user_data)
 {
 	char *do_once_file;
 	GFile *f, *c;
@@ -319,6 +324,8 @@ mark_desktop_files_trusted (void)
 	g_object_unref (f);
  out:	
 	g_free (do_once_file);
+
+	return FALSE;
 }
 
 static void
@@ -328,7 +335,8 @@ do_upgrades_once (NautilusApplication *self)
 	const gchar *message;
 	int fd, res;
 
-	mark_desktop_files_trusted ();
+	/* Nothing needs this right away, keep it out of startup. */
+	g_idle_add_full (G_PRIORITY_LOW, mark_desktop_files_trusted, NULL, NULL);
 
 	metafile_dir = g_build_filename (g_get_home_dir (),
 					 ".nautilus/metafiles", NULL);
@@ -400,6 +408,7 @@ nautilus_application_create_window (NautilusApplication *application,
 
 	g_return_val_if_fail (NAUTILUS_IS_APPLICATION (application), NULL);
 	nautilus_profile_start (NULL);
+	nautilus_startup_benchmark_begin_phase ("Window");
 
 	window = nautilus_window_new (screen);
 
@@ -429,6 +438,7 @@ nautilus_application_create_window (NautilusApplication *application,
 	g_free (geometry_string);
 
 	DEBUG ("Creating a new navigation window");
+	nautilus_startup_benchmark_end_phase ("Window");
 	nautilus_profile_end (NULL);
 
 	return window;
@@ -718,6 +728,16 @@ do_cmdline_sanity_checks (NautilusApplication *self,
 		goto out;
 	}
 
+	if (g_variant_dict_contains (options, "benchmark-startup") &&
+	    (g_variant_dict_contains (options, "check") ||
+	     g_variant_dict_contains (options, "quit") ||
+	     g_variant_dict_contains (options, "select") ||
+	     g_variant_dict_contains (options, "no-default-window"))) {
+		g_printerr ("%s\n",
+			    _("--benchmark-startup can only be used with URIs."));
+		goto out;
+	}
+
 	if (g_variant_dict_contains (options, "force-desktop") &&
 	    g_variant_dict_contains (options, "no-desktop")) {
 		g_printerr ("%s\n",
@@ -827,6 +847,8 @@ const GOptionEntry options[] = {
 	  N_("Quit Nautilus."), NULL },
 	{ "select", 's', 0, G_OPTION_ARG_NONE, NULL,
 	  N_("Select specified URI in parent folder."), NULL },
+	{ "benchmark-startup", '\0', 0, G_OPTION_ARG_NONE, NULL,
+	  N_("Open a window, print how long each part of startup took, and quit."), NULL },
 	{ G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_STRING_ARRAY, NULL, NULL,  N_("[URI...]") },
 
 	{ NULL }
@@ -898,6 +920,10 @@ nautilus_application_handle_local_options (GApplication *application,
 		goto out;
 	}
 
+	if (g_variant_dict_contains (options, "benchmark-startup")) {
+		nautilus_startup_benchmark_enable (application);
+	}
+
 	g_application_register (application, NULL, &error);
 
 	if (error != NULL) {
@@ -1203,6 +1229,14 @@ setup_theme_extensions (void)
 	theme_changed (settings);
 }
 
+static gboolean
+ensure_filename_index_idle (gpointer user_data)
+{
+	nautilus_filename_index_ensure ();
+
+	return FALSE;
+}
+
 static void
 nautilus_application_startup (GApplication *app)
 {
@@ -1223,7 +1257,9 @@ nautilus_application_startup (GApplication *app)
 	self->priv->fdb_manager = nautilus_freedesktop_dbus_new ();
 
 	/* initialize preferences and create the global GSettings objects */
+	nautilus_startup_benchmark_begin_phase ("GSettings");
 	nautilus_global_preferences_init ();
+	nautilus_startup_benchmark_end_phase ("GSettings");
 
 	/* register property pages */
 	nautilus_image_properties_page_register ();
@@ -1234,7 +1270,9 @@ nautilus_application_startup (GApplication *app)
 	
 	/* initialize nautilus modules */
 	nautilus_profile_start ("Modules");
+	nautilus_startup_benchmark_begin_phase ("Modules");
 	nautilus_module_setup ();
+	nautilus_startup_benchmark_end_phase ("Modules");
 	nautilus_profile_end ("Modules");
 
 	/* attach menu-provider module callback */
@@ -1251,12 +1289,39 @@ nautilus_application_startup (GApplication *app)
 
 	do_upgrades_once (self);
 
+	/* Have the filename index ready before the first search */
+	g_idle_add_full (G_PRIORITY_LOW, ensure_filename_index_idle, NULL, NULL);
+
 	nautilus_init_application_actions (self);
 	init_desktop (self);
 
 	nautilus_profile_end (NULL);
 }
 
+static gboolean
+register_search_provider_idle (gpointer user_data)
+{
+	NautilusApplication *self = user_data;
+	GDBusConnection *connection;
+	GError *error = NULL;
+
+	self->priv->search_provider_idle_id = 0;
+
+	connection = g_application_get_dbus_connection (G_APPLICATION (self));
+	if (connection == NULL) {
+		return FALSE;
+	}
+
+	self->priv->search_provider = nautilus_shell_search_provider_new ();
+	if (!nautilus_shell_search_provider_register (self->priv->search_provider, connection, &error)) {
+		g_warning ("Could not register the search provider: %s", error->message);
+		g_error_free (error);
+		g_clear_object (&self->priv->search_provider);
+	}
+
+	return FALSE;
+}
+
 static gboolean
 nautilus_application_dbus_register (GApplication	 *app,
 				    GDBusConnection      *connection,
@@ -1270,9 +1335,17 @@ nautilus_application_dbus_register (GApplication	 *app,
 		return FALSE;
 	}
 
-	self->priv->search_provider = nautilus_shell_search_provider_new ();
-	if (!nautilus_shell_search_provider_register (self->priv->search_provider, connection, error)) {
-		return FALSE;
+	/* When activated for a search, the shell calls right away;
+	 * otherwise the provider can wait until startup is done.
+	 */
+	if (g_application_get_flags (app) & G_APPLICATION_IS_SERVICE) {
+		self->priv->search_provider = nautilus_shell_search_provider_new ();
+		if (!nautilus_shell_search_provider_register (self->priv->search_provider, connection, error)) {
+			return FALSE;
+		}
+	} else {
+		self->priv->search_provider_idle_id =
+			g_idle_add_full (G_PRIORITY_LOW, register_search_provider_idle, self, NULL);
 	}
 
 	return TRUE;
@@ -1289,6 +1362,11 @@ nautilus_application_dbus_unregister (GApplication	*app,
 		nautilus_dbus_manager_unregister (self->priv->dbus_manager);
 	}
 
+	if (self->priv->search_provider_idle_id != 0) {
+		g_source_remove (self->priv->search_provider_idle_id);
+		self->priv->search_provider_idle_id = 0;
+	}
+
 	if (self->priv->search_provider) {
 		nautilus_shell_search_provider_unregister (self->priv->search_provider);
 	}
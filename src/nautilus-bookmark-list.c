@@ -158,6 +158,10 @@ clear (NautilusBookmarkList *bookmarks)
 static void
 do_finalize (GObject *object)
 {
+	if (NAUTILUS_BOOKMARK_LIST (object)->monitor_idle_id != 0) {
+		g_source_remove (NAUTILUS_BOOKMARK_LIST (object)->monitor_idle_id);
+	}
+
 	if (NAUTILUS_BOOKMARK_LIST (object)->monitor != NULL) {
 		g_file_monitor_cancel (NAUTILUS_BOOKMARK_LIST (object)->monitor);
 		NAUTILUS_BOOKMARK_LIST (object)->monitor = NULL;
@@ -203,22 +207,47 @@ bookmark_monitor_changed_cb (GFileMonitor      *monitor,
 }
 
 static void
-nautilus_bookmark_list_init (NautilusBookmarkList *bookmarks)
+start_monitoring_file (NautilusBookmarkList *bookmarks)
 {
 	GFile *file;
 
-	bookmarks->pending_ops = g_queue_new ();
-
-	nautilus_bookmark_list_load_file (bookmarks);
-
 	file = nautilus_bookmark_list_get_file ();
 	bookmarks->monitor = g_file_monitor_file (file, 0, NULL, NULL);
-	g_file_monitor_set_rate_limit (bookmarks->monitor, 1000);
+	g_object_unref (file);
 
+	g_file_monitor_set_rate_limit (bookmarks->monitor, 1000);
 	g_signal_connect (bookmarks->monitor, "changed",
 			  G_CALLBACK (bookmark_monitor_changed_cb), bookmarks);
+}
 
-	g_object_unref (file);
+static gboolean
+start_monitoring_file_idle (gpointer user_data)
+{
+	NautilusBookmarkList *bookmarks = user_data;
+
+	bookmarks->monitor_idle_id = 0;
+
+	/* A save in progress starts monitoring when it is done. */
+	if (bookmarks->monitor == NULL &&
+	    GPOINTER_TO_INT (g_queue_peek_tail (bookmarks->pending_ops)) != SAVE_JOB) {
+		start_monitoring_file (bookmarks);
+	}
+
+	return FALSE;
+}
+
+static void
+nautilus_bookmark_list_init (NautilusBookmarkList *bookmarks)
+{
+	bookmarks->pending_ops = g_queue_new ();
+
+	nautilus_bookmark_list_load_file (bookmarks);
+
+	/* Setting up the monitor is not needed to show the bookmarks,
+	 * so it does not hold up startup.
+	 */
+	bookmarks->monitor_idle_id =
+		g_idle_add_full (G_PRIORITY_LOW, start_monitoring_file_idle, bookmarks, NULL);
 }
 
 static void
@@ -524,16 +553,9 @@ save_callback (GObject *source,
 	       gpointer user_data)
 {
 	NautilusBookmarkList *self = NAUTILUS_BOOKMARK_LIST (source);
-	GFile *file;
 
 	/* re-enable bookmark file monitoring */
-	file = nautilus_bookmark_list_get_file ();
-	self->monitor = g_file_monitor_file (file, 0, NULL, NULL);
-	g_object_unref (file);
-
-	g_file_monitor_set_rate_limit (self->monitor, 1000);
-	g_signal_connect (self->monitor, "changed",
-			  G_CALLBACK (bookmark_monitor_changed_cb), self);
+	start_monitoring_file (self);
 
 	op_processed_cb (self);
 }
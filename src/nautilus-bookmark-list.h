@@ -50,6 +50,7 @@ struct NautilusBookmarkList {
 
 	GList *list; 
 	GFileMonitor *monitor;
+	guint monitor_idle_id;
 	GQueue *pending_ops;
 };
 
@@ -1825,6 +1825,8 @@ create_canvas_container (NautilusCanvasView *canvas_view)
 
 	canvas_container = nautilus_canvas_view_container_new (canvas_view);
 	canvas_view->details->canvas_container = GTK_WIDGET (canvas_container);
+	nautilus_canvas_container_set_selection_model
+		(canvas_container, nautilus_view_get_selection_model (NAUTILUS_VIEW (canvas_view)));
 	g_object_add_weak_pointer (G_OBJECT (canvas_container),
 				   (gpointer *) &canvas_view->details->canvas_container);
 	
@@ -1955,6 +1957,26 @@ canvas_view_get_first_visible_file (NautilusView *view)
 	return NULL;
 }
 
+static GList *
+canvas_view_get_priority_files (NautilusView *view)
+{
+	GList *icons, *l, *files;
+
+	icons = nautilus_canvas_container_get_visible_icons
+		(get_canvas_container (NAUTILUS_CANVAS_VIEW (view)));
+
+	files = NULL;
+	for (l = icons; l != NULL; l = l->next) {
+		files = g_list_prepend (files, nautilus_file_ref (NAUTILUS_FILE (l->data)));
+	}
+	g_list_free (icons);
+	files = g_list_reverse (files);
+
+	nautilus_view_set_shown_files (view, files);
+
+	return files;
+}
+
 static void
 canvas_view_scroll_to_file (NautilusView *view,
 			  const char *uri)
@@ -2062,7 +2084,6 @@ nautilus_canvas_view_class_init (NautilusCanvasViewClass *klass)
 	nautilus_view_class->file_changed = nautilus_canvas_view_file_changed;
 	nautilus_view_class->get_selected_icon_locations = nautilus_canvas_view_get_selected_icon_locations;
 	nautilus_view_class->get_selection = nautilus_canvas_view_get_selection;
-	nautilus_view_class->get_selection_for_file_transfer = nautilus_canvas_view_get_selection;
 	nautilus_view_class->is_empty = nautilus_canvas_view_is_empty;
 	nautilus_view_class->remove_file = nautilus_canvas_view_remove_file;
 	nautilus_view_class->reset_to_defaults = nautilus_canvas_view_reset_to_defaults;
@@ -2086,6 +2107,7 @@ nautilus_canvas_view_class_init (NautilusCanvasViewClass *klass)
 	nautilus_view_class->get_view_id = nautilus_canvas_view_get_id;
 	nautilus_view_class->get_first_visible_file = canvas_view_get_first_visible_file;
 	nautilus_view_class->scroll_to_file = canvas_view_scroll_to_file;
+	nautilus_view_class->get_priority_files = canvas_view_get_priority_files;
 
 	properties[PROP_SUPPORTS_AUTO_LAYOUT] =
 		g_param_spec_boolean ("supports-auto-layout",
@@ -26,6 +26,7 @@
 #include "nautilus-generated.h"
 
 #include <libnautilus-private/nautilus-file-operations.h>
+#include <libnautilus-private/nautilus-module.h>
 
 #define DEBUG_FLAG NAUTILUS_DEBUG_DBUS
 #include <libnautilus-private/nautilus-debug.h>
@@ -36,6 +37,7 @@ struct _NautilusDBusManager {
   GObject parent;
 
   NautilusDBusFileOperations *file_operations;
+  NautilusDBusDebug *debug;
 };
 
 struct _NautilusDBusManagerClass {
@@ -54,6 +56,8 @@ nautilus_dbus_manager_dispose (GObject *object)
     self->file_operations = NULL;
   }
 
+  g_clear_object (&self->debug);
+
   G_OBJECT_CLASS (nautilus_dbus_manager_parent_class)->dispose (object);
 }
 
@@ -124,6 +128,15 @@ handle_empty_trash (NautilusDBusFileOperations *object,
   return TRUE; /* invocation was handled */
 }
 
+static gboolean
+handle_get_extension_stats (NautilusDBusDebug *object,
+			    GDBusMethodInvocation *invocation)
+{
+  nautilus_dbus_debug_complete_get_extension_stats (object, invocation,
+						    nautilus_module_get_call_stats ());
+  return TRUE; /* invocation was handled */
+}
+
 static void
 nautilus_dbus_manager_init (NautilusDBusManager *self)
 {
@@ -141,6 +154,13 @@ nautilus_dbus_manager_init (NautilusDBusManager *self)
 		    "handle-empty-trash",
 		    G_CALLBACK (handle_empty_trash),
 		    self);
+
+  self->debug = nautilus_dbus_debug_skeleton_new ();
+
+  g_signal_connect (self->debug,
+		    "handle-get-extension-stats",
+		    G_CALLBACK (handle_get_extension_stats),
+		    self);
 }
 
 static void
@@ -163,7 +183,11 @@ nautilus_dbus_manager_register (NautilusDBusManager *self,
                                 GDBusConnection     *connection,
                                 GError             **error)
 {
-  return g_dbus_interface_skeleton_export (G_DBUS_INTERFACE_SKELETON (self->file_operations),
+  if (!g_dbus_interface_skeleton_export (G_DBUS_INTERFACE_SKELETON (self->file_operations),
+                                         connection, "/org/gnome/Nautilus", error))
+    return FALSE;
+
+  return g_dbus_interface_skeleton_export (G_DBUS_INTERFACE_SKELETON (self->debug),
                                            connection, "/org/gnome/Nautilus", error);
 }
 
@@ -171,4 +195,5 @@ void
 nautilus_dbus_manager_unregister (NautilusDBusManager *self)
 {
   g_dbus_interface_skeleton_unexport (G_DBUS_INTERFACE_SKELETON (self->file_operations));
+  g_dbus_interface_skeleton_unexport (G_DBUS_INTERFACE_SKELETON (self->debug));
 }
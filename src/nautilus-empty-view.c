@@ -36,7 +36,6 @@ struct NautilusEmptyViewDetails {
 };
 
 static GList *nautilus_empty_view_get_selection                   (NautilusView   *view);
-static GList *nautilus_empty_view_get_selection_for_file_transfer (NautilusView   *view);
 static void   nautilus_empty_view_scroll_to_file                  (NautilusView      *view,
 								   const char        *uri);
 
@@ -87,13 +86,6 @@ nautilus_empty_view_get_selection (NautilusView *view)
 	return NULL;
 }
 
-
-static GList *
-nautilus_empty_view_get_selection_for_file_transfer (NautilusView *view)
-{
-	return NULL;
-}
-
 static gboolean
 nautilus_empty_view_is_empty (NautilusView *view)
 {
@@ -260,7 +252,6 @@ nautilus_empty_view_class_init (NautilusEmptyViewClass *class)
 	nautilus_view_class->clear = nautilus_empty_view_clear;
 	nautilus_view_class->file_changed = nautilus_empty_view_file_changed;
 	nautilus_view_class->get_selection = nautilus_empty_view_get_selection;
-	nautilus_view_class->get_selection_for_file_transfer = nautilus_empty_view_get_selection_for_file_transfer;
 	nautilus_view_class->is_empty = nautilus_empty_view_is_empty;
 	nautilus_view_class->remove_file = nautilus_empty_view_remove_file;
 	nautilus_view_class->merge_menus = nautilus_empty_view_merge_menus;
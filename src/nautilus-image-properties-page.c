@@ -30,6 +30,7 @@
 #include <eel/eel-vfs-extensions.h>
 #include <libnautilus-extension/nautilus-property-page-provider.h>
 #include <libnautilus-private/nautilus-module.h>
+#include <libnautilus-private/nautilus-image-header.h>
 #include <string.h>
 
 #ifdef HAVE_EXIF
@@ -48,6 +49,7 @@ struct NautilusImagePropertiesPageDetails {
 	GCancellable *cancellable;
 	GtkWidget *grid;
 	GdkPixbufLoader *loader;
+	NautilusImageHeader *header;
 	gboolean got_size;
 	gboolean pixbuf_still_loading;
 	char buffer[LOAD_BUFFER_SIZE];
@@ -105,6 +107,11 @@ nautilus_image_properties_page_finalize (GObject *object)
 		page->details->cancellable = NULL;
 	}
 
+	if (page->details->header != NULL) {
+		nautilus_image_header_free (page->details->header);
+		page->details->header = NULL;
+	}
+
 	G_OBJECT_CLASS (nautilus_image_properties_page_parent_class)->finalize (object);
 }
 
@@ -311,6 +318,28 @@ append_option_value_pair (NautilusImagePropertiesPage *page,
 	return TRUE;
 }
 
+/* The pixbuf format matching the name the header reader gives */
+static GdkPixbufFormat *
+get_header_format (NautilusImageHeader *header)
+{
+	GdkPixbufFormat *format;
+	GSList *formats, *l;
+	char *name;
+
+	format = NULL;
+	formats = gdk_pixbuf_get_formats ();
+	for (l = formats; l != NULL && format == NULL; l = l->next) {
+		name = gdk_pixbuf_format_get_name (l->data);
+		if (g_ascii_strcasecmp (name, header->format) == 0) {
+			format = l->data;
+		}
+		g_free (name);
+	}
+	g_slist_free (formats);
+
+	return format;
+}
+
 static void
 append_basic_info (NautilusImagePropertiesPage *page)
 {
@@ -319,15 +348,25 @@ append_basic_info (NautilusImagePropertiesPage *page)
 	char *desc;
 	char *value;
 
-	format = gdk_pixbuf_loader_get_format (page->details->loader);
+	format = NULL;
+	if (page->details->loader != NULL) {
+		format = gdk_pixbuf_loader_get_format (page->details->loader);
+	} else if (page->details->header != NULL) {
+		format = get_header_format (page->details->header);
+	}
 
-	name = gdk_pixbuf_format_get_name (format);
-	desc = gdk_pixbuf_format_get_description (format);
-	value = g_strdup_printf ("%s (%s)", name, desc);
-	g_free (name);
-	g_free (desc);
-	append_item (page, _("Image Type"), value);
-	g_free (value);
+	if (format != NULL) {
+		name = gdk_pixbuf_format_get_name (format);
+		desc = gdk_pixbuf_format_get_description (format);
+		value = g_strdup_printf ("%s (%s)", name, desc);
+		g_free (name);
+		g_free (desc);
+		append_item (page, _("Image Type"), value);
+		g_free (value);
+	} else if (page->details->header != NULL) {
+		/* No loader knows the format, the name is all there is */
+		append_item (page, _("Image Type"), page->details->header->format);
+	}
 	value = g_strdup_printf (ngettext ("%d pixel",
 					   "%d pixels",
 					   page->details->width),
@@ -340,6 +379,27 @@ append_basic_info (NautilusImagePropertiesPage *page)
 				 page->details->height);
 	append_item (page, _("Height"), value);
 	g_free (value);
+
+#ifndef HAVE_EXIF
+	/* Without libexif, show what the header says about the camera */
+	if (page->details->header != NULL) {
+		if (page->details->header->camera_make != NULL) {
+			append_item (page, _("Camera Brand"), page->details->header->camera_make);
+		}
+		if (page->details->header->camera_model != NULL) {
+			append_item (page, _("Camera Model"), page->details->header->camera_model);
+		}
+		if (page->details->header->date_taken != 0) {
+			GDateTime *date_time;
+
+			date_time = g_date_time_new_from_unix_local (page->details->header->date_taken);
+			value = g_date_time_format (date_time, "%c");
+			append_item (page, _("Date Taken"), value);
+			g_free (value);
+			g_date_time_unref (date_time);
+		}
+	}
+#endif /*HAVE_EXIF*/
 }
 
 static void
@@ -347,6 +407,9 @@ append_options_info (NautilusImagePropertiesPage *page)
 {
 	GdkPixbuf *pixbuf;
 
+	if (page->details->loader == NULL)
+		return;
+
 	pixbuf = gdk_pixbuf_loader_get_pixbuf (page->details->loader);
 	if (pixbuf == NULL)
 		return;
@@ -551,6 +614,14 @@ size_prepared_callback (GdkPixbufLoader *loader,
 	page->details->pixbuf_still_loading = FALSE;
 }
 
+/* PNG text chunks end up in the pixbuf options, see append_options_info() */
+static gboolean
+needs_pixbuf_loader (NautilusImagePropertiesPage *page)
+{
+	return !page->details->got_size ||
+		strcmp (page->details->header->format, "PNG") == 0;
+}
+
 typedef struct {
 	NautilusImagePropertiesPage *page;
 	NautilusFileInfo            *info;
@@ -576,24 +647,30 @@ file_open_callback (GObject      *object,
 	if (stream) {
 		char *mime_type;
 
-		mime_type = nautilus_file_info_get_mime_type (data->info);
-		page->details->loader = gdk_pixbuf_loader_new_with_mime_type (mime_type, &error);
-		if (error != NULL) {
-			g_warning ("Error creating loader for %s: %s", uri, error->message);
-			g_clear_error (&error);
+		/* When the header gave the size, the file is only read
+		 * for its EXIF data, which comes at the start, and for
+		 * the text fields only the pixbuf loader reads.
+		 */
+		if (needs_pixbuf_loader (page)) {
+			mime_type = nautilus_file_info_get_mime_type (data->info);
+			page->details->loader = gdk_pixbuf_loader_new_with_mime_type (mime_type, &error);
+			if (error != NULL) {
+				g_warning ("Error creating loader for %s: %s", uri, error->message);
+				g_clear_error (&error);
+			}
+			g_free (mime_type);
 		}
-		page->details->pixbuf_still_loading = TRUE;
-		page->details->width = 0;
-		page->details->height = 0;
+		page->details->pixbuf_still_loading = page->details->loader != NULL;
 #ifdef HAVE_EXIF
 		page->details->exifldr = exif_loader_new ();
 #endif /*HAVE_EXIF*/
-		g_free (mime_type);
 
-		g_signal_connect (page->details->loader,
-				  "size-prepared",
-				  G_CALLBACK (size_prepared_callback),
-				  page);
+		if (page->details->loader != NULL) {
+			g_signal_connect (page->details->loader,
+					  "size-prepared",
+					  G_CALLBACK (size_prepared_callback),
+					  page);
+		}
 
 		g_input_stream_read_async (G_INPUT_STREAM (stream),
 					   page->details->buffer,
@@ -614,6 +691,65 @@ file_open_callback (GObject      *object,
 	g_free (data);
 }
 
+static void
+header_read_thread (GTask        *task,
+		    gpointer      source_object,
+		    gpointer      task_data,
+		    GCancellable *cancellable)
+{
+	NautilusImageHeader *header;
+	GError *error;
+
+	error = NULL;
+	header = nautilus_image_header_read (G_FILE (task_data), cancellable, &error);
+	if (header == NULL) {
+		g_task_return_error (task, error);
+	} else {
+		g_task_return_pointer (task, header,
+				       (GDestroyNotify) nautilus_image_header_free);
+	}
+}
+
+static void
+header_read_callback (GObject      *object,
+		      GAsyncResult *res,
+		      gpointer      user_data)
+{
+	FileOpenData *data = user_data;
+	NautilusImagePropertiesPage *page = data->page;
+	NautilusImageHeader *header;
+	GFile *file;
+
+	file = G_FILE (g_task_get_task_data (G_TASK (res)));
+
+	/* Formats the header reader does not know are decoded as before */
+	header = g_task_propagate_pointer (G_TASK (res), NULL);
+	if (header != NULL && header->width > 0 && header->height > 0) {
+		page->details->header = header;
+		page->details->width = header->width;
+		page->details->height = header->height;
+		page->details->got_size = TRUE;
+	} else if (header != NULL) {
+		nautilus_image_header_free (header);
+	}
+
+#ifndef HAVE_EXIF
+	if (!needs_pixbuf_loader (page)) {
+		load_finished (page);
+		g_object_unref (page->details->cancellable);
+		page->details->cancellable = NULL;
+		g_free (data);
+		return;
+	}
+#endif /*HAVE_EXIF*/
+
+	g_file_read_async (file,
+			   0,
+			   page->details->cancellable,
+			   file_open_callback,
+			   data);
+}
+
 static void
 load_location (NautilusImagePropertiesPage *page,
 	       NautilusFileInfo            *info)
@@ -621,6 +757,7 @@ load_location (NautilusImagePropertiesPage *page,
 	GFile *file;
 	char *uri;
 	FileOpenData *data;
+	GTask *task;
 
 	g_assert (NAUTILUS_IS_IMAGE_PROPERTIES_PAGE (page));
 	g_assert (info != NULL);
@@ -654,11 +791,15 @@ load_location (NautilusImagePropertiesPage *page,
 	data->page = page;
 	data->info = info;
 
-	g_file_read_async (file,
-			   0,
-			   page->details->cancellable,
-			   file_open_callback,
-			   data);
+	/* The size and camera details come from the header, read in a
+	 * thread, so most images do not have to be decoded at all.
+	 */
+	page->details->width = 0;
+	page->details->height = 0;
+	task = g_task_new (page, page->details->cancellable, header_read_callback, data);
+	g_task_set_task_data (task, g_object_ref (file), g_object_unref);
+	g_task_run_in_thread (task, header_read_thread);
+	g_object_unref (task);
 
 	g_object_unref (file);
 	g_free (uri);
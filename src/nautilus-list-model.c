@@ -976,6 +976,38 @@ nautilus_list_model_file_changed (NautilusListModel *model, NautilusFile *file,
 	gtk_tree_path_free (path);
 }
 
+/* Updates the rows of @file in every folder it is listed in, for changes
+ * that do not come from one of the model's directories.
+ */
+void
+nautilus_list_model_file_changed_everywhere (NautilusListModel *model,
+					     NautilusFile *file)
+{
+	GHashTableIter iter;
+	gpointer directory, value;
+	FileEntry *file_entry;
+	GList *directories, *l;
+
+	if (g_hash_table_contains (model->details->top_reverse_map, file)) {
+		nautilus_list_model_file_changed (model, file, NULL);
+	}
+
+	directories = NULL;
+	g_hash_table_iter_init (&iter, model->details->directory_reverse_map);
+	while (g_hash_table_iter_next (&iter, &directory, &value)) {
+		file_entry = g_sequence_get (value);
+		if (file_entry->reverse_map != NULL &&
+		    g_hash_table_contains (file_entry->reverse_map, file)) {
+			directories = g_list_prepend (directories, directory);
+		}
+	}
+
+	for (l = directories; l != NULL; l = l->next) {
+		nautilus_list_model_file_changed (model, file, l->data);
+	}
+	g_list_free (directories);
+}
+
 gboolean
 nautilus_list_model_is_empty (NautilusListModel *model)
 {
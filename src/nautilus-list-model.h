@@ -77,6 +77,8 @@ gboolean nautilus_list_model_add_file                          (NautilusListMode
 void     nautilus_list_model_file_changed                      (NautilusListModel          *model,
 								NautilusFile         *file,
 								NautilusDirectory    *directory);
+void     nautilus_list_model_file_changed_everywhere           (NautilusListModel          *model,
+								NautilusFile         *file);
 gboolean nautilus_list_model_is_empty                          (NautilusListModel          *model);
 guint    nautilus_list_model_get_length                        (NautilusListModel          *model);
 void     nautilus_list_model_remove_file                       (NautilusListModel          *model,
@@ -103,11 +103,23 @@ struct NautilusListViewDetails {
 	gulong clipboard_handler_id;
 
 	GQuark last_sort_attr;
-};
 
-struct SelectionForeachData {
-	GList *list;
-	GtkTreeSelection *selection;
+	guint column_widths_idle_id;
+	gboolean column_widths_estimated;
+	/* A button is held on the column headers, where the resize
+	 * handles are, so width changes come from the user.
+	 */
+	gboolean header_button_down;
+
+	/* Files on screen with a monitor of ours for the total size or
+	 * image columns, with the attributes monitored, and the folders
+	 * whose count moved on since their rows were last updated.
+	 */
+	GHashTable *requested_files;
+	GHashTable *total_size_changed_files;
+	guint total_size_update_id;
+	/* The folder shown, while sorting by an image column */
+	NautilusDirectory *image_info_directory;
 };
 
 /*
@@ -123,12 +135,22 @@ struct SelectionForeachData {
 /* Wait for the rename to end when activating a file being renamed */
 #define WAIT_FOR_RENAME_ON_ACTIVATE 200
 
+/* Columns use fixed widths so rows can be laid out without measuring
+ * them. The widths are estimated from this many rows spread over the
+ * model, and capped so one long value can't take over the view.
+ */
+#define COLUMN_WIDTH_SAMPLE_ROWS 64
+#define COLUMN_WIDTH_MAX 300
+#define NAME_COLUMN_WIDTH_MAX 450
+
+/* Rows of folders being counted show the size found so far this often */
+#define TOTAL_SIZE_UPDATE_INTERVAL 250
+
 static GdkCursor *              hand_cursor = NULL;
 
 static GtkTargetList *          source_target_list = NULL;
 
 static GList *nautilus_list_view_get_selection                   (NautilusView   *view);
-static GList *nautilus_list_view_get_selection_for_file_transfer (NautilusView   *view);
 static void   nautilus_list_view_set_zoom_level                  (NautilusListView        *view,
 								  NautilusZoomLevel  new_level,
 								  gboolean           always_set_level);
@@ -146,6 +168,7 @@ static char **get_visible_columns                                (NautilusListVi
 static char **get_default_visible_columns                        (NautilusListView *list_view);
 static char **get_column_order                                   (NautilusListView *list_view);
 static char **get_default_column_order                           (NautilusListView *list_view);
+static void   queue_column_width_estimate                        (NautilusListView *list_view);
 
 
 G_DEFINE_TYPE (NautilusListView, nautilus_list_view, NAUTILUS_TYPE_VIEW);
@@ -198,6 +221,43 @@ get_default_sort_order (NautilusFile *file, gboolean *reversed)
 	return retval;
 }
 
+static void
+selection_model_foreach_func (GtkTreeModel *model,
+			      GtkTreePath  *path,
+			      GtkTreeIter  *iter,
+			      gpointer      data)
+{
+	NautilusFile *file;
+
+	gtk_tree_model_get (model, iter,
+			    NAUTILUS_LIST_MODEL_FILE_COLUMN, &file,
+			    -1);
+
+	if (file != NULL) {
+		nautilus_selection_model_set_selected (data, file, TRUE);
+		nautilus_file_unref (file);
+	}
+}
+
+/* Reads the selection back from the tree view. This only runs once the
+ * selection model is used after one or more changes, not on every
+ * change, so rubberbanding or extending the selection row by row does
+ * not walk the whole selection each time.
+ */
+static void
+sync_selection_model (NautilusSelectionModel *selection_model,
+		      gpointer user_data)
+{
+	NautilusListView *view;
+
+	view = NAUTILUS_LIST_VIEW (user_data);
+
+	nautilus_selection_model_unselect_all (selection_model);
+	gtk_tree_selection_selected_foreach (gtk_tree_view_get_selection (view->details->tree_view),
+					     selection_model_foreach_func,
+					     selection_model);
+}
+
 static void
 list_selection_changed_callback (GtkTreeSelection *selection, gpointer user_data)
 {
@@ -205,6 +265,7 @@ list_selection_changed_callback (GtkTreeSelection *selection, gpointer user_data
 
 	view = NAUTILUS_VIEW (user_data);
 
+	nautilus_selection_model_invalidate (nautilus_view_get_selection_model (view));
 	nautilus_view_notify_selection_changed (view);
 }
 
@@ -371,7 +432,7 @@ drag_data_get_callback (GtkWidget *widget,
 {
 	GtkTreeView *tree_view;
 	GtkTreeModel *model;
-	GList *selection_cache;
+	NautilusDragSelectionCache *selection_cache;
 
 	tree_view = GTK_TREE_VIEW (widget);
   
@@ -485,14 +546,27 @@ each_item_get_data_binder (NautilusDragEachSelectedItemDataGet iteratee,
 {
 	NautilusListView *view = NAUTILUS_LIST_VIEW (iterator_context);
 	ListGetDataBinderContext context;
-	GtkTreeSelection *selection;
+	NautilusSelectionIter selection_iter;
+	NautilusFile *file;
+	GtkTreeModel *model;
+	GtkTreeIter iter;
+	GtkTreePath *path;
 
 	context.view = view;
 	context.iteratee = iteratee;
 	context.iteratee_data = data;
 
-	selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (view->details->tree_view));
-	gtk_tree_selection_selected_foreach (selection, item_get_data_binder, &context);
+	model = GTK_TREE_MODEL (view->details->model);
+	nautilus_selection_iter_init (&selection_iter,
+				      nautilus_view_get_selection_model (NAUTILUS_VIEW (view)));
+	while (nautilus_selection_iter_next (&selection_iter, &file)) {
+		if (!nautilus_list_model_get_first_iter_for_file (view->details->model, file, &iter)) {
+			continue;
+		}
+		path = gtk_tree_model_get_path (model, &iter);
+		item_get_data_binder (model, path, &iter, &context);
+		gtk_tree_path_free (path);
+	}
 }
 
 
@@ -501,7 +575,7 @@ drag_begin_callback (GtkWidget *widget,
 		     GdkDragContext *context,
 		     NautilusListView *view)
 {
-	GList *selection_cache;
+	NautilusDragSelectionCache *selection_cache;
 	cairo_surface_t *surface;
 
 	surface = get_drag_surface (view);
@@ -521,7 +595,7 @@ drag_begin_callback (GtkWidget *widget,
 	g_object_set_data_full (G_OBJECT (context),
 				"drag-info",
 				selection_cache,
-				(GDestroyNotify)nautilus_drag_destroy_selection_list);
+				(GDestroyNotify)nautilus_drag_selection_cache_free);
 }
 
 static gboolean
@@ -671,6 +745,7 @@ button_press_callback (GtkWidget *widget, GdkEventButton *event, gpointer callba
 	}
 
 	if (event->window != gtk_tree_view_get_bin_window (tree_view)) {
+		view->details->header_button_down = TRUE;
 		return FALSE;
 	}
 
@@ -714,6 +789,7 @@ button_press_callback (GtkWidget *widget, GdkEventButton *event, gpointer callba
 		/* Deselect if people click outside any row. It's OK to
 		   let default code run; it won't reselect anything. */
 		gtk_tree_selection_unselect_all (gtk_tree_view_get_selection (tree_view));
+		nautilus_selection_model_unselect_all (nautilus_view_get_selection_model (NAUTILUS_VIEW (view)));
 		tree_view_class->button_press_event (widget, event);
 
 		if (event->button == 3) {
@@ -858,6 +934,7 @@ button_release_callback (GtkWidget *widget,
 	NautilusListView *view;
 	
 	view = NAUTILUS_LIST_VIEW (callback_data);
+	view->details->header_button_down = FALSE;
 
 	if (event->button == view->details->drag_button) {
 		stop_drag_check (view);
@@ -908,6 +985,8 @@ row_expanded_callback (GtkTreeView *treeview,
 	g_free (uri);
 
 	nautilus_view_add_subdirectory (NAUTILUS_VIEW (view), directory);
+	/* Let folders expanded on screen load before those scrolled away */
+	nautilus_view_queue_full_info_request (NAUTILUS_VIEW (view));
 
 	if (nautilus_directory_are_all_files_seen (directory)) {
 		nautilus_list_model_subdirectory_done_loading (view->details->model,
@@ -1247,6 +1326,8 @@ sort_column_changed_callback (GtkTreeSortable *sortable,
 	nautilus_file_set_metadata (file, NAUTILUS_METADATA_KEY_LIST_VIEW_SORT_REVERSED,
 				    default_reversed_attr, reversed_attr);
 
+	nautilus_view_queue_full_info_request (NAUTILUS_VIEW (view));
+
 	/* Make sure selected item(s) is visible after sort */
 	nautilus_list_view_reveal_selection (NAUTILUS_VIEW (view));
 
@@ -1709,6 +1790,10 @@ apply_columns_settings (NautilusListView *list_view,
 		prev_view_column = l->data;
 	}
 	g_list_free (view_columns);
+
+	queue_column_width_estimate (list_view);
+	/* Start or stop counting total sizes */
+	nautilus_view_queue_full_info_request (NAUTILUS_VIEW (list_view));
 }
 
 static void
@@ -1875,6 +1960,288 @@ trash_orig_path_cell_data_func (GtkTreeViewColumn *column,
 }
 
 
+static int
+estimate_column_width (NautilusListView *view,
+		       GtkTreeViewColumn *column)
+{
+	GtkTreeModel *model;
+	GtkTreeIter iter;
+	int n_rows, step, i;
+	int width, cell_width;
+	int expander_size, separator;
+
+	gtk_widget_get_preferred_width (gtk_tree_view_column_get_button (column),
+					&width, NULL);
+
+	model = GTK_TREE_MODEL (view->details->model);
+	n_rows = gtk_tree_model_iter_n_children (model, NULL);
+	step = MAX (1, n_rows / COLUMN_WIDTH_SAMPLE_ROWS);
+
+	for (i = 0; i < n_rows; i += step) {
+		if (!gtk_tree_model_iter_nth_child (model, &iter, NULL, i)) {
+			break;
+		}
+		gtk_tree_view_column_cell_set_cell_data (column, model, &iter, FALSE, FALSE);
+		gtk_tree_view_column_cell_get_size (column, NULL, NULL, NULL, &cell_width, NULL);
+		width = MAX (width, cell_width);
+	}
+
+	gtk_widget_style_get (GTK_WIDGET (view->details->tree_view),
+			      "expander-size", &expander_size,
+			      "horizontal-separator", &separator,
+			      NULL);
+	width += separator;
+
+	if (column == view->details->file_name_column) {
+		if (gtk_tree_view_get_show_expanders (view->details->tree_view)) {
+			/* Room for the expander and one level of nesting. */
+			width += 2 * expander_size;
+		}
+		return MIN (width, NAME_COLUMN_WIDTH_MAX);
+	}
+
+	return MIN (width, COLUMN_WIDTH_MAX);
+}
+
+#define COLUMN_RESIZED_BY_USER "nautilus-list-view-resized-by-user"
+
+static void
+column_width_changed_callback (GObject *column,
+			       GParamSpec *pspec,
+			       NautilusListView *view)
+{
+	if (view->details->header_button_down) {
+		g_object_set_data (column, COLUMN_RESIZED_BY_USER, GINT_TO_POINTER (TRUE));
+	}
+}
+
+/* Columns the user resized keep their width. */
+static void
+estimate_column_widths (NautilusListView *view)
+{
+	GList *columns, *l;
+
+	columns = gtk_tree_view_get_columns (view->details->tree_view);
+	for (l = columns; l != NULL; l = l->next) {
+		if (gtk_tree_view_column_get_visible (l->data) &&
+		    g_object_get_data (l->data, COLUMN_RESIZED_BY_USER) == NULL) {
+			gtk_tree_view_column_set_fixed_width (l->data,
+							      estimate_column_width (view, l->data));
+		}
+	}
+	g_list_free (columns);
+}
+
+static gboolean
+column_widths_idle_callback (gpointer data)
+{
+	NautilusListView *view;
+
+	view = NAUTILUS_LIST_VIEW (data);
+	view->details->column_widths_idle_id = 0;
+
+	if (view->details->model != NULL) {
+		estimate_column_widths (view);
+		view->details->column_widths_estimated = TRUE;
+	}
+
+	return FALSE;
+}
+
+static void
+queue_column_width_estimate (NautilusListView *view)
+{
+	if (view->details->column_widths_idle_id == 0) {
+		view->details->column_widths_idle_id =
+			g_idle_add (column_widths_idle_callback, view);
+	}
+}
+
+static gboolean
+total_size_column_is_visible (NautilusListView *view)
+{
+	GtkTreeViewColumn *column;
+
+	column = g_hash_table_lookup (view->details->columns, "total_size");
+	return column != NULL && gtk_tree_view_column_get_visible (column);
+}
+
+static gboolean
+image_column_is_visible (NautilusListView *view)
+{
+	GtkTreeViewColumn *column;
+
+	column = g_hash_table_lookup (view->details->columns, "dimensions");
+	if (column != NULL && gtk_tree_view_column_get_visible (column)) {
+		return TRUE;
+	}
+	column = g_hash_table_lookup (view->details->columns, "date_taken");
+	return column != NULL && gtk_tree_view_column_get_visible (column);
+}
+
+static gboolean
+sort_needs_image_info (NautilusListView *view)
+{
+	gint sort_column_id;
+	GtkSortType order;
+	GQuark attribute;
+
+	if (!gtk_tree_sortable_get_sort_column_id (GTK_TREE_SORTABLE (view->details->model),
+						   &sort_column_id, &order)) {
+		return FALSE;
+	}
+
+	attribute = nautilus_list_model_get_attribute_from_sort_column_id (view->details->model,
+									   sort_column_id);
+
+	return attribute == g_quark_from_static_string ("dimensions")
+		|| attribute == g_quark_from_static_string ("date_taken");
+}
+
+static gboolean
+total_size_update_callback (gpointer data)
+{
+	NautilusListView *view;
+	NautilusFile *file;
+	GHashTableIter iter;
+
+	view = NAUTILUS_LIST_VIEW (data);
+	view->details->total_size_update_id = 0;
+
+	/* The rows may be listed in a search rather than in their
+	 * parent folder, or in both.
+	 */
+	g_hash_table_iter_init (&iter, view->details->total_size_changed_files);
+	while (g_hash_table_iter_next (&iter, (gpointer *) &file, NULL)) {
+		nautilus_list_model_file_changed_everywhere (view->details->model, file);
+	}
+	g_hash_table_remove_all (view->details->total_size_changed_files);
+
+	return FALSE;
+}
+
+static void
+total_size_progress_callback (NautilusFile *file,
+			      gpointer callback_data)
+{
+	NautilusListView *view;
+
+	view = NAUTILUS_LIST_VIEW (callback_data);
+
+	/* A count reports every folder it is done with, so the rows are
+	 * updated in batches.
+	 */
+	g_hash_table_add (view->details->total_size_changed_files, file);
+	if (view->details->total_size_update_id == 0) {
+		view->details->total_size_update_id =
+			g_timeout_add (TOTAL_SIZE_UPDATE_INTERVAL,
+				       total_size_update_callback, view);
+	}
+}
+
+static void
+requested_file_release (NautilusListView *view,
+			NautilusFile *file)
+{
+	g_signal_handlers_disconnect_by_func (file,
+					      G_CALLBACK (total_size_progress_callback),
+					      view);
+	nautilus_file_monitor_remove (file, view);
+	g_hash_table_remove (view->details->total_size_changed_files, file);
+}
+
+/* Count the total size of the folders among the shown files and read
+ * the headers of the shown images, and stop for those no longer shown.
+ * Finished counts stay with the files, so other views and later visits
+ * reuse them until a folder changes. Sorting by an image column needs
+ * all images in the folder, so they are read as well, after those on
+ * screen.
+ */
+static void
+update_file_requests (NautilusListView *view,
+		      GList *shown_files)
+{
+	GHashTable *wanted;
+	GHashTableIter iter;
+	NautilusFile *file;
+	NautilusDirectory *directory;
+	NautilusFileAttributes attributes;
+	gboolean total_size, image_info;
+	gpointer value;
+	GList *l;
+
+	total_size = shown_files != NULL && total_size_column_is_visible (view);
+	image_info = shown_files != NULL && image_column_is_visible (view);
+
+	wanted = g_hash_table_new (NULL, NULL);
+	for (l = shown_files; l != NULL; l = l->next) {
+		file = NAUTILUS_FILE (l->data);
+		attributes = 0;
+		if (nautilus_file_is_directory (file)) {
+			if (total_size &&
+			    nautilus_file_should_show_directory_item_count (file)) {
+				attributes = NAUTILUS_FILE_ATTRIBUTE_DEEP_COUNTS;
+			}
+		} else if (image_info) {
+			attributes = NAUTILUS_FILE_ATTRIBUTE_IMAGE_INFO;
+		}
+		if (attributes != 0) {
+			g_hash_table_insert (wanted, file, GUINT_TO_POINTER (attributes));
+		}
+	}
+
+	g_hash_table_iter_init (&iter, view->details->requested_files);
+	while (g_hash_table_iter_next (&iter, (gpointer *) &file, NULL)) {
+		if (!g_hash_table_contains (wanted, file)) {
+			requested_file_release (view, file);
+			g_hash_table_iter_remove (&iter);
+		}
+	}
+
+	/* Visible rows come in order, so the work starts top down */
+	for (l = shown_files; l != NULL; l = l->next) {
+		file = NAUTILUS_FILE (l->data);
+		if (!g_hash_table_lookup_extended (wanted, file, NULL, &value)) {
+			continue;
+		}
+		attributes = GPOINTER_TO_UINT (value);
+		if (g_hash_table_lookup (view->details->requested_files, file) == value) {
+			continue;
+		}
+
+		if (!g_hash_table_contains (view->details->requested_files, file)) {
+			g_signal_connect (file, "updated-deep-count-in-progress",
+					  G_CALLBACK (total_size_progress_callback), view);
+		}
+		g_hash_table_insert (view->details->requested_files,
+				     nautilus_file_ref (file), value);
+		/* Replaces an earlier monitor of ours */
+		nautilus_file_monitor_add (file, view, attributes);
+	}
+
+	g_hash_table_destroy (wanted);
+
+	directory = NULL;
+	if (image_info && sort_needs_image_info (view)) {
+		directory = nautilus_view_get_model (NAUTILUS_VIEW (view));
+	}
+	if (view->details->image_info_directory != directory) {
+		if (view->details->image_info_directory != NULL) {
+			nautilus_directory_file_monitor_remove (view->details->image_info_directory,
+								&view->details->image_info_directory);
+			nautilus_directory_unref (view->details->image_info_directory);
+		}
+		view->details->image_info_directory = nautilus_directory_ref (directory);
+		if (directory != NULL) {
+			nautilus_directory_file_monitor_add (directory,
+							     &view->details->image_info_directory,
+							     FALSE,
+							     NAUTILUS_FILE_ATTRIBUTE_IMAGE_INFO,
+							     NULL, NULL);
+		}
+	}
+}
+
 static void
 set_up_pixbuf_size (NautilusListView *view)
 {
@@ -1885,9 +2252,15 @@ set_up_pixbuf_size (NautilusListView *view)
 	gtk_cell_renderer_set_fixed_size (GTK_CELL_RENDERER (view->details->pixbuf_cell),
 					  -1, icon_size);
 
+	/* The tree view measures the fixed row height once, from the
+	 * first row; toggling the mode makes it measure again.
+	 */
+	if (gtk_tree_view_get_fixed_height_mode (view->details->tree_view)) {
+		gtk_tree_view_set_fixed_height_mode (view->details->tree_view, FALSE);
+		gtk_tree_view_set_fixed_height_mode (view->details->tree_view, TRUE);
+	}
 
-	/* FIXME: https://bugzilla.gnome.org/show_bug.cgi?id=641518 */
-	gtk_tree_view_columns_autosize (view->details->tree_view);
+	queue_column_width_estimate (view);
 }
 
 static gint
@@ -1943,6 +2316,8 @@ create_and_set_up_tree_view (NautilusListView *view)
 	g_signal_connect_object (gtk_tree_view_get_selection (view->details->tree_view),
 				 "changed",
 				 G_CALLBACK (list_selection_changed_callback), view, 0);
+	nautilus_selection_model_set_sync_func (nautilus_view_get_selection_model (NAUTILUS_VIEW (view)),
+						sync_selection_model, view);
 
 	g_signal_connect_object (view->details->tree_view, "drag-begin",
 				 G_CALLBACK (drag_begin_callback), view, 0);
@@ -2039,6 +2414,10 @@ create_and_set_up_tree_view (NautilusListView *view)
 			gtk_tree_view_column_set_title (view->details->file_name_column, _("Name"));
 			gtk_tree_view_column_set_resizable (view->details->file_name_column, TRUE);
 			gtk_tree_view_column_set_expand (view->details->file_name_column, TRUE);
+			gtk_tree_view_column_set_sizing (view->details->file_name_column,
+							 GTK_TREE_VIEW_COLUMN_FIXED);
+			g_signal_connect (view->details->file_name_column, "notify::width",
+					  G_CALLBACK (column_width_changed_callback), view);
 
 			/* Initial padding */
 			cell = gtk_cell_renderer_text_new ();
@@ -2066,6 +2445,7 @@ create_and_set_up_tree_view (NautilusListView *view)
 				      "single-paragraph-mode", TRUE,
 				      "xpad", 5,
 				      NULL);
+			gtk_cell_renderer_text_set_fixed_height_from_font (GTK_CELL_RENDERER_TEXT (cell), 1);
 
 			g_signal_connect (cell, "edited", G_CALLBACK (cell_renderer_edited), view);
 			g_signal_connect (cell, "editing-canceled", G_CALLBACK (cell_renderer_editing_canceled), view);
@@ -2080,7 +2460,9 @@ create_and_set_up_tree_view (NautilusListView *view)
 			g_object_set (cell,
 				      "xalign", xalign,
 				      "xpad", 5,
+				      "ellipsize", PANGO_ELLIPSIZE_END,
 				      NULL);
+			gtk_cell_renderer_text_set_fixed_height_from_font (GTK_CELL_RENDERER_TEXT (cell), 1);
 			view->details->cells = g_list_append (view->details->cells,
 							      cell);
 			column = gtk_tree_view_column_new_with_attributes (label,
@@ -2099,7 +2481,10 @@ create_and_set_up_tree_view (NautilusListView *view)
 			                  view);
 			
 			gtk_tree_view_column_set_resizable (column, TRUE);
+			gtk_tree_view_column_set_sizing (column, GTK_TREE_VIEW_COLUMN_FIXED);
 			gtk_tree_view_column_set_sort_order (column, sort_order);
+			g_signal_connect (column, "notify::width",
+					  G_CALLBACK (column_width_changed_callback), view);
 
 			if (!strcmp (name, "where")) {
 				gtk_tree_view_column_set_cell_data_func (column, cell,
@@ -2116,6 +2501,12 @@ create_and_set_up_tree_view (NautilusListView *view)
 	}
 	nautilus_column_list_free (nautilus_columns);
 
+	/* All rows get the height of the first one and only the rows
+	 * being drawn are measured, so large folders show up without
+	 * every row's cells being sized first.
+	 */
+	gtk_tree_view_set_fixed_height_mode (view->details->tree_view, TRUE);
+
 	default_visible_columns = g_settings_get_strv (nautilus_list_view_preferences,
 						       NAUTILUS_PREFERENCES_LIST_VIEW_DEFAULT_VISIBLE_COLUMNS);
 	default_column_order = g_settings_get_strv (nautilus_list_view_preferences,
@@ -2320,6 +2711,8 @@ nautilus_list_view_begin_loading (NautilusView *view)
 
 	list_view = NAUTILUS_LIST_VIEW (view);
 
+	list_view->details->column_widths_estimated = FALSE;
+
 	set_sort_order_from_metadata_and_preferences (list_view);
 	set_columns_settings_from_metadata_and_preferences (list_view);
 }
@@ -2351,6 +2744,7 @@ nautilus_list_view_clear (NautilusView *view)
 
 	if (list_view->details->model != NULL) {
 		stop_cell_editing (list_view);
+		update_file_requests (list_view, NULL);
 		nautilus_list_model_clear (list_view->details->model);
 	}
 }
@@ -2597,53 +2991,6 @@ nautilus_list_view_get_selection (NautilusView *view)
 	return g_list_reverse (list);
 }
 
-static void
-nautilus_list_view_get_selection_for_file_transfer_foreach_func (GtkTreeModel *model, GtkTreePath *path, GtkTreeIter *iter, gpointer data)
-{
-	NautilusFile *file;
-	struct SelectionForeachData *selection_data;
-	GtkTreeIter parent, child;
-
-	selection_data = data;
-
-	gtk_tree_model_get (model, iter,
-			    NAUTILUS_LIST_MODEL_FILE_COLUMN, &file,
-			    -1);
-
-	if (file != NULL) {
-		/* If the parent folder is also selected, don't include this file in the
-		 * file operation, since that would copy it to the toplevel target instead
-		 * of keeping it as a child of the copied folder
-		 */
-		child = *iter;
-		while (gtk_tree_model_iter_parent (model, &parent, &child)) {
-			if (gtk_tree_selection_iter_is_selected (selection_data->selection,
-								 &parent)) {
-				return;
-			}
-			child = parent;
-		}
-		
-		nautilus_file_ref (file);
-		selection_data->list = g_list_prepend (selection_data->list, file);
-	}
-}
-
-
-static GList *
-nautilus_list_view_get_selection_for_file_transfer (NautilusView *view)
-{
-	struct SelectionForeachData selection_data;
-
-	selection_data.list = NULL;
-	selection_data.selection = gtk_tree_view_get_selection (NAUTILUS_LIST_VIEW (view)->details->tree_view);
-
-	gtk_tree_selection_selected_foreach (selection_data.selection,
-					     nautilus_list_view_get_selection_for_file_transfer_foreach_func, &selection_data);
-
-	return g_list_reverse (selection_data.list);
-}
-
 static gboolean
 nautilus_list_view_is_empty (NautilusView *view)
 {
@@ -2657,6 +3004,13 @@ nautilus_list_view_end_file_changes (NautilusView *view)
 
 	list_view = NAUTILUS_LIST_VIEW (view);
 
+	/* Size the columns from the first files shown; end_loading
+	 * refines the estimate once the whole folder is known.
+	 */
+	if (!list_view->details->column_widths_estimated) {
+		queue_column_width_estimate (list_view);
+	}
+
 	if (list_view->details->new_selection_path) {
 		gtk_tree_view_set_cursor (list_view->details->tree_view,
 					  list_view->details->new_selection_path,
@@ -2729,6 +3083,7 @@ static void
 nautilus_list_view_set_selection (NautilusView *view, GList *selection)
 {
 	NautilusListView *list_view;
+	NautilusSelectionModel *selection_model;
 	GtkTreeSelection *tree_selection;
 	GList *node;
 	GList *iters, *l;
@@ -2736,10 +3091,15 @@ nautilus_list_view_set_selection (NautilusView *view, GList *selection)
 	
 	list_view = NAUTILUS_LIST_VIEW (view);
 	tree_selection = gtk_tree_view_get_selection (list_view->details->tree_view);
+	selection_model = nautilus_view_get_selection_model (view);
 
 	g_signal_handlers_block_by_func (tree_selection, list_selection_changed_callback, view);
 
+	/* The files are known here, so the selection model is set
+	 * along with the rows rather than read back from them.
+	 */
 	gtk_tree_selection_unselect_all (tree_selection);
+	nautilus_selection_model_unselect_all (selection_model);
 	for (node = selection; node != NULL; node = node->next) {
 		file = node->data;
 		iters = nautilus_list_model_get_all_iters_for_file (list_view->details->model, file);
@@ -2748,6 +3108,9 @@ nautilus_list_view_set_selection (NautilusView *view, GList *selection)
 			gtk_tree_selection_select_iter (tree_selection,
 							(GtkTreeIter *)l->data);
 		}
+		if (iters != NULL) {
+			nautilus_selection_model_set_selected (selection_model, file, TRUE);
+		}
 		g_list_free_full (iters, g_free);
 	}
 
@@ -2789,13 +3152,22 @@ nautilus_list_view_invert_selection (NautilusView *view)
 	g_list_free (selection);
 
 	g_signal_handlers_unblock_by_func (tree_selection, list_selection_changed_callback, view);
-	nautilus_view_notify_selection_changed (view);
+	list_selection_changed_callback (tree_selection, view);
 }
 
 static void
 nautilus_list_view_select_all (NautilusView *view)
 {
 	gtk_tree_selection_select_all (gtk_tree_view_get_selection (NAUTILUS_LIST_VIEW (view)->details->tree_view));
+
+	/* Without expanded folders every file of the selection model is a
+	 * row, so selecting them all is a range over the bitset. Otherwise
+	 * files of collapsed folders must stay unselected, and the
+	 * selection is read back from the rows when needed.
+	 */
+	if (!nautilus_view_has_subdirectories (view)) {
+		nautilus_selection_model_select_all (nautilus_view_get_selection_model (view));
+	}
 }
 
 static void
@@ -3389,12 +3761,19 @@ nautilus_list_view_dispose (GObject *object)
 
 	list_view = NAUTILUS_LIST_VIEW (object);
 
+	update_file_requests (list_view, NULL);
+
 	if (list_view->details->model) {
 		stop_cell_editing (list_view);
 		g_object_unref (list_view->details->model);
 		list_view->details->model = NULL;
 	}
 
+	if (list_view->details->total_size_update_id != 0) {
+		g_source_remove (list_view->details->total_size_update_id);
+		list_view->details->total_size_update_id = 0;
+	}
+
 	if (list_view->details->drag_dest) {
 		g_object_unref (list_view->details->drag_dest);
 		list_view->details->drag_dest = NULL;
@@ -3405,6 +3784,11 @@ nautilus_list_view_dispose (GObject *object)
 		list_view->details->renaming_file_activate_timeout = 0;
 	}
 
+	if (list_view->details->column_widths_idle_id != 0) {
+		g_source_remove (list_view->details->column_widths_idle_id);
+		list_view->details->column_widths_idle_id = 0;
+	}
+
 	if (list_view->details->clipboard_handler_id != 0) {
 		g_signal_handler_disconnect (nautilus_clipboard_monitor_get (),
 		                             list_view->details->clipboard_handler_id);
@@ -3436,6 +3820,8 @@ nautilus_list_view_finalize (GObject *object)
 	
 	g_list_free (list_view->details->cells);
 	g_hash_table_destroy (list_view->details->columns);
+	g_hash_table_destroy (list_view->details->requested_files);
+	g_hash_table_destroy (list_view->details->total_size_changed_files);
 
 	if (list_view->details->hover_path != NULL) {
 		gtk_tree_path_free (list_view->details->hover_path);
@@ -3516,6 +3902,94 @@ nautilus_list_view_scroll_to_file (NautilusListView *view,
 	gtk_tree_path_free (path);
 }
 
+/* Columns whose values are only known once the complete file info is
+ * loaded; sorting on them needs it for every file.
+ */
+static gboolean
+sort_needs_full_info (NautilusListView *list_view)
+{
+	gint sort_column_id;
+	GtkSortType order;
+	GQuark attribute;
+
+	if (!gtk_tree_sortable_get_sort_column_id (GTK_TREE_SORTABLE (list_view->details->model),
+						   &sort_column_id, &order)) {
+		return FALSE;
+	}
+
+	attribute = nautilus_list_model_get_attribute_from_sort_column_id (list_view->details->model,
+									   sort_column_id);
+
+	return attribute == g_quark_from_static_string ("owner")
+		|| attribute == g_quark_from_static_string ("group")
+		|| attribute == g_quark_from_static_string ("selinux_context")
+		|| attribute == g_quark_from_static_string ("type")
+		|| attribute == g_quark_from_static_string ("detailed_type");
+}
+
+static GList *
+nautilus_list_view_get_priority_files (NautilusView *view)
+{
+	NautilusListView *list_view;
+	GtkTreeModel *model;
+	GtkTreePath *path, *end_path;
+	GtkTreeIter iter;
+	NautilusFile *file;
+	GList *files, *all_files;
+
+	list_view = NAUTILUS_LIST_VIEW (view);
+	model = GTK_TREE_MODEL (list_view->details->model);
+	files = NULL;
+
+	/* The rows on screen, including those of expanded folders. */
+	if (gtk_tree_view_get_visible_range (list_view->details->tree_view,
+					     &path, &end_path)) {
+		while (TRUE) {
+			while (!gtk_tree_model_get_iter (model, &iter, path) &&
+			       gtk_tree_path_get_depth (path) > 1) {
+				gtk_tree_path_up (path);
+				gtk_tree_path_next (path);
+			}
+			if (gtk_tree_path_compare (path, end_path) > 0 ||
+			    !gtk_tree_model_get_iter (model, &iter, path)) {
+				break;
+			}
+
+			gtk_tree_model_get (model, &iter,
+					    NAUTILUS_LIST_MODEL_FILE_COLUMN, &file,
+					    -1);
+			if (file != NULL) {
+				files = g_list_prepend (files, file);
+			}
+
+			if (gtk_tree_view_row_expanded (list_view->details->tree_view, path) &&
+			    gtk_tree_model_iter_has_child (model, &iter)) {
+				gtk_tree_path_down (path);
+			} else {
+				gtk_tree_path_next (path);
+			}
+		}
+
+		gtk_tree_path_free (path);
+		gtk_tree_path_free (end_path);
+	}
+	files = g_list_reverse (files);
+
+	/* The files on screen are also those whose total size is counted,
+	 * whose image headers are read and whose thumbnails are kept.
+	 */
+	update_file_requests (list_view, files);
+	nautilus_view_set_shown_files (view, files);
+
+	if (nautilus_view_get_model (view) != NULL &&
+	    sort_needs_full_info (list_view)) {
+		all_files = nautilus_directory_get_file_list (nautilus_view_get_model (view));
+		files = g_list_concat (files, all_files);
+	}
+
+	return files;
+}
+
 static void
 list_view_scroll_to_file (NautilusView *view,
 			  const char *uri)
@@ -3563,6 +4037,10 @@ nautilus_list_view_end_loading (NautilusView *view,
 	info = nautilus_clipboard_monitor_get_clipboard_info (monitor);
 
 	list_view_notify_clipboard_info (monitor, info, NAUTILUS_LIST_VIEW (view));
+
+	if (all_files_seen) {
+		queue_column_width_estimate (NAUTILUS_LIST_VIEW (view));
+	}
 }
 
 static const char *
@@ -3592,7 +4070,6 @@ nautilus_list_view_class_init (NautilusListViewClass *class)
 	nautilus_view_class->file_changed = nautilus_list_view_file_changed;
 	nautilus_view_class->get_backing_uri = nautilus_list_view_get_backing_uri;
 	nautilus_view_class->get_selection = nautilus_list_view_get_selection;
-	nautilus_view_class->get_selection_for_file_transfer = nautilus_list_view_get_selection_for_file_transfer;
 	nautilus_view_class->is_empty = nautilus_list_view_is_empty;
 	nautilus_view_class->remove_file = nautilus_list_view_remove_file;
 	nautilus_view_class->merge_menus = nautilus_list_view_merge_menus;
@@ -3615,6 +4092,7 @@ nautilus_list_view_class_init (NautilusListViewClass *class)
 	nautilus_view_class->get_view_id = nautilus_list_view_get_id;
 	nautilus_view_class->get_first_visible_file = nautilus_list_view_get_first_visible_file;
 	nautilus_view_class->scroll_to_file = list_view_scroll_to_file;
+	nautilus_view_class->get_priority_files = nautilus_list_view_get_priority_files;
 }
 
 static void
@@ -3625,6 +4103,10 @@ nautilus_list_view_init (NautilusListView *list_view)
 	/* ensure that the zoom level is always set before settings up the tree view columns */
 	list_view->details->zoom_level = get_default_zoom_level ();
 
+	list_view->details->requested_files =
+		g_hash_table_new_full (NULL, NULL, (GDestroyNotify) nautilus_file_unref, NULL);
+	list_view->details->total_size_changed_files = g_hash_table_new (NULL, NULL);
+
 	create_and_set_up_tree_view (list_view);
 
 	g_signal_connect_swapped (nautilus_preferences,
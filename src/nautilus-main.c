@@ -32,6 +32,7 @@
 #include "nautilus-application.h"
 
 #include <libnautilus-private/nautilus-debug.h>
+#include <libnautilus-private/nautilus-profile.h>
 #include <eel/eel-debug.h>
 
 #include <glib/gi18n.h>
@@ -80,6 +81,8 @@ main (int argc, char *argv[])
 	if (g_getenv ("NAUTILUS_DEBUG") != NULL) {
 		eel_make_warnings_and_criticals_stop_in_debugger ();
 	}
+
+	nautilus_profile_init ();
 	
 	/* Initialize gettext support */
 	bindtextdomain (GETTEXT_PACKAGE, GNOMELOCALEDIR);
@@ -105,6 +108,7 @@ main (int argc, char *argv[])
 
 	g_object_unref (application);
 
+	nautilus_profile_shut_down ();
  	eel_debug_shut_down ();
 
 	return retval;
@@ -27,6 +27,7 @@
 
 #include "nautilus-window-slot.h"
 
+#include <eel/eel-debug.h>
 #include <eel/eel-glib-extensions.h>
 #include <eel/eel-stock-dialogs.h>
 #include <eel/eel-string.h>
@@ -324,268 +325,421 @@ file_has_local_path (NautilusFile *file)
 	return res;
 }
 
-GAppInfo *
-nautilus_mime_get_default_application_for_file (NautilusFile *file)
+/* The applications for a file only depend on its content type, its URI
+ * scheme and whether it has a local path, so they are looked up once
+ * per combination and kept until the MIME database or the installed
+ * applications change. Each application seen gets an index, and every
+ * cached set also keeps a bitset over those indexes, so the
+ * applications common to a large selection are found by and-ing a few
+ * words per distinct type instead of merging lists.
+ */
+typedef struct {
+	GList *applications;	/* sorted by name */
+	guint64 *bits;
+	guint n_words;
+	GAppInfo *default_application;
+} MimeApplications;
+
+static GHashTable *mime_applications_cache;
+/* application key -> index + 1 */
+static GHashTable *application_indexes;
+static GPtrArray *applications_by_index;
+
+static void
+mime_applications_free (MimeApplications *entry)
 {
-	GAppInfo *app;
-	char *mime_type;
-	char *uri_scheme;
+	g_list_free_full (entry->applications, g_object_unref);
+	g_free (entry->bits);
+	g_clear_object (&entry->default_application);
+	g_slice_free (MimeApplications, entry);
+}
 
-	if (!nautilus_mime_actions_check_if_required_attributes_ready (file)) {
-		return NULL;
+static void
+mime_applications_cache_clear (void)
+{
+	if (mime_applications_cache == NULL) {
+		return;
 	}
 
-	mime_type = nautilus_file_get_mime_type (file);
-	app = g_app_info_get_default_for_type (mime_type, !file_has_local_path (file));
-	g_free (mime_type);
+	DEBUG ("Clearing the application cache");
 
-	if (app == NULL) {
-		uri_scheme = nautilus_file_get_uri_scheme (file);
-		if (uri_scheme != NULL) {
-			app = g_app_info_get_default_for_uri_scheme (uri_scheme);
-			g_free (uri_scheme);
-		}
-	}
-	
-	return app;
+	g_hash_table_remove_all (mime_applications_cache);
+	g_hash_table_remove_all (application_indexes);
+	g_ptr_array_set_size (applications_by_index, 0);
 }
 
-static int
-file_compare_by_mime_type (NautilusFile *file_a,
-			   NautilusFile *file_b)
+static void
+mime_applications_cache_free (void)
 {
-	char *mime_type_a, *mime_type_b;
-	int ret;
-	
-	mime_type_a = nautilus_file_get_mime_type (file_a);
-	mime_type_b = nautilus_file_get_mime_type (file_b);
-	
-	ret = strcmp (mime_type_a, mime_type_b);
-	
-	g_free (mime_type_a);
-	g_free (mime_type_b);
-	
-	return ret;
+	g_clear_pointer (&mime_applications_cache, g_hash_table_destroy);
+	g_clear_pointer (&application_indexes, g_hash_table_destroy);
+	g_clear_pointer (&applications_by_index, g_ptr_array_unref);
 }
 
-static int
-file_compare_by_parent_uri (NautilusFile *file_a,
-			    NautilusFile *file_b) {
-	char *parent_uri_a, *parent_uri_b;
-	int ret;
+#if !GLIB_CHECK_VERSION (2, 40, 0)
+/* GAppInfoMonitor is new in GLib 2.40. Older versions watch the folders
+ * desktop files are installed to, and the user's mimeapps.list, instead.
+ */
+static GList *application_monitors;
 
-	parent_uri_a = nautilus_file_get_parent_uri (file_a);
-	parent_uri_b = nautilus_file_get_parent_uri (file_b);
+static void
+application_monitors_free (void)
+{
+	g_list_free_full (application_monitors, g_object_unref);
+	application_monitors = NULL;
+}
 
-	ret = strcmp (parent_uri_a, parent_uri_b);
+static void
+add_application_monitor (const char *path,
+			 gboolean is_directory)
+{
+	GFile *location;
+	GFileMonitor *monitor;
 
-	g_free (parent_uri_a);
-	g_free (parent_uri_b);
+	location = g_file_new_for_path (path);
+	if (is_directory) {
+		monitor = g_file_monitor_directory (location, G_FILE_MONITOR_NONE, NULL, NULL);
+	} else {
+		monitor = g_file_monitor_file (location, G_FILE_MONITOR_NONE, NULL, NULL);
+	}
+	g_object_unref (location);
+
+	if (monitor == NULL) {
+		return;
+	}
 
-	return ret;
+	g_signal_connect (monitor, "changed",
+			  G_CALLBACK (mime_applications_cache_clear), NULL);
+	application_monitors = g_list_prepend (application_monitors, monitor);
 }
 
-static int
-application_compare_by_name (const GAppInfo *app_a,
-			     const GAppInfo *app_b)
+static void
+monitor_applications (void)
 {
-	return g_utf8_collate (g_app_info_get_name ((GAppInfo *)app_a),
-			       g_app_info_get_name ((GAppInfo *)app_b));
+	const char * const *data_dirs;
+	char *path;
+	int i;
+
+	path = g_build_filename (g_get_user_data_dir (), "applications", NULL);
+	add_application_monitor (path, TRUE);
+	g_free (path);
+
+	data_dirs = g_get_system_data_dirs ();
+	for (i = 0; data_dirs[i] != NULL; i++) {
+		path = g_build_filename (data_dirs[i], "applications", NULL);
+		add_application_monitor (path, TRUE);
+		g_free (path);
+	}
+
+	path = g_build_filename (g_get_user_config_dir (), "mimeapps.list", NULL);
+	add_application_monitor (path, FALSE);
+	g_free (path);
+
+	eel_debug_call_at_shutdown (application_monitors_free);
 }
+#endif
 
-static int
-application_compare_by_id (const GAppInfo *app_a,
-			   const GAppInfo *app_b)
+static void
+ensure_mime_applications_cache (void)
 {
-	const char *id_a, *id_b;
+	if (mime_applications_cache != NULL) {
+		return;
+	}
 
-	id_a = g_app_info_get_id ((GAppInfo *)app_a);
-	id_b = g_app_info_get_id ((GAppInfo *)app_b);
+	mime_applications_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+							 (GDestroyNotify) mime_applications_free);
+	application_indexes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	applications_by_index = g_ptr_array_new_with_free_func (g_object_unref);
 
-	if (id_a == NULL && id_b == NULL) {
-		if (g_app_info_equal ((GAppInfo *)app_a, (GAppInfo *)app_b)) {
-			return 0;
-		}
-		if ((gsize)app_a < (gsize) app_b) {
-			return -1;
-		}
-		return 1;
-	}
+	g_signal_connect (nautilus_signaller_get_current (), "mime-data-changed",
+			  G_CALLBACK (mime_applications_cache_clear), NULL);
+#if GLIB_CHECK_VERSION (2, 40, 0)
+	g_signal_connect (g_app_info_monitor_get (), "changed",
+			  G_CALLBACK (mime_applications_cache_clear), NULL);
+#else
+	monitor_applications ();
+#endif
+
+	eel_debug_call_at_shutdown (mime_applications_cache_free);
+}
+
+static char *
+get_application_key (GAppInfo *application)
+{
+	const char *id;
 
-	if (id_a == NULL) {
-		return -1;
+	id = g_app_info_get_id (application);
+	if (id != NULL) {
+		return g_strdup (id);
 	}
-	
-	if (id_b == NULL) {
-		return 1;
+
+	/* Not installed, e.g. made up from a command line. */
+	return g_strconcat ("\n", g_app_info_get_commandline (application), NULL);
+}
+
+static guint
+get_application_index (GAppInfo *application)
+{
+	char *key;
+	gpointer value;
+	guint index;
+
+	key = get_application_key (application);
+	value = g_hash_table_lookup (application_indexes, key);
+	if (value != NULL) {
+		g_free (key);
+		return GPOINTER_TO_UINT (value) - 1;
 	}
-	
-	
-	return strcmp (id_a, id_b);
+
+	index = applications_by_index->len;
+	g_ptr_array_add (applications_by_index, g_object_ref (application));
+	g_hash_table_insert (application_indexes, key, GUINT_TO_POINTER (index + 1));
+
+	return index;
 }
 
-GList *
-nautilus_mime_get_applications_for_file (NautilusFile *file)
+static char *
+get_mime_applications_key (NautilusFile *file,
+			   char **mime_type,
+			   char **uri_scheme,
+			   gboolean *has_local_path)
+{
+	*mime_type = nautilus_file_get_mime_type (file);
+	*uri_scheme = nautilus_file_get_uri_scheme (file);
+	*has_local_path = file_has_local_path (file);
+
+	return g_strdup_printf ("%s\n%s\n%c",
+				*mime_type,
+				*uri_scheme != NULL ? *uri_scheme : "",
+				*has_local_path ? 'l' : 'r');
+}
+
+static int
+application_compare_by_name (const GAppInfo *app_a,
+			     const GAppInfo *app_b)
+{
+	return g_utf8_collate (g_app_info_get_name ((GAppInfo *)app_a),
+			       g_app_info_get_name ((GAppInfo *)app_b));
+}
+
+static GList *
+query_applications (const char *mime_type,
+		    const char *uri_scheme,
+		    gboolean has_local_path)
 {
-	char *mime_type;
-	char *uri_scheme;
 	GList *result;
 	GAppInfo *uri_handler;
 
-	if (!nautilus_mime_actions_check_if_required_attributes_ready (file)) {
-		return NULL;
-	}
-	mime_type = nautilus_file_get_mime_type (file);
 	result = g_app_info_get_all_for_type (mime_type);
 
-	uri_scheme = nautilus_file_get_uri_scheme (file);
 	if (uri_scheme != NULL) {
 		uri_handler = g_app_info_get_default_for_uri_scheme (uri_scheme);
 		if (uri_handler) {
 			result = g_list_prepend (result, uri_handler);
 		}
-		g_free (uri_scheme);
 	}
 
 	/* Filter out non-uri supporting apps */
-	result = filter_non_uri_apps (result, file_has_local_path (file));
+	result = filter_non_uri_apps (result, has_local_path);
 
 	result = g_list_sort (result, (GCompareFunc) application_compare_by_name);
-	g_free (mime_type);
 
 	return filter_nautilus_handler (result);
 }
 
-GAppInfo *
-nautilus_mime_get_default_application_for_files (GList *files)
+static GAppInfo *
+query_default_application (const char *mime_type,
+			   const char *uri_scheme,
+			   gboolean has_local_path)
 {
-	GList *l, *sorted_files;
-	NautilusFile *file;
-	GAppInfo *app, *one_app;
+	GAppInfo *app;
 
-	g_assert (files != NULL);
+	app = g_app_info_get_default_for_type (mime_type, !has_local_path);
 
-	sorted_files = g_list_sort (g_list_copy (files), (GCompareFunc) file_compare_by_mime_type);
+	if (app == NULL && uri_scheme != NULL) {
+		app = g_app_info_get_default_for_uri_scheme (uri_scheme);
+	}
 
-	app = NULL;
-	for (l = sorted_files; l != NULL; l = l->next) {
-		file = l->data;
+	return app;
+}
 
-		if (l->prev &&
-		    file_compare_by_mime_type (file, l->prev->data) == 0 &&
-		    file_compare_by_parent_uri (file, l->prev->data) == 0) {
-			continue;
-		}
+/* Returns the cached entry for the file, which must have the
+ * attributes mime actions need.
+ */
+static MimeApplications *
+lookup_mime_applications (NautilusFile *file)
+{
+	MimeApplications *entry;
+	char *key, *mime_type, *uri_scheme;
+	gboolean has_local_path;
+	GList *l;
+	guint index;
 
-		one_app = nautilus_mime_get_default_application_for_file (file);
-		if (one_app == NULL || (app != NULL && !g_app_info_equal (app, one_app))) {
-			if (app) {
-				g_object_unref (app);
-			}
-			if (one_app) {
-				g_object_unref (one_app);
-			}
-			app = NULL;
-			break;
-		}
+	ensure_mime_applications_cache ();
 
-		if (app == NULL) {
-			app = one_app;
-		} else {
-			g_object_unref (one_app);
+	key = get_mime_applications_key (file, &mime_type, &uri_scheme, &has_local_path);
+	entry = g_hash_table_lookup (mime_applications_cache, key);
+	if (entry != NULL) {
+		g_free (key);
+		g_free (mime_type);
+		g_free (uri_scheme);
+		return entry;
+	}
+
+	entry = g_slice_new0 (MimeApplications);
+	entry->applications = query_applications (mime_type, uri_scheme, has_local_path);
+	entry->default_application = query_default_application (mime_type, uri_scheme, has_local_path);
+
+	for (l = entry->applications; l != NULL; l = l->next) {
+		index = get_application_index (l->data);
+		if (index / 64 >= entry->n_words) {
+			entry->bits = g_renew (guint64, entry->bits, index / 64 + 1);
+			memset (entry->bits + entry->n_words, 0,
+				(index / 64 + 1 - entry->n_words) * sizeof (guint64));
+			entry->n_words = index / 64 + 1;
 		}
+		entry->bits[index / 64] |= G_GUINT64_CONSTANT (1) << (index % 64);
 	}
 
-	g_list_free (sorted_files);
+	g_hash_table_insert (mime_applications_cache, key, entry);
 
-	return app;
+	g_free (mime_type);
+	g_free (uri_scheme);
+
+	return entry;
 }
 
-/* returns an intersection of two mime application lists,
- * and returns a new list, freeing a, b and all applications
- * that are not in the intersection set.
- * The lists are assumed to be pre-sorted by their IDs */
-static GList *
-intersect_application_lists (GList *a,
-			     GList *b)
+GAppInfo *
+nautilus_mime_get_default_application_for_file (NautilusFile *file)
 {
-	GList *l, *m;
-	GList *ret;
-	GAppInfo *a_app, *b_app;
-	int cmp;
+	MimeApplications *entry;
 
-	ret = NULL;
+	if (!nautilus_mime_actions_check_if_required_attributes_ready (file)) {
+		return NULL;
+	}
 
-	l = a;
-	m = b;
+	entry = lookup_mime_applications (file);
+	if (entry->default_application == NULL) {
+		return NULL;
+	}
 
-	while (l != NULL && m != NULL) {
-		a_app = (GAppInfo *) l->data;
-		b_app = (GAppInfo *) m->data;
+	return g_object_ref (entry->default_application);
+}
 
-		cmp = application_compare_by_id (a_app, b_app);
-		if (cmp > 0) {
-			g_object_unref (b_app);
-			m = m->next;
-		} else if (cmp < 0) {
-			g_object_unref (a_app);
-			l = l->next;
-		} else {
-			g_object_unref (b_app);
-			ret = g_list_prepend (ret, a_app);
-			l = l->next;
-			m = m->next;
-		}
+GList *
+nautilus_mime_get_applications_for_file (NautilusFile *file)
+{
+	MimeApplications *entry;
+
+	if (!nautilus_mime_actions_check_if_required_attributes_ready (file)) {
+		return NULL;
 	}
 
-	g_list_foreach (l, (GFunc) g_object_unref, NULL);
-	g_list_foreach (m, (GFunc) g_object_unref, NULL);
+	entry = lookup_mime_applications (file);
 
-	g_list_free (a);
-	g_list_free (b);
+	return g_list_copy_deep (entry->applications, (GCopyFunc) g_object_ref, NULL);
+}
 
-	return g_list_reverse (ret);
+GAppInfo *
+nautilus_mime_get_default_application_for_files (GList *files)
+{
+	GList *l;
+	GHashTable *seen;
+	MimeApplications *entry;
+	GAppInfo *app;
+
+	g_assert (files != NULL);
+
+	seen = g_hash_table_new (NULL, NULL);
+
+	app = NULL;
+	for (l = files; l != NULL; l = l->next) {
+		if (!nautilus_mime_actions_check_if_required_attributes_ready (l->data)) {
+			app = NULL;
+			break;
+		}
+
+		entry = lookup_mime_applications (l->data);
+		if (g_hash_table_contains (seen, entry)) {
+			continue;
+		}
+		g_hash_table_add (seen, entry);
+
+		if (entry->default_application == NULL ||
+		    (app != NULL && !g_app_info_equal (app, entry->default_application))) {
+			app = NULL;
+			break;
+		}
+
+		app = entry->default_application;
+	}
+
+	g_hash_table_destroy (seen);
+
+	return app != NULL ? g_object_ref (app) : NULL;
 }
 
 GList *
 nautilus_mime_get_applications_for_files (GList *files)
 {
-	GList *l, *sorted_files;
-	NautilusFile *file;
-	GList *one_ret, *ret;
+	GList *l, *ret;
+	GHashTable *seen;
+	MimeApplications *entry;
+	guint64 *bits;
+	guint n_words, i, bit;
+	gboolean any;
 
 	g_assert (files != NULL);
 
-	sorted_files = g_list_sort (g_list_copy (files), (GCompareFunc) file_compare_by_mime_type);
+	seen = g_hash_table_new (NULL, NULL);
 
-	ret = NULL;
-	for (l = sorted_files; l != NULL; l = l->next) {
-		file = l->data;
+	bits = NULL;
+	n_words = 0;
+	for (l = files; l != NULL; l = l->next) {
+		if (!nautilus_mime_actions_check_if_required_attributes_ready (l->data)) {
+			n_words = 0;
+			break;
+		}
 
-		if (l->prev &&
-		    file_compare_by_mime_type (file, l->prev->data) == 0 &&
-		    file_compare_by_parent_uri (file, l->prev->data) == 0) {
+		entry = lookup_mime_applications (l->data);
+		if (g_hash_table_contains (seen, entry)) {
 			continue;
 		}
 
-		one_ret = nautilus_mime_get_applications_for_file (file);
-		one_ret = g_list_sort (one_ret, (GCompareFunc) application_compare_by_id);
-		if (ret != NULL) {
-			ret = intersect_application_lists (ret, one_ret);
+		if (bits == NULL) {
+			n_words = entry->n_words;
+			bits = g_memdup (entry->bits, n_words * sizeof (guint64));
 		} else {
-			ret = one_ret;
+			n_words = MIN (n_words, entry->n_words);
 		}
+		g_hash_table_add (seen, entry);
 
-		if (ret == NULL) {
+		any = FALSE;
+		for (i = 0; i < n_words; i++) {
+			bits[i] &= entry->bits[i];
+			any |= bits[i] != 0;
+		}
+		if (!any) {
+			n_words = 0;
 			break;
 		}
 	}
 
-	g_list_free (sorted_files);
+	g_hash_table_destroy (seen);
 
-	ret = g_list_sort (ret, (GCompareFunc) application_compare_by_name);
-	
-	return ret;
+	ret = NULL;
+	for (i = 0; i < n_words; i++) {
+		for (bit = 0; bit < 64; bit++) {
+			if (bits[i] & (G_GUINT64_CONSTANT (1) << bit)) {
+				ret = g_list_prepend (ret,
+						      g_object_ref (g_ptr_array_index (applications_by_index,
+										       i * 64 + bit)));
+			}
+		}
+	}
+	g_free (bits);
+
+	return g_list_sort (ret, (GCompareFunc) application_compare_by_name);
 }
 
 static void
@@ -4578,8 +4578,10 @@ append_extension_pages (NautilusPropertiesWindow *window)
 {
 	GList *providers;
 	GList *p;
+	NautilusModuleOperation *operation;
 	
  	providers = nautilus_module_get_extensions_for_type (NAUTILUS_TYPE_PROPERTY_PAGE_PROVIDER);
+	operation = nautilus_module_operation_new ("property pages");
 	
 	for (p = providers; p != NULL; p = p->next) {
 		NautilusPropertyPageProvider *provider;
@@ -4587,9 +4589,13 @@ append_extension_pages (NautilusPropertiesWindow *window)
 		GList *l;
 
 		provider = NAUTILUS_PROPERTY_PAGE_PROVIDER (p->data);
+		if (!nautilus_module_operation_begin_call (operation, p->data)) {
+			continue;
+		}
 		
 		pages = nautilus_property_page_provider_get_pages 
 			(provider, window->details->original_files);
+		nautilus_module_operation_end_call (operation, p->data);
 		
 		for (l = pages; l != NULL; l = l->next) {
 			NautilusPropertyPage *page;
@@ -4618,6 +4624,7 @@ append_extension_pages (NautilusPropertiesWindow *window)
 		g_list_free (pages);
 	}
 
+	nautilus_module_operation_free (operation);
 	nautilus_module_extension_list_free (providers);
 }
 
@@ -147,9 +147,10 @@ search_hits_added_cb (NautilusSearchEngine *engine,
 
   g_debug ("*** Search engine hits added");
 
+  nautilus_search_hit_list_compute_scores (hits, search->query);
+
   for (l = hits; l != NULL; l = l->next) {
     hit = l->data;
-    nautilus_search_hit_compute_scores (hit, search->query);
     hit_uri = nautilus_search_hit_get_uri (hit);
     g_debug ("    %s", hit_uri);
 
@@ -250,6 +251,7 @@ static void
 search_add_volumes_and_bookmarks (PendingSearch *search)
 {
   NautilusSearchHit *hit;
+  NautilusSearchHitScorer *scorer;
   NautilusBookmark *bookmark;
   const gchar *name;
   gint length, idx;
@@ -364,6 +366,7 @@ search_add_volumes_and_bookmarks (PendingSearch *search)
   /* now do the actual string matching */
   candidates = g_list_reverse (candidates);
 
+  scorer = nautilus_search_hit_scorer_new (search->query);
   for (l = candidates; l != NULL; l = l->next) {
     candidate = l->data;
     match = nautilus_query_matches_string (search->query,
@@ -372,10 +375,11 @@ search_add_volumes_and_bookmarks (PendingSearch *search)
     if (match > -1) {
       hit = nautilus_search_hit_new (candidate->uri);
       nautilus_search_hit_set_fts_rank (hit, match);
-      nautilus_search_hit_compute_scores (hit, search->query);
+      nautilus_search_hit_scorer_compute (scorer, hit);
       g_hash_table_replace (search->hits, g_strdup (candidate->uri), hit);
     }
   }
+  nautilus_search_hit_scorer_free (scorer);
   g_list_free_full (candidates, (GDestroyNotify) search_hit_candidate_free);
 }
 
@@ -0,0 +1,194 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+ *
+ * nautilus-startup-benchmark.c: measure the phases of startup.
+ *
+ * Nautilus is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * Nautilus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; see the file COPYING.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <config.h>
+#include "nautilus-startup-benchmark.h"
+
+#include "nautilus-view.h"
+
+#include <gtk/gtk.h>
+#include <string.h>
+
+typedef struct {
+	const char *name;
+	gint64 begin;
+	gint64 end;
+} Phase;
+
+static GApplication *benchmark_application;
+static gint64 start_time;
+/* Phases are few, kept in the order they began. */
+static GArray *phases;
+static gboolean view_loaded;
+
+static Phase *
+find_phase (const char *name)
+{
+	guint i;
+	Phase *phase;
+
+	for (i = 0; i < phases->len; i++) {
+		phase = &g_array_index (phases, Phase, i);
+		if (strcmp (phase->name, name) == 0) {
+			return phase;
+		}
+	}
+
+	return NULL;
+}
+
+/* Phase names must be static strings. */
+void
+nautilus_startup_benchmark_begin_phase (const char *name)
+{
+	Phase phase;
+
+	if (phases == NULL || find_phase (name) != NULL) {
+		return;
+	}
+
+	phase.name = name;
+	phase.begin = g_get_monotonic_time ();
+	phase.end = 0;
+	g_array_append_val (phases, phase);
+}
+
+void
+nautilus_startup_benchmark_end_phase (const char *name)
+{
+	Phase *phase;
+
+	if (phases == NULL) {
+		return;
+	}
+
+	phase = find_phase (name);
+	if (phase != NULL && phase->end == 0) {
+		phase->end = g_get_monotonic_time ();
+	}
+}
+
+static void
+print_phases (void)
+{
+	guint i;
+	Phase *phase;
+
+	g_print ("%-20s %10s %10s\n", "Phase", "Start", "Duration");
+	for (i = 0; i < phases->len; i++) {
+		phase = &g_array_index (phases, Phase, i);
+		if (phase->end == 0) {
+			g_print ("%-20s %8.1fms %10s\n", phase->name,
+				 (phase->begin - start_time) / 1000.0, "-");
+		} else {
+			g_print ("%-20s %8.1fms %8.1fms\n", phase->name,
+				 (phase->begin - start_time) / 1000.0,
+				 (phase->end - phase->begin) / 1000.0);
+		}
+	}
+	g_print ("%-20s %10s %8.1fms\n", "Total", "",
+		 (g_get_monotonic_time () - start_time) / 1000.0);
+}
+
+static gboolean
+quit_idle_callback (gpointer user_data)
+{
+	print_phases ();
+	g_application_quit (benchmark_application);
+
+	return FALSE;
+}
+
+static gboolean
+view_draw_callback (GtkWidget *widget,
+		    cairo_t *cr,
+		    gpointer user_data)
+{
+	g_signal_handlers_disconnect_by_func (widget, view_draw_callback, user_data);
+
+	nautilus_startup_benchmark_end_phase ("First paint");
+
+	/* Let the frame finish before leaving. */
+	g_idle_add (quit_idle_callback, NULL);
+
+	return FALSE;
+}
+
+static gboolean
+begin_loading_hook (GSignalInvocationHint *ihint,
+		    guint n_param_values,
+		    const GValue *param_values,
+		    gpointer user_data)
+{
+	nautilus_startup_benchmark_begin_phase ("First enumeration");
+
+	return FALSE;
+}
+
+static gboolean
+end_loading_hook (GSignalInvocationHint *ihint,
+		  guint n_param_values,
+		  const GValue *param_values,
+		  gpointer user_data)
+{
+	GtkWidget *view;
+	gboolean all_files_seen;
+
+	view = g_value_get_object (&param_values[0]);
+	all_files_seen = g_value_get_boolean (&param_values[1]);
+
+	if (!all_files_seen || view_loaded) {
+		return TRUE;
+	}
+	view_loaded = TRUE;
+
+	nautilus_startup_benchmark_end_phase ("First enumeration");
+	nautilus_startup_benchmark_begin_phase ("First paint");
+
+	g_signal_connect_after (view, "draw",
+				G_CALLBACK (view_draw_callback), NULL);
+	gtk_widget_queue_draw (view);
+
+	/* Only the first view matters. */
+	return FALSE;
+}
+
+void
+nautilus_startup_benchmark_enable (GApplication *application)
+{
+	if (phases != NULL) {
+		return;
+	}
+
+	start_time = g_get_monotonic_time ();
+	phases = g_array_new (FALSE, FALSE, sizeof (Phase));
+	benchmark_application = application;
+
+	/* Measure a fresh instance rather than a running one. */
+	g_application_set_flags (application,
+				 g_application_get_flags (application) | G_APPLICATION_NON_UNIQUE);
+
+	/* The signals only exist once the class is initialized. */
+	g_type_class_ref (NAUTILUS_TYPE_VIEW);
+	g_signal_add_emission_hook (g_signal_lookup ("begin-loading", NAUTILUS_TYPE_VIEW), 0,
+				    begin_loading_hook, NULL, NULL);
+	g_signal_add_emission_hook (g_signal_lookup ("end-loading", NAUTILUS_TYPE_VIEW), 0,
+				    end_loading_hook, NULL, NULL);
+}
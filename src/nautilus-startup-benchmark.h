@@ -0,0 +1,36 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+ *
+ * nautilus-startup-benchmark.h: measure the phases of startup.
+ *
+ * Nautilus is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * Nautilus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; see the file COPYING.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef NAUTILUS_STARTUP_BENCHMARK_H
+#define NAUTILUS_STARTUP_BENCHMARK_H
+
+#include <gio/gio.h>
+
+/* With --benchmark-startup, the application runs as a separate
+ * instance, opens its location, and once the first view has loaded
+ * all its files and painted them, prints how long each phase took
+ * and quits. The phase functions do nothing otherwise.
+ */
+void     nautilus_startup_benchmark_enable      (GApplication *application);
+
+void     nautilus_startup_benchmark_begin_phase (const char   *phase);
+void     nautilus_startup_benchmark_end_phase   (const char   *phase);
+
+#endif /* NAUTILUS_STARTUP_BENCHMARK_H */
@@ -65,6 +65,7 @@
 #include <libnautilus-private/nautilus-desktop-icon-file.h>
 #include <libnautilus-private/nautilus-desktop-directory.h>
 #include <libnautilus-private/nautilus-search-directory.h>
+#include <libnautilus-private/nautilus-selection-model.h>
 #include <libnautilus-private/nautilus-directory.h>
 #include <libnautilus-private/nautilus-dnd.h>
 #include <libnautilus-private/nautilus-file-attributes.h>
@@ -82,6 +83,7 @@
 #include <libnautilus-private/nautilus-program-choosing.h>
 #include <libnautilus-private/nautilus-trash-monitor.h>
 #include <libnautilus-private/nautilus-ui-utilities.h>
+#include <libnautilus-private/nautilus-warm-directories.h>
 #include <libnautilus-private/nautilus-signaller.h>
 #include <libnautilus-private/nautilus-icon-names.h>
 #include <libnautilus-private/nautilus-file-undo-manager.h>
@@ -194,6 +196,7 @@ struct NautilusViewDetails
 
 	guint display_pending_source_id;
 	guint changes_timeout_id;
+	guint full_info_timeout_id;
 
 	guint update_interval;
  	guint64 last_queued;
@@ -210,12 +213,19 @@ struct NautilusViewDetails
 	GList *new_changed_files;
 
 	GHashTable *non_ready_files;
+	/* Files on screen, whose thumbnails are kept */
+	GHashTable *shown_files;
 
 	GList *old_added_files;
 	GList *old_changed_files;
 
 	GList *pending_selection;
 
+	/* Files shown by the view and which of them are selected. Kept up
+	 * to date by the subclasses as their selection changes.
+	 */
+	NautilusSelectionModel *selection_model;
+
 	/* whether we are in the active slot */
 	gboolean active;
 
@@ -410,12 +420,59 @@ nautilus_view_call_set_selection (NautilusView *view, GList *selection)
 	NAUTILUS_VIEW_CLASS (G_OBJECT_GET_CLASS (view))->set_selection (view, selection);
 }
 
+/* Whether a folder that @file is shown inside of is also selected. */
+static gboolean
+parent_is_selected (NautilusView *view,
+		    NautilusFile *file)
+{
+	NautilusSelectionModel *model;
+	NautilusFile *parent, *next;
+	gboolean selected;
+
+	model = view->details->selection_model;
+	selected = FALSE;
+
+	parent = nautilus_file_get_parent (file);
+	while (parent != NULL &&
+	       nautilus_selection_model_get_index (model, parent, NULL)) {
+		if (nautilus_selection_model_is_selected (model, parent)) {
+			selected = TRUE;
+			break;
+		}
+		next = nautilus_file_get_parent (parent);
+		nautilus_file_unref (parent);
+		parent = next;
+	}
+	nautilus_file_unref (parent);
+
+	return selected;
+}
+
+/* Like nautilus_view_get_selection(), but leaves out the files whose
+ * folder is selected too, as copying both would put a second copy of
+ * the file at the top of the target.
+ */
 static GList *
 nautilus_view_get_selection_for_file_transfer (NautilusView *view)
 {
+	NautilusSelectionIter iter;
+	NautilusFile *file;
+	GList *selection;
+	gboolean check_parents;
+
 	g_return_val_if_fail (NAUTILUS_IS_VIEW (view), NULL);
 
-	return NAUTILUS_VIEW_CLASS (G_OBJECT_GET_CLASS (view))->get_selection_for_file_transfer (view);
+	check_parents = nautilus_view_has_subdirectories (view);
+
+	selection = NULL;
+	nautilus_selection_iter_init (&iter, view->details->selection_model);
+	while (nautilus_selection_iter_next (&iter, &file)) {
+		if (!check_parents || !parent_is_selected (view, file)) {
+			selection = g_list_prepend (selection, nautilus_file_ref (file));
+		}
+	}
+
+	return g_list_reverse (selection);
 }
 
 /**
@@ -695,6 +752,115 @@ nautilus_view_scroll_to_file (NautilusView *view,
 	NAUTILUS_VIEW_CLASS (G_OBJECT_GET_CLASS (view))->scroll_to_file (view, uri);
 }
 
+static gboolean
+full_info_timeout_callback (gpointer data)
+{
+	NautilusView *view;
+	GList *files;
+
+	view = NAUTILUS_VIEW (data);
+	view->details->full_info_timeout_id = 0;
+
+	files = NAUTILUS_VIEW_CLASS (G_OBJECT_GET_CLASS (view))->get_priority_files (view);
+	nautilus_file_list_request_full_info (files);
+	nautilus_file_list_free (files);
+
+	return FALSE;
+}
+
+/**
+ * nautilus_view_queue_full_info_request:
+ *
+ * Ask, shortly, for the complete information of the files the view
+ * considers most important. Called when files are added, when the view
+ * scrolls and by subclasses when what they show changes.
+ * @view: NautilusView of interest.
+ */
+void
+nautilus_view_queue_full_info_request (NautilusView *view)
+{
+	if (NAUTILUS_VIEW_CLASS (G_OBJECT_GET_CLASS (view))->get_priority_files == NULL) {
+		return;
+	}
+
+	if (view->details->full_info_timeout_id == 0) {
+		view->details->full_info_timeout_id =
+			g_timeout_add (100, full_info_timeout_callback, view);
+	}
+}
+
+/* A search lists more files than it keeps monitored, it monitors the
+ * ones on screen and the selected ones first.
+ */
+static void
+update_search_shown_files (NautilusView *view)
+{
+	NautilusSelectionIter iter;
+	NautilusFile *file;
+	GList *files;
+
+	if (!NAUTILUS_IS_SEARCH_DIRECTORY (view->details->model)) {
+		return;
+	}
+
+	files = g_hash_table_get_keys (view->details->shown_files);
+	nautilus_selection_iter_init (&iter, view->details->selection_model);
+	while (nautilus_selection_iter_next (&iter, &file)) {
+		files = g_list_prepend (files, file);
+	}
+	nautilus_search_directory_set_shown_files (NAUTILUS_SEARCH_DIRECTORY (view->details->model),
+						   files);
+	g_list_free (files);
+}
+
+/**
+ * nautilus_view_set_shown_files:
+ *
+ * Tell which files are on screen, so their thumbnails are not dropped
+ * when the memory for images runs short. Subclasses call this when
+ * they compute their priority files.
+ * @view: NautilusView of interest.
+ * @files: the files on screen.
+ */
+void
+nautilus_view_set_shown_files (NautilusView *view,
+			       GList *files)
+{
+	GHashTable *old_files;
+	GHashTableIter iter;
+	NautilusFile *file;
+	GList *l;
+
+	old_files = view->details->shown_files;
+	view->details->shown_files = g_hash_table_new (NULL, NULL);
+
+	for (l = files; l != NULL; l = l->next) {
+		file = l->data;
+		if (g_hash_table_contains (view->details->shown_files, file)) {
+			continue;
+		}
+
+		if (!g_hash_table_remove (old_files, file)) {
+			nautilus_file_ref (file);
+			nautilus_file_set_shown (file, TRUE);
+		}
+		g_hash_table_add (view->details->shown_files, file);
+	}
+
+	/* What is left went off screen */
+	g_hash_table_iter_init (&iter, old_files);
+	while (g_hash_table_iter_next (&iter, (gpointer *) &file, NULL)) {
+		nautilus_file_set_shown (file, FALSE);
+		nautilus_file_unref (file);
+	}
+	g_hash_table_destroy (old_files);
+
+	/* Not when clearing, the view may be going away */
+	if (files != NULL) {
+		update_search_shown_files (view);
+	}
+}
+
 /**
  * nautilus_view_get_selection:
  *
@@ -783,21 +949,6 @@ application_launch_parameters_free (ApplicationLaunchParameters *parameters)
 	g_free (parameters);
 }			      
 
-static GList *
-file_and_directory_list_to_files (GList *fad_list)
-{
-	GList *res, *l;
-	FileAndDirectory *fad;
-
-	res = NULL;
-	for (l = fad_list; l != NULL; l = l->next) {
-		fad = l->data;
-		res = g_list_prepend (res, nautilus_file_ref (fad->file));
-	}
-	return g_list_reverse (res);
-}
-
-
 static GList *
 file_and_directory_list_from_files (NautilusDirectory *directory, GList *files)
 {
@@ -2474,15 +2625,24 @@ nautilus_view_grab_focus (NautilusView *view)
 int
 nautilus_view_get_selection_count (NautilusView *view)
 {
-	/* FIXME: This could be faster if we special cased it in subclasses */
-	GList *files;
-	int len;
+	return nautilus_selection_model_get_count (view->details->selection_model);
+}
 
-	files = nautilus_view_get_selection (NAUTILUS_VIEW (view));
-	len = g_list_length (files);
-	nautilus_file_list_free (files);
-	
-	return len;
+/**
+ * nautilus_view_get_selection_model:
+ *
+ * Get the selection model of this view. It holds every file added to
+ * the view, and subclasses mark the selected ones in it so callers can
+ * count or walk the selection without building a list.
+ * @view: NautilusView to get the selection model of.
+ *
+ **/
+NautilusSelectionModel *
+nautilus_view_get_selection_model (NautilusView *view)
+{
+	g_return_val_if_fail (NAUTILUS_IS_VIEW (view), NULL);
+
+	return view->details->selection_model;
 }
 
 static void
@@ -2634,18 +2794,31 @@ nautilus_view_init (NautilusView *view)
 	/* Default to true; desktop-icon-view sets to false */
 	view->details->show_foreign_files = TRUE;
 
+	view->details->shown_files = g_hash_table_new (NULL, NULL);
+
 	view->details->non_ready_files =
 		g_hash_table_new_full (file_and_directory_hash,
 				       file_and_directory_equal,
 				       (GDestroyNotify)file_and_directory_free,
 				       NULL);
 
+	view->details->selection_model = nautilus_selection_model_new ();
+
 	gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (view),
 					GTK_POLICY_AUTOMATIC,
 					GTK_POLICY_AUTOMATIC);
 	gtk_scrolled_window_set_hadjustment (GTK_SCROLLED_WINDOW (view), NULL);
 	gtk_scrolled_window_set_vadjustment (GTK_SCROLLED_WINDOW (view), NULL);
 
+	g_signal_connect_object (gtk_scrolled_window_get_vadjustment (GTK_SCROLLED_WINDOW (view)),
+				 "value-changed",
+				 G_CALLBACK (nautilus_view_queue_full_info_request), view,
+				 G_CONNECT_SWAPPED);
+	g_signal_connect_object (gtk_scrolled_window_get_vadjustment (GTK_SCROLLED_WINDOW (view)),
+				 "changed",
+				 G_CALLBACK (nautilus_view_queue_full_info_request), view,
+				 G_CONNECT_SWAPPED);
+
 	gtk_style_context_set_junction_sides (gtk_widget_get_style_context (GTK_WIDGET (view)),
 					      GTK_JUNCTION_TOP | GTK_JUNCTION_LEFT);
 
@@ -2785,6 +2958,12 @@ nautilus_view_destroy (GtkWidget *object)
 		view->details->delayed_rename_file_id = 0;
 	}
 
+	if (view->details->full_info_timeout_id != 0) {
+		g_source_remove (view->details->full_info_timeout_id);
+		view->details->full_info_timeout_id = 0;
+	}
+	nautilus_view_set_shown_files (view, NULL);
+
 	if (view->details->model) {
 		nautilus_directory_unref (view->details->model);
 		view->details->model = NULL;
@@ -2828,6 +3007,8 @@ nautilus_view_finalize (GObject *object)
 	}
 
 	g_hash_table_destroy (view->details->non_ready_files);
+	g_hash_table_destroy (view->details->shown_files);
+	nautilus_selection_model_destroy (view->details->selection_model);
 
 	G_OBJECT_CLASS (nautilus_view_parent_class)->finalize (object);
 }
@@ -3463,7 +3644,6 @@ process_old_files (NautilusView *view)
 {
 	GList *files_added, *files_changed, *node;
 	FileAndDirectory *pending;
-	GList *selection, *files;
 	gboolean send_selection_change;
 
 	files_added = view->details->old_added_files;
@@ -3476,27 +3656,31 @@ process_old_files (NautilusView *view)
 
 		for (node = files_added; node != NULL; node = node->next) {
 			pending = node->data;
+			nautilus_selection_model_add_file (view->details->selection_model,
+							   pending->file);
 			g_signal_emit (view,
 				       signals[ADD_FILE], 0, pending->file, pending->directory);
 		}
 
 		for (node = files_changed; node != NULL; node = node->next) {
 			pending = node->data;
-			g_signal_emit (view,
-				       signals[still_should_show_file (view, pending->file, pending->directory)
-					       ? FILE_CHANGED : REMOVE_FILE], 0,
-				       pending->file, pending->directory);
+			if (still_should_show_file (view, pending->file, pending->directory)) {
+				g_signal_emit (view, signals[FILE_CHANGED], 0,
+					       pending->file, pending->directory);
+			} else {
+				g_signal_emit (view, signals[REMOVE_FILE], 0,
+					       pending->file, pending->directory);
+				nautilus_selection_model_remove_file (view->details->selection_model,
+								      pending->file);
+			}
 		}
 
 		g_signal_emit (view, signals[END_FILE_CHANGES], 0);
 
-		if (files_changed != NULL) {
-			selection = nautilus_view_get_selection (view);
-			files = file_and_directory_list_to_files (files_changed);
-			send_selection_change = eel_g_lists_sort_and_check_for_intersection
-				(&files, &selection);
-			nautilus_file_list_free (files);
-			nautilus_file_list_free (selection);
+		for (node = files_changed; node != NULL && !send_selection_change; node = node->next) {
+			pending = node->data;
+			send_selection_change = nautilus_selection_model_is_selected
+				(view->details->selection_model, pending->file);
 		}
 		
 		file_and_directory_list_free (view->details->old_added_files);
@@ -3526,6 +3710,8 @@ display_pending_files (NautilusView *view)
 	process_new_files (view);
 	process_old_files (view);
 
+	nautilus_view_queue_full_info_request (view);
+
 	if (view->details->model != NULL
 	    && nautilus_directory_are_all_files_seen (view->details->model)
 	    && g_hash_table_size (view->details->non_ready_files) == 0) {
@@ -3922,10 +4108,29 @@ nautilus_view_remove_subdirectory (NautilusView  *view,
 					      view);
 
 	nautilus_directory_file_monitor_remove (directory, &view->details->model);
+	nautilus_selection_model_remove_directory_files (view->details->selection_model,
+							 directory);
 
 	nautilus_directory_unref (directory);
 }
 
+/**
+ * nautilus_view_has_subdirectories:
+ *
+ * Whether files of subdirectories added with
+ * nautilus_view_add_subdirectory() are in the view, so not every file
+ * of the selection model is necessarily shown.
+ * @view: NautilusView of interest.
+ *
+ **/
+gboolean
+nautilus_view_has_subdirectories (NautilusView *view)
+{
+	g_return_val_if_fail (NAUTILUS_IS_VIEW (view), FALSE);
+
+	return view->details->subdirectory_list != NULL;
+}
+
 /**
  * nautilus_view_get_loading:
  * @view: an #NautilusView.
@@ -4563,21 +4768,28 @@ get_all_extension_menu_items (GtkWidget *window,
 	GList *items;
 	GList *providers;
 	GList *l;
+	NautilusModuleOperation *operation;
 	
 	providers = nautilus_module_get_extensions_for_type (NAUTILUS_TYPE_MENU_PROVIDER);
 	items = NULL;
+	operation = nautilus_module_operation_new ("file items");
 
 	for (l = providers; l != NULL; l = l->next) {
 		NautilusMenuProvider *provider;
 		GList *file_items;
 		
 		provider = NAUTILUS_MENU_PROVIDER (l->data);
+		if (!nautilus_module_operation_begin_call (operation, l->data)) {
+			continue;
+		}
 		file_items = nautilus_menu_provider_get_file_items (provider,
 								    window,
 								    selection);
+		nautilus_module_operation_end_call (operation, l->data);
 		items = g_list_concat (items, file_items);		
 	}
 
+	nautilus_module_operation_free (operation);
 	nautilus_module_extension_list_free (providers);
 
 	return items;
@@ -9020,10 +9232,12 @@ nautilus_view_notify_selection_changed (NautilusView *view)
 	
 	g_return_if_fail (NAUTILUS_IS_VIEW (view));
 
-	selection = nautilus_view_get_selection (view);
-	window = nautilus_view_get_containing_window (view);
-	DEBUG_FILES (selection, "Selection changed in window %p", window);
-	nautilus_file_list_free (selection);
+	if (DEBUGGING) {
+		selection = nautilus_view_get_selection (view);
+		window = nautilus_view_get_containing_window (view);
+		DEBUG_FILES (selection, "Selection changed in window %p", window);
+		nautilus_file_list_free (selection);
+	}
 
 	view->details->selection_was_removed = FALSE;
 
@@ -9045,6 +9259,8 @@ nautilus_view_notify_selection_changed (NautilusView *view)
 
 		/* Schedule an update of menu item states to match selection */
 		schedule_update_menus (view);
+
+		update_search_shown_files (view);
 	}
 }
 
@@ -9081,8 +9297,18 @@ load_directory (NautilusView *view,
 
 	nautilus_profile_start (NULL);
 
+	/* Keep the directory we're leaving loaded, in case we come back,
+	 * before dropping our monitors on it.
+	 */
+	if (view->details->model != NULL) {
+		nautilus_warm_directories_add (view->details->model);
+	}
+	nautilus_warm_directories_revisit (directory);
+
 	nautilus_view_stop_loading (view);
 	g_signal_emit (view, signals[CLEAR], 0);
+	nautilus_selection_model_clear (view->details->selection_model);
+	nautilus_view_set_shown_files (view, NULL);
 
 	view->details->loading = TRUE;
 
@@ -32,6 +32,7 @@
 #include <libnautilus-private/nautilus-directory.h>
 #include <libnautilus-private/nautilus-file.h>
 #include <libnautilus-private/nautilus-link.h>
+#include <libnautilus-private/nautilus-selection-model.h>
 
 typedef struct NautilusView NautilusView;
 typedef struct NautilusViewClass NautilusViewClass;
@@ -152,15 +153,6 @@ struct NautilusViewClass {
 	 */
 	GList *	(* get_selection) 	 	(NautilusView *view);
 	
-	/* get_selection_for_file_transfer  is a function pointer for
-	 * subclasses to replace (override). Subclasses must replace it
-	 * with a function that returns a newly-allocated GList of
-	 * NautilusFile pointers. The difference from get_selection is
-	 * that any files in the selection that also has a parent folder
-	 * in the selection is not included.
-	 */
-	GList *	(* get_selection_for_file_transfer)(NautilusView *view);
-	
         /* select_all is a function pointer that subclasses must override to
          * select all of the items in the view */
         void     (* select_all)	         	(NautilusView *view);
@@ -292,6 +284,13 @@ struct NautilusViewClass {
 	void           (* scroll_to_file)	  (NautilusView          *view,
 						   const char            *uri);
 
+	/* Return a ref'd list of the files whose complete information
+	 * should be loaded first, typically the ones on screen, most
+	 * important first. Files not returned keep the cheaper subset
+	 * read when enumerating the directory.
+	 */
+	GList *        (* get_priority_files)     (NautilusView          *view);
+
         /* Signals used only for keybindings */
         gboolean (* trash)                         (NautilusView *view);
         gboolean (* delete)                        (NautilusView *view);
@@ -356,6 +355,7 @@ void                nautilus_view_add_subdirectory                (NautilusView
 								   NautilusDirectory*directory);
 void                nautilus_view_remove_subdirectory             (NautilusView  *view,
 								   NautilusDirectory*directory);
+gboolean            nautilus_view_has_subdirectories              (NautilusView  *view);
 
 gboolean            nautilus_view_is_editable                     (NautilusView *view);
 
@@ -381,6 +381,7 @@ void              nautilus_view_new_file_with_initial_contents (NautilusView *vi
 /* selection handling */
 void              nautilus_view_activate_selection         (NautilusView      *view);
 int               nautilus_view_get_selection_count        (NautilusView      *view);
+NautilusSelectionModel *nautilus_view_get_selection_model (NautilusView      *view);
 GList *           nautilus_view_get_selection              (NautilusView      *view);
 void              nautilus_view_set_selection              (NautilusView      *view,
 							    GList             *selection);
@@ -391,6 +392,9 @@ void              nautilus_view_load_location              (NautilusView      *v
 void              nautilus_view_stop_loading               (NautilusView      *view);
 
 char *            nautilus_view_get_first_visible_file     (NautilusView      *view);
+void              nautilus_view_queue_full_info_request    (NautilusView      *view);
+void              nautilus_view_set_shown_files            (NautilusView      *view,
+							    GList             *files);
 void              nautilus_view_scroll_to_file             (NautilusView      *view,
 							    const char        *uri);
 char *            nautilus_view_get_title                  (NautilusView      *view);
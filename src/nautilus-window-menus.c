@@ -600,9 +600,11 @@ get_extension_menus (NautilusWindow *window)
 	GList *providers;
 	GList *items;
 	GList *l;
+	NautilusModuleOperation *operation;
 	
 	providers = nautilus_module_get_extensions_for_type (NAUTILUS_TYPE_MENU_PROVIDER);
 	items = NULL;
+	operation = nautilus_module_operation_new ("background items");
 
 	slot = nautilus_window_get_active_slot (window);
 	file = nautilus_window_slot_get_file (slot);
@@ -612,12 +614,17 @@ get_extension_menus (NautilusWindow *window)
 		GList *file_items;
 		
 		provider = NAUTILUS_MENU_PROVIDER (l->data);
+		if (!nautilus_module_operation_begin_call (operation, l->data)) {
+			continue;
+		}
 		file_items = nautilus_menu_provider_get_background_items (provider,
 									  GTK_WIDGET (window),
 									  file);
+		nautilus_module_operation_end_call (operation, l->data);
 		items = g_list_concat (items, file_items);
 	}
 
+	nautilus_module_operation_free (operation);
 	nautilus_module_extension_list_free (providers);
 
 	return items;
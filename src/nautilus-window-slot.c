@@ -219,7 +219,8 @@ sync_search_directory (NautilusWindowSlot *slot)
 		location = nautilus_query_editor_get_location (slot->details->query_editor);
 		nautilus_window_slot_open_location (slot, location, 0);
 		g_object_unref (location);
-	} else {
+	} else if (!nautilus_search_directory_refine_query (NAUTILUS_SEARCH_DIRECTORY (directory),
+							    query)) {
 		nautilus_search_directory_set_query (NAUTILUS_SEARCH_DIRECTORY (directory),
 						     query);
 		nautilus_window_slot_force_reload (slot);
@@ -2096,21 +2097,28 @@ slot_add_extension_extra_widgets (NautilusWindowSlot *slot)
 	GtkWidget *widget;
 	char *uri;
 	NautilusWindow *window;
+	NautilusModuleOperation *operation;
 
 	providers = nautilus_module_get_extensions_for_type (NAUTILUS_TYPE_LOCATION_WIDGET_PROVIDER);
 	window = nautilus_window_slot_get_window (slot);
+	operation = nautilus_module_operation_new ("location widget");
 
 	uri = nautilus_window_slot_get_location_uri (slot);
 	for (l = providers; l != NULL; l = l->next) {
 		NautilusLocationWidgetProvider *provider;
 
 		provider = NAUTILUS_LOCATION_WIDGET_PROVIDER (l->data);
+		if (!nautilus_module_operation_begin_call (operation, l->data)) {
+			continue;
+		}
 		widget = nautilus_location_widget_provider_get_widget (provider, uri, GTK_WIDGET (window));
+		nautilus_module_operation_end_call (operation, l->data);
 		if (widget != NULL) {
 			nautilus_window_slot_add_extra_location_widget (slot, widget);
 		}
 	}
 	g_free (uri);
+	nautilus_module_operation_free (operation);
 
 	nautilus_module_extension_list_free (providers);
 }
@@ -0,0 +1,57 @@
+#include <libnautilus-private/nautilus-clipboard.h>
+#include <libnautilus-private/nautilus-clipboard-monitor.h>
+#include <gtk/gtk.h>
+#include <string.h>
+
+#define N_URIS 1000000
+
+int 
+main (int argc, char* argv[])
+{
+	char **uris;
+	char *data;
+	gsize len;
+	gboolean cut;
+	GList *parsed, *l;
+	GTimer *timer;
+	guint i;
+
+	gtk_init (&argc, &argv);
+
+	uris = g_new (char *, N_URIS + 1);
+	for (i = 0; i < N_URIS; i++) {
+		uris[i] = g_strdup_printf ("file:///tmp/nautilus-clipboard-test/file-%07u", i);
+	}
+	uris[N_URIS] = NULL;
+
+	timer = g_timer_new ();
+
+	data = nautilus_clipboard_format_uris (uris, TRUE, FALSE, &len);
+	g_print ("copied %d uris (%" G_GSIZE_FORMAT " bytes) in %f s\n",
+		 N_URIS, len, g_timer_elapsed (timer, NULL));
+
+	g_timer_start (timer);
+	parsed = nautilus_clipboard_parse_uri_list (data, len, &cut);
+	g_print ("pasted %u uris in %f s\n",
+		 g_list_length (parsed), g_timer_elapsed (timer, NULL));
+
+	g_assert (cut);
+	for (i = 0, l = parsed; l != NULL; i++, l = l->next) {
+		g_assert_cmpstr (l->data, ==, uris[i]);
+	}
+	g_assert_cmpuint (i, ==, N_URIS);
+	g_free (data);
+
+	g_timer_start (timer);
+	data = nautilus_clipboard_format_uris (uris, FALSE, TRUE, &len);
+	g_print ("copied %d uris as text in %f s\n",
+		 N_URIS, g_timer_elapsed (timer, NULL));
+	g_assert (g_str_has_prefix (data, "/tmp/nautilus-clipboard-test/file-0000000\n"));
+	g_free (data);
+
+	g_list_free_full (parsed, g_free);
+	g_strfreev (uris);
+	g_timer_destroy (timer);
+
+	return 0;
+}